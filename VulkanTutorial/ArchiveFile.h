@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pch.h"
+
+//Layout of a packed asset archive: header, table of contents sorted by path hash, path strings, then the entry data
+//Entry data starts on 4K boundaries so every entry can be mapped and read without touching its neighbours' pages
+enum class ArchiveCompression : uint32_t {
+	None = 0,
+	LZ4 = 1
+};
+
+struct ArchiveHeader {
+	char identifier[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t alignment;
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+
+	static const uint32_t CURRENT_VERSION = 1;
+	static const uint32_t ALIGNMENT = 4096;
+
+	static ArchiveHeader Create(uint32_t entryCount, uint64_t stringTableOffset, uint64_t stringTableSize) {
+		ArchiveHeader header = {};
+		header.identifier[0] = 'V';
+		header.identifier[1] = 'P';
+		header.identifier[2] = 'A';
+		header.identifier[3] = 'K';
+		header.version = CURRENT_VERSION;
+		header.entryCount = entryCount;
+		header.alignment = ALIGNMENT;
+		header.stringTableOffset = stringTableOffset;
+		header.stringTableSize = stringTableSize;
+
+		return header;
+	}
+
+	bool IsValid() {
+		return identifier[0] == 'V' && identifier[1] == 'P' && identifier[2] == 'A' && identifier[3] == 'K' && version == CURRENT_VERSION;
+	}
+};
+
+struct ArchiveEntry {
+	uint64_t pathHash;
+	uint64_t offset;
+	//The number of bytes stored in the archive, smaller than the uncompressed size for compressed entries
+	uint64_t size;
+	uint64_t uncompressedSize;
+	//Where the entry's path is in the string table, used to tell apart paths with the same hash
+	uint32_t pathOffset;
+	uint32_t pathLength;
+	uint32_t compression;
+	uint32_t reserved;
+};
+
+//Returns the 64 bit FNV-1a hash of a path, paths are stored with forward slashes so both separators hash the same
+inline uint64_t HashArchivePath(const std::string& path) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < path.size(); i++) {
+		hash ^= static_cast<uint8_t>(path[i] == '\\' ? '/' : path[i]);
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "pch.h"
+#include "ArchivePacker.h"
+
+#include <fstream>
+#include <filesystem>
+
+#pragma region Packing
+
+void ArchivePacker::Pack(const std::string& outputPath, const std::vector<std::string>& inputPaths, bool compress)
+{
+	//Gather every file with the same relative path the app will request it by
+	std::vector<std::string> paths;
+
+	for (size_t i = 0; i < inputPaths.size(); i++) {
+		std::filesystem::path inputPath(inputPaths[i]);
+
+		if (std::filesystem::is_regular_file(inputPath)) {
+			paths.push_back(inputPath.lexically_normal().generic_string());
+			continue;
+		}
+
+		if (!std::filesystem::is_directory(inputPath)) {
+			throw std::runtime_error("Failed to find " + inputPaths[i] + " to pack!");
+		}
+
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(inputPath)) {
+			if (entry.is_regular_file()) {
+				paths.push_back(entry.path().lexically_normal().generic_string());
+			}
+		}
+	}
+
+	//The archive can't contain itself if it is written into one of the input directories
+	std::string normalizedOutputPath = std::filesystem::path(outputPath).lexically_normal().generic_string();
+	paths.erase(std::remove(paths.begin(), paths.end(), normalizedOutputPath), paths.end());
+
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	//Sort the table of contents by hash so the reader can binary search it
+	std::vector<ArchiveEntry> entries(paths.size());
+	std::string stringTable;
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		entries[i] = {};
+		entries[i].pathHash = HashArchivePath(paths[i]);
+		entries[i].pathOffset = static_cast<uint32_t>(stringTable.size());
+		entries[i].pathLength = static_cast<uint32_t>(paths[i].size());
+
+		stringTable += paths[i];
+	}
+
+	std::vector<uint32_t> order(paths.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return entries[a].pathHash != entries[b].pathHash ? entries[a].pathHash < entries[b].pathHash : paths[a] < paths[b];
+	});
+
+	uint64_t stringTableOffset = sizeof(ArchiveHeader) + sizeof(ArchiveEntry) * entries.size();
+	uint64_t offset = stringTableOffset + stringTable.size();
+
+	//Read and compress everything up front so the table of contents can be written before the data
+	std::vector<std::vector<char>> contents(paths.size());
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		std::ifstream file(paths[i], std::ios::ate | std::ios::binary);
+
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open " + paths[i] + " to pack!");
+		}
+
+		std::vector<char> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+		entries[i].uncompressedSize = data.size();
+		entries[i].compression = static_cast<uint32_t>(ArchiveCompression::None);
+
+		if (compress && !data.empty()) {
+			std::vector<char> compressed = CompressBlock(data.data(), data.size());
+
+			if (compressed.size() < data.size() * (1.0f - MIN_COMPRESSION_SAVING)) {
+				data = std::move(compressed);
+				entries[i].compression = static_cast<uint32_t>(ArchiveCompression::LZ4);
+			}
+		}
+
+		entries[i].size = data.size();
+		contents[i] = std::move(data);
+	}
+
+	//Data is laid out in path order so related files stay next to each other on disk
+	for (size_t i = 0; i < paths.size(); i++) {
+		offset = (offset + ArchiveHeader::ALIGNMENT - 1) & ~static_cast<uint64_t>(ArchiveHeader::ALIGNMENT - 1);
+		entries[i].offset = offset;
+		offset += entries[i].size;
+	}
+
+	std::vector<ArchiveEntry> sortedEntries(entries.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		sortedEntries[i] = entries[order[i]];
+	}
+
+	ArchiveHeader header = ArchiveHeader::Create(static_cast<uint32_t>(entries.size()), stringTableOffset, stringTable.size());
+	std::ofstream file(outputPath, std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open archive for writing!");
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(ArchiveHeader));
+	file.write(reinterpret_cast<const char*>(sortedEntries.data()), sizeof(ArchiveEntry) * sortedEntries.size());
+	file.write(stringTable.data(), static_cast<std::streamsize>(stringTable.size()));
+
+	const std::vector<char> padding(ArchiveHeader::ALIGNMENT, 0);
+	for (size_t i = 0; i < contents.size(); i++) {
+		file.write(padding.data(), static_cast<std::streamsize>(entries[i].offset - static_cast<uint64_t>(file.tellp())));
+		file.write(contents[i].data(), static_cast<std::streamsize>(contents[i].size()));
+	}
+
+	if (!file) {
+		throw std::runtime_error("Failed to write archive!");
+	}
+}
+
+std::vector<char> ArchivePacker::CompressBlock(const char* data, size_t size)
+{
+	//Matches need 4 bytes, can't start in the last 12 bytes and the last 5 bytes are always literals
+	const size_t MIN_MATCH = 4;
+	const size_t LAST_LITERALS = 5;
+	const size_t MATCH_SEARCH_LIMIT = 12;
+	const size_t MAX_OFFSET = 65535;
+	const uint32_t HASH_BITS = 16;
+
+	const uint8_t* source = reinterpret_cast<const uint8_t*>(data);
+	std::vector<char> output;
+	output.reserve(size + size / 255 + 16);
+
+	//The most recent position of every hashed 4 byte sequence
+	std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, UINT32_MAX);
+
+	auto read32 = [&](size_t position) {
+		uint32_t value;
+		memcpy(&value, source + position, sizeof(uint32_t));
+		return value;
+	};
+
+	auto writeLength = [&](size_t length) {
+		while (length >= 255) {
+			output.push_back(static_cast<char>(255));
+			length -= 255;
+		}
+
+		output.push_back(static_cast<char>(length));
+	};
+
+	auto writeSequence = [&](size_t literalStart, size_t literalLength, size_t matchOffset, size_t matchLength) {
+		uint8_t token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+
+		if (matchLength > 0) {
+			token |= static_cast<uint8_t>(std::min<size_t>(matchLength - MIN_MATCH, 15));
+		}
+
+		output.push_back(static_cast<char>(token));
+
+		if (literalLength >= 15) {
+			writeLength(literalLength - 15);
+		}
+
+		output.insert(output.end(), data + literalStart, data + literalStart + literalLength);
+
+		//The final sequence is literals only
+		if (matchLength == 0) {
+			return;
+		}
+
+		output.push_back(static_cast<char>(matchOffset & 0xFF));
+		output.push_back(static_cast<char>(matchOffset >> 8));
+
+		if (matchLength - MIN_MATCH >= 15) {
+			writeLength(matchLength - MIN_MATCH - 15);
+		}
+	};
+
+	size_t anchor = 0;
+	size_t position = 0;
+
+	while (size >= MATCH_SEARCH_LIMIT && position <= size - MATCH_SEARCH_LIMIT) {
+		uint32_t sequence = read32(position);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		size_t candidate = table[hash];
+		table[hash] = static_cast<uint32_t>(position);
+
+		if (candidate == UINT32_MAX || position - candidate > MAX_OFFSET || read32(candidate) != sequence) {
+			position++;
+			continue;
+		}
+
+		size_t matchLength = MIN_MATCH;
+		while (position + matchLength < size - LAST_LITERALS && source[candidate + matchLength] == source[position + matchLength]) {
+			matchLength++;
+		}
+
+		writeSequence(anchor, position - anchor, position - candidate, matchLength);
+
+		position += matchLength;
+		anchor = position;
+	}
+
+	writeSequence(anchor, size - anchor, 0, 0);
+
+	return output;
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "pch.h"
+#include "ArchiveFile.h"
+
+class ArchivePacker
+{
+public:
+	//Entries are only stored compressed when it saves at least this fraction of their size
+	static constexpr float MIN_COMPRESSION_SAVING = 0.05f;
+
+#pragma region Packing
+
+	/// <summary>
+	/// Packs every file in the input directories into a single archive, entries are named by their path relative to the working directory
+	/// </summary>
+	/// <param name="outputPath">The path of the archive to write</param>
+	/// <param name="inputPaths">Directories to pack recursively or single files</param>
+	/// <param name="compress">Whether entries that shrink enough are stored LZ4 compressed</param>
+	static void Pack(const std::string& outputPath, const std::vector<std::string>& inputPaths, bool compress = true);
+
+	/// <summary>
+	/// Compresses data into the LZ4 block format
+	/// </summary>
+	/// <param name="data">The data to compress</param>
+	/// <param name="size">The size of the data in bytes</param>
+	/// <returns>The compressed block, may be larger than the input for incompressible data</returns>
+	static std::vector<char> CompressBlock(const char* data, size_t size);
+
+#pragma endregion
+};
\ No newline at end of file
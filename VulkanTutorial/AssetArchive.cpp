@@ -0,0 +1,326 @@
+#include "pch.h"
+#include "AssetArchive.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#pragma region Constructor
+
+AssetArchive::AssetArchive()
+{
+	mappedData = nullptr;
+	mappedSize = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+	fileDescriptor = -1;
+	entries = nullptr;
+	entryCount = 0;
+	stringTable = nullptr;
+}
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+#pragma endregion
+
+#pragma region Reading
+
+void AssetArchive::Open(const std::string& filePath)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open archive!");
+	}
+
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		throw std::runtime_error("Failed to read archive!");
+	}
+
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mappingHandle == nullptr) {
+		Close();
+		throw std::runtime_error("Failed to map archive!");
+	}
+
+	mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	fileDescriptor = open(filePath.c_str(), O_RDONLY);
+
+	if (fileDescriptor < 0) {
+		throw std::runtime_error("Failed to open archive!");
+	}
+
+	struct stat fileStatus;
+	if (fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0) {
+		Close();
+		throw std::runtime_error("Failed to read archive!");
+	}
+
+	mappedSize = static_cast<size_t>(fileStatus.st_size);
+	void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	mappedData = mapping == MAP_FAILED ? nullptr : static_cast<const char*>(mapping);
+
+	//Everything in the archive is expected to be loaded during startup so ask for it to be read ahead in one go
+	if (mappedData != nullptr) {
+		madvise(mapping, mappedSize, MADV_WILLNEED);
+	}
+#endif
+
+	if (mappedData == nullptr) {
+		Close();
+		throw std::runtime_error("Failed to map archive!");
+	}
+
+	ArchiveHeader header;
+	if (mappedSize < sizeof(ArchiveHeader)) {
+		Close();
+		throw std::runtime_error("Invalid archive!");
+	}
+
+	memcpy(&header, mappedData, sizeof(ArchiveHeader));
+
+	//Check every table fits in the file before trusting any offsets
+	uint64_t tableEnd = sizeof(ArchiveHeader) + static_cast<uint64_t>(sizeof(ArchiveEntry)) * header.entryCount;
+	if (!header.IsValid() || tableEnd > mappedSize || header.stringTableOffset < tableEnd || header.stringTableOffset > mappedSize || header.stringTableSize > mappedSize - header.stringTableOffset) {
+		Close();
+		throw std::runtime_error("Invalid archive!");
+	}
+
+	entries = reinterpret_cast<const ArchiveEntry*>(mappedData + sizeof(ArchiveHeader));
+	entryCount = header.entryCount;
+	stringTable = mappedData + header.stringTableOffset;
+
+	for (uint32_t i = 0; i < entryCount; i++) {
+		const ArchiveEntry& entry = entries[i];
+
+		if (entry.offset > mappedSize || entry.size > mappedSize - entry.offset || static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > header.stringTableSize) {
+			Close();
+			throw std::runtime_error("Invalid archive entry!");
+		}
+	}
+
+	this->filePath = filePath;
+}
+
+void AssetArchive::Close()
+{
+#ifdef _WIN32
+	if (mappedData != nullptr) {
+		UnmapViewOfFile(mappedData);
+	}
+
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+
+	if (fileHandle != nullptr) {
+		CloseHandle(fileHandle);
+	}
+#else
+	if (mappedData != nullptr) {
+		munmap(const_cast<char*>(mappedData), mappedSize);
+	}
+
+	if (fileDescriptor >= 0) {
+		close(fileDescriptor);
+	}
+#endif
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+	fileDescriptor = -1;
+	entries = nullptr;
+	entryCount = 0;
+	stringTable = nullptr;
+	filePath.clear();
+}
+
+bool AssetArchive::IsOpen() const
+{
+	return mappedData != nullptr;
+}
+
+const ArchiveEntry* AssetArchive::Find(const std::string& path) const
+{
+	if (entries == nullptr) {
+		return nullptr;
+	}
+
+	std::string normalizedPath = path;
+	std::replace(normalizedPath.begin(), normalizedPath.end(), '\\', '/');
+
+	uint64_t hash = HashArchivePath(normalizedPath);
+	const ArchiveEntry* end = entries + entryCount;
+	const ArchiveEntry* entry = std::lower_bound(entries, end, hash, [](const ArchiveEntry& a, uint64_t b) {
+		return a.pathHash < b;
+	});
+
+	//Different paths can share a hash so compare the stored path too
+	for (; entry != end && entry->pathHash == hash; entry++) {
+		if (entry->pathLength == normalizedPath.size() && normalizedPath.compare(0, normalizedPath.size(), stringTable + entry->pathOffset, entry->pathLength) == 0) {
+			return entry;
+		}
+	}
+
+	return nullptr;
+}
+
+bool AssetArchive::Contains(const std::string& path) const
+{
+	return Find(path) != nullptr;
+}
+
+bool AssetArchive::Read(const std::string& path, std::vector<char>& data) const
+{
+	const ArchiveEntry* entry = Find(path);
+
+	if (entry == nullptr) {
+		return false;
+	}
+
+	data.resize(static_cast<size_t>(entry->uncompressedSize));
+
+	switch (static_cast<ArchiveCompression>(entry->compression)) {
+	case ArchiveCompression::None:
+		if (entry->size != entry->uncompressedSize) {
+			throw std::runtime_error("Invalid archive entry!");
+		}
+
+		if (!data.empty()) {
+			memcpy(data.data(), mappedData + entry->offset, data.size());
+		}
+		break;
+	case ArchiveCompression::LZ4:
+		DecompressBlock(mappedData + entry->offset, static_cast<size_t>(entry->size), data.data(), data.size());
+		break;
+	default:
+		throw std::runtime_error("Unsupported archive compression!");
+	}
+
+	return true;
+}
+
+bool AssetArchive::GetView(const std::string& path, const char*& data, size_t& size) const
+{
+	const ArchiveEntry* entry = Find(path);
+
+	if (entry == nullptr || entry->compression != static_cast<uint32_t>(ArchiveCompression::None)) {
+		return false;
+	}
+
+	data = mappedData + entry->offset;
+	size = static_cast<size_t>(entry->size);
+
+	return true;
+}
+
+std::vector<std::string> AssetArchive::GetPaths() const
+{
+	std::vector<std::string> paths(entryCount);
+
+	for (uint32_t i = 0; i < entryCount; i++) {
+		paths[i] = std::string(stringTable + entries[i].pathOffset, entries[i].pathLength);
+	}
+
+	return paths;
+}
+
+const std::string& AssetArchive::GetFilePath() const
+{
+	return filePath;
+}
+
+#pragma endregion
+
+#pragma region Decompression
+
+void AssetArchive::DecompressBlock(const char* source, size_t sourceSize, char* destination, size_t destinationSize)
+{
+	const uint8_t* input = reinterpret_cast<const uint8_t*>(source);
+	const uint8_t* inputEnd = input + sourceSize;
+	size_t written = 0;
+
+	auto readLength = [&](size_t length) {
+		if (length != 15) {
+			return length;
+		}
+
+		uint8_t value;
+		do {
+			if (input >= inputEnd) {
+				throw std::runtime_error("Corrupt archive entry!");
+			}
+
+			value = *input++;
+			length += value;
+		} while (value == 255);
+
+		return length;
+	};
+
+	while (input < inputEnd) {
+		uint8_t token = *input++;
+
+		size_t literalLength = readLength(token >> 4);
+		if (literalLength > static_cast<size_t>(inputEnd - input) || literalLength > destinationSize - written) {
+			throw std::runtime_error("Corrupt archive entry!");
+		}
+
+		memcpy(destination + written, input, literalLength);
+		input += literalLength;
+		written += literalLength;
+
+		//The last sequence ends after its literals
+		if (input == inputEnd) {
+			break;
+		}
+
+		if (inputEnd - input < 2) {
+			throw std::runtime_error("Corrupt archive entry!");
+		}
+
+		size_t offset = input[0] | (static_cast<size_t>(input[1]) << 8);
+		input += 2;
+
+		size_t matchLength = readLength(token & 0x0F) + 4;
+		if (offset == 0 || offset > written || matchLength > destinationSize - written) {
+			throw std::runtime_error("Corrupt archive entry!");
+		}
+
+		//Matches can overlap the bytes they produce so copy one byte at a time
+		const char* match = destination + written - offset;
+		for (size_t i = 0; i < matchLength; i++) {
+			destination[written + i] = match[i];
+		}
+
+		written += matchLength;
+	}
+
+	if (written != destinationSize) {
+		throw std::runtime_error("Corrupt archive entry!");
+	}
+}
+
+#pragma endregion
\ No newline at end of file
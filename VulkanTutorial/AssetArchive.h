@@ -0,0 +1,107 @@
+#pragma once
+
+#include "pch.h"
+#include "ArchiveFile.h"
+
+class AssetArchive
+{
+private:
+	std::string filePath;
+
+	//The whole archive is mapped read only, pages are only read from disk when an entry touches them
+	const char* mappedData;
+	size_t mappedSize;
+
+	//A file handle and mapping handle on Windows, a file descriptor elsewhere
+	void* fileHandle;
+	void* mappingHandle;
+	int fileDescriptor;
+
+	const ArchiveEntry* entries;
+	uint32_t entryCount;
+	const char* stringTable;
+
+public:
+#pragma region Constructor
+
+	AssetArchive();
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	~AssetArchive();
+
+#pragma endregion
+
+#pragma region Reading
+
+	/// <summary>
+	/// Maps an archive into memory and validates its table of contents
+	/// </summary>
+	/// <param name="filePath">The path of the archive to open</param>
+	void Open(const std::string& filePath);
+
+	/// <summary>
+	/// Unmaps the archive, any views into it become invalid
+	/// </summary>
+	void Close();
+
+	/// <summary>
+	/// Returns whether an archive is mapped
+	/// </summary>
+	bool IsOpen() const;
+
+	/// <summary>
+	/// Finds an entry by path with a binary search over the path hashes
+	/// </summary>
+	/// <param name="path">The path relative to the working directory, either separator can be used</param>
+	/// <returns>The entry or nullptr if the archive doesn't contain the path</returns>
+	const ArchiveEntry* Find(const std::string& path) const;
+
+	/// <summary>
+	/// Returns whether the archive contains a path
+	/// </summary>
+	bool Contains(const std::string& path) const;
+
+	/// <summary>
+	/// Copies an entry out of the archive, decompressing it if needed, safe to call from several threads at once
+	/// </summary>
+	/// <param name="path">The path of the entry to read</param>
+	/// <param name="data">Set to the entry's contents</param>
+	/// <returns>False if the archive doesn't contain the path</returns>
+	bool Read(const std::string& path, std::vector<char>& data) const;
+
+	/// <summary>
+	/// Returns a pointer straight into the mapped archive for uncompressed entries
+	/// </summary>
+	/// <param name="path">The path of the entry to view</param>
+	/// <param name="data">Set to the start of the entry's contents</param>
+	/// <param name="size">Set to the size of the entry</param>
+	/// <returns>False if the archive doesn't contain the path or the entry is compressed</returns>
+	bool GetView(const std::string& path, const char*& data, size_t& size) const;
+
+	/// <summary>
+	/// Returns the path of every entry in table of contents order
+	/// </summary>
+	std::vector<std::string> GetPaths() const;
+
+	/// <summary>
+	/// Returns the path of the open archive
+	/// </summary>
+	const std::string& GetFilePath() const;
+
+#pragma endregion
+
+#pragma region Decompression
+
+	/// <summary>
+	/// Decompresses an LZ4 block written by ArchivePacker::CompressBlock, throws if the block is corrupt or doesn't decompress to exactly the expected size
+	/// </summary>
+	/// <param name="source">The compressed block</param>
+	/// <param name="sourceSize">The size of the compressed block in bytes</param>
+	/// <param name="destination">Where the data is written</param>
+	/// <param name="destinationSize">The size of the data before it was compressed</param>
+	static void DecompressBlock(const char* source, size_t sourceSize, char* destination, size_t destinationSize);
+
+#pragma endregion
+};
\ No newline at end of file
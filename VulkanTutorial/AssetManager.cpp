@@ -0,0 +1,332 @@
+#include "pch.h"
+#include "AssetManager.h"
+
+#include <fstream>
+#include <filesystem>
+
+#pragma region Asset
+
+Asset::Asset(const std::string& path, AssetStage decode, AssetStage upload)
+{
+	this->path = path;
+	this->decode = decode;
+	this->upload = upload;
+	state = AssetState::Queued;
+}
+
+const std::string& Asset::GetPath()
+{
+	return path;
+}
+
+AssetState Asset::GetState()
+{
+	return state;
+}
+
+bool Asset::IsReady()
+{
+	return state == AssetState::Ready;
+}
+
+bool Asset::IsDone()
+{
+	return state == AssetState::Ready || state == AssetState::Failed;
+}
+
+const std::string& Asset::GetError()
+{
+	return error;
+}
+
+const std::vector<char>& Asset::GetData()
+{
+	return data;
+}
+
+void Asset::ReleaseData()
+{
+	data.clear();
+	data.shrink_to_fit();
+}
+
+void Asset::SetPayload(std::shared_ptr<void> value)
+{
+	payload = value;
+}
+
+#pragma endregion
+
+#pragma region Constructor
+
+AssetManager::AssetManager(uint32_t workerCount)
+{
+	stopping = false;
+	pendingCount = 0;
+
+	if (workerCount == 0) {
+		//hardware_concurrency returns 0 when the core count is unknown
+		workerCount = std::thread::hardware_concurrency();
+		workerCount = workerCount == 0 ? 1 : workerCount;
+
+		if (workerCount > MAX_WORKER_THREADS) {
+			workerCount = MAX_WORKER_THREADS;
+		}
+	}
+
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.push_back(std::thread(&AssetManager::WorkerLoop, this));
+	}
+}
+
+AssetManager::~AssetManager()
+{
+	Cleanup();
+}
+
+void AssetManager::Cleanup()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+
+		for (size_t i = 0; i < queued.size(); i++) {
+			queued[i]->error = "Asset manager was cleaned up before the asset loaded!";
+			queued[i]->state = AssetState::Failed;
+		}
+
+		pendingCount -= static_cast<uint32_t>(queued.size());
+		queued.clear();
+	}
+
+	//Wake anything waiting on an asset that will now never load
+	workAvailable.notify_all();
+	workCompleted.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+
+	workers.clear();
+}
+
+#pragma endregion
+
+#pragma region Loading
+
+AssetHandle AssetManager::Load(const std::string& path, AssetStage decode, AssetStage upload)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	//Handing out the existing asset keeps every file from being read more than once while something still uses it
+	auto cached = cache.find(path);
+	if (cached != cache.end()) {
+		AssetHandle asset = cached->second.lock();
+
+		if (asset != nullptr) {
+			return asset;
+		}
+	}
+
+	AssetHandle asset = std::make_shared<Asset>(path, decode, upload);
+	cache[path] = asset;
+
+	//Nothing will ever pick the asset up once the workers have stopped
+	if (workers.empty()) {
+		asset->error = "Asset manager has been cleaned up!";
+		asset->state = AssetState::Failed;
+		return asset;
+	}
+
+	queued.push_back(asset);
+	pendingCount++;
+	workAvailable.notify_one();
+
+	return asset;
+}
+
+AssetHandle AssetManager::Wait(const AssetHandle& asset)
+{
+	bool finish = false;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		workCompleted.wait(lock, [&]() {
+			AssetState state = asset->GetState();
+			return state == AssetState::Decoded || asset->IsDone();
+		});
+
+		//Take the asset out of the completed list so Update doesn't finish it a second time
+		auto position = std::find(completed.begin(), completed.end(), asset);
+		if (position != completed.end()) {
+			completed.erase(position);
+			finish = true;
+		}
+	}
+
+	if (finish) {
+		FinishAsset(*asset);
+	}
+
+	if (asset->GetState() == AssetState::Failed) {
+		throw std::runtime_error("Failed to load " + asset->GetPath() + ": " + asset->GetError());
+	}
+
+	return asset;
+}
+
+std::vector<AssetHandle> AssetManager::Update(uint32_t maxUploads)
+{
+	std::vector<AssetHandle> finished;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		while (!completed.empty() && finished.size() < maxUploads) {
+			finished.push_back(completed.front());
+			completed.pop_front();
+		}
+	}
+
+	//Uploads run outside the lock so the workers can keep reading while the GPU work is recorded
+	for (size_t i = 0; i < finished.size(); i++) {
+		FinishAsset(*finished[i]);
+	}
+
+	return finished;
+}
+
+uint32_t AssetManager::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pendingCount;
+}
+
+void AssetManager::MountArchive(std::shared_ptr<AssetArchive> value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	archive = value;
+}
+
+bool AssetManager::Exists(const std::string& path)
+{
+	std::shared_ptr<AssetArchive> mountedArchive;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		mountedArchive = archive;
+	}
+
+	if (mountedArchive != nullptr && mountedArchive->Contains(path)) {
+		return true;
+	}
+
+	std::error_code error;
+	return std::filesystem::is_regular_file(path, error);
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void AssetManager::WorkerLoop()
+{
+	while (true) {
+		AssetHandle asset;
+		std::shared_ptr<AssetArchive> mountedArchive;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [&]() {
+				return stopping || !queued.empty();
+			});
+
+			if (stopping) {
+				return;
+			}
+
+			asset = queued.front();
+			queued.pop_front();
+			mountedArchive = archive;
+		}
+
+		asset->state = AssetState::Loading;
+		AssetState result = AssetState::Decoded;
+
+		try {
+			ReadAsset(*asset, mountedArchive);
+
+			if (asset->decode) {
+				asset->decode(*asset);
+			}
+		}
+		catch (const std::exception& e) {
+			asset->error = e.what();
+			asset->upload = nullptr;
+			result = AssetState::Failed;
+		}
+
+		asset->decode = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			//The state only changes under the lock so Wait never sees a decoded asset that isn't in the completed list yet
+			asset->state = result;
+			completed.push_back(asset);
+
+			//Failed assets have nothing left to run, decoded ones wait for their upload on the polling thread
+			if (result == AssetState::Failed) {
+				pendingCount--;
+			}
+		}
+
+		workCompleted.notify_all();
+	}
+}
+
+void AssetManager::ReadAsset(Asset& asset, const std::shared_ptr<AssetArchive>& archive)
+{
+	if (archive != nullptr && archive->Read(asset.path, asset.data)) {
+		return;
+	}
+
+	std::ifstream file(asset.path, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file!");
+	}
+
+	//Size the buffer from the end position so the whole file comes in with a single read
+	asset.data.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(asset.data.data(), static_cast<std::streamsize>(asset.data.size()));
+
+	if (!file) {
+		throw std::runtime_error("Failed to read file!");
+	}
+}
+
+void AssetManager::FinishAsset(Asset& asset)
+{
+	if (asset.GetState() == AssetState::Decoded) {
+		try {
+			if (asset.upload) {
+				asset.upload(asset);
+			}
+
+			asset.state = AssetState::Ready;
+		}
+		catch (const std::exception& e) {
+			asset.error = e.what();
+			asset.state = AssetState::Failed;
+		}
+
+		asset.upload = nullptr;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingCount--;
+	}
+}
+
+#pragma endregion
\ No newline at end of file
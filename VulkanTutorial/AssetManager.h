@@ -0,0 +1,207 @@
+#pragma once
+
+#include "pch.h"
+#include "AssetArchive.h"
+
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class Asset;
+class AssetManager;
+
+//Shared by every request for the same path, the asset is dropped from the cache once the last handle is released
+typedef std::shared_ptr<Asset> AssetHandle;
+
+//A step of loading an asset, decoding runs on a worker thread and uploading on the thread that polls the manager
+typedef std::function<void(Asset& asset)> AssetStage;
+
+enum class AssetState {
+	Queued,
+	Loading,
+	Decoded,
+	Ready,
+	Failed
+};
+
+class Asset
+{
+private:
+	friend class AssetManager;
+
+	std::string path;
+	std::atomic<AssetState> state;
+	std::string error;
+
+	std::vector<char> data;
+	std::shared_ptr<void> payload;
+
+	AssetStage decode;
+	AssetStage upload;
+
+public:
+#pragma region Constructor
+
+	Asset(const std::string& path, AssetStage decode, AssetStage upload);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the path the asset was requested with
+	/// </summary>
+	const std::string& GetPath();
+
+	/// <summary>
+	/// Returns how far through loading the asset is
+	/// </summary>
+	AssetState GetState();
+
+	/// <summary>
+	/// Returns whether every stage has finished successfully
+	/// </summary>
+	bool IsReady();
+
+	/// <summary>
+	/// Returns whether loading has finished, successfully or not
+	/// </summary>
+	bool IsDone();
+
+	/// <summary>
+	/// Returns why loading failed, empty unless the state is failed
+	/// </summary>
+	const std::string& GetError();
+
+	/// <summary>
+	/// Returns the contents of the file, empty after a stage releases it
+	/// </summary>
+	const std::vector<char>& GetData();
+
+	/// <summary>
+	/// Frees the contents of the file once a stage has turned them into something else
+	/// </summary>
+	void ReleaseData();
+
+	/// <summary>
+	/// Returns the object a stage produced from the file
+	/// </summary>
+	template<typename T>
+	std::shared_ptr<T> GetPayload() {
+		return std::static_pointer_cast<T>(payload);
+	}
+
+	/// <summary>
+	/// Sets the object produced from the file, the next stage and the asset's users read it with GetPayload
+	/// </summary>
+	void SetPayload(std::shared_ptr<void> value);
+
+#pragma endregion
+};
+
+class AssetManager
+{
+private:
+	std::vector<std::thread> workers;
+	bool stopping;
+
+	//Guards everything below
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workCompleted;
+
+	std::unordered_map<std::string, std::weak_ptr<Asset>> cache;
+	//Checked before the file system when set
+	std::shared_ptr<AssetArchive> archive;
+	std::deque<AssetHandle> queued;
+	//Assets that finished on a worker and are waiting for their upload stage
+	std::deque<AssetHandle> completed;
+	uint32_t pendingCount;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Reads and decodes queued assets until the manager is cleaned up
+	/// </summary>
+	void WorkerLoop();
+
+	/// <summary>
+	/// Reads a whole file out of the archive, or from disk with one positioned read if the archive doesn't contain it
+	/// </summary>
+	static void ReadAsset(Asset& asset, const std::shared_ptr<AssetArchive>& archive);
+
+	/// <summary>
+	/// Runs an asset's upload stage and marks it ready
+	/// </summary>
+	void FinishAsset(Asset& asset);
+
+#pragma endregion
+
+public:
+	//File reads are mostly waiting on the disk so a few workers are enough to keep it busy
+	static const uint32_t MAX_WORKER_THREADS = 4;
+
+#pragma region Constructor
+
+	/// <summary>
+	/// Starts the worker threads
+	/// </summary>
+	/// <param name="workerCount">The number of worker threads, 0 picks one per core up to the maximum</param>
+	AssetManager(uint32_t workerCount = 0);
+
+	~AssetManager();
+
+	/// <summary>
+	/// Stops the worker threads, assets that haven't started loading are dropped
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Loading
+
+	/// <summary>
+	/// Requests an asset and returns straight away, requests for a path that is already loaded or in flight share the same asset and ignore the new stages
+	/// </summary>
+	/// <param name="path">The path of the file to load</param>
+	/// <param name="decode">Run on a worker thread after the file is read, must not touch the GPU</param>
+	/// <param name="upload">Run on the polling thread after decoding, used for GPU uploads</param>
+	/// <returns>A handle to the asset</returns>
+	AssetHandle Load(const std::string& path, AssetStage decode = nullptr, AssetStage upload = nullptr);
+
+	/// <summary>
+	/// Blocks until an asset has loaded, running its upload stage on the calling thread, throws if loading failed
+	/// </summary>
+	/// <param name="asset">The asset to wait for</param>
+	/// <returns>The same asset</returns>
+	AssetHandle Wait(const AssetHandle& asset);
+
+	/// <summary>
+	/// Runs the upload stage of assets that finished on the workers, called at the start of every frame
+	/// </summary>
+	/// <param name="maxUploads">The maximum number of assets to finish this call</param>
+	/// <returns>The assets that became ready or failed</returns>
+	std::vector<AssetHandle> Update(uint32_t maxUploads = UINT32_MAX);
+
+	/// <summary>
+	/// Returns the number of assets that haven't finished loading
+	/// </summary>
+	uint32_t GetPendingCount();
+
+	/// <summary>
+	/// Serves loads from a packed archive, paths the archive doesn't contain still load from disk
+	/// </summary>
+	/// <param name="value">The open archive, or nullptr to only load from disk</param>
+	void MountArchive(std::shared_ptr<AssetArchive> value);
+
+	/// <summary>
+	/// Returns whether a path can be loaded from the mounted archive or from disk
+	/// </summary>
+	bool Exists(const std::string& path);
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include "TriangleApp.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <iomanip>
+#include <cmath>
+
+#pragma region Running
+
+void Benchmark::Run(const std::vector<std::string>& arguments)
+{
+	std::string outputPath;
+	std::string memoryLogPath;
+	uint32_t warmupFrames = DEFAULT_WARMUP_FRAMES;
+	uint32_t measuredFrames = DEFAULT_MEASURED_FRAMES;
+	bool quick = false;
+
+	for (size_t i = 0; i < arguments.size(); i++) {
+		if (arguments[i] == "--quick") {
+			quick = true;
+		}
+		else if ((arguments[i] == "--frames" || arguments[i] == "--warmup") && i + 1 < arguments.size()) {
+			uint32_t value = static_cast<uint32_t>(std::stoul(arguments[i + 1]));
+			(arguments[i] == "--frames" ? measuredFrames : warmupFrames) = value;
+			i++;
+		}
+		else if (arguments[i] == "--memory-log" && i + 1 < arguments.size()) {
+			memoryLogPath = arguments[i + 1];
+			i++;
+		}
+		else if (outputPath.empty() && arguments[i].rfind("--", 0) != 0) {
+			outputPath = arguments[i];
+		}
+		else {
+			throw std::runtime_error("Unknown benchmark argument " + arguments[i] + "!");
+		}
+	}
+
+	if (measuredFrames == 0) {
+		throw std::runtime_error("The benchmark needs at least one measured frame!");
+	}
+
+	std::vector<BenchmarkConfig> configs = CreateSweep(quick);
+	std::vector<BenchmarkResult> results;
+
+	//One row per measured frame of every configuration
+	std::ofstream memoryLog;
+
+	if (!memoryLogPath.empty()) {
+		memoryLog.open(memoryLogPath);
+
+		if (!memoryLog.is_open()) {
+			throw std::runtime_error("Failed to open " + memoryLogPath + " for writing!");
+		}
+
+		memoryLog << "sweep,instances,meshes,sphereResolution,lights,framesInFlight,frame,";
+		MemoryTelemetry::WriteCSVHeader(memoryLog);
+		memoryLog << std::endl;
+	}
+
+	for (size_t i = 0; i < configs.size(); i++) {
+		const BenchmarkConfig& config = configs[i];
+		std::cerr << "[" << i + 1 << "/" << configs.size() << "] " << config.sweep << ": " << config.instanceCount << " instances, " << config.meshCount << " meshes, sphere resolution " << config.sphereResolution << ", " << config.lightCount << " lights, " << config.framesInFlight << " frames in flight" << std::endl;
+
+		//Every configuration gets its own device and window so nothing carries over between runs
+		std::unique_ptr<TriangleApp> app = std::make_unique<TriangleApp>(static_cast<int>(config.framesInFlight));
+		results.push_back(app->RunBenchmark(config, warmupFrames, measuredFrames, memoryLog.is_open() ? &memoryLog : nullptr));
+	}
+
+	if (memoryLog.is_open() && !memoryLog.flush()) {
+		throw std::runtime_error("Failed to write the memory log!");
+	}
+
+	if (outputPath.empty()) {
+		WriteCSV(std::cout, results);
+		return;
+	}
+
+	std::ofstream file(outputPath);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open " + outputPath + " for writing!");
+	}
+
+	if (std::filesystem::path(outputPath).extension() == ".json") {
+		WriteJSON(file, results);
+	}
+	else {
+		WriteCSV(file, results);
+	}
+
+	if (!file) {
+		throw std::runtime_error("Failed to write benchmark results!");
+	}
+}
+
+std::vector<BenchmarkConfig> Benchmark::CreateSweep(bool quick)
+{
+	std::vector<uint32_t> instanceCounts = { 1000, 10000, 100000, 1000000 };
+	std::vector<uint32_t> meshCounts = { 1, 4, 16, 64 };
+	std::vector<uint32_t> sphereResolutions = { 8, 16, 32, 64 };
+	std::vector<uint32_t> lightCounts = { 1, 16, 256, 4096 };
+	std::vector<uint32_t> framesInFlight = { 1, 2, 3 };
+
+	if (quick) {
+		instanceCounts.pop_back();
+		meshCounts.pop_back();
+		sphereResolutions.pop_back();
+		lightCounts.pop_back();
+	}
+
+	std::vector<BenchmarkConfig> configs;
+
+	auto addSweep = [&](const std::string& name, const std::vector<uint32_t>& values, uint32_t BenchmarkConfig::* parameter) {
+		for (uint32_t value : values) {
+			BenchmarkConfig config;
+			config.sweep = name;
+			config.*parameter = value;
+			configs.push_back(config);
+		}
+	};
+
+	addSweep("instances", instanceCounts, &BenchmarkConfig::instanceCount);
+	addSweep("meshes", meshCounts, &BenchmarkConfig::meshCount);
+	addSweep("sphereResolution", sphereResolutions, &BenchmarkConfig::sphereResolution);
+	addSweep("lights", lightCounts, &BenchmarkConfig::lightCount);
+	addSweep("framesInFlight", framesInFlight, &BenchmarkConfig::framesInFlight);
+
+	return configs;
+}
+
+#pragma endregion
+
+#pragma region Output
+
+void Benchmark::WriteCSV(std::ostream& stream, const std::vector<BenchmarkResult>& results)
+{
+	stream << CSV_HEADER << std::endl;
+
+	for (const BenchmarkResult& result : results) {
+		const BenchmarkConfig& config = result.config;
+
+		//Device names can contain commas so they are always quoted
+		std::string device = result.device;
+		for (size_t i = device.find('"'); i != std::string::npos; i = device.find('"', i + 2)) {
+			device.insert(i, 1, '"');
+		}
+
+		stream << config.sweep << "," << config.instanceCount << "," << config.meshCount << "," << config.sphereResolution << "," << config.lightCount << "," << config.framesInFlight << ","
+			<< "\"" << device << "\"," << (result.occlusionCulling ? 1 : 0) << "," << result.frames << ","
+			<< result.cpuFrameTime << "," << result.cpuFrameTimeP95 << "," << result.gpuFrameTime << ","
+			<< result.uploadBytes << "," << result.drawCalls << "," << result.deviceMemory << ",";
+
+		for (uint64_t memory : result.categoryMemory) {
+			stream << memory << ",";
+		}
+
+		stream << result.hostMemory << "," << result.heapUsage << "," << result.heapBudget << std::endl;
+	}
+}
+
+void Benchmark::WriteJSON(std::ostream& stream, const std::vector<BenchmarkResult>& results)
+{
+	stream << "[" << std::endl;
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& result = results[i];
+		const BenchmarkConfig& config = result.config;
+
+		std::string device;
+		for (char character : result.device) {
+			if (character == '"' || character == '\\') {
+				device += '\\';
+			}
+
+			device += character;
+		}
+
+		stream << "\t{ \"sweep\": \"" << config.sweep << "\", \"instances\": " << config.instanceCount << ", \"meshes\": " << config.meshCount
+			<< ", \"sphereResolution\": " << config.sphereResolution << ", \"lights\": " << config.lightCount << ", \"framesInFlight\": " << config.framesInFlight
+			<< ", \"device\": \"" << device << "\", \"occlusionCulling\": " << (result.occlusionCulling ? "true" : "false") << ", \"frames\": " << result.frames
+			<< ", \"cpuFrameMs\": " << result.cpuFrameTime << ", \"cpuFrameP95Ms\": " << result.cpuFrameTimeP95 << ", \"gpuFrameMs\": " << result.gpuFrameTime
+			<< ", \"uploadBytesPerFrame\": " << result.uploadBytes << ", \"drawCallsPerFrame\": " << result.drawCalls << ", \"deviceMemoryBytes\": " << result.deviceMemory;
+
+		for (uint32_t j = 0; j < MEMORY_CATEGORY_COUNT; j++) {
+			stream << ", \"" << MemoryTelemetry::GetCategoryName(static_cast<MemoryCategory>(j)) << "Bytes\": " << result.categoryMemory[j];
+		}
+
+		stream << ", \"hostMemoryBytes\": " << result.hostMemory << ", \"heapUsageBytes\": " << result.heapUsage << ", \"heapBudgetBytes\": " << result.heapBudget
+			<< " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+
+	stream << "]" << std::endl;
+}
+
+std::vector<BenchmarkResult> Benchmark::ReadCSV(std::istream& stream)
+{
+	std::string line;
+
+	if (!std::getline(stream, line) || line != CSV_HEADER) {
+		throw std::runtime_error("Not a benchmark results file!");
+	}
+
+	std::vector<BenchmarkResult> results;
+
+	while (std::getline(stream, line)) {
+		if (line.empty()) {
+			continue;
+		}
+
+		//Split on commas outside of quotes, a doubled quote inside quotes is a literal quote
+		std::vector<std::string> fields(1);
+		bool quoted = false;
+
+		for (size_t i = 0; i < line.size(); i++) {
+			if (line[i] == '"') {
+				if (quoted && i + 1 < line.size() && line[i + 1] == '"') {
+					fields.back() += '"';
+					i++;
+				}
+				else {
+					quoted = !quoted;
+				}
+			}
+			else if (line[i] == ',' && !quoted) {
+				fields.emplace_back();
+			}
+			else {
+				fields.back() += line[i];
+			}
+		}
+
+		if (fields.size() != 25) {
+			throw std::runtime_error("Invalid benchmark result row: " + line);
+		}
+
+		BenchmarkResult result;
+		result.config.sweep = fields[0];
+		result.config.instanceCount = static_cast<uint32_t>(std::stoul(fields[1]));
+		result.config.meshCount = static_cast<uint32_t>(std::stoul(fields[2]));
+		result.config.sphereResolution = static_cast<uint32_t>(std::stoul(fields[3]));
+		result.config.lightCount = static_cast<uint32_t>(std::stoul(fields[4]));
+		result.config.framesInFlight = static_cast<uint32_t>(std::stoul(fields[5]));
+		result.device = fields[6];
+		result.occlusionCulling = fields[7] == "1";
+		result.frames = static_cast<uint32_t>(std::stoul(fields[8]));
+		result.cpuFrameTime = std::stod(fields[9]);
+		result.cpuFrameTimeP95 = std::stod(fields[10]);
+		result.gpuFrameTime = std::stod(fields[11]);
+		result.uploadBytes = std::stod(fields[12]);
+		result.drawCalls = std::stod(fields[13]);
+		result.deviceMemory = std::stoull(fields[14]);
+
+		for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+			result.categoryMemory[i] = std::stoull(fields[15 + i]);
+		}
+
+		result.hostMemory = std::stoull(fields[22]);
+		result.heapUsage = std::stoull(fields[23]);
+		result.heapBudget = std::stoull(fields[24]);
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+#pragma endregion
+
+#pragma region Comparison
+
+void Benchmark::Compare(const std::vector<std::string>& arguments)
+{
+	if (arguments.size() != 2) {
+		throw std::runtime_error("Expected a baseline and a candidate results file!");
+	}
+
+	std::vector<BenchmarkResult> results[2];
+
+	for (size_t i = 0; i < 2; i++) {
+		std::ifstream file(arguments[i]);
+
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open " + arguments[i] + "!");
+		}
+
+		results[i] = ReadCSV(file);
+	}
+
+	auto getName = [](const BenchmarkConfig& config) {
+		return config.sweep + " " + std::to_string(config.instanceCount) + "/" + std::to_string(config.meshCount) + "/" + std::to_string(config.sphereResolution) + "/" + std::to_string(config.lightCount) + "/" + std::to_string(config.framesInFlight);
+	};
+
+	auto getChange = [](double baseline, double candidate) {
+		return baseline > 0.0 ? (candidate / baseline - 1.0) * 100.0 : 0.0;
+	};
+
+	std::cout << std::left << std::setw(48) << "Sweep instances/meshes/resolution/lights/frames" << std::right << std::setw(14) << "Baseline ms" << std::setw(14) << "Candidate ms" << std::setw(10) << "CPU %" << std::setw(10) << "P95 %" << std::setw(10) << "GPU %" << std::setw(10) << "Memory %" << std::setw(10) << "Host %" << std::endl;
+
+	double logRatioSum = 0.0;
+	uint32_t compared = 0;
+
+	for (const BenchmarkResult& candidate : results[1]) {
+		std::string name = getName(candidate.config);
+		auto baseline = std::find_if(results[0].begin(), results[0].end(), [&](const BenchmarkResult& result) {
+			return getName(result.config) == name;
+		});
+
+		if (baseline == results[0].end()) {
+			std::cerr << "No baseline for " << name << std::endl;
+			continue;
+		}
+
+		std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3) << std::setw(14) << baseline->cpuFrameTime << std::setw(14) << candidate.cpuFrameTime
+			<< std::showpos << std::setprecision(1) << std::setw(10) << getChange(baseline->cpuFrameTime, candidate.cpuFrameTime) << std::setw(10) << getChange(baseline->cpuFrameTimeP95, candidate.cpuFrameTimeP95)
+			<< std::setw(10) << getChange(baseline->gpuFrameTime, candidate.gpuFrameTime) << std::setw(10) << getChange(static_cast<double>(baseline->deviceMemory), static_cast<double>(candidate.deviceMemory))
+			<< std::setw(10) << getChange(static_cast<double>(baseline->hostMemory), static_cast<double>(candidate.hostMemory)) << std::noshowpos << std::defaultfloat << std::endl;
+
+		if (baseline->cpuFrameTime > 0.0 && candidate.cpuFrameTime > 0.0) {
+			logRatioSum += std::log(candidate.cpuFrameTime / baseline->cpuFrameTime);
+			compared++;
+		}
+	}
+
+	if (compared == 0) {
+		throw std::runtime_error("The result files have no configurations in common!");
+	}
+
+	//The geometric mean keeps one large scene from outweighing the rest
+	std::cout << "Mean CPU frame time change over " << compared << " configurations: " << std::showpos << std::fixed << std::setprecision(1) << (std::exp(logRatioSum / compared) - 1.0) * 100.0 << "%" << std::noshowpos << std::defaultfloat << std::endl;
+}
+
+#pragma endregion
\ No newline at end of file
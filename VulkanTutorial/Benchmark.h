@@ -0,0 +1,97 @@
+#pragma once
+
+#include "pch.h"
+#include "MemoryTelemetry.h"
+
+#include <istream>
+#include <ostream>
+
+//One point of a benchmark sweep, the parameters that aren't being swept stay at these baseline values
+struct BenchmarkConfig {
+	//The parameter this configuration varies, written out so results can be grouped into curves
+	std::string sweep = "baseline";
+	uint32_t instanceCount = 10000;
+	uint32_t meshCount = 2;
+	uint32_t sphereResolution = 16;
+	uint32_t lightCount = 16;
+	uint32_t framesInFlight = 2;
+};
+
+//Per frame averages over the measured frames of one configuration
+struct BenchmarkResult {
+	BenchmarkConfig config;
+	std::string device;
+	//Occlusion culling is turned off for scenes larger than the cull buffers
+	bool occlusionCulling = false;
+	uint32_t frames = 0;
+	//Wall clock time of Update and DrawFrame in milliseconds, including any waits on the GPU
+	double cpuFrameTime = 0.0;
+	double cpuFrameTimeP95 = 0.0;
+	//Time between the first and last command of each frame in milliseconds, zero if the device can't write timestamps
+	double gpuFrameTime = 0.0;
+	double uploadBytes = 0.0;
+	double drawCalls = 0.0;
+	//The most device memory held by buffers and images during the measured frames
+	uint64_t deviceMemory = 0;
+	//The most device memory held by each category, the categories don't necessarily peak on the same frame
+	std::array<uint64_t, MEMORY_CATEGORY_COUNT> categoryMemory = {};
+	//The most CPU memory allocated with operator new during the measured frames
+	uint64_t hostMemory = 0;
+	//The highest device local heap usage the driver reported and the budget at that frame, zero without VK_EXT_memory_budget
+	uint64_t heapUsage = 0;
+	uint64_t heapBudget = 0;
+};
+
+class Benchmark
+{
+public:
+	static const uint32_t DEFAULT_WARMUP_FRAMES = 60;
+	static const uint32_t DEFAULT_MEASURED_FRAMES = 300;
+	static constexpr const char* CSV_HEADER = "sweep,instances,meshes,sphereResolution,lights,framesInFlight,device,occlusionCulling,frames,cpuFrameMs,cpuFrameP95Ms,gpuFrameMs,uploadBytesPerFrame,drawCallsPerFrame,deviceMemoryBytes,"
+		"geometryBytes,instancesBytes,uniformsBytes,texturesBytes,attachmentsBytes,stagingBytes,otherBytes,hostMemoryBytes,heapUsageBytes,heapBudgetBytes";
+
+#pragma region Running
+
+	/// <summary>
+	/// Runs every configuration of the sweep in a fresh renderer and writes the results, CSV is written to the console without an output path
+	/// </summary>
+	/// <param name="arguments">The arguments after --benchmark: [output.csv|output.json] [--frames N] [--warmup N] [--quick] [--memory-log memory.csv]</param>
+	static void Run(const std::vector<std::string>& arguments);
+
+	/// <summary>
+	/// Creates the configurations to run, each sweep varies one parameter away from the baseline
+	/// </summary>
+	/// <param name="quick">Whether to leave out the largest configurations</param>
+	static std::vector<BenchmarkConfig> CreateSweep(bool quick);
+
+#pragma endregion
+
+#pragma region Output
+
+	/// <summary>
+	/// Writes one row per result with a header row, columns are in the same order as the JSON fields
+	/// </summary>
+	static void WriteCSV(std::ostream& stream, const std::vector<BenchmarkResult>& results);
+
+	/// <summary>
+	/// Writes the results as an array of objects
+	/// </summary>
+	static void WriteJSON(std::ostream& stream, const std::vector<BenchmarkResult>& results);
+
+	/// <summary>
+	/// Reads results written by WriteCSV
+	/// </summary>
+	static std::vector<BenchmarkResult> ReadCSV(std::istream& stream);
+
+#pragma endregion
+
+#pragma region Comparison
+
+	/// <summary>
+	/// Prints the change in frame times and peak memory for every configuration found in both result files, used to check optimized builds against a baseline
+	/// </summary>
+	/// <param name="arguments">The arguments after --compare: baseline.csv candidate.csv</param>
+	static void Compare(const std::vector<std::string>& arguments);
+
+#pragma endregion
+};
\ No newline at end of file
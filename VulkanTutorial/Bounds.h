@@ -0,0 +1,165 @@
+#pragma once
+
+#include "pch.h"
+
+#include <limits>
+
+//An axis aligned box, starts empty so the first point grown into it becomes both corners
+struct AABB {
+	glm::vec3 minimum;
+	glm::vec3 maximum;
+
+	AABB(glm::vec3 minimum = glm::vec3(std::numeric_limits<float>::max()), glm::vec3 maximum = glm::vec3(-std::numeric_limits<float>::max())) {
+		this->minimum = minimum;
+		this->maximum = maximum;
+	}
+
+	void grow(glm::vec3 point) {
+		minimum = glm::min(minimum, point);
+		maximum = glm::max(maximum, point);
+	}
+
+	void grow(const AABB& other) {
+		minimum = glm::min(minimum, other.minimum);
+		maximum = glm::max(maximum, other.maximum);
+	}
+
+	bool isEmpty() const {
+		return minimum.x > maximum.x || minimum.y > maximum.y || minimum.z > maximum.z;
+	}
+
+	glm::vec3 getCenter() const {
+		return (minimum + maximum) * 0.5f;
+	}
+
+	float getSurfaceArea() const {
+		if (isEmpty()) {
+			return 0.0f;
+		}
+
+		glm::vec3 size = maximum - minimum;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	bool intersects(const AABB& other) const {
+		return minimum.x <= other.maximum.x && maximum.x >= other.minimum.x &&
+			minimum.y <= other.maximum.y && maximum.y >= other.minimum.y &&
+			minimum.z <= other.maximum.z && maximum.z >= other.minimum.z;
+	}
+
+	bool intersectsSphere(glm::vec3 center, float radius) const {
+		glm::vec3 closest = glm::clamp(center, minimum, maximum);
+		glm::vec3 offset = closest - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	/// <summary>
+	/// Returns the box containing this box after it is transformed, the result is larger than the transformed contents when rotated
+	/// </summary>
+	/// <param name="matrix">An affine transform</param>
+	AABB transform(const glm::mat4& matrix) const {
+		if (isEmpty()) {
+			return *this;
+		}
+
+		glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+		glm::vec3 extent = (maximum - minimum) * 0.5f;
+
+		//Each world axis extent is the sum of the local extents projected onto it
+		glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+		glm::vec3 transformedExtent = absolute * extent;
+
+		return AABB(center - transformedExtent, center + transformedExtent);
+	}
+};
+
+//A ray with its inverse direction precomputed for slab tests
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverseDirection;
+
+	Ray(glm::vec3 origin = glm::vec3(0.0f), glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f)) {
+		this->origin = origin;
+		this->direction = direction;
+		inverseDirection = 1.0f / direction;
+	}
+
+	/// <summary>
+	/// Returns whether the ray hits a box before a distance
+	/// </summary>
+	/// <param name="box">The box to test</param>
+	/// <param name="maxDistance">Hits further than this are ignored</param>
+	/// <param name="distance">Set to the distance the ray enters the box, 0 if it starts inside</param>
+	bool intersects(const AABB& box, float maxDistance, float& distance) const {
+		glm::vec3 minimumSlab = (box.minimum - origin) * inverseDirection;
+		glm::vec3 maximumSlab = (box.maximum - origin) * inverseDirection;
+		glm::vec3 entry = glm::min(minimumSlab, maximumSlab);
+		glm::vec3 exit = glm::max(minimumSlab, maximumSlab);
+
+		float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+		float leave = std::min(std::min(exit.x, exit.y), std::min(exit.z, maxDistance));
+
+		distance = enter;
+		return enter <= leave;
+	}
+};
+
+//The six planes of a view frustum, normals point inwards
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+
+	/// <summary>
+	/// Extracts the planes of a view projection matrix with a 0 to 1 depth range
+	/// </summary>
+	static Frustum fromViewProjection(const glm::mat4& viewProjection) {
+		glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum = {};
+		frustum.planes[0] = row3 + row0;
+		frustum.planes[1] = row3 - row0;
+		frustum.planes[2] = row3 + row1;
+		frustum.planes[3] = row3 - row1;
+		frustum.planes[4] = row2;
+		frustum.planes[5] = row3 - row2;
+
+		for (glm::vec4& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		return frustum;
+	}
+
+	/// <summary>
+	/// Tests a box against the planes in a mask, planes the box is fully inside of are removed from the mask so children can skip them
+	/// </summary>
+	/// <param name="box">The box to test</param>
+	/// <param name="planeMask">One bit per plane still worth testing, 0 once the box is fully inside</param>
+	/// <returns>False if the box is completely outside</returns>
+	bool cull(const AABB& box, uint32_t& planeMask) const {
+		for (uint32_t i = 0; i < 6; i++) {
+			if ((planeMask & (1u << i)) == 0) {
+				continue;
+			}
+
+			glm::vec3 normal = glm::vec3(planes[i]);
+
+			//The corner furthest along the normal decides if anything is inside, the nearest one if everything is
+			glm::vec3 positive = glm::mix(box.minimum, box.maximum, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+			glm::vec3 negative = glm::mix(box.maximum, box.minimum, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+
+			if (glm::dot(normal, positive) + planes[i].w < 0.0f) {
+				return false;
+			}
+
+			if (glm::dot(normal, negative) + planes[i].w >= 0.0f) {
+				planeMask &= ~(1u << i);
+			}
+		}
+
+		return true;
+	}
+};
\ No newline at end of file
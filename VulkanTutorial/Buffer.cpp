@@ -10,12 +10,17 @@ Buffer::Buffer(VkBuffer buffer, VkDeviceMemory bufferMemory)
 {
 	this->buffer = buffer;
 	this->bufferMemory = bufferMemory;
+	memorySize = 0;
+	category = MemoryCategory::Other;
 }
 
 void Buffer::Cleanup()
 {
 	vkDestroyBuffer(TriangleApp::logicalDevice, buffer, nullptr);
 	vkFreeMemory(TriangleApp::logicalDevice, bufferMemory, nullptr);
+
+	MemoryTelemetry::RemoveDeviceMemory(category, memorySize);
+	memorySize = 0;
 }
 
 #pragma endregion
@@ -42,11 +47,21 @@ void Buffer::SetBufferMemory(VkDeviceMemory value)
 	bufferMemory = value;
 }
 
+VkDeviceSize Buffer::GetMemorySize()
+{
+	return memorySize;
+}
+
+MemoryCategory Buffer::GetCategory()
+{
+	return category;
+}
+
 #pragma endregion
 
 #pragma region Helper Methods
 
-void Buffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, Buffer& buffer)
+void Buffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, Buffer& buffer)
 {
 	//Setup Create Info
 	VkBufferCreateInfo createInfo = {};
@@ -77,6 +92,10 @@ void Buffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryP
 
 	//Bind buffer memory
 	vkBindBufferMemory(TriangleApp::logicalDevice, buffer.buffer, buffer.bufferMemory, 0);
+
+	buffer.memorySize = memoryRequirements.size;
+	buffer.category = category;
+	MemoryTelemetry::AddDeviceMemory(category, memoryRequirements.size);
 }
 
 void Buffer::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
@@ -2,11 +2,15 @@
 
 #include "pch.h"
 
+#include "MemoryTelemetry.h"
+
 class Buffer
 {
 private:
 	VkBuffer buffer;
 	VkDeviceMemory bufferMemory;
+	VkDeviceSize memorySize;
+	MemoryCategory category;
 public:
 #pragma region Constructor
 
@@ -45,6 +49,18 @@ public:
 	/// <param name="value">The value to set the VkDeviceMemory to</param>
 	void SetBufferMemory(VkDeviceMemory value);
 
+	/// <summary>
+	/// Returns the amount of device memory allocated for this buffer
+	/// </summary>
+	/// <returns>The size of the buffer's allocation in bytes</returns>
+	VkDeviceSize GetMemorySize();
+
+	/// <summary>
+	/// Returns what the buffer's memory is counted as in memory reports
+	/// </summary>
+	/// <returns>The category the buffer was created with</returns>
+	MemoryCategory GetCategory();
+
 #pragma endregion
 
 #pragma region Helper Methods
@@ -55,9 +71,9 @@ public:
 	/// <param name="size">The size of the data to be stored</param>
 	/// <param name="usage">The intended VK_BUFFER_USAGE of this buffer</param>
 	/// <param name="properties">The required memory properties for the created buffer</param>
+	/// <param name="category">What the buffer's memory is counted as in memory reports</param>
 	/// <param name="buffer">The buffer to create</param>
-	/// <param name="bufferMemory">The device memory associated with the buffer</param>
-	static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, Buffer& buffer);
+	static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, Buffer& buffer);
 
 	/// <summary>
 	/// Copies data from the source buffer to the destination buffer
@@ -18,9 +18,9 @@ Camera::Camera(glm::vec3 position, glm::quat orientation, bool perspective, floa
 	this->aspectRatio = aspectRatio;
 	clippingPlanes = glm::vec2(nearPlane, farPlane);
 
-	//Mark matrices for regeneration
+	//Mark matrices for regeneration, the view is regenerated whenever the transform's version doesn't match
 	projectionDirty = true;
-	viewDirty = true;
+	viewVersion = UINT64_MAX;
 
 	//Set this to the main camera if no main camera has been set
 	if (mainCamera == nullptr) {
@@ -62,8 +62,8 @@ glm::mat4 Camera::GetProjection()
 
 glm::mat4 Camera::GetView()
 {
-	//Regenerate the view matrix if it is dirty
-	if (viewDirty) {
+	//Regenerate the view matrix if the transform has changed since it was last generated
+	if (viewVersion != transform->GetWorldVersion()) {
 		UpdateView();
 	}
 
@@ -72,9 +72,6 @@ glm::mat4 Camera::GetView()
 
 std::shared_ptr<Transform> Camera::GetTransform()
 {
-	//HACK: Sets the view matrix to dirty whenever the transform is accessed, not great as just accessing the transform doesn't necessarily mean anything was changed
-	viewDirty = true;
-
 	return transform;
 }
 
@@ -172,15 +169,43 @@ void Camera::UpdateProjection()
 	}
 
 	projection[1][1] *= -1; //Correct for flipped y-axis from OpenGL
+
+	projectionDirty = false;
 }
 
 void Camera::UpdateView()
 {
+	//Use the world matrix so the camera follows its scene parents
+	glm::mat4 world = transform->GetModelMatrix();
+	glm::vec3 position = glm::vec3(world[3]);
+
 	//Find the direction to look at by rotating the forward vector by the camera's orientation
-	glm::vec3 lookDirection = transform->GetOrientation() * glm::vec3(0.0f, 0.0f, 1.0f);
+	glm::vec3 lookDirection = glm::normalize(glm::vec3(world * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)));
 
 	//Look in the target direction
-	view = glm::lookAt(transform->GetPosition(), transform->GetPosition() + lookDirection, glm::vec3(0.0f, 1.0f, 0.0f));
+	view = glm::lookAt(position, position + lookDirection, glm::vec3(0.0f, 1.0f, 0.0f));
+
+	viewVersion = transform->GetWorldVersion();
+}
+
+#pragma endregion
+
+#pragma region Ray Casting
+
+Ray Camera::ScreenPointToRay(glm::vec2 screenPoint, glm::vec2 screenSize)
+{
+	//The projection's y-axis is already flipped so the top of the screen is -1 like the cursor's origin
+	glm::vec2 deviceCoordinates = (screenPoint / screenSize) * 2.0f - 1.0f;
+	glm::mat4 inverseViewProjection = glm::inverse(GetProjection() * GetView());
+
+	//Depth runs from 0 at the near plane to 1 at the far plane, unprojecting both ends works for either projection
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(deviceCoordinates, 0.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(deviceCoordinates, 1.0f, 1.0f);
+
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+	return Ray(origin, direction);
 }
 
 #pragma endregion
\ No newline at end of file
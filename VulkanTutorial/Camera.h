@@ -2,6 +2,7 @@
 
 #include "pch.h"
 #include "Transform.h"
+#include "Bounds.h"
 
 class Camera
 {
@@ -12,7 +13,7 @@ private:
 	glm::mat4 view;
 	std::shared_ptr<Transform> transform;
 	bool projectionDirty;
-	bool viewDirty;
+	uint64_t viewVersion; //The transform's world version the view was last generated from
 	bool perspective;
 	float FOV;
 	float aspectRatio;
@@ -27,7 +28,7 @@ private:
 	void UpdateProjection();
 
 	/// <summary>
-	/// Updates the view matrix if something has changed
+	/// Regenerates the view matrix from the transform's world matrix
 	/// </summary>
 	void UpdateView();
 
@@ -69,7 +70,7 @@ public:
 	glm::mat4 GetProjection();
 
 	/// <summary>
-	/// Returns the view matrix and regenerates it if necessary
+	/// Returns the view matrix and regenerates it if the transform or one of its scene parents has moved
 	/// </summary>
 	/// <returns>The mat4 projection matrix</returns>
 	glm::mat4 GetView();
@@ -152,5 +153,17 @@ public:
 	/// <param name="value">The calue to set the far clipping plane to</param>
 	void SetFarPlane(float value);
 
+#pragma endregion
+
+#pragma region Ray Casting
+
+	/// <summary>
+	/// Returns the world space ray that passes through a point on the screen, starting at the near plane
+	/// </summary>
+	/// <param name="screenPoint">The point in pixels with the origin at the top left, like cursor positions</param>
+	/// <param name="screenSize">The size of the screen in pixels</param>
+	/// <returns>A ray with a normalized direction</returns>
+	Ray ScreenPointToRay(glm::vec2 screenPoint, glm::vec2 screenSize);
+
 #pragma endregion
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "pch.h"
+
+class Transform;
+class Camera;
+
+#pragma region Rendering
+
+//An entity's position rotation and scale relative to its parent in the scene graph
+struct TransformComponent
+{
+	glm::vec3 position;
+	glm::quat orientation;
+	glm::vec3 scale;
+
+	TransformComponent(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::quat orientation = glm::quat(glm::vec3(0.0f, 0.0f, 0.0f)), glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f))
+	{
+		this->position = position;
+		this->orientation = orientation;
+		this->scale = scale;
+	}
+};
+
+//Draws a mesh at the entity's transform
+struct MeshRenderer
+{
+	uint32_t meshIndex;
+	//The id the mesh gave the entity's instance
+	uint32_t instanceId;
+};
+
+//Renders the scene from the entity's transform, aspect ratio follows the swap chain so it isn't stored here
+struct CameraComponent
+{
+	bool perspective;
+	float FOV;
+	float orthographicSize;
+	float nearPlane;
+	float farPlane;
+};
+
+//The renderer side objects an entity's components are copied into when they change, owned by the renderer
+struct RenderProxy
+{
+	Transform* transform;
+	Camera* camera;
+};
+
+#pragma endregion
+
+#pragma region Behaviours
+
+//Rotates the entity at a constant rate
+struct Spin
+{
+	glm::vec3 degreesPerSecond;
+};
+
+//Moves the entity back and forth along an offset from its origin
+struct Bob
+{
+	glm::vec3 origin;
+	glm::vec3 offset;
+	float angularSpeed;
+};
+
+//Moves the entity in a horizontal circle
+struct Orbit
+{
+	glm::vec3 center;
+	float radius;
+	float angularSpeed;
+};
+
+#pragma endregion
\ No newline at end of file
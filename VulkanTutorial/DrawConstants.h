@@ -0,0 +1,47 @@
+#pragma once
+
+#include "pch.h"
+
+//Per draw values pushed straight into the command buffer, must match the push_constant block in BasicShader.vert and BasicShader.frag
+//Vulkan only guarantees 128 bytes of push constants so anything larger belongs in a buffer
+struct DrawConstants {
+	glm::vec4 tint;
+	uint32_t materialIndex;
+	uint32_t lod;
+	uint32_t padding[2];
+
+	DrawConstants(glm::vec4 tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), uint32_t materialIndex = 0, uint32_t lod = 0) {
+		this->tint = tint;
+		this->materialIndex = materialIndex;
+		this->lod = lod;
+		padding[0] = 0;
+		padding[1] = 0;
+	}
+
+	static VkPushConstantRange getPushConstantRange() {
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DrawConstants);
+
+		return pushConstantRange;
+	}
+
+	/// <summary>
+	/// Records the constants into a command buffer, they stay set for every following draw until pushed again
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into</param>
+	/// <param name="pipelineLayout">A pipeline layout created with getPushConstantRange</param>
+	void push(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) const {
+		VkPushConstantRange pushConstantRange = getPushConstantRange();
+		vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantRange.stageFlags, pushConstantRange.offset, pushConstantRange.size, this);
+	}
+
+	bool operator==(const DrawConstants& other) const {
+		return tint == other.tint && materialIndex == other.materialIndex && lod == other.lod;
+	}
+
+	bool operator!=(const DrawConstants& other) const {
+		return !(*this == other);
+	}
+};
\ No newline at end of file
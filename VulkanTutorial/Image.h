@@ -0,0 +1,124 @@
+#pragma once
+
+#include "pch.h"
+
+#include "MemoryTelemetry.h"
+
+class Image
+{
+private:
+	VkImage image;
+	VkDeviceMemory imageMemory;
+	VkDeviceSize memorySize;
+	MemoryCategory category;
+public:
+#pragma region Constructor
+
+	Image(VkImage image = VK_NULL_HANDLE, VkDeviceMemory imageMemory = VK_NULL_HANDLE, VkDeviceSize memorySize = 0);
+
+	/// <summary>
+	/// Destroys the image and frees image memory
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the VkImage associated with this image
+	/// </summary>
+	/// <returns>The VkImage associated with this image</returns>
+	VkImage GetImage();
+
+	/// <summary>
+	/// Returns the device memory associated with this image
+	/// </summary>
+	/// <returns>The VkDeviceMemory associated with this image</returns>
+	VkDeviceMemory GetImageMemory();
+
+	/// <summary>
+	/// Returns the amount of device memory allocated for this image
+	/// </summary>
+	/// <returns>The size of the image's allocation in bytes</returns>
+	VkDeviceSize GetMemorySize();
+
+	/// <summary>
+	/// Returns what the image's memory is counted as in memory reports
+	/// </summary>
+	/// <returns>The category the image was created with</returns>
+	MemoryCategory GetCategory();
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Creates an image with the specified parameters and binds it to memory
+	/// </summary>
+	/// <param name="width">The width of the largest mip level</param>
+	/// <param name="height">The height of the largest mip level</param>
+	/// <param name="mipLevels">The number of mip levels in the image</param>
+	/// <param name="format">The format of the image</param>
+	/// <param name="tiling">The tiling of the image</param>
+	/// <param name="usage">The intended VK_IMAGE_USAGE of the image</param>
+	/// <param name="properties">The required memory properties for the created image</param>
+	/// <param name="category">What the image's memory is counted as in memory reports</param>
+	/// <param name="image">The image to create</param>
+	/// <param name="arrayLayers">The number of array layers in the image (1 by default)</param>
+	static void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, Image& image, uint32_t arrayLayers = 1);
+
+	/// <summary>
+	/// Creates an image view covering the first mipLevels levels of the image
+	/// </summary>
+	/// <param name="image">The image to create a view for</param>
+	/// <param name="format">The format of the image</param>
+	/// <param name="aspectFlags">The aspects of the image that the view can access</param>
+	/// <param name="mipLevels">The number of mip levels visible through the view (1 by default)</param>
+	/// <param name="viewType">The type of view to create (2D by default)</param>
+	/// <param name="arrayLayers">The number of array layers visible through the view (1 by default)</param>
+	/// <param name="baseMipLevel">The first mip level visible through the view (0 by default)</param>
+	/// <returns>The created image view</returns>
+	static VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t arrayLayers = 1, uint32_t baseMipLevel = 0);
+
+	/// <summary>
+	/// Transitions the image's Image Layout
+	/// </summary>
+	/// <param name="image">The image to transition</param>
+	/// <param name="format">The format of the image</param>
+	/// <param name="oldLayout">The current layout of the image</param>
+	/// <param name="newLayout">The layout to transition to</param>
+	/// <param name="mipLevels">The number of mip levels to transition (1 by default)</param>
+	/// <param name="arrayLayers">The number of array layers to transition (1 by default)</param>
+	static void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
+
+	/// <summary>
+	/// Copies buffer data to a mip level of an image
+	/// </summary>
+	/// <param name="buffer">The buffer to copy data from</param>
+	/// <param name="image">The image to copy the data to</param>
+	/// <param name="imageWidth">The width of the mip level</param>
+	/// <param name="imageHeight">The height of the mip level</param>
+	/// <param name="mipLevel">The mip level to copy to (0 by default)</param>
+	static void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t imageWidth, uint32_t imageHeight, uint32_t mipLevel = 0);
+
+	/// <summary>
+	/// Fills every mip level below level 0 by repeatedly blitting the previous level on the GPU, leaves the image in SHADER_READ_ONLY_OPTIMAL
+	/// </summary>
+	/// <param name="image">The image to generate mips for, level 0 must be in TRANSFER_DST_OPTIMAL</param>
+	/// <param name="format">The format of the image, must support linear filtering</param>
+	/// <param name="width">The width of mip level 0</param>
+	/// <param name="height">The height of mip level 0</param>
+	/// <param name="mipLevels">The number of mip levels in the image</param>
+	static void GenerateMipmaps(VkImage image, VkFormat format, int32_t width, int32_t height, uint32_t mipLevels);
+
+	/// <summary>
+	/// Returns the number of mip levels in a full mip chain for an image of the given size
+	/// </summary>
+	/// <param name="width">The width of the image</param>
+	/// <param name="height">The height of the image</param>
+	/// <returns>The length of the full mip chain</returns>
+	static uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+#pragma endregion
+};
\ No newline at end of file
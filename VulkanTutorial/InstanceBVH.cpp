@@ -0,0 +1,373 @@
+#include "pch.h"
+#include "InstanceBVH.h"
+
+#pragma region Constructor
+
+InstanceBVH::InstanceBVH()
+{
+	dirty = false;
+	builtCost = 0.0f;
+	rebuildCount = 0;
+}
+
+#pragma endregion
+
+#pragma region Building
+
+void InstanceBVH::Build(const std::vector<AABB>& bounds)
+{
+	if (&bounds != &itemBounds) {
+		itemBounds = bounds;
+	}
+
+	uint32_t itemCount = static_cast<uint32_t>(itemBounds.size());
+	itemOrder.resize(itemCount);
+	itemLeaves.resize(itemCount);
+
+	for (uint32_t i = 0; i < itemCount; i++) {
+		itemOrder[i] = i;
+	}
+
+	nodes.clear();
+	parents.clear();
+	dirty = false;
+
+	if (itemCount == 0) {
+		dirtyNodes.clear();
+		builtCost = 0.0f;
+		return;
+	}
+
+	//A binary tree with single item leaves has 2n - 1 nodes
+	nodes.reserve(itemCount * 2);
+	parents.reserve(itemCount * 2);
+
+	nodes.push_back({ AABB(), 0, itemCount });
+	parents.push_back(UINT32_MAX);
+	UpdateNodeBounds(0);
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+
+		if (Subdivide(nodeIndex)) {
+			stack.push_back(nodes[nodeIndex].first);
+			stack.push_back(nodes[nodeIndex].first + 1);
+		}
+	}
+
+	//Remember which leaf every item ended up in so moving it only refits the nodes above that leaf
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		for (uint32_t j = 0; j < nodes[i].count; j++) {
+			itemLeaves[itemOrder[nodes[i].first + j]] = i;
+		}
+	}
+
+	dirtyNodes.assign(nodes.size(), 0);
+	builtCost = ComputeCost();
+}
+
+bool InstanceBVH::Subdivide(uint32_t nodeIndex)
+{
+	Node node = nodes[nodeIndex];
+
+	if (node.count <= 1) {
+		return false;
+	}
+
+	//Bin on item centers, the item bounds themselves can overlap arbitrarily
+	AABB centerBounds;
+	for (uint32_t i = 0; i < node.count; i++) {
+		centerBounds.grow(itemBounds[itemOrder[node.first + i]].getCenter());
+	}
+
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centerBounds.maximum[axis] - centerBounds.minimum[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+
+		std::array<AABB, SAH_BINS> binBounds;
+		std::array<uint32_t, SAH_BINS> binCounts = {};
+		float scale = SAH_BINS / extent;
+
+		for (uint32_t i = 0; i < node.count; i++) {
+			const AABB& bounds = itemBounds[itemOrder[node.first + i]];
+			uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((bounds.getCenter()[axis] - centerBounds.minimum[axis]) * scale));
+			binCounts[bin]++;
+			binBounds[bin].grow(bounds);
+		}
+
+		//Sweep from both sides so every split plane between bins is costed in linear time
+		std::array<float, SAH_BINS - 1> leftCosts;
+		AABB leftBounds;
+		uint32_t leftCount = 0;
+
+		for (uint32_t i = 0; i < SAH_BINS - 1; i++) {
+			leftBounds.grow(binBounds[i]);
+			leftCount += binCounts[i];
+			leftCosts[i] = leftCount * leftBounds.getSurfaceArea();
+		}
+
+		AABB rightBounds;
+		uint32_t rightCount = 0;
+
+		for (uint32_t i = SAH_BINS - 1; i > 0; i--) {
+			rightBounds.grow(binBounds[i]);
+			rightCount += binCounts[i];
+
+			float cost = leftCosts[i - 1] + rightCount * rightBounds.getSurfaceArea();
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i - 1;
+			}
+		}
+	}
+
+	//Small leaves are kept whole unless splitting them is cheaper to traverse
+	float leafCost = node.count * node.bounds.getSurfaceArea();
+	if (node.count <= MAX_LEAF_ITEMS && (bestAxis < 0 || bestCost >= leafCost)) {
+		return false;
+	}
+
+	uint32_t* begin = itemOrder.data() + node.first;
+	uint32_t* end = begin + node.count;
+	uint32_t* middle = begin + node.count / 2;
+
+	if (bestAxis >= 0) {
+		float scale = SAH_BINS / (centerBounds.maximum[bestAxis] - centerBounds.minimum[bestAxis]);
+
+		middle = std::partition(begin, end, [&](uint32_t item) {
+			uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((itemBounds[item].getCenter()[bestAxis] - centerBounds.minimum[bestAxis]) * scale));
+			return bin <= bestSplit;
+		});
+	}
+
+	//Items with identical centers can't be separated spatially so they are split down the middle
+	if (middle == begin || middle == end) {
+		middle = begin + node.count / 2;
+	}
+
+	uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+	uint32_t left = static_cast<uint32_t>(nodes.size());
+
+	nodes.push_back({ AABB(), node.first, leftCount });
+	nodes.push_back({ AABB(), node.first + leftCount, node.count - leftCount });
+	parents.push_back(nodeIndex);
+	parents.push_back(nodeIndex);
+
+	nodes[nodeIndex].first = left;
+	nodes[nodeIndex].count = 0;
+
+	UpdateNodeBounds(left);
+	UpdateNodeBounds(left + 1);
+
+	return true;
+}
+
+void InstanceBVH::UpdateNodeBounds(uint32_t nodeIndex)
+{
+	Node& node = nodes[nodeIndex];
+	AABB bounds;
+
+	if (node.count > 0) {
+		for (uint32_t i = 0; i < node.count; i++) {
+			bounds.grow(itemBounds[itemOrder[node.first + i]]);
+		}
+	}
+	else {
+		bounds.grow(nodes[node.first].bounds);
+		bounds.grow(nodes[node.first + 1].bounds);
+	}
+
+	node.bounds = bounds;
+}
+
+float InstanceBVH::ComputeCost()
+{
+	float rootArea = nodes[0].bounds.getSurfaceArea();
+	if (rootArea <= 0.0f) {
+		return 0.0f;
+	}
+
+	//Every internal node costs one box test and every leaf one test per item, weighted by how likely a ray is to reach it
+	float cost = 0.0f;
+	for (const Node& node : nodes) {
+		cost += node.bounds.getSurfaceArea() * (node.count > 0 ? node.count : 1);
+	}
+
+	return cost / rootArea;
+}
+
+void InstanceBVH::UpdateItem(uint32_t item, const AABB& bounds)
+{
+	itemBounds[item] = bounds;
+	dirtyNodes[itemLeaves[item]] = 1;
+	dirty = true;
+}
+
+void InstanceBVH::Refit()
+{
+	if (!dirty) {
+		return;
+	}
+
+	//Children always come after their parents so walking backwards finishes every child before its parent
+	for (size_t i = nodes.size(); i-- > 0;) {
+		if (!dirtyNodes[i]) {
+			continue;
+		}
+
+		UpdateNodeBounds(static_cast<uint32_t>(i));
+		dirtyNodes[i] = 0;
+
+		if (parents[i] != UINT32_MAX) {
+			dirtyNodes[parents[i]] = 1;
+		}
+	}
+
+	dirty = false;
+
+	//Refitting keeps the topology, once items have moved far enough the boxes overlap and a fresh build is cheaper to query
+	if (ComputeCost() > builtCost * REBUILD_COST_RATIO) {
+		Build(itemBounds);
+		rebuildCount++;
+	}
+}
+
+size_t InstanceBVH::GetItemCount()
+{
+	return itemBounds.size();
+}
+
+uint32_t InstanceBVH::GetRebuildCount()
+{
+	return rebuildCount;
+}
+
+#pragma endregion
+
+#pragma region Queries
+
+void InstanceBVH::CollectSubtree(uint32_t nodeIndex, std::vector<uint32_t>& results)
+{
+	std::vector<uint32_t> stack = { nodeIndex };
+
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (node.count > 0) {
+			results.insert(results.end(), itemOrder.begin() + node.first, itemOrder.begin() + node.first + node.count);
+		}
+		else {
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+		}
+	}
+}
+
+void InstanceBVH::Query(const std::function<bool(const AABB&)>& test, std::vector<uint32_t>& results)
+{
+	if (nodes.empty()) {
+		return;
+	}
+
+	std::vector<uint32_t> stack = { 0 };
+
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!test(node.bounds)) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (uint32_t i = 0; i < node.count; i++) {
+				uint32_t item = itemOrder[node.first + i];
+
+				if (test(itemBounds[item])) {
+					results.push_back(item);
+				}
+			}
+		}
+		else {
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+		}
+	}
+}
+
+void InstanceBVH::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results)
+{
+	if (nodes.empty()) {
+		return;
+	}
+
+	//Each entry carries the planes its parent wasn't already fully inside of
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0x3F } };
+
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back().first;
+		uint32_t planeMask = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+
+		if (!frustum.cull(node.bounds, planeMask)) {
+			continue;
+		}
+
+		//Nothing under a node that is fully inside can be outside
+		if (planeMask == 0) {
+			CollectSubtree(nodeIndex, results);
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (uint32_t i = 0; i < node.count; i++) {
+				uint32_t item = itemOrder[node.first + i];
+				uint32_t itemMask = planeMask;
+
+				if (frustum.cull(itemBounds[item], itemMask)) {
+					results.push_back(item);
+				}
+			}
+		}
+		else {
+			stack.push_back({ node.first, planeMask });
+			stack.push_back({ node.first + 1, planeMask });
+		}
+	}
+}
+
+void InstanceBVH::QueryRay(const Ray& ray, float maxDistance, std::vector<uint32_t>& results)
+{
+	Query([&](const AABB& bounds) {
+		float distance;
+		return ray.intersects(bounds, maxDistance, distance);
+	}, results);
+}
+
+void InstanceBVH::QuerySphere(glm::vec3 center, float radius, std::vector<uint32_t>& results)
+{
+	Query([&](const AABB& bounds) {
+		return bounds.intersectsSphere(center, radius);
+	}, results);
+}
+
+void InstanceBVH::QueryAABB(const AABB& box, std::vector<uint32_t>& results)
+{
+	Query([&](const AABB& bounds) {
+		return bounds.intersects(box);
+	}, results);
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "pch.h"
+#include "Bounds.h"
+
+#include <functional>
+
+class InstanceBVH
+{
+private:
+	//Leaves hold a range of items, internal nodes have their two children next to each other and always after themselves
+	struct Node
+	{
+		AABB bounds;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> parents;
+	std::vector<uint8_t> dirtyNodes;
+	bool dirty;
+
+	std::vector<AABB> itemBounds;
+	std::vector<uint32_t> itemOrder;
+	std::vector<uint32_t> itemLeaves;
+
+	//The SAH cost right after the last build, refits that drift too far from it trigger a rebuild
+	float builtCost;
+	uint32_t rebuildCount;
+
+#pragma region Building
+
+	/// <summary>
+	/// Finds the best binned SAH split of a leaf and splits it, leaves that are cheaper to keep whole are left alone
+	/// </summary>
+	/// <param name="nodeIndex">The leaf to split</param>
+	/// <returns>Whether the leaf was split</returns>
+	bool Subdivide(uint32_t nodeIndex);
+
+	/// <summary>
+	/// Recomputes a node's bounds from its items or children
+	/// </summary>
+	void UpdateNodeBounds(uint32_t nodeIndex);
+
+	/// <summary>
+	/// Returns the SAH cost of the tree relative to its root
+	/// </summary>
+	float ComputeCost();
+
+#pragma endregion
+
+#pragma region Queries
+
+	/// <summary>
+	/// Adds every item under a node to the results without testing them
+	/// </summary>
+	void CollectSubtree(uint32_t nodeIndex, std::vector<uint32_t>& results);
+
+	/// <summary>
+	/// Walks the tree, descending into nodes the test accepts and adding items in leaves it accepts
+	/// </summary>
+	/// <param name="test">Returns whether a box might contain results</param>
+	void Query(const std::function<bool(const AABB&)>& test, std::vector<uint32_t>& results);
+
+#pragma endregion
+
+public:
+	static const uint32_t MAX_LEAF_ITEMS = 4;
+	static const uint32_t SAH_BINS = 12;
+
+	//Refitted trees are rebuilt once their SAH cost has grown this much
+	static constexpr float REBUILD_COST_RATIO = 1.5f;
+
+#pragma region Constructor
+
+	InstanceBVH();
+
+#pragma endregion
+
+#pragma region Building
+
+	/// <summary>
+	/// Builds the tree from scratch, items are referred to by their index in the bounds
+	/// </summary>
+	/// <param name="bounds">The world space bounds of every item</param>
+	void Build(const std::vector<AABB>& bounds);
+
+	/// <summary>
+	/// Moves an item, the tree isn't changed until Refit is called
+	/// </summary>
+	/// <param name="item">The item's index</param>
+	/// <param name="bounds">The item's new bounds</param>
+	void UpdateItem(uint32_t item, const AABB& bounds);
+
+	/// <summary>
+	/// Grows or shrinks the nodes above moved items, rebuilding the tree if refitting has made it too loose
+	/// </summary>
+	void Refit();
+
+	/// <summary>
+	/// Returns the number of items in the tree
+	/// </summary>
+	size_t GetItemCount();
+
+	/// <summary>
+	/// Returns how many times the tree has been rebuilt because refitting degraded it
+	/// </summary>
+	uint32_t GetRebuildCount();
+
+#pragma endregion
+
+#pragma region Queries
+
+	/// <summary>
+	/// Finds every item that might be visible, subtrees fully inside the frustum are added without testing their items
+	/// </summary>
+	/// <param name="frustum">The frustum to test against</param>
+	/// <param name="results">The indices of the visible items are appended here</param>
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results);
+
+	/// <summary>
+	/// Finds every item whose bounds a ray passes through
+	/// </summary>
+	/// <param name="ray">The ray to test</param>
+	/// <param name="maxDistance">Hits further than this are ignored</param>
+	/// <param name="results">The indices of the hit items are appended here</param>
+	void QueryRay(const Ray& ray, float maxDistance, std::vector<uint32_t>& results);
+
+	/// <summary>
+	/// Finds every item whose bounds overlap a sphere
+	/// </summary>
+	void QuerySphere(glm::vec3 center, float radius, std::vector<uint32_t>& results);
+
+	/// <summary>
+	/// Finds every item whose bounds overlap a box
+	/// </summary>
+	void QueryAABB(const AABB& box, std::vector<uint32_t>& results);
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "LightClusters.h"
+
+#include "TriangleApp.h"
+
+#pragma region Constructor
+
+LightClusters::LightClusters()
+{
+	descriptorSetLayout = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+}
+
+void LightClusters::Cleanup()
+{
+	if (pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(TriangleApp::logicalDevice, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(TriangleApp::logicalDevice, pipelineLayout, nullptr);
+		pipelineLayout = VK_NULL_HANDLE;
+	}
+
+	if (descriptorSetLayout != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(TriangleApp::logicalDevice, descriptorSetLayout, nullptr);
+		descriptorSetLayout = VK_NULL_HANDLE;
+	}
+}
+
+#pragma endregion
+
+#pragma region Resources
+
+VkPipeline LightClusters::CreatePipeline(VkShaderModule shaderModule)
+{
+	if (pipelineLayout == VK_NULL_HANDLE) {
+		CreateLayouts();
+	}
+
+	VkPipelineShaderStageCreateInfo stageCreateInfo = {};
+	stageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageCreateInfo.module = shaderModule;
+	stageCreateInfo.pName = "main";
+
+	VkComputePipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.stage = stageCreateInfo;
+	createInfo.layout = pipelineLayout;
+	createInfo.basePipelineHandle = VK_NULL_HANDLE;
+	createInfo.basePipelineIndex = -1;
+
+	VkPipeline newPipeline;
+	if (vkCreateComputePipelines(TriangleApp::logicalDevice, VK_NULL_HANDLE, 1, &createInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Light Cluster Pipeline!");
+	}
+
+	VkPipeline oldPipeline = pipeline;
+	pipeline = newPipeline;
+
+	return oldPipeline;
+}
+
+void LightClusters::CreateResources(const std::vector<std::shared_ptr<Buffer>>& uniformBuffers)
+{
+	size_t imageCount = uniformBuffers.size();
+
+	lightBuffers.resize(imageCount);
+	clusterBuffers.resize(imageCount);
+	lightIndexBuffers.resize(imageCount);
+
+	//Lights are written by the CPU every frame, the cluster lists only ever live on the GPU
+	for (size_t i = 0; i < imageCount; i++) {
+		lightBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(Light) * MAX_LIGHTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniforms, *lightBuffers[i]);
+
+		clusterBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(uint32_t) * CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *clusterBuffers[i]);
+
+		lightIndexBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(uint32_t) * CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *lightIndexBuffers[i]);
+	}
+
+	//Create the descriptor pool
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(imageCount);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(imageCount) * 3;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	poolCreateInfo.maxSets = static_cast<uint32_t>(imageCount);
+
+	if (vkCreateDescriptorPool(TriangleApp::logicalDevice, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Light Cluster Descriptor Pool!");
+	}
+
+	//Allocate the descriptor sets
+	std::vector<VkDescriptorSetLayout> layouts(imageCount, descriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = descriptorPool;
+	allocateInfo.descriptorSetCount = static_cast<uint32_t>(imageCount);
+	allocateInfo.pSetLayouts = layouts.data();
+
+	descriptorSets.resize(imageCount);
+
+	if (vkAllocateDescriptorSets(TriangleApp::logicalDevice, &allocateInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate Light Cluster Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < imageCount; i++) {
+		std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+		bufferInfos[0].buffer = uniformBuffers[i]->GetBuffer();
+		bufferInfos[0].range = sizeof(UniformBufferObject);
+		bufferInfos[1].buffer = lightBuffers[i]->GetBuffer();
+		bufferInfos[1].range = VK_WHOLE_SIZE;
+		bufferInfos[2].buffer = clusterBuffers[i]->GetBuffer();
+		bufferInfos[2].range = VK_WHOLE_SIZE;
+		bufferInfos[3].buffer = lightIndexBuffers[i]->GetBuffer();
+		bufferInfos[3].range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
+		for (size_t j = 0; j < descriptorWrites.size(); j++) {
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].dstSet = descriptorSets[i];
+			descriptorWrites[j].dstBinding = static_cast<uint32_t>(j);
+			descriptorWrites[j].dstArrayElement = 0;
+			descriptorWrites[j].descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+		}
+
+		vkUpdateDescriptorSets(TriangleApp::logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void LightClusters::CleanupResources()
+{
+	vkDestroyDescriptorPool(TriangleApp::logicalDevice, descriptorPool, nullptr);
+	descriptorPool = VK_NULL_HANDLE;
+	descriptorSets.clear();
+
+	for (size_t i = 0; i < lightBuffers.size(); i++) {
+		lightBuffers[i]->Cleanup();
+		clusterBuffers[i]->Cleanup();
+		lightIndexBuffers[i]->Cleanup();
+	}
+
+	lightBuffers.clear();
+	clusterBuffers.clear();
+	lightIndexBuffers.clear();
+}
+
+#pragma endregion
+
+#pragma region Lights
+
+uint32_t LightClusters::AddLight(Light light)
+{
+	if (lights.size() >= MAX_LIGHTS) {
+		throw std::runtime_error("Too many lights in the scene!");
+	}
+
+	lights.push_back(light);
+
+	return static_cast<uint32_t>(lights.size() - 1);
+}
+
+Light& LightClusters::GetLight(uint32_t index)
+{
+	return lights[index];
+}
+
+uint32_t LightClusters::GetLightCount()
+{
+	return static_cast<uint32_t>(lights.size());
+}
+
+void LightClusters::ClearLights()
+{
+	lights.clear();
+}
+
+#pragma endregion
+
+#pragma region Rendering
+
+VkDeviceSize LightClusters::UpdateLightBuffer(uint32_t imageIndex)
+{
+	if (lights.empty()) {
+		return 0;
+	}
+
+	VkDeviceSize bufferSize = sizeof(Light) * lights.size();
+
+	void* data;
+	vkMapMemory(TriangleApp::logicalDevice, lightBuffers[imageIndex]->GetBufferMemory(), 0, bufferSize, 0, &data);
+	memcpy(data, lights.data(), bufferSize);
+	vkUnmapMemory(TriangleApp::logicalDevice, lightBuffers[imageIndex]->GetBufferMemory());
+
+	return bufferSize;
+}
+
+void LightClusters::RecordDispatch(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[imageIndex], 0, nullptr);
+
+	//One thread per cluster, the light count is read from the uniform buffer so the command buffer does not change when lights are added
+	vkCmdDispatch(commandBuffer, (CLUSTER_COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	//Make the cluster lists visible to the fragment shader
+	std::array<VkBufferMemoryBarrier, 2> barriers = {};
+	VkBuffer barrierBuffers[] = { clusterBuffers[imageIndex]->GetBuffer(), lightIndexBuffers[imageIndex]->GetBuffer() };
+
+	for (size_t i = 0; i < barriers.size(); i++) {
+		barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].buffer = barrierBuffers[i];
+		barriers[i].offset = 0;
+		barriers[i].size = VK_WHOLE_SIZE;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data(),
+		0, nullptr);
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkBuffer LightClusters::GetLightBuffer(uint32_t imageIndex)
+{
+	return lightBuffers[imageIndex]->GetBuffer();
+}
+
+VkBuffer LightClusters::GetClusterBuffer(uint32_t imageIndex)
+{
+	return clusterBuffers[imageIndex]->GetBuffer();
+}
+
+VkBuffer LightClusters::GetLightIndexBuffer(uint32_t imageIndex)
+{
+	return lightIndexBuffers[imageIndex]->GetBuffer();
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void LightClusters::CreateLayouts()
+{
+	//Binding 0 is the camera uniform buffer, the rest are the light and cluster storage buffers
+	std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+	for (size_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = static_cast<uint32_t>(i);
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(TriangleApp::logicalDevice, &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Light Cluster Descriptor Set Layout!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+
+	if (vkCreatePipelineLayout(TriangleApp::logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Light Cluster Pipeline Layout!");
+	}
+}
+
+#pragma endregion
\ No newline at end of file
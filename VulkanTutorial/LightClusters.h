@@ -0,0 +1,140 @@
+#pragma once
+
+#include "pch.h"
+#include "Buffer.h"
+#include "UniformBufferObject.h"
+
+class LightClusters
+{
+private:
+	std::vector<Light> lights;
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> descriptorSets;
+
+	std::vector<std::shared_ptr<Buffer>> lightBuffers;
+	std::vector<std::shared_ptr<Buffer>> clusterBuffers;
+	std::vector<std::shared_ptr<Buffer>> lightIndexBuffers;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Creates the descriptor set layout and pipeline layout used by the cluster compute shader
+	/// </summary>
+	void CreateLayouts();
+
+#pragma endregion
+
+public:
+	//Must match the constants in ClusterLights.comp and BasicShader.frag
+	static const uint32_t CLUSTER_COUNT_X = 16;
+	static const uint32_t CLUSTER_COUNT_Y = 9;
+	static const uint32_t CLUSTER_COUNT_Z = 24;
+	static const uint32_t CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+	static const uint32_t MAX_LIGHTS = 4096;
+	static const uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+	static const uint32_t WORKGROUP_SIZE = 128;
+
+#pragma region Constructor
+
+	LightClusters();
+
+	/// <summary>
+	/// Destroys the compute pipeline and layouts, CleanupResources must be called first
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Resources
+
+	/// <summary>
+	/// Creates the compute pipeline, the previous pipeline is returned so the caller can destroy it once no frame is using it
+	/// </summary>
+	/// <param name="shaderModule">The compiled ClusterLights.comp shader</param>
+	/// <returns>The replaced pipeline or VK_NULL_HANDLE if there was none</returns>
+	VkPipeline CreatePipeline(VkShaderModule shaderModule);
+
+	/// <summary>
+	/// Creates the light and cluster buffers and descriptor sets for each swap chain image
+	/// </summary>
+	/// <param name="uniformBuffers">The per image uniform buffers holding the camera matrices and cluster settings</param>
+	void CreateResources(const std::vector<std::shared_ptr<Buffer>>& uniformBuffers);
+
+	/// <summary>
+	/// Destroys the per image buffers and descriptor sets
+	/// </summary>
+	void CleanupResources();
+
+#pragma endregion
+
+#pragma region Lights
+
+	/// <summary>
+	/// Adds a light to the scene
+	/// </summary>
+	/// <param name="light">The light to add</param>
+	/// <returns>The index of the light</returns>
+	uint32_t AddLight(Light light);
+
+	/// <summary>
+	/// Returns a reference to a light so it can be moved or changed
+	/// </summary>
+	/// <param name="index">The index returned when the light was added</param>
+	/// <returns>The light</returns>
+	Light& GetLight(uint32_t index);
+
+	/// <summary>
+	/// Returns the number of lights in the scene
+	/// </summary>
+	/// <returns>The light count</returns>
+	uint32_t GetLightCount();
+
+	/// <summary>
+	/// Removes every light from the scene
+	/// </summary>
+	void ClearLights();
+
+#pragma endregion
+
+#pragma region Rendering
+
+	/// <summary>
+	/// Copies the lights into the light buffer of a swap chain image
+	/// </summary>
+	/// <param name="imageIndex">The swap chain image that is about to be drawn</param>
+	/// <returns>The number of bytes copied to the device</returns>
+	VkDeviceSize UpdateLightBuffer(uint32_t imageIndex);
+
+	/// <summary>
+	/// Records the compute dispatch that bins lights into clusters, followed by a barrier so the fragment shader sees the results
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into, outside of a render pass</param>
+	/// <param name="imageIndex">The swap chain image the command buffer draws to</param>
+	void RecordDispatch(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the light storage buffer for a swap chain image
+	/// </summary>
+	VkBuffer GetLightBuffer(uint32_t imageIndex);
+
+	/// <summary>
+	/// Returns the buffer holding the light count of every cluster for a swap chain image
+	/// </summary>
+	VkBuffer GetClusterBuffer(uint32_t imageIndex);
+
+	/// <summary>
+	/// Returns the buffer holding the light indices of every cluster for a swap chain image
+	/// </summary>
+	VkBuffer GetLightIndexBuffer(uint32_t imageIndex);
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,412 @@
+#include "pch.h"
+#include "MemoryTelemetry.h"
+
+#include <new>
+#include <iomanip>
+
+std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> MemoryTelemetry::deviceMemory = {};
+std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> MemoryTelemetry::peakDeviceMemory = {};
+std::atomic<uint64_t> MemoryTelemetry::totalDeviceMemory(0);
+std::atomic<uint64_t> MemoryTelemetry::peakTotalDeviceMemory(0);
+
+std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> MemoryTelemetry::hostMemory = {};
+std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> MemoryTelemetry::peakHostMemory = {};
+std::atomic<uint64_t> MemoryTelemetry::totalHostMemory(0);
+std::atomic<uint64_t> MemoryTelemetry::peakTotalHostMemory(0);
+std::atomic<uint64_t> MemoryTelemetry::hostAllocations(0);
+
+thread_local MemoryCategory MemoryTelemetry::hostCategory = MemoryCategory::Other;
+
+VkPhysicalDevice MemoryTelemetry::physicalDevice = VK_NULL_HANDLE;
+PFN_vkGetPhysicalDeviceMemoryProperties2KHR MemoryTelemetry::getMemoryProperties2 = nullptr;
+
+#pragma region Allocator Hook
+
+//Every CPU allocation starts with a header recording its size and category so operator delete can uncount it, padded to keep the returned memory aligned
+struct AllocationHeader {
+	uint64_t size;
+	MemoryCategory category;
+};
+
+static const size_t ALLOCATION_HEADER_SIZE = sizeof(AllocationHeader) > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? sizeof(AllocationHeader) : __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+static void* AllocateTracked(size_t size)
+{
+	void* memory = malloc(size + ALLOCATION_HEADER_SIZE);
+
+	if (memory == nullptr) {
+		return nullptr;
+	}
+
+	AllocationHeader* header = static_cast<AllocationHeader*>(memory);
+	header->size = size;
+	header->category = MemoryTelemetry::GetHostCategory();
+	MemoryTelemetry::AddHostMemory(header->category, size);
+
+	return static_cast<char*>(memory) + ALLOCATION_HEADER_SIZE;
+}
+
+static void FreeTracked(void* pointer)
+{
+	if (pointer == nullptr) {
+		return;
+	}
+
+	AllocationHeader* header = reinterpret_cast<AllocationHeader*>(static_cast<char*>(pointer) - ALLOCATION_HEADER_SIZE);
+	MemoryTelemetry::RemoveHostMemory(header->category, header->size);
+	free(header);
+}
+
+//Over-aligned allocations keep the default operators, they are rare and are allocated and freed by a separate pair
+void* operator new(size_t size)
+{
+	void* pointer = AllocateTracked(size);
+
+	if (pointer == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateTracked(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateTracked(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	FreeTracked(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	FreeTracked(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	FreeTracked(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	FreeTracked(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	FreeTracked(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	FreeTracked(pointer);
+}
+
+#pragma endregion
+
+#pragma region Memory Snapshot
+
+VkDeviceSize MemorySnapshot::GetDeviceLocalUsage() const
+{
+	VkDeviceSize usage = 0;
+
+	for (const HeapUsage& heap : heaps) {
+		usage += heap.deviceLocal ? heap.usage : 0;
+	}
+
+	return usage;
+}
+
+VkDeviceSize MemorySnapshot::GetDeviceLocalBudget() const
+{
+	VkDeviceSize budget = 0;
+
+	for (const HeapUsage& heap : heaps) {
+		budget += heap.deviceLocal ? heap.budget : 0;
+	}
+
+	return budget;
+}
+
+#pragma endregion
+
+#pragma region Memory Scope
+
+MemoryScope::MemoryScope(MemoryCategory category)
+{
+	previousCategory = MemoryTelemetry::GetHostCategory();
+	MemoryTelemetry::SetHostCategory(category);
+}
+
+MemoryScope::~MemoryScope()
+{
+	MemoryTelemetry::SetHostCategory(previousCategory);
+}
+
+#pragma endregion
+
+#pragma region Setup
+
+void MemoryTelemetry::Initialize(VkInstance instance, VkPhysicalDevice device, bool budgetSupported)
+{
+	physicalDevice = device;
+	getMemoryProperties2 = nullptr;
+
+	if (budgetSupported) {
+		getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+	}
+}
+
+void MemoryTelemetry::Shutdown()
+{
+	physicalDevice = VK_NULL_HANDLE;
+	getMemoryProperties2 = nullptr;
+}
+
+#pragma endregion
+
+#pragma region Counters
+
+void MemoryTelemetry::UpdatePeak(std::atomic<uint64_t>& peak, uint64_t value)
+{
+	uint64_t current = peak.load(std::memory_order_relaxed);
+
+	while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+void MemoryTelemetry::AddDeviceMemory(MemoryCategory category, VkDeviceSize size)
+{
+	uint32_t index = static_cast<uint32_t>(category);
+
+	UpdatePeak(peakDeviceMemory[index], deviceMemory[index] += size);
+	UpdatePeak(peakTotalDeviceMemory, totalDeviceMemory += size);
+}
+
+void MemoryTelemetry::RemoveDeviceMemory(MemoryCategory category, VkDeviceSize size)
+{
+	deviceMemory[static_cast<uint32_t>(category)] -= size;
+	totalDeviceMemory -= size;
+}
+
+void MemoryTelemetry::AddHostMemory(MemoryCategory category, uint64_t size)
+{
+	uint32_t index = static_cast<uint32_t>(category);
+
+	//Relaxed ordering is enough for counters and keeps the cost of every allocation down
+	uint64_t categoryTotal = hostMemory[index].fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t total = totalHostMemory.fetch_add(size, std::memory_order_relaxed) + size;
+	hostAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	UpdatePeak(peakHostMemory[index], categoryTotal);
+	UpdatePeak(peakTotalHostMemory, total);
+}
+
+void MemoryTelemetry::RemoveHostMemory(MemoryCategory category, uint64_t size)
+{
+	hostMemory[static_cast<uint32_t>(category)].fetch_sub(size, std::memory_order_relaxed);
+	totalHostMemory.fetch_sub(size, std::memory_order_relaxed);
+	hostAllocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+MemoryCategory MemoryTelemetry::GetHostCategory()
+{
+	return hostCategory;
+}
+
+void MemoryTelemetry::SetHostCategory(MemoryCategory category)
+{
+	hostCategory = category;
+}
+
+void MemoryTelemetry::ResetPeaks()
+{
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		peakDeviceMemory[i] = deviceMemory[i].load();
+		peakHostMemory[i] = hostMemory[i].load();
+	}
+
+	peakTotalDeviceMemory = totalDeviceMemory.load();
+	peakTotalHostMemory = totalHostMemory.load();
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkDeviceSize MemoryTelemetry::GetDeviceMemory()
+{
+	return totalDeviceMemory;
+}
+
+VkDeviceSize MemoryTelemetry::GetDeviceMemory(MemoryCategory category)
+{
+	return deviceMemory[static_cast<uint32_t>(category)];
+}
+
+VkDeviceSize MemoryTelemetry::GetPeakDeviceMemory()
+{
+	return peakTotalDeviceMemory;
+}
+
+VkDeviceSize MemoryTelemetry::GetPeakDeviceMemory(MemoryCategory category)
+{
+	return peakDeviceMemory[static_cast<uint32_t>(category)];
+}
+
+uint64_t MemoryTelemetry::GetHostMemory()
+{
+	return totalHostMemory;
+}
+
+uint64_t MemoryTelemetry::GetHostMemory(MemoryCategory category)
+{
+	return hostMemory[static_cast<uint32_t>(category)];
+}
+
+uint64_t MemoryTelemetry::GetPeakHostMemory()
+{
+	return peakTotalHostMemory;
+}
+
+const char* MemoryTelemetry::GetCategoryName(MemoryCategory category)
+{
+	switch (category) {
+	case MemoryCategory::Geometry:
+		return "geometry";
+	case MemoryCategory::Instances:
+		return "instances";
+	case MemoryCategory::Uniforms:
+		return "uniforms";
+	case MemoryCategory::Textures:
+		return "textures";
+	case MemoryCategory::Attachments:
+		return "attachments";
+	case MemoryCategory::Staging:
+		return "staging";
+	default:
+		return "other";
+	}
+}
+
+#pragma endregion
+
+#pragma region Snapshots
+
+MemorySnapshot MemoryTelemetry::Capture(uint64_t frame)
+{
+	MemorySnapshot snapshot;
+	snapshot.frame = frame;
+
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		snapshot.deviceMemory[i] = deviceMemory[i];
+		snapshot.hostMemory[i] = hostMemory[i];
+	}
+
+	snapshot.totalDeviceMemory = totalDeviceMemory;
+	snapshot.peakDeviceMemory = peakTotalDeviceMemory;
+	snapshot.totalHostMemory = totalHostMemory;
+	snapshot.peakHostMemory = peakTotalHostMemory;
+	snapshot.hostAllocations = hostAllocations;
+
+	if (physicalDevice == VK_NULL_HANDLE) {
+		return snapshot;
+	}
+
+	//The budget extension reports what the driver and other processes use as well, which the counters above can't see
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2KHR memoryProperties = {};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+
+	if (getMemoryProperties2 != nullptr) {
+		memoryProperties.pNext = &budgetProperties;
+		getMemoryProperties2(physicalDevice, &memoryProperties);
+	}
+	else {
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties.memoryProperties);
+	}
+
+	snapshot.heaps.resize(memoryProperties.memoryProperties.memoryHeapCount);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++) {
+		snapshot.heaps[i].size = memoryProperties.memoryProperties.memoryHeaps[i].size;
+		snapshot.heaps[i].usage = budgetProperties.heapUsage[i];
+		snapshot.heaps[i].budget = budgetProperties.heapBudget[i];
+		snapshot.heaps[i].deviceLocal = (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+
+	return snapshot;
+}
+
+void MemoryTelemetry::Print(std::ostream& stream, const MemorySnapshot& snapshot)
+{
+	const double MEGABYTE = 1024.0 * 1024.0;
+
+	stream << "Memory at frame " << snapshot.frame << std::endl;
+	stream << std::fixed << std::setprecision(2);
+	stream << "\t" << std::left << std::setw(14) << "category" << std::right << std::setw(14) << "device MB" << std::setw(14) << "CPU MB" << std::endl;
+
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		stream << "\t" << std::left << std::setw(14) << GetCategoryName(static_cast<MemoryCategory>(i)) << std::right << std::setw(14) << snapshot.deviceMemory[i] / MEGABYTE << std::setw(14) << snapshot.hostMemory[i] / MEGABYTE << std::endl;
+	}
+
+	stream << "\t" << std::left << std::setw(14) << "total" << std::right << std::setw(14) << snapshot.totalDeviceMemory / MEGABYTE << std::setw(14) << snapshot.totalHostMemory / MEGABYTE << std::endl;
+	stream << "\t" << std::left << std::setw(14) << "peak" << std::right << std::setw(14) << snapshot.peakDeviceMemory / MEGABYTE << std::setw(14) << snapshot.peakHostMemory / MEGABYTE << std::endl;
+	stream << "\t" << snapshot.hostAllocations << " live CPU allocations" << std::endl;
+
+	for (size_t i = 0; i < snapshot.heaps.size(); i++) {
+		const HeapUsage& heap = snapshot.heaps[i];
+		stream << "\tHeap " << i << (heap.deviceLocal ? " (device local)" : "") << ": " << heap.size / MEGABYTE << " MB";
+
+		if (heap.budget > 0) {
+			stream << ", " << heap.usage / MEGABYTE << " MB used of a " << heap.budget / MEGABYTE << " MB budget";
+		}
+
+		stream << std::endl;
+	}
+
+	stream << std::defaultfloat;
+}
+
+void MemoryTelemetry::WriteCSVHeader(std::ostream& stream)
+{
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		stream << GetCategoryName(static_cast<MemoryCategory>(i)) << "DeviceBytes,";
+	}
+
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		stream << GetCategoryName(static_cast<MemoryCategory>(i)) << "HostBytes,";
+	}
+
+	stream << "deviceBytes,peakDeviceBytes,hostBytes,peakHostBytes,hostAllocations,deviceLocalUsageBytes,deviceLocalBudgetBytes";
+}
+
+void MemoryTelemetry::WriteCSV(std::ostream& stream, const MemorySnapshot& snapshot)
+{
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		stream << snapshot.deviceMemory[i] << ",";
+	}
+
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		stream << snapshot.hostMemory[i] << ",";
+	}
+
+	stream << snapshot.totalDeviceMemory << "," << snapshot.peakDeviceMemory << "," << snapshot.totalHostMemory << "," << snapshot.peakHostMemory << "," << snapshot.hostAllocations << ","
+		<< snapshot.GetDeviceLocalUsage() << "," << snapshot.GetDeviceLocalBudget();
+}
+
+#pragma endregion
\ No newline at end of file
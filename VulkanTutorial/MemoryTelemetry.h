@@ -0,0 +1,226 @@
+#pragma once
+
+#include "pch.h"
+
+#include <atomic>
+#include <ostream>
+
+//What an allocation is used for, device and CPU memory are both counted per category
+enum class MemoryCategory : uint32_t {
+	//Vertex, position and index data
+	Geometry = 0,
+	//Per instance transforms and the buffers the cull pass fills with them
+	Instances = 1,
+	//Data rewritten every frame such as uniforms, lights and joint matrices
+	Uniforms = 2,
+	Textures = 3,
+	//The depth buffer and the depth pyramid
+	Attachments = 4,
+	//Host visible buffers that only live until their copy has been recorded
+	Staging = 5,
+	//Compute working buffers, indirect draws and CPU allocations made outside any MemoryScope
+	Other = 6
+};
+
+static const uint32_t MEMORY_CATEGORY_COUNT = 7;
+
+//One device memory heap as reported by the driver, usage and budget are zero without VK_EXT_memory_budget
+struct HeapUsage {
+	VkDeviceSize size = 0;
+	VkDeviceSize usage = 0;
+	VkDeviceSize budget = 0;
+	bool deviceLocal = false;
+};
+
+//The memory counters at one point in time
+struct MemorySnapshot {
+	uint64_t frame = 0;
+	std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> deviceMemory = {};
+	std::array<uint64_t, MEMORY_CATEGORY_COUNT> hostMemory = {};
+	VkDeviceSize totalDeviceMemory = 0;
+	VkDeviceSize peakDeviceMemory = 0;
+	uint64_t totalHostMemory = 0;
+	uint64_t peakHostMemory = 0;
+	//The number of live CPU allocations
+	uint64_t hostAllocations = 0;
+	//Empty until MemoryTelemetry::Initialize has been called
+	std::vector<HeapUsage> heaps;
+
+	/// <summary>
+	/// Returns the usage reported for the device local heaps, this includes memory held by the driver and other processes
+	/// </summary>
+	VkDeviceSize GetDeviceLocalUsage() const;
+
+	/// <summary>
+	/// Returns the budget reported for the device local heaps
+	/// </summary>
+	VkDeviceSize GetDeviceLocalBudget() const;
+};
+
+//Counts CPU allocations made on this thread against a category while it is alive
+class MemoryScope
+{
+private:
+	MemoryCategory previousCategory;
+
+public:
+	MemoryScope(MemoryCategory category);
+	~MemoryScope();
+
+	MemoryScope(const MemoryScope&) = delete;
+	MemoryScope& operator=(const MemoryScope&) = delete;
+};
+
+class MemoryTelemetry
+{
+private:
+	static std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> deviceMemory;
+	static std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> peakDeviceMemory;
+	static std::atomic<uint64_t> totalDeviceMemory;
+	static std::atomic<uint64_t> peakTotalDeviceMemory;
+
+	static std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> hostMemory;
+	static std::array<std::atomic<uint64_t>, MEMORY_CATEGORY_COUNT> peakHostMemory;
+	static std::atomic<uint64_t> totalHostMemory;
+	static std::atomic<uint64_t> peakTotalHostMemory;
+	static std::atomic<uint64_t> hostAllocations;
+
+	//The category CPU allocations on each thread are counted against, set by MemoryScope
+	static thread_local MemoryCategory hostCategory;
+
+	static VkPhysicalDevice physicalDevice;
+	//Only set when VK_EXT_memory_budget is enabled
+	static PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2;
+
+	/// <summary>
+	/// Raises the peak to the value if the value is higher
+	/// </summary>
+	static void UpdatePeak(std::atomic<uint64_t>& peak, uint64_t value);
+
+public:
+#pragma region Setup
+
+	/// <summary>
+	/// Sets the device that snapshots read heap sizes from
+	/// </summary>
+	/// <param name="instance">The instance, used to load vkGetPhysicalDeviceMemoryProperties2KHR</param>
+	/// <param name="device">The physical device the logical device was created from</param>
+	/// <param name="budgetSupported">Whether VK_EXT_memory_budget and VK_KHR_get_physical_device_properties2 are enabled</param>
+	static void Initialize(VkInstance instance, VkPhysicalDevice device, bool budgetSupported);
+
+	/// <summary>
+	/// Stops reading heaps once the device has been destroyed, the counters are kept
+	/// </summary>
+	static void Shutdown();
+
+#pragma endregion
+
+#pragma region Counters
+
+	/// <summary>
+	/// Counts device memory bound to a buffer or image
+	/// </summary>
+	static void AddDeviceMemory(MemoryCategory category, VkDeviceSize size);
+
+	/// <summary>
+	/// Stops counting device memory that has been freed
+	/// </summary>
+	static void RemoveDeviceMemory(MemoryCategory category, VkDeviceSize size);
+
+	/// <summary>
+	/// Counts a CPU allocation, called by the global operator new
+	/// </summary>
+	static void AddHostMemory(MemoryCategory category, uint64_t size);
+
+	/// <summary>
+	/// Stops counting a CPU allocation, called by the global operator delete
+	/// </summary>
+	static void RemoveHostMemory(MemoryCategory category, uint64_t size);
+
+	/// <summary>
+	/// Returns the category CPU allocations on this thread are currently counted against
+	/// </summary>
+	static MemoryCategory GetHostCategory();
+
+	/// <summary>
+	/// Sets the category CPU allocations on this thread are counted against, MemoryScope should be used instead where possible
+	/// </summary>
+	static void SetHostCategory(MemoryCategory category);
+
+	/// <summary>
+	/// Lowers every peak to the current value so the next peaks only cover what happens after this call
+	/// </summary>
+	static void ResetPeaks();
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the device memory currently allocated across every category
+	/// </summary>
+	static VkDeviceSize GetDeviceMemory();
+
+	/// <summary>
+	/// Returns the device memory currently allocated for a category
+	/// </summary>
+	static VkDeviceSize GetDeviceMemory(MemoryCategory category);
+
+	/// <summary>
+	/// Returns the most device memory allocated at once since the last ResetPeaks
+	/// </summary>
+	static VkDeviceSize GetPeakDeviceMemory();
+
+	/// <summary>
+	/// Returns the most device memory allocated for a category at once since the last ResetPeaks, the categories don't necessarily peak together
+	/// </summary>
+	static VkDeviceSize GetPeakDeviceMemory(MemoryCategory category);
+
+	/// <summary>
+	/// Returns the CPU memory currently allocated with operator new
+	/// </summary>
+	static uint64_t GetHostMemory();
+
+	/// <summary>
+	/// Returns the CPU memory currently allocated with operator new for a category
+	/// </summary>
+	static uint64_t GetHostMemory(MemoryCategory category);
+
+	/// <summary>
+	/// Returns the most CPU memory allocated at once since the last ResetPeaks
+	/// </summary>
+	static uint64_t GetPeakHostMemory();
+
+	/// <summary>
+	/// Returns the name of a category as it is written in reports
+	/// </summary>
+	static const char* GetCategoryName(MemoryCategory category);
+
+#pragma endregion
+
+#pragma region Snapshots
+
+	/// <summary>
+	/// Reads every counter and the heap usage reported by the driver
+	/// </summary>
+	/// <param name="frame">The frame the snapshot is taken at</param>
+	/// <returns>The current memory usage</returns>
+	static MemorySnapshot Capture(uint64_t frame);
+
+	/// <summary>
+	/// Writes a readable report of a snapshot
+	/// </summary>
+	static void Print(std::ostream& stream, const MemorySnapshot& snapshot);
+
+	/// <summary>
+	/// Writes the names of the columns WriteCSV writes without a line ending
+	/// </summary>
+	static void WriteCSVHeader(std::ostream& stream);
+
+	/// <summary>
+	/// Writes a snapshot as one CSV row without a line ending so callers can add their own columns in front
+	/// </summary>
+	static void WriteCSV(std::ostream& stream, const MemorySnapshot& snapshot);
+
+#pragma endregion
+};
\ No newline at end of file
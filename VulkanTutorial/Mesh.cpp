@@ -14,57 +14,120 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint16_t> indices, std::sha
 	this->indices = indices;
 	this->vertexBuffer = vertexBuffer;
 	this->vertexBufferOffset = vertexBufferOffset;
+	positionBuffer = nullptr;
 	this->indexBuffer = indexBuffer;
 	this->indexBufferOffset = indexBufferOffset;
 	this->instances = instances;
 	this->instanceBuffer = instanceBuffer;
 
 	activeInstanceCount = static_cast<uint32_t>(instances.size());
+	instanceCapacity = 0;
+	instanceRegionCount = 1;
+	instanceReallocationCount = 0;
+	instanceBufferFormat = pipelineKey.instanceFormat;
 }
 
 #pragma endregion
 
 #pragma region Buffer Management
 
-void Mesh::CreateInstanceBuffer()
+void Mesh::CreateInstanceBuffer(uint32_t regionCount)
+{
+	//Leave room to grow so the first few added instances don't reallocate
+	uint32_t capacity = MIN_INSTANCE_CAPACITY;
+	while (capacity < activeInstanceCount) {
+		capacity *= 2;
+	}
+
+	AllocateInstanceBuffer(capacity, regionCount);
+
+	for (uint32_t i = 0; i < instanceRegionCount; i++) {
+		UpdateInstanceBuffer(i);
+	}
+}
+
+std::shared_ptr<Buffer> Mesh::ReserveInstances(uint32_t count, uint32_t regionCount)
+{
+	uint32_t capacity = instanceCapacity < MIN_INSTANCE_CAPACITY ? MIN_INSTANCE_CAPACITY : instanceCapacity;
+
+	//Doubling keeps the number of reallocations logarithmic in the instance count
+	while (capacity < count) {
+		capacity *= 2;
+	}
+
+	//Only shrink well below the halved size so counts hovering around a boundary don't reallocate every frame
+	while (capacity > MIN_INSTANCE_CAPACITY && count <= capacity / 4) {
+		capacity /= 2;
+	}
+
+	if (capacity == instanceCapacity && regionCount == instanceRegionCount && instanceBuffer != nullptr && instanceBufferFormat == pipelineKey.instanceFormat) {
+		return nullptr;
+	}
+
+	std::shared_ptr<Buffer> oldBuffer = instanceBuffer;
+	AllocateInstanceBuffer(capacity, regionCount);
+	instanceReallocationCount++;
+
+	return oldBuffer;
+}
+
+VkDeviceSize Mesh::UpdateInstanceBuffer(uint32_t region)
 {
-	//Get Data as TransformData
 	std::vector<std::shared_ptr<Transform>> activeInstances = GetActiveInstances();
-	std::vector<TransformData> bufferData(activeInstanceCount);
 
-	for (size_t i = 0; i < activeInstanceCount; i++) {
-		bufferData[i] = TransformData::LoadMat4(activeInstances[i]->GetModelMatrix());
+	if (activeInstanceCount > instanceCapacity) {
+		throw std::runtime_error("Too many instances for the instance buffer, reserve space for them first!");
 	}
 
-	//Create buffer
-	VkDeviceSize bufferSize = sizeof(TransformData) * bufferData.size();
-	instanceBuffer = std::make_shared<Buffer>(VkBuffer(), VkDeviceMemory());
-	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *instanceBuffer);
+	if (activeInstances.empty()) {
+		return 0;
+	}
+
+	//Pack straight into the mapped buffer in the layout it was allocated for
+	uint32_t stride = TransformData::GetStride(instanceBufferFormat);
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(stride) * activeInstances.size();
 
-	//Copy Data
 	void* data;
-	vkMapMemory(logicalDevice, instanceBuffer->GetBufferMemory(), 0, bufferSize, 0, &data);
-	memcpy(data, bufferData.data(), bufferSize);
+	vkMapMemory(logicalDevice, instanceBuffer->GetBufferMemory(), GetInstanceBufferOffset(region), bufferSize, 0, &data);
+
+	for (size_t i = 0; i < activeInstances.size(); i++) {
+		TransformData::Pack(instanceBufferFormat, activeInstances[i]->GetModelMatrix(), reinterpret_cast<char*>(data) + stride * i);
+	}
+
 	vkUnmapMemory(logicalDevice, instanceBuffer->GetBufferMemory());
+
+	return bufferSize;
 }
 
-void Mesh::UpdateInstanceBuffer()
+VkDeviceSize Mesh::UpdateInstanceBuffer(uint32_t region, const std::vector<uint32_t>& visibleInstances)
 {
-	//Get Data as TransformData
-	std::vector<std::shared_ptr<Transform>> activeInstances = GetActiveInstances();
-	std::vector<TransformData> bufferData(activeInstanceCount);
+	if (visibleInstances.empty()) {
+		return 0;
+	}
 
-	for (size_t i = 0; i < activeInstanceCount; i++) {
-		bufferData[i] = TransformData::LoadMat4(activeInstances[i]->GetModelMatrix());
+	if (visibleInstances.size() > instanceCapacity) {
+		throw std::runtime_error("Too many instances for the instance buffer, reserve space for them first!");
 	}
 
-	VkDeviceSize bufferSize = sizeof(TransformData) * bufferData.size();
+	std::vector<std::shared_ptr<Transform>> activeInstances = GetActiveInstances();
+	uint32_t stride = TransformData::GetStride(instanceBufferFormat);
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(stride) * visibleInstances.size();
 
-	//Copy Data
 	void* data;
-	vkMapMemory(logicalDevice, instanceBuffer->GetBufferMemory(), 0, bufferSize, 0, &data);
-	memcpy(data, bufferData.data(), bufferSize);
+	vkMapMemory(logicalDevice, instanceBuffer->GetBufferMemory(), GetInstanceBufferOffset(region), bufferSize, 0, &data);
+
+	for (size_t i = 0; i < visibleInstances.size(); i++) {
+		TransformData::Pack(instanceBufferFormat, activeInstances[visibleInstances[i]]->GetModelMatrix(), reinterpret_cast<char*>(data) + stride * i);
+	}
+
 	vkUnmapMemory(logicalDevice, instanceBuffer->GetBufferMemory());
+
+	return bufferSize;
+}
+
+VkDeviceSize Mesh::GetInstanceBufferOffset(uint32_t region)
+{
+	return static_cast<VkDeviceSize>(TransformData::GetStride(instanceBufferFormat)) * instanceCapacity * region;
 }
 
 #pragma endregion
@@ -79,6 +142,7 @@ std::vector<Vertex> Mesh::GetVertices()
 void Mesh::SetVertices(std::vector<Vertex> value)
 {
 	vertices = value;
+	triangleBVH = nullptr;
 }
 
 std::shared_ptr<Buffer> Mesh::GetVertexBuffer()
@@ -97,6 +161,16 @@ void Mesh::SetVertexBuffer(std::shared_ptr<Buffer> value, uint32_t offset)
 	vertexBufferOffset = offset;
 }
 
+std::shared_ptr<Buffer> Mesh::GetPositionBuffer()
+{
+	return positionBuffer;
+}
+
+void Mesh::SetPositionBuffer(std::shared_ptr<Buffer> value)
+{
+	positionBuffer = value;
+}
+
 std::vector<uint16_t> Mesh::GetIndices()
 {
 	return indices;
@@ -105,6 +179,7 @@ std::vector<uint16_t> Mesh::GetIndices()
 void Mesh::SetIndices(std::vector<uint16_t> value)
 {
 	indices = value;
+	triangleBVH = nullptr;
 }
 
 std::shared_ptr<Buffer> Mesh::GetIndexBuffer()
@@ -143,6 +218,19 @@ std::vector<std::shared_ptr<Transform>> Mesh::GetActiveInstances()
 	return activeInstances;
 }
 
+std::vector<uint32_t> Mesh::GetActiveInstanceIds()
+{
+	std::vector<uint32_t> activeInstanceIds;
+
+	for (size_t i = 0; i < instances.size(); i++) {
+		if (instances[i] != nullptr) {
+			activeInstanceIds.push_back(static_cast<uint32_t>(i));
+		}
+	}
+
+	return activeInstanceIds;
+}
+
 std::shared_ptr<Buffer> Mesh::GetInstanceBuffer()
 {
 	return instanceBuffer;
@@ -153,28 +241,152 @@ void Mesh::SetInstanceBuffer(std::shared_ptr<Buffer> value)
 	instanceBuffer = value;
 }
 
+uint32_t Mesh::GetInstanceCapacity()
+{
+	return instanceCapacity;
+}
+
+uint32_t Mesh::GetInstanceReallocationCount()
+{
+	return instanceReallocationCount;
+}
+
+PipelineKey Mesh::GetPipelineKey()
+{
+	return pipelineKey;
+}
+
+void Mesh::SetPipelineKey(PipelineKey value)
+{
+	pipelineKey = value;
+}
+
+DrawConstants Mesh::GetDrawConstants()
+{
+	return drawConstants;
+}
+
+void Mesh::SetDrawConstants(DrawConstants value)
+{
+	drawConstants = value;
+}
+
 #pragma endregion
 
-#pragma region Mesh Generation
+#pragma region Texturing
 
-void Mesh::AddInstance(std::shared_ptr<Transform> value)
+void Mesh::SetAtlasRegion(AtlasRegion region)
 {
-	activeInstanceCount++;
-	size_t freeIndex = -1;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		vertices[i].textureCoordinate = region.uvOffset + vertices[i].textureCoordinate * region.uvScale;
+		vertices[i].textureLayer = static_cast<float>(region.layer);
+	}
 
-	for (size_t i = 0; i < instances.size(); i++) {
-		if (instances[i] == nullptr) {
-			freeIndex = i;
-			break;
+	UpdateBuffers();
+}
+
+bool Mesh::SamplesStreamedTexture()
+{
+	//Every vertex of an atlas mesh has the region's layer, the others keep a negative layer
+	return (pipelineKey.features & SHADER_FEATURE_TEXTURE) != 0 && !vertices.empty() && vertices[0].textureLayer < 0.0f;
+}
+
+#pragma endregion
+
+#pragma region Bounds
+
+glm::vec4 Mesh::GetBoundingSphere()
+{
+	if (vertices.empty()) {
+		return glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	//Center on the bounding box, slightly larger than the tightest sphere but cheap and stable
+	glm::vec3 minimum = vertices[0].position;
+	glm::vec3 maximum = vertices[0].position;
+
+	for (size_t i = 1; i < vertices.size(); i++) {
+		minimum = glm::min(minimum, vertices[i].position);
+		maximum = glm::max(maximum, vertices[i].position);
+	}
+
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		radius = std::max(radius, glm::length(vertices[i].position - center));
+	}
+
+	return glm::vec4(center, radius);
+}
+
+AABB Mesh::GetBoundingBox()
+{
+	AABB bounds;
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		bounds.grow(vertices[i].position);
+	}
+
+	return bounds;
+}
+
+std::shared_ptr<TriangleBVH> Mesh::GetTriangleBVH()
+{
+	if (triangleBVH == nullptr) {
+		std::vector<glm::vec3> positions(vertices.size());
+
+		for (size_t i = 0; i < vertices.size(); i++) {
+			positions[i] = vertices[i].position;
 		}
+
+		triangleBVH = std::make_shared<TriangleBVH>(positions, indices);
+	}
+
+	return triangleBVH;
+}
+
+#pragma endregion
+
+#pragma region Skinning
+
+std::vector<VertexSkin> Mesh::GetSkin()
+{
+	return skin;
+}
+
+void Mesh::SetSkin(std::vector<VertexSkin> value)
+{
+	if (!value.empty() && value.size() != vertices.size()) {
+		throw std::runtime_error("Skin does not match the mesh's vertices!");
 	}
 
-	if (freeIndex == -1) {
+	skin = value;
+}
+
+bool Mesh::IsSkinned()
+{
+	return !skin.empty();
+}
+
+#pragma endregion
+
+#pragma region Mesh Generation
+
+uint32_t Mesh::AddInstance(std::shared_ptr<Transform> value)
+{
+	activeInstanceCount++;
+
+	if (freeInstanceIds.empty()) {
 		instances.push_back(value);
-		return;
+		return static_cast<uint32_t>(instances.size() - 1);
 	}
 
+	uint32_t freeIndex = freeInstanceIds.back();
+	freeInstanceIds.pop_back();
+
 	instances[freeIndex] = value;
+	return freeIndex;
 }
 
 void Mesh::RemoveInstance(int instanceId)
@@ -183,12 +395,20 @@ void Mesh::RemoveInstance(int instanceId)
 		throw std::runtime_error("Failed to remove instance Id out of bounds!");
 	}
 
+	if (instances[instanceId] == nullptr) {
+		return;
+	}
+
 	activeInstanceCount--;
-	instances[instanceId] == nullptr;
+	instances[instanceId] = nullptr;
+	freeInstanceIds.push_back(static_cast<uint32_t>(instanceId));
 }
 
 void Mesh::GeneratePlane()
 {
+	//Count the vertex and index arrays as geometry in memory reports
+	MemoryScope scope(MemoryCategory::Geometry);
+
 	//Set vertices
 	vertices.resize(4);
 
@@ -211,6 +431,8 @@ void Mesh::GeneratePlane()
 }
 
 void Mesh::GenerateCube() {
+	MemoryScope scope(MemoryCategory::Geometry);
+
 	//Set vertices
 	vertices.resize(4);
 
@@ -248,6 +470,8 @@ void Mesh::GenerateCube() {
 
 void Mesh::GenerateSphere(int resolution)
 {
+	MemoryScope scope(MemoryCategory::Geometry);
+
 	//Set minimum resolution of 3
 	if (resolution < 3) {
 		resolution = 3;
@@ -348,9 +572,20 @@ void Mesh::GenerateSphere(int resolution)
 
 #pragma region Buffer Management
 
+void Mesh::AllocateInstanceBuffer(uint32_t capacity, uint32_t regionCount)
+{
+	instanceBufferFormat = pipelineKey.instanceFormat;
+	instanceBuffer = std::make_shared<Buffer>(VkBuffer(), VkDeviceMemory());
+	Buffer::CreateBuffer(static_cast<VkDeviceSize>(TransformData::GetStride(instanceBufferFormat)) * capacity * regionCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Instances, *instanceBuffer);
+
+	instanceCapacity = capacity;
+	instanceRegionCount = regionCount;
+}
+
 void Mesh::UpdateBuffers()
 {
 	//TODO: Update buffers with accurate mesh data
+	triangleBVH = nullptr;
 }
 
 #pragma endregion
\ No newline at end of file
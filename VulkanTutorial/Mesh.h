@@ -5,29 +5,58 @@
 #include "Transform.h"
 #include "Buffer.h"
 #include "UniformBufferObject.h"
+#include "TextureAtlas.h"
+#include "PipelineKey.h"
+#include "DrawConstants.h"
+#include "Bounds.h"
+#include "TriangleBVH.h"
 
 class Mesh
 {
 private:
 	std::vector<Vertex> vertices;
+	//Empty unless the mesh is skinned
+	std::vector<VertexSkin> skin;
 	uint32_t vertexBufferOffset;
 	std::shared_ptr<Buffer> vertexBuffer;
+	std::shared_ptr<Buffer> positionBuffer;
 
 	std::vector<uint16_t> indices;
 	uint32_t indexBufferOffset;
 	std::shared_ptr<Buffer> indexBuffer;
 
 	std::vector<std::shared_ptr<Transform>> instances;
+	//Slots emptied by RemoveInstance, reused before the list grows so adding an instance doesn't search the list
+	std::vector<uint32_t> freeInstanceIds;
 	uint32_t activeInstanceCount;
 	std::shared_ptr<Buffer> instanceBuffer;
+	//The number of instances each region of the instance buffer has room for and how many times it has been replaced to change that
+	uint32_t instanceCapacity;
+	//The instance buffer holds one region per swap chain image so a frame never writes the instances an earlier frame in flight is drawing
+	uint32_t instanceRegionCount;
+	uint32_t instanceReallocationCount;
+	//The layout the instance buffer was allocated for, it is replaced when the pipeline key asks for a different one
+	InstanceFormat instanceBufferFormat;
+
+	PipelineKey pipelineKey;
+	DrawConstants drawConstants;
+
+	//Built the first time the mesh is ray cast and shared by every instance, cleared whenever the geometry changes
+	std::shared_ptr<TriangleBVH> triangleBVH;
 
 #pragma region Buffer Management
 
 	void UpdateBuffers();
 
+	/// <summary>
+	/// Replaces the instance buffer with an empty one that fits the specified number of instances in the pipeline key's instance format in every region
+	/// </summary>
+	void AllocateInstanceBuffer(uint32_t capacity, uint32_t regionCount);
+
 #pragma endregion
 
 public:
+	static const uint32_t MIN_INSTANCE_CAPACITY = 16;
 
 #pragma region Constructor
 
@@ -45,12 +74,38 @@ public:
 	/// <summary>
 	/// Creates and allocates the instance buffer that will be used by this mesh
 	/// </summary>
-	void CreateInstanceBuffer();
+	/// <param name="regionCount">The number of swap chain images, each gets its own region of the buffer</param>
+	void CreateInstanceBuffer(uint32_t regionCount);
 
 	/// <summary>
-	/// Updates the mesh's instance buffer
+	/// Grows the instance buffer geometrically if the instances don't fit, or halves it once they use less than a quarter of it
+	/// The buffer is also replaced if the pipeline key's instance format or the number of regions changed
 	/// </summary>
-	void UpdateInstanceBuffer();
+	/// <param name="count">The number of instances that need to fit</param>
+	/// <param name="regionCount">The number of swap chain images, each gets its own region of the buffer</param>
+	/// <returns>The replaced buffer, which must be kept alive until no frame in flight uses it, or nullptr if the buffer didn't change</returns>
+	std::shared_ptr<Buffer> ReserveInstances(uint32_t count, uint32_t regionCount);
+
+	/// <summary>
+	/// Updates a region of the mesh's instance buffer
+	/// </summary>
+	/// <param name="region">The swap chain image being drawn, its last frame must have finished</param>
+	/// <returns>The number of bytes copied to the device</returns>
+	VkDeviceSize UpdateInstanceBuffer(uint32_t region);
+
+	/// <summary>
+	/// Packs a subset of the active instances into the front of a region of the instance buffer
+	/// </summary>
+	/// <param name="region">The swap chain image being drawn, its last frame must have finished</param>
+	/// <param name="visibleInstances">Indices into the active instances to write</param>
+	/// <returns>The number of bytes copied to the device</returns>
+	VkDeviceSize UpdateInstanceBuffer(uint32_t region, const std::vector<uint32_t>& visibleInstances);
+
+	/// <summary>
+	/// Returns where a region starts in the instance buffer
+	/// </summary>
+	/// <param name="region">The swap chain image being drawn</param>
+	VkDeviceSize GetInstanceBufferOffset(uint32_t region);
 
 #pragma endregion
 
@@ -87,6 +142,18 @@ public:
 	/// <param name="offset">The offset within the buffer that this mesh's data is stored at</param>
 	void SetVertexBuffer(std::shared_ptr<Buffer> value, uint32_t offset = 0);
 
+	/// <summary>
+	/// Returns the buffer holding only the vertex positions, used by the depth pre-pass
+	/// </summary>
+	/// <returns>The position buffer</returns>
+	std::shared_ptr<Buffer> GetPositionBuffer();
+
+	/// <summary>
+	/// Sets the buffer holding only the vertex positions
+	/// </summary>
+	/// <param name="value">The position buffer to set to</param>
+	void SetPositionBuffer(std::shared_ptr<Buffer> value);
+
 	/// <summary>
 	/// Returns the list of indices associated with this mesh
 	/// </summary>
@@ -129,6 +196,11 @@ public:
 	/// </summary>
 	std::vector<std::shared_ptr<Transform>> GetActiveInstances();
 
+	/// <summary>
+	/// Returns the ids AddInstance gave the active instances, in the same order as GetActiveInstances
+	/// </summary>
+	std::vector<uint32_t> GetActiveInstanceIds();
+
 	/// <summary>
 	/// Returns the instance buffer used by this mesh
 	/// </summary>
@@ -141,6 +213,41 @@ public:
 	/// <param name="value">The value to set the instance buffer to</param>
 	void SetInstanceBuffer(std::shared_ptr<Buffer> value);
 
+	/// <summary>
+	/// Returns the number of instances the instance buffer has room for
+	/// </summary>
+	uint32_t GetInstanceCapacity();
+
+	/// <summary>
+	/// Returns how many times the instance buffer has been replaced to change its capacity
+	/// </summary>
+	uint32_t GetInstanceReallocationCount();
+
+	/// <summary>
+	/// Returns the shader permutation this mesh is drawn with
+	/// </summary>
+	/// <returns>The mesh's pipeline key</returns>
+	PipelineKey GetPipelineKey();
+
+	/// <summary>
+	/// Sets the shader permutation this mesh is drawn with, command buffers must be re-recorded for the change to take effect
+	/// Changing the instance format takes effect once ReserveInstances has replaced the instance buffer
+	/// </summary>
+	/// <param name="value">The pipeline key to draw with</param>
+	void SetPipelineKey(PipelineKey value);
+
+	/// <summary>
+	/// Returns the values pushed before this mesh is drawn
+	/// </summary>
+	/// <returns>The mesh's draw constants</returns>
+	DrawConstants GetDrawConstants();
+
+	/// <summary>
+	/// Sets the values pushed before this mesh is drawn, command buffers must be re-recorded for the change to take effect
+	/// </summary>
+	/// <param name="value">The draw constants to push</param>
+	void SetDrawConstants(DrawConstants value);
+
 #pragma endregion
 
 #pragma region Instances
@@ -149,7 +256,8 @@ public:
 	/// Adds the specified transform to the instance list
 	/// </summary>
 	/// <param name="value">The transform to add</param>
-	void AddInstance(std::shared_ptr<Transform> value);
+	/// <returns>The instance's id, used to remove it</returns>
+	uint32_t AddInstance(std::shared_ptr<Transform> value);
 
 	/// <summary>
 	/// Removes the specified instance from the instance list
@@ -159,6 +267,64 @@ public:
 
 #pragma endregion
 
+#pragma region Texturing
+
+	/// <summary>
+	/// Remaps the mesh's texture coordinates into a region of a texture atlas, must be called before the vertex buffer is created
+	/// </summary>
+	/// <param name="region">The atlas region to sample from, texture coordinates are expected to be in the 0 to 1 range</param>
+	void SetAtlasRegion(AtlasRegion region);
+
+	/// <summary>
+	/// Returns whether the mesh's draws sample the streamed texture rather than the atlas
+	/// </summary>
+	/// <returns>True if the pipeline reads a texture and the mesh has no atlas region</returns>
+	bool SamplesStreamedTexture();
+
+#pragma endregion
+
+#pragma region Bounds
+
+	/// <summary>
+	/// Returns a sphere in model space that contains every vertex, used for culling
+	/// </summary>
+	/// <returns>The sphere's center in xyz and its radius in w</returns>
+	glm::vec4 GetBoundingSphere();
+
+	/// <summary>
+	/// Returns the box in model space that contains every vertex
+	/// </summary>
+	AABB GetBoundingBox();
+
+	/// <summary>
+	/// Returns the triangle BVH used to ray cast against the mesh, building it if the geometry changed since it was last used
+	/// </summary>
+	/// <returns>The tree in model space, shared by every instance</returns>
+	std::shared_ptr<TriangleBVH> GetTriangleBVH();
+
+#pragma endregion
+
+#pragma region Skinning
+
+	/// <summary>
+	/// Returns the joints and weights of every vertex, empty if the mesh is not skinned
+	/// </summary>
+	/// <returns>One entry per vertex</returns>
+	std::vector<VertexSkin> GetSkin();
+
+	/// <summary>
+	/// Sets the joints and weights of every vertex
+	/// </summary>
+	/// <param name="value">One entry per vertex, or empty to make the mesh rigid</param>
+	void SetSkin(std::vector<VertexSkin> value);
+
+	/// <summary>
+	/// Returns whether the mesh has skinning data
+	/// </summary>
+	bool IsSkinned();
+
+#pragma endregion
+
 #pragma region Mesh Generation
 
 	/// <summary>
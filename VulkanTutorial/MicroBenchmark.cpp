@@ -0,0 +1,346 @@
+#include "pch.h"
+#include "MicroBenchmark.h"
+
+#include "Transform.h"
+#include "TransformData.h"
+#include "Camera.h"
+#include "Mesh.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <iomanip>
+
+#pragma region Constructor
+
+BenchmarkState::BenchmarkState(uint64_t iterations, int64_t argument)
+{
+	this->iterations = iterations;
+	this->argument = argument;
+	remainingIterations = iterations;
+	itemsProcessed = 0;
+
+	running = false;
+	elapsedTime = std::chrono::steady_clock::duration::zero();
+}
+
+#pragma endregion
+
+#pragma region Timing
+
+bool BenchmarkState::KeepRunning()
+{
+	if (!running && remainingIterations == iterations) {
+		ResumeTiming();
+	}
+
+	if (remainingIterations == 0) {
+		PauseTiming();
+		return false;
+	}
+
+	remainingIterations--;
+	return true;
+}
+
+void BenchmarkState::PauseTiming()
+{
+	if (running) {
+		elapsedTime += std::chrono::steady_clock::now() - startTime;
+		running = false;
+	}
+}
+
+void BenchmarkState::ResumeTiming()
+{
+	if (!running) {
+		startTime = std::chrono::steady_clock::now();
+		running = true;
+	}
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+int64_t BenchmarkState::GetArgument()
+{
+	return argument;
+}
+
+uint64_t BenchmarkState::GetIterations()
+{
+	return iterations;
+}
+
+double BenchmarkState::GetElapsedTime()
+{
+	return std::chrono::duration<double>(elapsedTime).count();
+}
+
+uint64_t BenchmarkState::GetItemsProcessed()
+{
+	return itemsProcessed;
+}
+
+void BenchmarkState::SetItemsProcessed(uint64_t value)
+{
+	itemsProcessed = value;
+}
+
+#pragma endregion
+
+#pragma region Running
+
+void MicroBenchmark::Run(const std::vector<std::string>& arguments)
+{
+	std::string filter;
+	std::string outputPath;
+	double minTime = DEFAULT_MIN_TIME;
+
+	for (size_t i = 0; i < arguments.size(); i++) {
+		if (arguments[i] == "--min-time" && i + 1 < arguments.size()) {
+			minTime = std::stod(arguments[++i]);
+		}
+		else if (arguments[i] == "--output" && i + 1 < arguments.size()) {
+			outputPath = arguments[++i];
+		}
+		else if (filter.empty() && arguments[i].rfind("--", 0) != 0) {
+			filter = arguments[i];
+		}
+		else {
+			throw std::runtime_error("Unknown microbenchmark argument " + arguments[i] + "!");
+		}
+	}
+
+	std::vector<MicroBenchmarkResult> results;
+
+	std::cout << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(16) << "Time (ns)" << std::setw(14) << "Iterations" << std::setw(18) << "Items/s" << std::endl;
+
+	for (const MicroBenchmarkCase& benchmarkCase : CreateCases()) {
+		std::vector<int64_t> caseArguments = benchmarkCase.arguments.empty() ? std::vector<int64_t>{ 0 } : benchmarkCase.arguments;
+
+		for (int64_t argument : caseArguments) {
+			std::string name = benchmarkCase.arguments.empty() ? benchmarkCase.name : benchmarkCase.name + "/" + std::to_string(argument);
+
+			if (name.find(filter) == std::string::npos) {
+				continue;
+			}
+
+			BenchmarkState state = Measure(benchmarkCase.function, argument, minTime);
+
+			MicroBenchmarkResult result;
+			result.name = name;
+			result.iterations = state.GetIterations();
+			result.timePerIteration = state.GetElapsedTime() * 1000000000.0 / state.GetIterations();
+			result.itemsPerSecond = state.GetElapsedTime() > 0.0 ? state.GetItemsProcessed() / state.GetElapsedTime() : 0.0;
+			results.push_back(result);
+
+			std::cout << std::left << std::setw(48) << result.name << std::right << std::setw(16) << std::fixed << std::setprecision(1) << result.timePerIteration << std::setw(14) << result.iterations;
+			std::cout << std::setw(18) << std::scientific << std::setprecision(3) << result.itemsPerSecond << std::defaultfloat << std::endl;
+		}
+	}
+
+	if (outputPath.empty()) {
+		return;
+	}
+
+	std::ofstream file(outputPath);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open " + outputPath + " for writing!");
+	}
+
+	if (std::filesystem::path(outputPath).extension() == ".json") {
+		WriteJSON(file, results);
+	}
+	else {
+		WriteCSV(file, results);
+	}
+
+	if (!file) {
+		throw std::runtime_error("Failed to write microbenchmark results!");
+	}
+}
+
+std::vector<MicroBenchmarkCase> MicroBenchmark::CreateCases()
+{
+	std::vector<MicroBenchmarkCase> cases;
+
+	//Instance counts from a small scene up to the largest the scene benchmark sweeps
+	const std::vector<int64_t> INSTANCE_COUNTS = { 64, 4096, 262144 };
+
+	//Every instance moves each frame so each one's matrix is rebuilt before it is read
+	cases.push_back({ "Transform/GenerateModelMatrix", [](BenchmarkState& state) {
+		size_t count = static_cast<size_t>(state.GetArgument());
+		std::vector<std::shared_ptr<Transform>> transforms(count);
+
+		for (size_t i = 0; i < count; i++) {
+			transforms[i] = std::make_shared<Transform>(glm::vec3(static_cast<float>(i), 0.0f, 0.0f), glm::quat(glm::vec3(0.0f, i * 0.1f, 0.0f)), glm::vec3(0.5f));
+		}
+
+		while (state.KeepRunning()) {
+			for (size_t i = 0; i < count; i++) {
+				transforms[i]->SetPosition(glm::vec3(static_cast<float>(i), 0.0f, 0.0f));
+				DoNotOptimize(transforms[i]->GetModelMatrix());
+			}
+		}
+
+		state.SetItemsProcessed(state.GetIterations() * count);
+	}, INSTANCE_COUNTS });
+
+	cases.push_back({ "Camera/UpdateView", [](BenchmarkState& state) {
+		Camera camera(glm::vec3(0.0f, 5.0f, 5.0f), glm::quat(glm::vec3(glm::radians(45.0f), 0.0f, 0.0f)));
+		float offset = 0.0f;
+
+		while (state.KeepRunning()) {
+			camera.GetTransform()->SetPosition(glm::vec3(offset, 5.0f, 5.0f));
+			DoNotOptimize(camera.GetView());
+			offset += 0.001f;
+		}
+
+		state.SetItemsProcessed(state.GetIterations());
+	}, {} });
+
+	cases.push_back({ "Camera/UpdateProjection", [](BenchmarkState& state) {
+		Camera camera;
+		float aspectRatio = 1.0f;
+
+		while (state.KeepRunning()) {
+			camera.SetAspectRatio(aspectRatio);
+			DoNotOptimize(camera.GetProjection());
+			aspectRatio = aspectRatio == 1.0f ? 1.5f : 1.0f;
+		}
+
+		state.SetItemsProcessed(state.GetIterations());
+	}, {} });
+
+	cases.push_back({ "TransformData/LoadMat4", [](BenchmarkState& state) {
+		size_t count = static_cast<size_t>(state.GetArgument());
+		std::vector<glm::mat4> matrices(count);
+		std::vector<TransformData> data(count);
+
+		for (size_t i = 0; i < count; i++) {
+			matrices[i] = Transform(glm::vec3(static_cast<float>(i), 1.0f, 2.0f), glm::quat(glm::vec3(0.0f, i * 0.1f, 0.0f))).GetModelMatrix();
+		}
+
+		while (state.KeepRunning()) {
+			for (size_t i = 0; i < count; i++) {
+				data[i] = TransformData::LoadMat4(matrices[i]);
+			}
+
+			DoNotOptimize(data.data());
+		}
+
+		state.SetItemsProcessed(state.GetIterations() * count);
+	}, INSTANCE_COUNTS });
+
+	//The argument is the instance format, 4096 instances are packed into a buffer laid out like a mapped instance buffer
+	cases.push_back({ "TransformData/Pack", [](BenchmarkState& state) {
+		const size_t COUNT = 4096;
+		InstanceFormat format = static_cast<InstanceFormat>(state.GetArgument());
+		uint32_t stride = TransformData::GetStride(format);
+		std::vector<glm::mat4> matrices(COUNT);
+		std::vector<char> buffer(stride * COUNT);
+
+		for (size_t i = 0; i < COUNT; i++) {
+			matrices[i] = Transform(glm::vec3(static_cast<float>(i), 1.0f, 2.0f), glm::quat(glm::vec3(0.0f, i * 0.1f, 0.0f)), glm::vec3(0.5f)).GetModelMatrix();
+		}
+
+		while (state.KeepRunning()) {
+			for (size_t i = 0; i < COUNT; i++) {
+				TransformData::Pack(format, matrices[i], buffer.data() + stride * i);
+			}
+
+			DoNotOptimize(buffer.data());
+		}
+
+		state.SetItemsProcessed(state.GetIterations() * COUNT);
+	}, { 0, 1, 2, 3 } });
+
+	//A quarter of the instances are removed so the active list has holes like a scene that has despawned objects
+	cases.push_back({ "Mesh/GetActiveInstances", [](BenchmarkState& state) {
+		size_t count = static_cast<size_t>(state.GetArgument());
+		Mesh mesh;
+
+		for (size_t i = 0; i < count; i++) {
+			mesh.AddInstance(std::make_shared<Transform>());
+		}
+
+		for (size_t i = 0; i < count; i += 4) {
+			mesh.RemoveInstance(static_cast<int>(i));
+		}
+
+		while (state.KeepRunning()) {
+			std::vector<std::shared_ptr<Transform>> instances = mesh.GetActiveInstances();
+			DoNotOptimize(instances.data());
+		}
+
+		state.SetItemsProcessed(state.GetIterations() * count);
+	}, INSTANCE_COUNTS });
+
+	//The argument is the sphere resolution, 128 is the largest that fits in 16 bit indices with room to spare
+	cases.push_back({ "Mesh/GenerateSphere", [](BenchmarkState& state) {
+		Mesh mesh;
+
+		while (state.KeepRunning()) {
+			mesh.GenerateSphere(static_cast<int>(state.GetArgument()));
+			DoNotOptimize(mesh);
+		}
+
+		state.SetItemsProcessed(state.GetIterations());
+	}, { 8, 16, 32, 64, 128 } });
+
+	return cases;
+}
+
+BenchmarkState MicroBenchmark::Measure(const std::function<void(BenchmarkState&)>& function, int64_t argument, double minTime)
+{
+	uint64_t iterations = 1;
+
+	while (true) {
+		BenchmarkState state(iterations, argument);
+		function(state);
+
+		double elapsedTime = state.GetElapsedTime();
+		if (elapsedTime >= minTime || iterations >= MAX_ITERATIONS) {
+			return state;
+		}
+
+		//Aim a little past the minimum time from the rate so far, growing at most tenfold in case the first runs were too short to time
+		double scale = elapsedTime > 0.0 ? minTime * 1.4 / elapsedTime : 10.0;
+		scale = scale > 10.0 ? 10.0 : scale;
+
+		uint64_t nextIterations = static_cast<uint64_t>(iterations * scale) + 1;
+		iterations = nextIterations < MAX_ITERATIONS ? nextIterations : MAX_ITERATIONS;
+	}
+}
+
+#pragma endregion
+
+#pragma region Output
+
+void MicroBenchmark::WriteCSV(std::ostream& stream, const std::vector<MicroBenchmarkResult>& results)
+{
+	stream << "name,iterations,timeNs,itemsPerSecond" << std::endl;
+
+	for (const MicroBenchmarkResult& result : results) {
+		stream << result.name << "," << result.iterations << "," << result.timePerIteration << "," << result.itemsPerSecond << std::endl;
+	}
+}
+
+void MicroBenchmark::WriteJSON(std::ostream& stream, const std::vector<MicroBenchmarkResult>& results)
+{
+	stream << "[" << std::endl;
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const MicroBenchmarkResult& result = results[i];
+
+		stream << "\t{ \"name\": \"" << result.name << "\", \"iterations\": " << result.iterations << ", \"timeNs\": " << result.timePerIteration
+			<< ", \"itemsPerSecond\": " << result.itemsPerSecond << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+
+	stream << "]" << std::endl;
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "pch.h"
+
+#include <ostream>
+#include <functional>
+#include <chrono>
+#include <atomic>
+
+//Passed to every microbenchmark, only the code inside the KeepRunning loop is timed
+class BenchmarkState
+{
+private:
+	uint64_t iterations;
+	uint64_t remainingIterations;
+	int64_t argument;
+	uint64_t itemsProcessed;
+
+	bool running;
+	std::chrono::steady_clock::time_point startTime;
+	std::chrono::steady_clock::duration elapsedTime;
+
+public:
+#pragma region Constructor
+
+	BenchmarkState(uint64_t iterations, int64_t argument);
+
+#pragma endregion
+
+#pragma region Timing
+
+	/// <summary>
+	/// Starts the timer on the first call and stops it once every iteration has run
+	/// </summary>
+	/// <returns>Whether another iteration should run</returns>
+	bool KeepRunning();
+
+	/// <summary>
+	/// Stops the timer so per iteration setup isn't measured
+	/// </summary>
+	void PauseTiming();
+
+	/// <summary>
+	/// Restarts the timer after PauseTiming
+	/// </summary>
+	void ResumeTiming();
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the size parameter the benchmark is being run with
+	/// </summary>
+	int64_t GetArgument();
+
+	/// <summary>
+	/// Returns the number of times the timed loop runs
+	/// </summary>
+	uint64_t GetIterations();
+
+	/// <summary>
+	/// Returns the time spent in the timed loop in seconds
+	/// </summary>
+	double GetElapsedTime();
+
+	/// <summary>
+	/// Returns the number of items set by SetItemsProcessed
+	/// </summary>
+	uint64_t GetItemsProcessed();
+
+	/// <summary>
+	/// Sets the total number of items handled across every iteration, reported as a throughput
+	/// </summary>
+	void SetItemsProcessed(uint64_t value);
+
+#pragma endregion
+};
+
+//A benchmark function and the sizes to run it with, without any arguments it runs once with an argument of 0
+struct MicroBenchmarkCase {
+	std::string name;
+	std::function<void(BenchmarkState&)> function;
+	std::vector<int64_t> arguments;
+};
+
+struct MicroBenchmarkResult {
+	std::string name;
+	uint64_t iterations;
+	double timePerIteration;
+	//Zero for benchmarks that don't set the items processed
+	double itemsPerSecond;
+};
+
+class MicroBenchmark
+{
+public:
+	//Each benchmark runs with more iterations until it takes at least this long
+	static constexpr double DEFAULT_MIN_TIME = 0.5;
+	static const uint64_t MAX_ITERATIONS = 1000000000;
+
+#pragma region Running
+
+	/// <summary>
+	/// Runs every registered CPU benchmark whose name contains the filter and prints the results
+	/// </summary>
+	/// <param name="arguments">The arguments after --microbench: [filter] [--min-time seconds] [--output results.csv|results.json]</param>
+	static void Run(const std::vector<std::string>& arguments);
+
+	/// <summary>
+	/// Creates the benchmarks for the transform, camera, instance packing and mesh generation hot paths
+	/// </summary>
+	static std::vector<MicroBenchmarkCase> CreateCases();
+
+	/// <summary>
+	/// Runs a benchmark with growing iteration counts until it runs for the minimum time
+	/// </summary>
+	/// <param name="function">The benchmark to run</param>
+	/// <param name="argument">The size parameter to pass to the benchmark</param>
+	/// <param name="minTime">The minimum time in seconds the measured run has to take</param>
+	/// <returns>The state of the measured run</returns>
+	static BenchmarkState Measure(const std::function<void(BenchmarkState&)>& function, int64_t argument, double minTime);
+
+	/// <summary>
+	/// Stops the compiler from optimizing away a value that is otherwise unused
+	/// </summary>
+	template<typename T>
+	static void DoNotOptimize(const T& value) {
+#ifdef _MSC_VER
+		//MSVC has no inline assembly on x64 so the value is read back through a volatile pointer instead
+		const volatile char* pointer = reinterpret_cast<const volatile char*>(&value);
+		*pointer;
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+
+#pragma endregion
+
+#pragma region Output
+
+	/// <summary>
+	/// Writes one row per result with a header row
+	/// </summary>
+	static void WriteCSV(std::ostream& stream, const std::vector<MicroBenchmarkResult>& results);
+
+	/// <summary>
+	/// Writes the results as an array of objects
+	/// </summary>
+	static void WriteJSON(std::ostream& stream, const std::vector<MicroBenchmarkResult>& results);
+
+#pragma endregion
+};
\ No newline at end of file
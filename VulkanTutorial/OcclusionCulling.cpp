@@ -0,0 +1,671 @@
+#include "pch.h"
+#include "OcclusionCulling.h"
+
+#include "TriangleApp.h"
+#include "Command.h"
+
+#pragma region Constructor
+
+OcclusionCulling::OcclusionCulling(uint32_t maxInstances, uint32_t maxMeshes)
+{
+	this->maxInstances = maxInstances;
+	this->maxMeshes = maxMeshes;
+	instanceFormat = InstanceFormat::Matrix4x4;
+
+	cullSetLayout = VK_NULL_HANDLE;
+	reduceSetLayout = VK_NULL_HANDLE;
+	cullPipelineLayout = VK_NULL_HANDLE;
+	reducePipelineLayout = VK_NULL_HANDLE;
+	earlyCullPipeline = VK_NULL_HANDLE;
+	lateCullPipeline = VK_NULL_HANDLE;
+	reducePipeline = VK_NULL_HANDLE;
+	pyramidSampler = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	pyramidView = VK_NULL_HANDLE;
+}
+
+void OcclusionCulling::Cleanup()
+{
+	VkPipeline pipelines[] = { earlyCullPipeline, lateCullPipeline, reducePipeline };
+	for (VkPipeline pipeline : pipelines) {
+		if (pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(TriangleApp::logicalDevice, pipeline, nullptr);
+		}
+	}
+
+	earlyCullPipeline = VK_NULL_HANDLE;
+	lateCullPipeline = VK_NULL_HANDLE;
+	reducePipeline = VK_NULL_HANDLE;
+
+	if (cullPipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(TriangleApp::logicalDevice, cullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(TriangleApp::logicalDevice, reducePipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(TriangleApp::logicalDevice, cullSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(TriangleApp::logicalDevice, reduceSetLayout, nullptr);
+		vkDestroySampler(TriangleApp::logicalDevice, pyramidSampler, nullptr);
+
+		cullPipelineLayout = VK_NULL_HANDLE;
+		reducePipelineLayout = VK_NULL_HANDLE;
+		cullSetLayout = VK_NULL_HANDLE;
+		reduceSetLayout = VK_NULL_HANDLE;
+		pyramidSampler = VK_NULL_HANDLE;
+	}
+}
+
+#pragma endregion
+
+#pragma region Resources
+
+void OcclusionCulling::SetInstanceFormat(InstanceFormat format)
+{
+	instanceFormat = format;
+}
+
+std::array<VkPipeline, 3> OcclusionCulling::CreatePipelines(VkShaderModule cullModule, VkShaderModule reduceModule)
+{
+	if (cullPipelineLayout == VK_NULL_HANDLE) {
+		CreateLayouts();
+	}
+
+	//Both cull phases come from the same shader, the phase, buffer sizes and instance layout are specialization constants
+	struct CullSpecialization {
+		VkBool32 latePhase;
+		uint32_t maxMeshes;
+		uint32_t maxInstances;
+		int32_t instanceFormat;
+		uint32_t instanceWords;
+	};
+
+	std::array<VkSpecializationMapEntry, 5> specializationEntries = {};
+	specializationEntries[0].constantID = 0;
+	specializationEntries[0].offset = offsetof(CullSpecialization, latePhase);
+	specializationEntries[0].size = sizeof(VkBool32);
+	specializationEntries[1].constantID = 1;
+	specializationEntries[1].offset = offsetof(CullSpecialization, maxMeshes);
+	specializationEntries[1].size = sizeof(uint32_t);
+	specializationEntries[2].constantID = 2;
+	specializationEntries[2].offset = offsetof(CullSpecialization, maxInstances);
+	specializationEntries[2].size = sizeof(uint32_t);
+	specializationEntries[3].constantID = 3;
+	specializationEntries[3].offset = offsetof(CullSpecialization, instanceFormat);
+	specializationEntries[3].size = sizeof(int32_t);
+	specializationEntries[4].constantID = 4;
+	specializationEntries[4].offset = offsetof(CullSpecialization, instanceWords);
+	specializationEntries[4].size = sizeof(uint32_t);
+
+	std::array<CullSpecialization, 2> specializations = {};
+	std::array<VkSpecializationInfo, 2> specializationInfos = {};
+	std::array<VkComputePipelineCreateInfo, 3> createInfos = {};
+
+	for (size_t i = 0; i < createInfos.size(); i++) {
+		bool reduce = i == 2;
+
+		createInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		createInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		createInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		createInfos[i].stage.module = reduce ? reduceModule : cullModule;
+		createInfos[i].stage.pName = "main";
+		createInfos[i].layout = reduce ? reducePipelineLayout : cullPipelineLayout;
+		createInfos[i].basePipelineHandle = VK_NULL_HANDLE;
+		createInfos[i].basePipelineIndex = -1;
+
+		if (!reduce) {
+			specializations[i].latePhase = i == 1 ? VK_TRUE : VK_FALSE;
+			specializations[i].maxMeshes = maxMeshes;
+			specializations[i].maxInstances = maxInstances;
+			specializations[i].instanceFormat = static_cast<int32_t>(instanceFormat);
+			specializations[i].instanceWords = TransformData::GetStride(instanceFormat) / sizeof(uint32_t);
+
+			specializationInfos[i].mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+			specializationInfos[i].pMapEntries = specializationEntries.data();
+			specializationInfos[i].dataSize = sizeof(CullSpecialization);
+			specializationInfos[i].pData = &specializations[i];
+
+			createInfos[i].stage.pSpecializationInfo = &specializationInfos[i];
+		}
+	}
+
+	std::array<VkPipeline, 3> newPipelines = {};
+	if (vkCreateComputePipelines(TriangleApp::logicalDevice, VK_NULL_HANDLE, static_cast<uint32_t>(createInfos.size()), createInfos.data(), nullptr, newPipelines.data()) != VK_SUCCESS) {
+		for (VkPipeline pipeline : newPipelines) {
+			if (pipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(TriangleApp::logicalDevice, pipeline, nullptr);
+			}
+		}
+
+		throw std::runtime_error("Failed to create Occlusion Culling Pipelines!");
+	}
+
+	std::array<VkPipeline, 3> oldPipelines = { earlyCullPipeline, lateCullPipeline, reducePipeline };
+	earlyCullPipeline = newPipelines[0];
+	lateCullPipeline = newPipelines[1];
+	reducePipeline = newPipelines[2];
+
+	return oldPipelines;
+}
+
+void OcclusionCulling::CreateResources(const std::vector<std::shared_ptr<Buffer>>& uniformBuffers, VkExtent2D depthExtent, VkImageView depthImageView)
+{
+	size_t imageCount = uniformBuffers.size();
+
+	objectBuffers.resize(imageCount);
+	meshBuffers.resize(imageCount);
+
+	for (size_t i = 0; i < imageCount; i++) {
+		objectBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(uint32_t) * 4 + sizeof(CullObject) * maxInstances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Instances, *objectBuffers[i]);
+
+		meshBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(CullMesh) * maxMeshes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Other, *meshBuffers[i]);
+	}
+
+	//The first half of the draws and visible instances belong to the early phase, the second half to the late phase
+	//Visible instances are sized for the largest instance format so switching formats doesn't reallocate them
+	drawBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxMeshes * 2, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *drawBuffer);
+
+	visibleInstanceBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(static_cast<VkDeviceSize>(TransformData::MAX_STRIDE) * maxInstances * 2, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Instances, *visibleInstanceBuffer);
+
+	occludedBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(uint32_t) * maxInstances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *occludedBuffer);
+
+	CreatePyramid(depthExtent);
+
+	uint32_t levelCount = static_cast<uint32_t>(pyramidLevelViews.size());
+
+	//Create the descriptor pool
+	std::array<VkDescriptorPoolSize, 4> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(imageCount);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(imageCount) * 5;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(imageCount) + levelCount;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[3].descriptorCount = levelCount;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	poolCreateInfo.maxSets = static_cast<uint32_t>(imageCount) + levelCount;
+
+	if (vkCreateDescriptorPool(TriangleApp::logicalDevice, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Occlusion Culling Descriptor Pool!");
+	}
+
+	//Allocate the descriptor sets
+	std::vector<VkDescriptorSetLayout> cullLayouts(imageCount, cullSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = descriptorPool;
+	allocateInfo.descriptorSetCount = static_cast<uint32_t>(imageCount);
+	allocateInfo.pSetLayouts = cullLayouts.data();
+
+	cullSets.resize(imageCount);
+
+	if (vkAllocateDescriptorSets(TriangleApp::logicalDevice, &allocateInfo, cullSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate Occlusion Culling Descriptor Sets!");
+	}
+
+	std::vector<VkDescriptorSetLayout> reduceLayouts(levelCount, reduceSetLayout);
+	allocateInfo.descriptorSetCount = levelCount;
+	allocateInfo.pSetLayouts = reduceLayouts.data();
+
+	reduceSets.resize(levelCount);
+
+	if (vkAllocateDescriptorSets(TriangleApp::logicalDevice, &allocateInfo, reduceSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate Depth Pyramid Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < imageCount; i++) {
+		std::array<VkDescriptorBufferInfo, 6> bufferInfos = {};
+		bufferInfos[0].buffer = uniformBuffers[i]->GetBuffer();
+		bufferInfos[0].range = sizeof(UniformBufferObject);
+		bufferInfos[1].buffer = objectBuffers[i]->GetBuffer();
+		bufferInfos[1].range = VK_WHOLE_SIZE;
+		bufferInfos[2].buffer = meshBuffers[i]->GetBuffer();
+		bufferInfos[2].range = VK_WHOLE_SIZE;
+		bufferInfos[3].buffer = drawBuffer->GetBuffer();
+		bufferInfos[3].range = VK_WHOLE_SIZE;
+		bufferInfos[4].buffer = visibleInstanceBuffer->GetBuffer();
+		bufferInfos[4].range = VK_WHOLE_SIZE;
+		bufferInfos[5].buffer = occludedBuffer->GetBuffer();
+		bufferInfos[5].range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo pyramidInfo = {};
+		pyramidInfo.sampler = pyramidSampler;
+		pyramidInfo.imageView = pyramidView;
+		pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		std::array<VkWriteDescriptorSet, 7> descriptorWrites = {};
+		for (size_t j = 0; j < descriptorWrites.size(); j++) {
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].dstSet = cullSets[i];
+			descriptorWrites[j].dstBinding = static_cast<uint32_t>(j);
+			descriptorWrites[j].dstArrayElement = 0;
+			descriptorWrites[j].descriptorCount = 1;
+
+			if (j == 0) {
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+			}
+			else if (j < bufferInfos.size()) {
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+			}
+			else {
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				descriptorWrites[j].pImageInfo = &pyramidInfo;
+			}
+		}
+
+		vkUpdateDescriptorSets(TriangleApp::logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	//Each level reads the one above it, the first level reads the depth buffer
+	for (uint32_t i = 0; i < levelCount; i++) {
+		VkDescriptorImageInfo sourceInfo = {};
+		sourceInfo.sampler = pyramidSampler;
+		sourceInfo.imageView = i == 0 ? depthImageView : pyramidLevelViews[i - 1];
+		sourceInfo.imageLayout = i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo destinationInfo = {};
+		destinationInfo.imageView = pyramidLevelViews[i];
+		destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+		for (size_t j = 0; j < descriptorWrites.size(); j++) {
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].dstSet = reduceSets[i];
+			descriptorWrites[j].dstBinding = static_cast<uint32_t>(j);
+			descriptorWrites[j].dstArrayElement = 0;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptorWrites[j].pImageInfo = j == 0 ? &sourceInfo : &destinationInfo;
+		}
+
+		vkUpdateDescriptorSets(TriangleApp::logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void OcclusionCulling::CleanupResources()
+{
+	vkDestroyDescriptorPool(TriangleApp::logicalDevice, descriptorPool, nullptr);
+	descriptorPool = VK_NULL_HANDLE;
+	cullSets.clear();
+	reduceSets.clear();
+
+	for (size_t i = 0; i < objectBuffers.size(); i++) {
+		objectBuffers[i]->Cleanup();
+		meshBuffers[i]->Cleanup();
+	}
+
+	objectBuffers.clear();
+	meshBuffers.clear();
+
+	drawBuffer->Cleanup();
+	visibleInstanceBuffer->Cleanup();
+	occludedBuffer->Cleanup();
+
+	for (VkImageView view : pyramidLevelViews) {
+		vkDestroyImageView(TriangleApp::logicalDevice, view, nullptr);
+	}
+
+	pyramidLevelViews.clear();
+	pyramidLevelExtents.clear();
+
+	vkDestroyImageView(TriangleApp::logicalDevice, pyramidView, nullptr);
+	pyramidView = VK_NULL_HANDLE;
+	pyramid.Cleanup();
+}
+
+#pragma endregion
+
+#pragma region Rendering
+
+VkDeviceSize OcclusionCulling::UpdateInstances(uint32_t imageIndex, std::vector<Mesh>& meshes)
+{
+	if (meshes.size() > maxMeshes) {
+		throw std::runtime_error("Too many meshes to cull!");
+	}
+
+	//Mesh bounds never change once the vertices are uploaded so they are only found once
+	if (boundingSpheres.size() != meshes.size()) {
+		boundingSpheres.resize(meshes.size());
+
+		for (size_t i = 0; i < meshes.size(); i++) {
+			boundingSpheres[i] = meshes[i].GetBoundingSphere();
+		}
+	}
+
+	void* data;
+	vkMapMemory(TriangleApp::logicalDevice, meshBuffers[imageIndex]->GetBufferMemory(), 0, sizeof(CullMesh) * meshes.size(), 0, &data);
+	CullMesh* cullMeshes = reinterpret_cast<CullMesh*>(data);
+
+	uint32_t objectCount = 0;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		cullMeshes[i] = {};
+		cullMeshes[i].boundingSphere = boundingSpheres[i];
+		cullMeshes[i].indexCount = static_cast<uint32_t>(meshes[i].GetIndices().size());
+		cullMeshes[i].instanceOffset = objectCount;
+
+		objectCount += meshes[i].GetActiveInstanceCount();
+	}
+
+	vkUnmapMemory(TriangleApp::logicalDevice, meshBuffers[imageIndex]->GetBufferMemory());
+
+	if (objectCount > maxInstances) {
+		throw std::runtime_error("Too many instances to cull!");
+	}
+
+	//The object count sits in front of the objects so the shader can skip threads past the end
+	VkDeviceSize headerSize = sizeof(uint32_t) * 4;
+	vkMapMemory(TriangleApp::logicalDevice, objectBuffers[imageIndex]->GetBufferMemory(), 0, headerSize + sizeof(CullObject) * objectCount, 0, &data);
+	*reinterpret_cast<uint32_t*>(data) = objectCount;
+	CullObject* objects = reinterpret_cast<CullObject*>(reinterpret_cast<char*>(data) + headerSize);
+
+	uint32_t objectIndex = 0;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		std::vector<std::shared_ptr<Transform>> instances = meshes[i].GetActiveInstances();
+
+		for (size_t j = 0; j < instances.size(); j++) {
+			objects[objectIndex].meshIndex = static_cast<uint32_t>(i);
+			TransformData::Pack(instanceFormat, instances[j]->GetModelMatrix(), objects[objectIndex].instance);
+			objectIndex++;
+		}
+	}
+
+	vkUnmapMemory(TriangleApp::logicalDevice, objectBuffers[imageIndex]->GetBufferMemory());
+
+	return sizeof(CullMesh) * meshes.size() + headerSize + sizeof(CullObject) * objectCount;
+}
+
+void OcclusionCulling::RecordEarlyCull(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t objectCount)
+{
+	//The previous frame has to be done drawing from the culling buffers and writing the pyramid before they are reused
+	VkMemoryBarrier reuseBarrier = {};
+	reuseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reuseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	reuseBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &reuseBarrier,
+		0, nullptr,
+		0, nullptr);
+
+	//Both phases count their instances up from zero
+	vkCmdFillBuffer(commandBuffer, drawBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+	VkBufferMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.buffer = drawBuffer->GetBuffer();
+	clearBarrier.offset = 0;
+	clearBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0, nullptr,
+		1, &clearBarrier,
+		0, nullptr);
+
+	RecordCull(commandBuffer, imageIndex, objectCount, earlyCullPipeline);
+}
+
+void OcclusionCulling::RecordBuildPyramid(VkCommandBuffer commandBuffer)
+{
+	//The early cull has to finish reading the pyramid before it is overwritten
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+
+	for (size_t i = 0; i < pyramidLevelViews.size(); i++) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipelineLayout, 0, 1, &reduceSets[i], 0, nullptr);
+
+		VkExtent2D extent = pyramidLevelExtents[i];
+		vkCmdDispatch(commandBuffer, (extent.width + REDUCE_WORKGROUP_SIZE - 1) / REDUCE_WORKGROUP_SIZE, (extent.height + REDUCE_WORKGROUP_SIZE - 1) / REDUCE_WORKGROUP_SIZE, 1);
+
+		//The next level and the late cull read this one
+		VkImageMemoryBarrier levelBarrier = {};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.image = pyramid.GetImage();
+		levelBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		levelBarrier.subresourceRange.baseMipLevel = static_cast<uint32_t>(i);
+		levelBarrier.subresourceRange.levelCount = 1;
+		levelBarrier.subresourceRange.baseArrayLayer = 0;
+		levelBarrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &levelBarrier);
+	}
+}
+
+void OcclusionCulling::RecordLateCull(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t objectCount)
+{
+	RecordCull(commandBuffer, imageIndex, objectCount, lateCullPipeline);
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkBuffer OcclusionCulling::GetDrawBuffer()
+{
+	return drawBuffer->GetBuffer();
+}
+
+VkDeviceSize OcclusionCulling::GetDrawOffset(uint32_t meshIndex, bool latePhase)
+{
+	return sizeof(VkDrawIndexedIndirectCommand) * (meshIndex + (latePhase ? maxMeshes : 0));
+}
+
+VkBuffer OcclusionCulling::GetVisibleInstanceBuffer()
+{
+	return visibleInstanceBuffer->GetBuffer();
+}
+
+uint32_t OcclusionCulling::GetMaxMeshes()
+{
+	return maxMeshes;
+}
+
+uint32_t OcclusionCulling::GetMaxInstances()
+{
+	return maxInstances;
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void OcclusionCulling::CreateLayouts()
+{
+	//Binding 0 is the camera uniform buffer, then the object, mesh, draw, visible instance and occluded buffers and the pyramid
+	std::array<VkDescriptorSetLayoutBinding, 7> cullBindings = {};
+	for (size_t i = 0; i < cullBindings.size(); i++) {
+		cullBindings[i].binding = static_cast<uint32_t>(i);
+		cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		cullBindings[i].descriptorCount = 1;
+		cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		cullBindings[i].pImmutableSamplers = nullptr;
+	}
+
+	cullBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cullBindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+	layoutCreateInfo.pBindings = cullBindings.data();
+
+	if (vkCreateDescriptorSetLayout(TriangleApp::logicalDevice, &layoutCreateInfo, nullptr, &cullSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Occlusion Culling Descriptor Set Layout!");
+	}
+
+	//The reduction reads the level above and writes the next one
+	std::array<VkDescriptorSetLayoutBinding, 2> reduceBindings = {};
+	for (size_t i = 0; i < reduceBindings.size(); i++) {
+		reduceBindings[i].binding = static_cast<uint32_t>(i);
+		reduceBindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		reduceBindings[i].descriptorCount = 1;
+		reduceBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		reduceBindings[i].pImmutableSamplers = nullptr;
+	}
+
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(reduceBindings.size());
+	layoutCreateInfo.pBindings = reduceBindings.data();
+
+	if (vkCreateDescriptorSetLayout(TriangleApp::logicalDevice, &layoutCreateInfo, nullptr, &reduceSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Depth Pyramid Descriptor Set Layout!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &cullSetLayout;
+
+	if (vkCreatePipelineLayout(TriangleApp::logicalDevice, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Occlusion Culling Pipeline Layout!");
+	}
+
+	pipelineLayoutCreateInfo.pSetLayouts = &reduceSetLayout;
+
+	if (vkCreatePipelineLayout(TriangleApp::logicalDevice, &pipelineLayoutCreateInfo, nullptr, &reducePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Depth Pyramid Pipeline Layout!");
+	}
+
+	//Texels are fetched directly so the sampler never filters
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = 1.0f;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerCreateInfo.compareEnable = VK_FALSE;
+	samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(TriangleApp::logicalDevice, &samplerCreateInfo, nullptr, &pyramidSampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Depth Pyramid Sampler!");
+	}
+}
+
+void OcclusionCulling::CreatePyramid(VkExtent2D depthExtent)
+{
+	//The first level is half the depth buffer, rounded up so no depth texel is left out
+	VkExtent2D extent = { std::max((depthExtent.width + 1) / 2, 1u), std::max((depthExtent.height + 1) / 2, 1u) };
+
+	pyramidLevelExtents.clear();
+	pyramidLevelExtents.push_back(extent);
+
+	while (extent.width > 1 || extent.height > 1) {
+		extent = { std::max((extent.width + 1) / 2, 1u), std::max((extent.height + 1) / 2, 1u) };
+		pyramidLevelExtents.push_back(extent);
+	}
+
+	uint32_t levelCount = static_cast<uint32_t>(pyramidLevelExtents.size());
+
+	Image::CreateImage(pyramidLevelExtents[0].width, pyramidLevelExtents[0].height, levelCount,
+		VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MemoryCategory::Attachments,
+		pyramid);
+
+	pyramidView = Image::CreateImageView(pyramid.GetImage(), VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+
+	pyramidLevelViews.resize(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		pyramidLevelViews[i] = Image::CreateImageView(pyramid.GetImage(), VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, VK_IMAGE_VIEW_TYPE_2D, 1, i);
+	}
+
+	//The pyramid stays in the general layout since it is both written and sampled every frame
+	VkCommandBuffer commandBuffer = Command::BeginSingleTimeCommand();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramid.GetImage();
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	//Everything passes against a pyramid at the far plane
+	VkClearColorValue clearColor = {};
+	clearColor.float32[0] = 1.0f;
+	vkCmdClearColorImage(commandBuffer, pyramid.GetImage(), VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &barrier.subresourceRange);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	Command::EndSingleTimeCommand(commandBuffer);
+}
+
+void OcclusionCulling::RecordCull(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t objectCount, VkPipeline pipeline)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSets[imageIndex], 0, nullptr);
+
+	if (objectCount > 0) {
+		vkCmdDispatch(commandBuffer, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+	}
+
+	//The draws read the commands and instances, the late cull reads the occluded flags and adds to the counts
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+#pragma endregion
\ No newline at end of file
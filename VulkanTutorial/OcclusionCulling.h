@@ -0,0 +1,191 @@
+#pragma once
+
+#include "pch.h"
+#include "Buffer.h"
+#include "Image.h"
+#include "Mesh.h"
+#include "UniformBufferObject.h"
+#include "TransformData.h"
+
+//Must match the structs in OcclusionCull.comp
+struct CullObject {
+	uint32_t meshIndex;
+	uint32_t padding[3];
+	//The instance packed in the draw format, the shader unpacks it for the bounds and copies it to the visible instances as is
+	uint32_t instance[TransformData::MAX_STRIDE / sizeof(uint32_t)];
+};
+
+struct CullMesh {
+	glm::vec4 boundingSphere;
+	uint32_t indexCount;
+	uint32_t instanceOffset;
+	uint32_t padding[2];
+};
+
+class OcclusionCulling
+{
+private:
+	uint32_t maxInstances;
+	uint32_t maxMeshes;
+	InstanceFormat instanceFormat;
+
+	VkDescriptorSetLayout cullSetLayout;
+	VkDescriptorSetLayout reduceSetLayout;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipelineLayout reducePipelineLayout;
+	VkPipeline earlyCullPipeline;
+	VkPipeline lateCullPipeline;
+	VkPipeline reducePipeline;
+	VkSampler pyramidSampler;
+
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> cullSets;
+	std::vector<VkDescriptorSet> reduceSets;
+
+	//Instance transforms and mesh bounds are written by the CPU every frame, everything else only lives on the GPU
+	std::vector<std::shared_ptr<Buffer>> objectBuffers;
+	std::vector<std::shared_ptr<Buffer>> meshBuffers;
+	std::shared_ptr<Buffer> drawBuffer;
+	std::shared_ptr<Buffer> visibleInstanceBuffer;
+	std::shared_ptr<Buffer> occludedBuffer;
+
+	//Each level stores the farthest depth of the texels it covers
+	Image pyramid;
+	VkImageView pyramidView;
+	std::vector<VkImageView> pyramidLevelViews;
+	std::vector<VkExtent2D> pyramidLevelExtents;
+
+	std::vector<glm::vec4> boundingSpheres;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Creates the descriptor set layouts, pipeline layouts and the pyramid sampler
+	/// </summary>
+	void CreateLayouts();
+
+	/// <summary>
+	/// Creates the depth pyramid and clears it to the far plane so nothing is culled before the first pyramid is built
+	/// </summary>
+	/// <param name="depthExtent">The size of the depth buffer the pyramid is built from</param>
+	void CreatePyramid(VkExtent2D depthExtent);
+
+	/// <summary>
+	/// Records a dispatch of one of the cull pipelines followed by a barrier so the draws can read the results
+	/// </summary>
+	void RecordCull(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t objectCount, VkPipeline pipeline);
+
+#pragma endregion
+
+public:
+	//Must match the local sizes in OcclusionCull.comp and HiZReduce.comp
+	static const uint32_t CULL_WORKGROUP_SIZE = 64;
+	static const uint32_t REDUCE_WORKGROUP_SIZE = 8;
+
+#pragma region Constructor
+
+	OcclusionCulling(uint32_t maxInstances = 16384, uint32_t maxMeshes = 64);
+
+	/// <summary>
+	/// Destroys the compute pipelines, layouts and sampler, CleanupResources must be called first
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Resources
+
+	/// <summary>
+	/// Sets the layout the visible instances are written in, it must match the pipelines the culled draws use
+	/// The cull pipelines bake the layout in so CreatePipelines has to be called afterwards
+	/// </summary>
+	void SetInstanceFormat(InstanceFormat format);
+
+	/// <summary>
+	/// Creates the cull and pyramid reduction pipelines, the previous pipelines are returned so the caller can destroy them once no frame is using them
+	/// </summary>
+	/// <param name="cullModule">The compiled OcclusionCull.comp shader</param>
+	/// <param name="reduceModule">The compiled HiZReduce.comp shader</param>
+	/// <returns>The replaced pipelines, VK_NULL_HANDLE entries were never created</returns>
+	std::array<VkPipeline, 3> CreatePipelines(VkShaderModule cullModule, VkShaderModule reduceModule);
+
+	/// <summary>
+	/// Creates the culling buffers, the depth pyramid and the descriptor sets for each swap chain image
+	/// </summary>
+	/// <param name="uniformBuffers">The per image uniform buffers holding the camera matrices</param>
+	/// <param name="depthExtent">The size of the depth buffer</param>
+	/// <param name="depthImageView">The depth buffer, it must be in the shader read only layout when the pyramid is built</param>
+	void CreateResources(const std::vector<std::shared_ptr<Buffer>>& uniformBuffers, VkExtent2D depthExtent, VkImageView depthImageView);
+
+	/// <summary>
+	/// Destroys the culling buffers, the pyramid and the descriptor sets
+	/// </summary>
+	void CleanupResources();
+
+#pragma endregion
+
+#pragma region Rendering
+
+	/// <summary>
+	/// Copies every active instance and the bounds of every mesh into the buffers of a swap chain image
+	/// </summary>
+	/// <param name="imageIndex">The swap chain image that is about to be drawn</param>
+	/// <param name="meshes">The meshes to cull, in the order they are drawn</param>
+	/// <returns>The number of bytes copied to the device</returns>
+	VkDeviceSize UpdateInstances(uint32_t imageIndex, std::vector<Mesh>& meshes);
+
+	/// <summary>
+	/// Tests every instance against the pyramid built last frame and writes the draws for the ones that pass
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into, outside of a render pass</param>
+	/// <param name="imageIndex">The swap chain image the command buffer draws to</param>
+	/// <param name="objectCount">The number of instances that will be uploaded by UpdateInstances</param>
+	void RecordEarlyCull(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t objectCount);
+
+	/// <summary>
+	/// Downsamples the depth buffer into the pyramid, the depth buffer must hold everything drawn by the early draws
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into, outside of a render pass</param>
+	void RecordBuildPyramid(VkCommandBuffer commandBuffer);
+
+	/// <summary>
+	/// Re-tests the instances the early cull rejected against the new pyramid and writes draws for the ones that became visible
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into, outside of a render pass</param>
+	/// <param name="imageIndex">The swap chain image the command buffer draws to</param>
+	/// <param name="objectCount">The number of instances that will be uploaded by UpdateInstances</param>
+	void RecordLateCull(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t objectCount);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the buffer holding the indirect draw commands, one per mesh for each phase
+	/// </summary>
+	VkBuffer GetDrawBuffer();
+
+	/// <summary>
+	/// Returns the offset of a mesh's indirect draw in the draw buffer
+	/// </summary>
+	/// <param name="meshIndex">The index of the mesh</param>
+	/// <param name="latePhase">Whether to return the draw written by the late cull</param>
+	VkDeviceSize GetDrawOffset(uint32_t meshIndex, bool latePhase);
+
+	/// <summary>
+	/// Returns the buffer holding the transforms of the visible instances, bound in place of the mesh instance buffers
+	/// </summary>
+	VkBuffer GetVisibleInstanceBuffer();
+
+	/// <summary>
+	/// Returns the maximum number of meshes that can be culled
+	/// </summary>
+	uint32_t GetMaxMeshes();
+
+	/// <summary>
+	/// Returns the maximum number of instances that can be culled across every mesh
+	/// </summary>
+	uint32_t GetMaxInstances();
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+#Builds the app with profile guided optimization and reports the frame time change against a normal build
+#
+#Run from anywhere with: cmake -P PGO.cmake
+#	-DBUILD_DIR=<path>			Where the baseline and PGO builds go, defaults to build next to this file
+#	-DGENERATOR=<name>			CMake generator to configure with
+#	-DBENCHMARK_ARGS=<args>		Arguments for the training and measured benchmark runs, defaults to --quick
+#	-DLTO=OFF					Build both without link time optimization, PGO is normally paired with it
+#	-DLLVM_PROFDATA=<path>		llvm-profdata matching the compiler, only needed for Clang
+#
+#1. A Release build is benchmarked to give the baseline
+#2. An instrumented build runs the same benchmark to record which paths are hot
+#3. The same build directory is rebuilt using the profile and benchmarked again
+#4. The two results files are compared with --compare
+
+cmake_minimum_required(VERSION 3.19)
+
+set(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}")
+
+if(NOT BUILD_DIR)
+	set(BUILD_DIR "${SOURCE_DIR}/build")
+endif()
+
+if(NOT DEFINED BENCHMARK_ARGS)
+	set(BENCHMARK_ARGS "--quick")
+endif()
+
+if(NOT DEFINED LTO)
+	set(LTO ON)
+endif()
+
+set(BASELINE_DIR "${BUILD_DIR}/pgo-baseline")
+set(PGO_DIR "${BUILD_DIR}/pgo")
+set(PROFILE_DIR "${PGO_DIR}/profile")
+
+set(CONFIGURE_ARGS -DCMAKE_BUILD_TYPE=Release -DVT_ENABLE_LTO=${LTO} "-DVT_BENCHMARK_ARGS=${BENCHMARK_ARGS}" "-DVT_PGO_DIRECTORY=${PROFILE_DIR}")
+
+if(GENERATOR)
+	list(APPEND CONFIGURE_ARGS -G "${GENERATOR}")
+endif()
+
+function(run_step description)
+	message(STATUS "${description}")
+	execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${description} failed")
+	endif()
+endfunction()
+
+#Baseline
+run_step("Configuring the baseline build" ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BASELINE_DIR}" ${CONFIGURE_ARGS} -DVT_PGO=OFF)
+run_step("Building the baseline" ${CMAKE_COMMAND} --build "${BASELINE_DIR}" --config Release)
+run_step("Benchmarking the baseline" ${CMAKE_COMMAND} --build "${BASELINE_DIR}" --config Release --target Benchmark)
+
+#Training, old profiles are removed so code that has since changed isn't optimized for stale counts
+file(REMOVE_RECURSE "${PROFILE_DIR}")
+run_step("Configuring the instrumented build" ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${PGO_DIR}" ${CONFIGURE_ARGS} -DVT_PGO=GENERATE -DVT_BENCHMARK_BASELINE=)
+run_step("Building the instrumented app" ${CMAKE_COMMAND} --build "${PGO_DIR}" --config Release)
+run_step("Recording the profile" ${CMAKE_COMMAND} --build "${PGO_DIR}" --config Release --target Benchmark)
+
+#Clang writes raw profiles that have to be merged before they can be used, GCC and MSVC read theirs directly
+file(GLOB RAW_PROFILES "${PROFILE_DIR}/*.profraw")
+
+if(RAW_PROFILES)
+	if(NOT LLVM_PROFDATA)
+		find_program(LLVM_PROFDATA NAMES llvm-profdata)
+	endif()
+
+	if(NOT LLVM_PROFDATA)
+		message(FATAL_ERROR "llvm-profdata was not found, pass it with -DLLVM_PROFDATA=<path>")
+	endif()
+
+	run_step("Merging the profile" "${LLVM_PROFDATA}" merge "-output=${PROFILE_DIR}/default.profdata" ${RAW_PROFILES})
+endif()
+
+#Optimized build, reusing the directory keeps object paths the same so GCC can match each profile to its source
+run_step("Configuring the optimized build" ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${PGO_DIR}" ${CONFIGURE_ARGS} -DVT_PGO=USE "-DVT_BENCHMARK_BASELINE=${BASELINE_DIR}/benchmark.csv")
+run_step("Building the optimized app" ${CMAKE_COMMAND} --build "${PGO_DIR}" --config Release)
+run_step("Benchmarking the optimized app" ${CMAKE_COMMAND} --build "${PGO_DIR}" --config Release --target Benchmark)
+run_step("Comparing against the baseline" ${CMAKE_COMMAND} --build "${PGO_DIR}" --config Release --target BenchmarkCompare)
\ No newline at end of file
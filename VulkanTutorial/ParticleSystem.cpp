@@ -0,0 +1,408 @@
+#include "pch.h"
+#include "ParticleSystem.h"
+
+#include "TriangleApp.h"
+#include "Command.h"
+
+#pragma region Constructor
+
+ParticleSystem::ParticleSystem(uint32_t maxParticles)
+{
+	this->maxParticles = maxParticles;
+
+	gravity = glm::vec3(0.0f, -9.8f, 0.0f);
+	restitution = 0.5f;
+	emitAccumulator = 0.0f;
+	frameSeed = 0;
+
+	descriptorSetLayout = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	simulatePipeline = VK_NULL_HANDLE;
+	finishPipeline = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+}
+
+void ParticleSystem::Cleanup()
+{
+	VkPipeline pipelines[] = { simulatePipeline, finishPipeline };
+	for (VkPipeline pipeline : pipelines) {
+		if (pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(TriangleApp::logicalDevice, pipeline, nullptr);
+		}
+	}
+
+	simulatePipeline = VK_NULL_HANDLE;
+	finishPipeline = VK_NULL_HANDLE;
+
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(TriangleApp::logicalDevice, pipelineLayout, nullptr);
+		pipelineLayout = VK_NULL_HANDLE;
+	}
+
+	if (descriptorSetLayout != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(TriangleApp::logicalDevice, descriptorSetLayout, nullptr);
+		descriptorSetLayout = VK_NULL_HANDLE;
+	}
+}
+
+#pragma endregion
+
+#pragma region Resources
+
+std::array<VkPipeline, 2> ParticleSystem::CreatePipelines(VkShaderModule shaderModule)
+{
+	if (pipelineLayout == VK_NULL_HANDLE) {
+		CreateLayouts();
+	}
+
+	//Both passes come from the same shader, the pass and buffer size are specialization constants
+	struct ParticleSpecialization {
+		VkBool32 finishPass;
+		uint32_t maxParticles;
+	};
+
+	std::array<VkSpecializationMapEntry, 2> specializationEntries = {};
+	specializationEntries[0].constantID = 0;
+	specializationEntries[0].offset = offsetof(ParticleSpecialization, finishPass);
+	specializationEntries[0].size = sizeof(VkBool32);
+	specializationEntries[1].constantID = 1;
+	specializationEntries[1].offset = offsetof(ParticleSpecialization, maxParticles);
+	specializationEntries[1].size = sizeof(uint32_t);
+
+	std::array<ParticleSpecialization, 2> specializations = {};
+	std::array<VkSpecializationInfo, 2> specializationInfos = {};
+	std::array<VkComputePipelineCreateInfo, 2> createInfos = {};
+
+	for (size_t i = 0; i < createInfos.size(); i++) {
+		specializations[i].finishPass = i == 1 ? VK_TRUE : VK_FALSE;
+		specializations[i].maxParticles = maxParticles;
+
+		specializationInfos[i].mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+		specializationInfos[i].pMapEntries = specializationEntries.data();
+		specializationInfos[i].dataSize = sizeof(ParticleSpecialization);
+		specializationInfos[i].pData = &specializations[i];
+
+		createInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		createInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		createInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		createInfos[i].stage.module = shaderModule;
+		createInfos[i].stage.pName = "main";
+		createInfos[i].stage.pSpecializationInfo = &specializationInfos[i];
+		createInfos[i].layout = pipelineLayout;
+		createInfos[i].basePipelineHandle = VK_NULL_HANDLE;
+		createInfos[i].basePipelineIndex = -1;
+	}
+
+	std::array<VkPipeline, 2> newPipelines = {};
+	if (vkCreateComputePipelines(TriangleApp::logicalDevice, VK_NULL_HANDLE, static_cast<uint32_t>(createInfos.size()), createInfos.data(), nullptr, newPipelines.data()) != VK_SUCCESS) {
+		for (VkPipeline pipeline : newPipelines) {
+			if (pipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(TriangleApp::logicalDevice, pipeline, nullptr);
+			}
+		}
+
+		throw std::runtime_error("Failed to create Particle Pipelines!");
+	}
+
+	std::array<VkPipeline, 2> oldPipelines = { simulatePipeline, finishPipeline };
+	simulatePipeline = newPipelines[0];
+	finishPipeline = newPipelines[1];
+
+	return oldPipelines;
+}
+
+void ParticleSystem::CreateResources(uint32_t imageCount)
+{
+	settingsBuffers.resize(imageCount);
+
+	for (size_t i = 0; i < imageCount; i++) {
+		settingsBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(ParticleSettings), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniforms, *settingsBuffers[i]);
+	}
+
+	particleBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(Particle) * maxParticles * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *particleBuffer);
+
+	stateBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(ParticleState), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *stateBuffer);
+
+	//Each particle is written as a transform so it can be drawn through the same vertex input as mesh instances
+	instanceBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(glm::mat4) * maxParticles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Instances, *instanceBuffer);
+
+	drawBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Other, *drawBuffer);
+
+	//Start with no particles alive and nothing to draw
+	VkCommandBuffer commandBuffer = Command::BeginSingleTimeCommand();
+	vkCmdFillBuffer(commandBuffer, stateBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+	vkCmdFillBuffer(commandBuffer, drawBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+	Command::EndSingleTimeCommand(commandBuffer);
+
+	//Create the descriptor pool
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = imageCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = imageCount * 4;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	poolCreateInfo.maxSets = imageCount;
+
+	if (vkCreateDescriptorPool(TriangleApp::logicalDevice, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Particle Descriptor Pool!");
+	}
+
+	//Allocate the descriptor sets
+	std::vector<VkDescriptorSetLayout> layouts(imageCount, descriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = descriptorPool;
+	allocateInfo.descriptorSetCount = imageCount;
+	allocateInfo.pSetLayouts = layouts.data();
+
+	descriptorSets.resize(imageCount);
+
+	if (vkAllocateDescriptorSets(TriangleApp::logicalDevice, &allocateInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate Particle Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < imageCount; i++) {
+		std::array<VkDescriptorBufferInfo, 5> bufferInfos = {};
+		bufferInfos[0].buffer = settingsBuffers[i]->GetBuffer();
+		bufferInfos[0].range = sizeof(ParticleSettings);
+		bufferInfos[1].buffer = particleBuffer->GetBuffer();
+		bufferInfos[1].range = VK_WHOLE_SIZE;
+		bufferInfos[2].buffer = stateBuffer->GetBuffer();
+		bufferInfos[2].range = VK_WHOLE_SIZE;
+		bufferInfos[3].buffer = instanceBuffer->GetBuffer();
+		bufferInfos[3].range = VK_WHOLE_SIZE;
+		bufferInfos[4].buffer = drawBuffer->GetBuffer();
+		bufferInfos[4].range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 5> descriptorWrites = {};
+		for (size_t j = 0; j < descriptorWrites.size(); j++) {
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].dstSet = descriptorSets[i];
+			descriptorWrites[j].dstBinding = static_cast<uint32_t>(j);
+			descriptorWrites[j].dstArrayElement = 0;
+			descriptorWrites[j].descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+		}
+
+		vkUpdateDescriptorSets(TriangleApp::logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void ParticleSystem::CleanupResources()
+{
+	vkDestroyDescriptorPool(TriangleApp::logicalDevice, descriptorPool, nullptr);
+	descriptorPool = VK_NULL_HANDLE;
+	descriptorSets.clear();
+
+	for (size_t i = 0; i < settingsBuffers.size(); i++) {
+		settingsBuffers[i]->Cleanup();
+	}
+
+	settingsBuffers.clear();
+
+	particleBuffer->Cleanup();
+	stateBuffer->Cleanup();
+	instanceBuffer->Cleanup();
+	drawBuffer->Cleanup();
+}
+
+#pragma endregion
+
+#pragma region Simulation
+
+ParticleEmitter& ParticleSystem::GetEmitter()
+{
+	return emitter;
+}
+
+void ParticleSystem::SetGravity(glm::vec3 value)
+{
+	gravity = value;
+}
+
+void ParticleSystem::SetRestitution(float value)
+{
+	restitution = value;
+}
+
+uint32_t ParticleSystem::AddCollisionPlane(glm::vec3 normal, float distance)
+{
+	if (collisionPlanes.size() >= MAX_COLLISION_PLANES) {
+		throw std::runtime_error("Too many particle collision planes!");
+	}
+
+	//Stored as a plane equation so the shader finds the signed distance with a single dot product
+	glm::vec3 unitNormal = glm::normalize(normal);
+	collisionPlanes.push_back(glm::vec4(unitNormal, -distance));
+
+	return static_cast<uint32_t>(collisionPlanes.size() - 1);
+}
+
+void ParticleSystem::ClearCollisionPlanes()
+{
+	collisionPlanes.clear();
+}
+
+VkDeviceSize ParticleSystem::UpdateSettings(uint32_t imageIndex, float deltaTime, uint32_t indexCount)
+{
+	//Spawn whole particles and carry the remainder over so low rates still emit at high frame rates
+	emitAccumulator += emitter.rate * deltaTime;
+	uint32_t emitCount = static_cast<uint32_t>(std::min(emitAccumulator, static_cast<float>(maxParticles)));
+	emitAccumulator -= static_cast<float>(emitCount);
+
+	ParticleSettings settings = {};
+	settings.emitterPosition = glm::vec4(emitter.position, emitter.radius);
+	settings.emitterVelocity = glm::vec4(emitter.velocity, emitter.velocitySpread);
+	settings.gravity = glm::vec4(gravity, deltaTime);
+	settings.minLifetime = emitter.minLifetime;
+	settings.maxLifetime = std::max(emitter.maxLifetime, emitter.minLifetime);
+	settings.size = emitter.size;
+	settings.restitution = restitution;
+	settings.emitCount = emitCount;
+	settings.planeCount = static_cast<uint32_t>(collisionPlanes.size());
+	settings.seed = frameSeed++;
+	settings.indexCount = indexCount;
+
+	for (size_t i = 0; i < collisionPlanes.size(); i++) {
+		settings.planes[i] = collisionPlanes[i];
+	}
+
+	void* data;
+	vkMapMemory(TriangleApp::logicalDevice, settingsBuffers[imageIndex]->GetBufferMemory(), 0, sizeof(ParticleSettings), 0, &data);
+	memcpy(data, &settings, sizeof(ParticleSettings));
+	vkUnmapMemory(TriangleApp::logicalDevice, settingsBuffers[imageIndex]->GetBufferMemory());
+
+	return sizeof(ParticleSettings);
+}
+
+void ParticleSystem::RecordSimulation(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	//The previous frame has to finish simulating and drawing the particles before they are overwritten
+	VkMemoryBarrier previousFrameBarrier = {};
+	previousFrameBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	previousFrameBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	previousFrameBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &previousFrameBarrier,
+		0, nullptr,
+		0, nullptr);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[imageIndex], 0, nullptr);
+
+	//One thread per particle slot, the alive count only exists on the GPU so threads past it spawn or exit
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulatePipeline);
+	vkCmdDispatch(commandBuffer, (maxParticles + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	//The finish pass reads the alive count every simulation thread added to
+	VkBufferMemoryBarrier stateBarrier = {};
+	stateBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	stateBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	stateBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	stateBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	stateBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	stateBarrier.buffer = stateBuffer->GetBuffer();
+	stateBarrier.offset = 0;
+	stateBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0, nullptr,
+		1, &stateBarrier,
+		0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, finishPipeline);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+	//Make the draw and the transforms visible to the draw
+	std::array<VkBufferMemoryBarrier, 2> drawBarriers = {};
+	VkBuffer barrierBuffers[] = { drawBuffer->GetBuffer(), instanceBuffer->GetBuffer() };
+	VkAccessFlags barrierAccess[] = { VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT };
+
+	for (size_t i = 0; i < drawBarriers.size(); i++) {
+		drawBarriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		drawBarriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		drawBarriers[i].dstAccessMask = barrierAccess[i];
+		drawBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		drawBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		drawBarriers[i].buffer = barrierBuffers[i];
+		drawBarriers[i].offset = 0;
+		drawBarriers[i].size = VK_WHOLE_SIZE;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(drawBarriers.size()), drawBarriers.data(),
+		0, nullptr);
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkBuffer ParticleSystem::GetInstanceBuffer()
+{
+	return instanceBuffer->GetBuffer();
+}
+
+VkBuffer ParticleSystem::GetDrawBuffer()
+{
+	return drawBuffer->GetBuffer();
+}
+
+uint32_t ParticleSystem::GetMaxParticles()
+{
+	return maxParticles;
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void ParticleSystem::CreateLayouts()
+{
+	//Binding 0 is the settings uniform buffer, the rest are the particle storage buffers
+	std::array<VkDescriptorSetLayoutBinding, 5> bindings = {};
+	for (size_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = static_cast<uint32_t>(i);
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(TriangleApp::logicalDevice, &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Particle Descriptor Set Layout!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+
+	if (vkCreatePipelineLayout(TriangleApp::logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Particle Pipeline Layout!");
+	}
+}
+
+#pragma endregion
\ No newline at end of file
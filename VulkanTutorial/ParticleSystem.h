@@ -0,0 +1,205 @@
+#pragma once
+
+#include "pch.h"
+#include "Buffer.h"
+
+//Must match the structs in ParticleUpdate.comp
+struct Particle {
+	//xyz is the position, w is the remaining lifetime in seconds
+	glm::vec4 positionLife;
+	//xyz is the velocity, w is the size
+	glm::vec4 velocitySize;
+};
+
+struct ParticleState {
+	uint32_t aliveCounts[2];
+	//Which half of the particle buffer holds the particles that are alive
+	uint32_t current;
+	uint32_t padding;
+};
+
+//Laid out to match the std140 ParticleSettings block in ParticleUpdate.comp
+struct ParticleSettings {
+	glm::vec4 emitterPosition;
+	glm::vec4 emitterVelocity;
+	glm::vec4 gravity;
+	float minLifetime;
+	float maxLifetime;
+	float size;
+	float restitution;
+	uint32_t emitCount;
+	uint32_t planeCount;
+	uint32_t seed;
+	uint32_t indexCount;
+	glm::vec4 planes[8];
+};
+
+struct ParticleEmitter {
+	glm::vec3 position;
+	//Particles spawn anywhere inside a sphere of this radius
+	float radius;
+	glm::vec3 velocity;
+	//Random velocity added to each particle, up to this speed in any direction
+	float velocitySpread;
+	float minLifetime;
+	float maxLifetime;
+	float size;
+	//Particles spawned per second
+	float rate;
+
+	ParticleEmitter(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f), float rate = 1000.0f) {
+		this->position = position;
+		this->velocity = velocity;
+		this->rate = rate;
+		radius = 0.0f;
+		velocitySpread = 0.0f;
+		minLifetime = 1.0f;
+		maxLifetime = 1.0f;
+		size = 0.05f;
+	}
+};
+
+class ParticleSystem
+{
+private:
+	uint32_t maxParticles;
+
+	ParticleEmitter emitter;
+	glm::vec3 gravity;
+	float restitution;
+	std::vector<glm::vec4> collisionPlanes;
+	float emitAccumulator;
+	uint32_t frameSeed;
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline simulatePipeline;
+	VkPipeline finishPipeline;
+
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> descriptorSets;
+
+	//Settings are written by the CPU every frame, the particles themselves only ever live on the GPU
+	std::vector<std::shared_ptr<Buffer>> settingsBuffers;
+	//Both halves of the double buffer live in one buffer, the state says which half is current
+	std::shared_ptr<Buffer> particleBuffer;
+	std::shared_ptr<Buffer> stateBuffer;
+	std::shared_ptr<Buffer> instanceBuffer;
+	std::shared_ptr<Buffer> drawBuffer;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Creates the descriptor set layout and pipeline layout used by the particle compute shader
+	/// </summary>
+	void CreateLayouts();
+
+#pragma endregion
+
+public:
+	//Must match the constants in ParticleUpdate.comp
+	static const uint32_t WORKGROUP_SIZE = 256;
+	static const uint32_t MAX_COLLISION_PLANES = 8;
+
+#pragma region Constructor
+
+	ParticleSystem(uint32_t maxParticles = 1 << 20);
+
+	/// <summary>
+	/// Destroys the compute pipelines and layouts, CleanupResources must be called first
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Resources
+
+	/// <summary>
+	/// Creates the simulate and finish pipelines, the previous pipelines are returned so the caller can destroy them once no frame is using them
+	/// </summary>
+	/// <param name="shaderModule">The compiled ParticleUpdate.comp shader</param>
+	/// <returns>The replaced pipelines, VK_NULL_HANDLE entries were never created</returns>
+	std::array<VkPipeline, 2> CreatePipelines(VkShaderModule shaderModule);
+
+	/// <summary>
+	/// Creates the particle buffers and descriptor sets for each swap chain image, every particle starts dead
+	/// </summary>
+	/// <param name="imageCount">The number of swap chain images</param>
+	void CreateResources(uint32_t imageCount);
+
+	/// <summary>
+	/// Destroys the particle buffers and descriptor sets
+	/// </summary>
+	void CleanupResources();
+
+#pragma endregion
+
+#pragma region Simulation
+
+	/// <summary>
+	/// Returns the emitter new particles are spawned from
+	/// </summary>
+	ParticleEmitter& GetEmitter();
+
+	/// <summary>
+	/// Sets the acceleration applied to every particle
+	/// </summary>
+	/// <param name="value">The acceleration in units per second squared</param>
+	void SetGravity(glm::vec3 value);
+
+	/// <summary>
+	/// Sets how much speed particles keep when they bounce off a collision plane
+	/// </summary>
+	/// <param name="value">0 stops particles on contact, 1 bounces them without losing speed</param>
+	void SetRestitution(float value);
+
+	/// <summary>
+	/// Adds a plane particles bounce off, particles are kept on the side the normal points to
+	/// </summary>
+	/// <param name="normal">The plane's normal</param>
+	/// <param name="distance">The plane's distance from the origin along the normal</param>
+	/// <returns>The index of the plane</returns>
+	uint32_t AddCollisionPlane(glm::vec3 normal, float distance);
+
+	/// <summary>
+	/// Removes every collision plane
+	/// </summary>
+	void ClearCollisionPlanes();
+
+	/// <summary>
+	/// Works out how many particles to spawn this frame and copies the settings into the settings buffer of a swap chain image
+	/// </summary>
+	/// <param name="imageIndex">The swap chain image that is about to be drawn</param>
+	/// <param name="deltaTime">The time since the last frame in seconds</param>
+	/// <param name="indexCount">The number of indices in the mesh each particle is drawn with</param>
+	/// <returns>The number of bytes copied to the device</returns>
+	VkDeviceSize UpdateSettings(uint32_t imageIndex, float deltaTime, uint32_t indexCount);
+
+	/// <summary>
+	/// Records the simulation followed by the pass that writes the indirect draw, with barriers so the draw can read the results
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into, outside of a render pass</param>
+	/// <param name="imageIndex">The swap chain image the command buffer draws to</param>
+	void RecordSimulation(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the buffer holding a transform for every living particle, laid out like a mesh instance buffer
+	/// </summary>
+	VkBuffer GetInstanceBuffer();
+
+	/// <summary>
+	/// Returns the buffer holding the indirect draw for the living particles
+	/// </summary>
+	VkBuffer GetDrawBuffer();
+
+	/// <summary>
+	/// Returns the maximum number of particles that can be alive at once
+	/// </summary>
+	uint32_t GetMaxParticles();
+
+#pragma endregion
+};
\ No newline at end of file
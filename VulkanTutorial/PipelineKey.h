@@ -0,0 +1,105 @@
+#pragma once
+
+#include "pch.h"
+#include "TransformData.h"
+
+#include <functional>
+
+//Optional fragment shader features, each one maps to a boolean specialization constant in BasicShader.frag
+enum ShaderFeature : uint32_t {
+	SHADER_FEATURE_TEXTURE = 1 << 0,
+	SHADER_FEATURE_VERTEX_COLOR = 1 << 1,
+	SHADER_FEATURE_FOG = 1 << 2
+};
+
+//Values passed to the shaders' specialization constants, the order matches the constant_id of each constant
+struct PipelineSpecialization {
+	int32_t lightCount;
+	VkBool32 useTexture;
+	VkBool32 useVertexColor;
+	VkBool32 useFog;
+	int32_t quality;
+	//Read by the vertex shaders to rebuild the model matrix
+	int32_t instanceFormat;
+
+	static std::array<VkSpecializationMapEntry, 6> getMapEntries() {
+		std::array<VkSpecializationMapEntry, 6> mapEntries = {};
+
+		mapEntries[0].constantID = 0;
+		mapEntries[0].offset = offsetof(PipelineSpecialization, lightCount);
+		mapEntries[0].size = sizeof(int32_t);
+
+		mapEntries[1].constantID = 1;
+		mapEntries[1].offset = offsetof(PipelineSpecialization, useTexture);
+		mapEntries[1].size = sizeof(VkBool32);
+
+		mapEntries[2].constantID = 2;
+		mapEntries[2].offset = offsetof(PipelineSpecialization, useVertexColor);
+		mapEntries[2].size = sizeof(VkBool32);
+
+		mapEntries[3].constantID = 3;
+		mapEntries[3].offset = offsetof(PipelineSpecialization, useFog);
+		mapEntries[3].size = sizeof(VkBool32);
+
+		mapEntries[4].constantID = 4;
+		mapEntries[4].offset = offsetof(PipelineSpecialization, quality);
+		mapEntries[4].size = sizeof(int32_t);
+
+		mapEntries[5].constantID = 5;
+		mapEntries[5].offset = offsetof(PipelineSpecialization, instanceFormat);
+		mapEntries[5].size = sizeof(int32_t);
+
+		return mapEntries;
+	}
+};
+
+//Identifies a shader permutation, every unique key is compiled into its own pipeline the first time it is drawn
+struct PipelineKey {
+	uint32_t lightCount;
+	uint32_t features;
+	uint32_t quality;
+	//Transparent pipelines blend with what is behind them and do not write depth
+	bool transparent;
+	//The layout of the instance buffer bound with the pipeline
+	InstanceFormat instanceFormat;
+
+	//Lights shaded per fragment are capped at the size of a cluster's light list
+	static constexpr uint32_t MAX_LIGHTS = 128;
+	static constexpr uint32_t MAX_QUALITY = 1;
+
+	PipelineKey(uint32_t lightCount = MAX_LIGHTS, uint32_t features = SHADER_FEATURE_TEXTURE | SHADER_FEATURE_VERTEX_COLOR, uint32_t quality = MAX_QUALITY, bool transparent = false, InstanceFormat instanceFormat = InstanceFormat::Matrix4x4) {
+		this->lightCount = std::min(lightCount, MAX_LIGHTS);
+		this->features = features;
+		this->quality = std::min(quality, MAX_QUALITY);
+		this->transparent = transparent;
+		this->instanceFormat = instanceFormat;
+	}
+
+	bool HasFeature(ShaderFeature feature) const {
+		return (features & feature) != 0;
+	}
+
+	PipelineSpecialization GetSpecialization() const {
+		PipelineSpecialization specialization = {};
+		specialization.lightCount = static_cast<int32_t>(lightCount);
+		specialization.useTexture = HasFeature(SHADER_FEATURE_TEXTURE) ? VK_TRUE : VK_FALSE;
+		specialization.useVertexColor = HasFeature(SHADER_FEATURE_VERTEX_COLOR) ? VK_TRUE : VK_FALSE;
+		specialization.useFog = HasFeature(SHADER_FEATURE_FOG) ? VK_TRUE : VK_FALSE;
+		specialization.quality = static_cast<int32_t>(quality);
+		specialization.instanceFormat = static_cast<int32_t>(instanceFormat);
+
+		return specialization;
+	}
+
+	bool operator==(const PipelineKey& other) const {
+		return lightCount == other.lightCount && features == other.features && quality == other.quality && transparent == other.transparent && instanceFormat == other.instanceFormat;
+	}
+};
+
+struct PipelineKeyHash {
+	size_t operator()(const PipelineKey& key) const {
+		//Every field is small so packing them into one integer never collides
+		uint64_t packed = (static_cast<uint64_t>(key.instanceFormat) << 52) | (static_cast<uint64_t>(key.transparent) << 48) | (static_cast<uint64_t>(key.lightCount) << 40) | (static_cast<uint64_t>(key.quality) << 32) | key.features;
+		return std::hash<uint64_t>()(packed);
+	}
+};
\ No newline at end of file
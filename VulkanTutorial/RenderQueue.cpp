@@ -0,0 +1,178 @@
+#include "pch.h"
+#include "RenderQueue.h"
+
+#include <thread>
+
+#pragma region Queue
+
+void RenderQueue::Clear()
+{
+	keys.clear();
+}
+
+void RenderQueue::Submit(uint64_t key)
+{
+	keys.push_back(key);
+}
+
+void RenderQueue::Sort()
+{
+	RadixSort(keys, scratchKeys);
+}
+
+const std::vector<uint64_t>& RenderQueue::GetKeys()
+{
+	return keys;
+}
+
+#pragma endregion
+
+#pragma region Keys
+
+uint32_t RenderQueue::GetPipelineId(const PipelineKey& key)
+{
+	auto pipelineId = pipelineIds.find(key);
+
+	if (pipelineId != pipelineIds.end()) {
+		return pipelineId->second;
+	}
+
+	uint32_t newId = static_cast<uint32_t>(pipelineIds.size());
+	if (newId >= (1u << PIPELINE_BITS)) {
+		throw std::runtime_error("Too many pipelines to sort!");
+	}
+
+	pipelineIds[key] = newId;
+
+	return newId;
+}
+
+uint64_t RenderQueue::MakeKey(bool transparent, uint32_t pipelineId, uint32_t materialId, uint32_t meshIndex, float depth)
+{
+	uint64_t pipeline = pipelineId & ((1u << PIPELINE_BITS) - 1);
+	uint64_t material = materialId & ((1u << MATERIAL_BITS) - 1);
+	uint64_t mesh = meshIndex & ((1u << MESH_BITS) - 1);
+	uint64_t quantizedDepth = static_cast<uint64_t>(glm::clamp(depth, 0.0f, 1.0f) * static_cast<float>((1u << DEPTH_BITS) - 1));
+
+	if (!transparent) {
+		//Group by state first, within a state the closest draws go first so they fill the depth buffer early
+		return (pipeline << (MATERIAL_BITS + DEPTH_BITS + MESH_BITS)) |
+			(material << (DEPTH_BITS + MESH_BITS)) |
+			(quantizedDepth << MESH_BITS) |
+			mesh;
+	}
+
+	//Blending has to happen back to front so depth comes before state
+	uint64_t invertedDepth = ((1u << DEPTH_BITS) - 1) - quantizedDepth;
+
+	return (1ull << 63) |
+		(invertedDepth << (PIPELINE_BITS + MATERIAL_BITS + MESH_BITS)) |
+		(pipeline << (MATERIAL_BITS + MESH_BITS)) |
+		(material << MESH_BITS) |
+		mesh;
+}
+
+uint32_t RenderQueue::GetMeshIndex(uint64_t key)
+{
+	return static_cast<uint32_t>(key & ((1u << MESH_BITS) - 1));
+}
+
+bool RenderQueue::IsTransparent(uint64_t key)
+{
+	return (key >> 63) != 0;
+}
+
+#pragma endregion
+
+#pragma region Sorting
+
+void RenderQueue::RadixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+{
+	size_t count = keys.size();
+	scratch.resize(count);
+
+	if (count < 2) {
+		return;
+	}
+
+	//Each thread owns a contiguous chunk, chunks are scattered in order so the sort stays stable
+	size_t threadCount = 1;
+	if (count >= PARALLEL_SORT_THRESHOLD) {
+		threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / PARALLEL_SORT_THRESHOLD));
+	}
+
+	size_t chunkSize = (count + threadCount - 1) / threadCount;
+	std::vector<std::array<size_t, 256>> histograms(threadCount);
+
+	auto runChunks = [&](const std::function<void(size_t, size_t, size_t)>& work) {
+		if (threadCount == 1) {
+			work(0, 0, count);
+			return;
+		}
+
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < threadCount; t++) {
+			size_t begin = std::min(t * chunkSize, count);
+			size_t end = std::min(begin + chunkSize, count);
+			workers.emplace_back(work, t, begin, end);
+		}
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	};
+
+	uint64_t* source = keys.data();
+	uint64_t* destination = scratch.data();
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		runChunks([&](size_t thread, size_t begin, size_t end) {
+			histograms[thread].fill(0);
+
+			for (size_t i = begin; i < end; i++) {
+				histograms[thread][(source[i] >> shift) & 0xFF]++;
+			}
+		});
+
+		//Keys rarely use every byte, a pass where every key has the same digit would only copy them
+		bool singleDigit = false;
+		for (size_t digit = 0; digit < 256 && !singleDigit; digit++) {
+			size_t digitCount = 0;
+
+			for (size_t t = 0; t < threadCount; t++) {
+				digitCount += histograms[t][digit];
+			}
+
+			singleDigit = digitCount == count;
+		}
+
+		if (singleDigit) {
+			continue;
+		}
+
+		//Turn the counts into the position each thread writes its first key of every digit to
+		size_t offset = 0;
+		for (size_t digit = 0; digit < 256; digit++) {
+			for (size_t t = 0; t < threadCount; t++) {
+				size_t digitCount = histograms[t][digit];
+				histograms[t][digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		runChunks([&](size_t thread, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				destination[histograms[thread][(source[i] >> shift) & 0xFF]++] = source[i];
+			}
+		});
+
+		std::swap(source, destination);
+	}
+
+	//An odd number of passes leaves the sorted keys in the scratch buffer
+	if (source != keys.data()) {
+		keys.swap(scratch);
+	}
+}
+
+#pragma endregion
\ No newline at end of file
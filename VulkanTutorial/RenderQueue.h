@@ -0,0 +1,97 @@
+#pragma once
+
+#include "pch.h"
+#include "PipelineKey.h"
+
+#include <unordered_map>
+
+class RenderQueue
+{
+private:
+	std::vector<uint64_t> keys;
+	std::vector<uint64_t> scratchKeys;
+
+	//Pipelines are numbered in the order they are first drawn so the ids stay stable between frames
+	std::unordered_map<PipelineKey, uint32_t, PipelineKeyHash> pipelineIds;
+
+public:
+	//Key layout, most significant bits first
+	//Opaque:      transparent(1) pipeline(11) material(12) depth(24) mesh(16)
+	//Transparent: transparent(1) inverted depth(24) pipeline(11) material(12) mesh(16)
+	static const uint32_t PIPELINE_BITS = 11;
+	static const uint32_t MATERIAL_BITS = 12;
+	static const uint32_t DEPTH_BITS = 24;
+	static const uint32_t MESH_BITS = 16;
+
+	//Below this many keys a single thread sorts faster than starting workers
+	static const size_t PARALLEL_SORT_THRESHOLD = 16384;
+
+#pragma region Queue
+
+	/// <summary>
+	/// Removes every draw from the queue
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// Adds a draw to the queue
+	/// </summary>
+	/// <param name="key">The draw's sort key, created with MakeKey</param>
+	void Submit(uint64_t key);
+
+	/// <summary>
+	/// Sorts the queued draws, opaque draws are grouped by state and drawn front to back, transparent draws follow back to front
+	/// </summary>
+	void Sort();
+
+	/// <summary>
+	/// Returns the queued keys, in draw order once Sort has been called
+	/// </summary>
+	/// <returns>The queued keys</returns>
+	const std::vector<uint64_t>& GetKeys();
+
+#pragma endregion
+
+#pragma region Keys
+
+	/// <summary>
+	/// Returns a small id for a pipeline that can be packed into a key, assigning a new one the first time a pipeline is seen
+	/// </summary>
+	/// <param name="key">The pipeline's permutation</param>
+	/// <returns>The pipeline's id</returns>
+	uint32_t GetPipelineId(const PipelineKey& key);
+
+	/// <summary>
+	/// Packs a draw's state and depth into a sort key
+	/// </summary>
+	/// <param name="transparent">Whether the draw blends with what is behind it</param>
+	/// <param name="pipelineId">The id returned by GetPipelineId</param>
+	/// <param name="materialId">The material the draw binds</param>
+	/// <param name="meshIndex">The mesh to draw, returned by GetMeshIndex</param>
+	/// <param name="depth">The draw's view depth scaled to the 0 to 1 range</param>
+	/// <returns>The sort key</returns>
+	static uint64_t MakeKey(bool transparent, uint32_t pipelineId, uint32_t materialId, uint32_t meshIndex, float depth);
+
+	/// <summary>
+	/// Returns the mesh index packed into a key
+	/// </summary>
+	static uint32_t GetMeshIndex(uint64_t key);
+
+	/// <summary>
+	/// Returns whether a key belongs to a transparent draw
+	/// </summary>
+	static bool IsTransparent(uint64_t key);
+
+#pragma endregion
+
+#pragma region Sorting
+
+	/// <summary>
+	/// Sorts keys with a least significant digit radix sort, one byte per pass, large inputs are split between threads
+	/// </summary>
+	/// <param name="keys">The keys to sort</param>
+	/// <param name="scratch">Working memory, resized to match the keys</param>
+	static void RadixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch);
+
+#pragma endregion
+};
\ No newline at end of file
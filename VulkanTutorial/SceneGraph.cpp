@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "SceneGraph.h"
+
+#include <thread>
+
+#pragma region Constructor
+
+SceneGraph::SceneGraph()
+{
+	hierarchyChanged = false;
+	updateCount = 0;
+}
+
+SceneGraph::~SceneGraph()
+{
+	//Transforms can outlive the scene so they go back to being their own world space
+	for (Node& node : nodes) {
+		if (node.alive) {
+			node.transform->sceneGraph = nullptr;
+			node.transform->sceneNode = INVALID_NODE;
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Hierarchy
+
+uint32_t SceneGraph::AddNode(std::shared_ptr<Transform> transform, uint32_t parent)
+{
+	if (transform->sceneGraph != nullptr) {
+		throw std::runtime_error("Transform is already part of a scene!");
+	}
+
+	if (parent != INVALID_NODE && (parent >= nodes.size() || !nodes[parent].alive)) {
+		throw std::runtime_error("Parent node does not exist!");
+	}
+
+	//Reuse the ids of removed nodes so the node list doesn't grow forever
+	uint32_t id;
+	if (!freeNodes.empty()) {
+		id = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		id = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	nodes[id].transform = transform;
+	nodes[id].parent = parent;
+	nodes[id].slot = 0;
+	nodes[id].alive = true;
+
+	transform->sceneGraph = this;
+	transform->sceneNode = id;
+
+	hierarchyChanged = true;
+
+	return id;
+}
+
+void SceneGraph::RemoveNode(uint32_t node)
+{
+	if (node >= nodes.size() || !nodes[node].alive) {
+		throw std::runtime_error("Node does not exist!");
+	}
+
+	//Children move up a level instead of being removed with their parent
+	for (Node& child : nodes) {
+		if (child.alive && child.parent == node) {
+			child.parent = nodes[node].parent;
+		}
+	}
+
+	nodes[node].transform->sceneGraph = nullptr;
+	nodes[node].transform->sceneNode = INVALID_NODE;
+	nodes[node].transform.reset();
+	nodes[node].alive = false;
+	freeNodes.push_back(node);
+
+	hierarchyChanged = true;
+}
+
+void SceneGraph::SetParent(uint32_t node, uint32_t parent)
+{
+	if (node >= nodes.size() || !nodes[node].alive) {
+		throw std::runtime_error("Node does not exist!");
+	}
+
+	if (parent != INVALID_NODE && (parent >= nodes.size() || !nodes[parent].alive)) {
+		throw std::runtime_error("Parent node does not exist!");
+	}
+
+	//A node can't be moved under one of its own descendants
+	for (uint32_t ancestor = parent; ancestor != INVALID_NODE; ancestor = nodes[ancestor].parent) {
+		if (ancestor == node) {
+			throw std::runtime_error("Cannot parent a node to its own subtree!");
+		}
+	}
+
+	nodes[node].parent = parent;
+
+	hierarchyChanged = true;
+}
+
+uint32_t SceneGraph::GetParent(uint32_t node)
+{
+	return nodes[node].parent;
+}
+
+std::shared_ptr<Transform> SceneGraph::GetTransform(uint32_t node)
+{
+	return nodes[node].transform;
+}
+
+size_t SceneGraph::GetNodeCount()
+{
+	return nodes.size() - freeNodes.size();
+}
+
+void SceneGraph::RebuildLevels()
+{
+	//Find every node's depth, walking up until a node with a known depth is found
+	std::vector<uint32_t> depths(nodes.size(), INVALID_NODE);
+	std::vector<uint32_t> chain;
+	uint32_t maxDepth = 0;
+
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		if (!nodes[i].alive || depths[i] != INVALID_NODE) {
+			continue;
+		}
+
+		uint32_t current = i;
+		while (current != INVALID_NODE && depths[current] == INVALID_NODE) {
+			chain.push_back(current);
+			current = nodes[current].parent;
+		}
+
+		uint32_t depth = current == INVALID_NODE ? 0 : depths[current] + 1;
+		while (!chain.empty()) {
+			depths[chain.back()] = depth;
+			maxDepth = std::max(maxDepth, depth);
+			chain.pop_back();
+			depth++;
+		}
+	}
+
+	//Counting sort by depth so each level is one contiguous range
+	size_t nodeCount = GetNodeCount();
+	levelOffsets.assign(nodeCount > 0 ? maxDepth + 2 : 1, 0);
+
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].alive) {
+			levelOffsets[depths[i] + 1]++;
+		}
+	}
+
+	for (size_t level = 1; level < levelOffsets.size(); level++) {
+		levelOffsets[level] += levelOffsets[level - 1];
+	}
+
+	std::vector<size_t> nextSlot(levelOffsets.begin(), levelOffsets.end() - 1);
+	slotNodes.resize(nodeCount);
+
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].alive) {
+			size_t slot = nextSlot[depths[i]]++;
+			slotNodes[slot] = i;
+			nodes[i].slot = static_cast<uint32_t>(slot);
+		}
+	}
+
+	slotParents.resize(nodeCount);
+	slotTransforms.resize(nodeCount);
+	worldMatrices.resize(nodeCount);
+	worldVersions.resize(nodeCount);
+	changed.resize(nodeCount);
+
+	for (size_t slot = 0; slot < nodeCount; slot++) {
+		Node& node = nodes[slotNodes[slot]];
+		slotParents[slot] = node.parent == INVALID_NODE ? INVALID_NODE : nodes[node.parent].slot;
+		slotTransforms[slot] = node.transform.get();
+	}
+
+	//Slots have moved so no stored version matches, forcing every node to be recomputed
+	localVersions.assign(nodeCount, UINT64_MAX);
+
+	hierarchyChanged = false;
+}
+
+void SceneGraph::UpdateSlots(size_t begin, size_t end)
+{
+	for (size_t slot = begin; slot < end; slot++) {
+		Transform* transform = slotTransforms[slot];
+		uint32_t parent = slotParents[slot];
+
+		//A node is only recomputed if it or one of its ancestors moved
+		bool dirty = transform->version != localVersions[slot] || (parent != INVALID_NODE && changed[parent]);
+		changed[slot] = dirty;
+
+		if (!dirty) {
+			continue;
+		}
+
+		localVersions[slot] = transform->version;
+
+		if (parent == INVALID_NODE) {
+			worldMatrices[slot] = transform->GetLocalMatrix();
+		}
+		else {
+			worldMatrices[slot] = worldMatrices[parent] * transform->GetLocalMatrix();
+		}
+
+		worldVersions[slot] = updateCount;
+	}
+}
+
+#pragma endregion
+
+#pragma region World Matrices
+
+void SceneGraph::UpdateWorldMatrices()
+{
+	if (hierarchyChanged) {
+		RebuildLevels();
+	}
+
+	updateCount++;
+
+	for (size_t level = 0; level + 1 < levelOffsets.size(); level++) {
+		size_t begin = levelOffsets[level];
+		size_t end = levelOffsets[level + 1];
+		size_t count = end - begin;
+
+		size_t threadCount = 1;
+		if (count >= PARALLEL_UPDATE_THRESHOLD) {
+			threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / PARALLEL_UPDATE_THRESHOLD));
+		}
+
+		if (threadCount == 1) {
+			UpdateSlots(begin, end);
+			continue;
+		}
+
+		//Nodes in a level only depend on the level above so each thread can take a chunk
+		size_t chunkSize = (count + threadCount - 1) / threadCount;
+		std::vector<std::thread> workers;
+
+		for (size_t t = 0; t < threadCount; t++) {
+			size_t chunkBegin = std::min(begin + t * chunkSize, end);
+			size_t chunkEnd = std::min(chunkBegin + chunkSize, end);
+			workers.emplace_back(&SceneGraph::UpdateSlots, this, chunkBegin, chunkEnd);
+		}
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+}
+
+glm::mat4 SceneGraph::GetWorldMatrix(uint32_t node)
+{
+	//Nodes that were just added or moved don't have a slot yet
+	if (hierarchyChanged) {
+		UpdateWorldMatrices();
+	}
+
+	return worldMatrices[nodes[node].slot];
+}
+
+uint64_t SceneGraph::GetWorldVersion(uint32_t node)
+{
+	if (hierarchyChanged) {
+		UpdateWorldMatrices();
+	}
+
+	return worldVersions[nodes[node].slot];
+}
+
+#pragma endregion
\ No newline at end of file
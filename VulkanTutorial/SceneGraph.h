@@ -0,0 +1,131 @@
+#pragma once
+
+#include "pch.h"
+#include "Transform.h"
+
+class SceneGraph
+{
+private:
+	//Stable per node data indexed by node id, only changes when the hierarchy does
+	struct Node
+	{
+		std::shared_ptr<Transform> transform;
+		uint32_t parent;
+		uint32_t slot;
+		bool alive;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> freeNodes;
+	bool hierarchyChanged;
+
+	//Depth sorted flat arrays indexed by slot, every parent sits in an earlier level than its children
+	//so a level only reads results written by the level before it
+	std::vector<uint32_t> slotNodes;
+	std::vector<uint32_t> slotParents;
+	std::vector<Transform*> slotTransforms;
+	std::vector<uint64_t> localVersions;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<uint64_t> worldVersions;
+	std::vector<uint8_t> changed;
+	std::vector<size_t> levelOffsets;
+
+	//Incremented once per update, a node's world version is the update that last changed its world matrix
+	uint64_t updateCount;
+
+#pragma region Hierarchy
+
+	/// <summary>
+	/// Re-sorts the nodes by depth into the flat arrays and marks every node for propagation
+	/// </summary>
+	void RebuildLevels();
+
+	/// <summary>
+	/// Recomputes the world matrices of the changed nodes in a range of slots
+	/// </summary>
+	/// <param name="begin">The first slot to update</param>
+	/// <param name="end">One past the last slot to update</param>
+	void UpdateSlots(size_t begin, size_t end);
+
+#pragma endregion
+
+public:
+	static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+	//Below this many nodes in a level a single thread is faster than starting workers
+	static const size_t PARALLEL_UPDATE_THRESHOLD = 4096;
+
+#pragma region Constructor
+
+	SceneGraph();
+
+	~SceneGraph();
+
+#pragma endregion
+
+#pragma region Hierarchy
+
+	/// <summary>
+	/// Adds a transform to the scene, its position rotation and scale become relative to the parent
+	/// </summary>
+	/// <param name="transform">The node's local transform, can only belong to one scene</param>
+	/// <param name="parent">The parent node or INVALID_NODE for a root</param>
+	/// <returns>The id of the new node</returns>
+	uint32_t AddNode(std::shared_ptr<Transform> transform, uint32_t parent = INVALID_NODE);
+
+	/// <summary>
+	/// Removes a node from the scene, its children are attached to its parent
+	/// </summary>
+	/// <param name="node">The node to remove</param>
+	void RemoveNode(uint32_t node);
+
+	/// <summary>
+	/// Moves a node and its subtree under a new parent, the local transform is kept as is
+	/// </summary>
+	/// <param name="node">The node to move</param>
+	/// <param name="parent">The new parent or INVALID_NODE to make it a root</param>
+	void SetParent(uint32_t node, uint32_t parent);
+
+	/// <summary>
+	/// Returns a node's parent
+	/// </summary>
+	/// <param name="node">The node to check</param>
+	/// <returns>The parent node or INVALID_NODE for a root</returns>
+	uint32_t GetParent(uint32_t node);
+
+	/// <summary>
+	/// Returns the transform a node was added with
+	/// </summary>
+	std::shared_ptr<Transform> GetTransform(uint32_t node);
+
+	/// <summary>
+	/// Returns the number of nodes in the scene
+	/// </summary>
+	size_t GetNodeCount();
+
+#pragma endregion
+
+#pragma region World Matrices
+
+	/// <summary>
+	/// Propagates changed local transforms to the world matrices one level at a time, large levels are split between threads
+	/// Subtrees whose transforms and ancestors have not changed are skipped
+	/// </summary>
+	void UpdateWorldMatrices();
+
+	/// <summary>
+	/// Returns a node's world matrix as of the last UpdateWorldMatrices
+	/// </summary>
+	/// <param name="node">The node to check</param>
+	/// <returns>The node's world matrix</returns>
+	glm::mat4 GetWorldMatrix(uint32_t node);
+
+	/// <summary>
+	/// Returns a version that changes every time the node's world matrix does
+	/// </summary>
+	/// <param name="node">The node to check</param>
+	/// <returns>The node's world version</returns>
+	uint64_t GetWorldVersion(uint32_t node);
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "pch.h"
+#include "ShaderManager.h"
+
+#include <iostream>
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#pragma region Constructor
+
+ShaderManager::ShaderManager(const std::string& shaderDirectory)
+{
+	this->shaderDirectory = shaderDirectory;
+	running = false;
+}
+
+ShaderManager::~ShaderManager()
+{
+	Stop();
+}
+
+#pragma endregion
+
+#pragma region Watching
+
+void ShaderManager::AddShader(const std::string& sourcePath, const std::string& spirvPath)
+{
+	if (running) {
+		throw std::runtime_error("Shaders must be added before the shader manager is started!");
+	}
+
+	ShaderSource shader;
+	shader.sourcePath = sourcePath;
+	shader.spirvPath = spirvPath;
+
+	//Sources are assumed to match their SPIR-V at startup so nothing is compiled until it changes
+	std::error_code error;
+	shader.lastWriteTime = std::filesystem::last_write_time(sourcePath, error);
+
+	shaders.push_back(shader);
+}
+
+void ShaderManager::Start()
+{
+	if (running) {
+		return;
+	}
+
+	running = true;
+	watchThread = std::thread(&ShaderManager::Watch, this);
+}
+
+void ShaderManager::Stop()
+{
+	running = false;
+
+	if (watchThread.joinable()) {
+		watchThread.join();
+	}
+}
+
+std::vector<std::string> ShaderManager::PollCompiledShaders()
+{
+	std::lock_guard<std::mutex> lock(compiledMutex);
+
+	std::vector<std::string> compiled;
+	compiled.swap(compiledShaders);
+
+	return compiled;
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void ShaderManager::Watch()
+{
+#ifdef __linux__
+	//Sleep until something in the shader directory is written instead of polling every file
+	int inotifyHandle = inotify_init1(IN_NONBLOCK);
+
+	if (inotifyHandle >= 0 && inotify_add_watch(inotifyHandle, shaderDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0) {
+		while (running) {
+			pollfd descriptor = {};
+			descriptor.fd = inotifyHandle;
+			descriptor.events = POLLIN;
+
+			//Wake up regularly so Stop never waits on a file change
+			if (poll(&descriptor, 1, 250) > 0) {
+				char events[4096];
+				while (read(inotifyHandle, events, sizeof(events)) > 0) {
+				}
+
+				CompileChangedShaders();
+			}
+		}
+
+		close(inotifyHandle);
+		return;
+	}
+
+	if (inotifyHandle >= 0) {
+		close(inotifyHandle);
+	}
+#endif
+
+	//Fall back to checking file times when there is no change notification
+	while (running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		CompileChangedShaders();
+	}
+}
+
+void ShaderManager::CompileChangedShaders()
+{
+	for (size_t i = 0; i < shaders.size(); i++) {
+		std::error_code error;
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(shaders[i].sourcePath, error);
+
+		if (error || writeTime == shaders[i].lastWriteTime) {
+			continue;
+		}
+
+		shaders[i].lastWriteTime = writeTime;
+
+		if (Compile(shaders[i])) {
+			std::lock_guard<std::mutex> lock(compiledMutex);
+			compiledShaders.push_back(shaders[i].spirvPath);
+		}
+	}
+}
+
+bool ShaderManager::Compile(const ShaderSource& shader)
+{
+	std::string temporaryPath = shader.spirvPath + ".tmp";
+	std::string command = "\"" + GetCompilerPath() + "\" \"" + shader.sourcePath + "\" -o \"" + temporaryPath + "\"";
+
+#ifdef _WIN32
+	//cmd strips the outer quotes so wrap the whole command in another pair
+	command = "\"" + command + "\"";
+#endif
+
+	if (std::system(command.c_str()) != 0) {
+		std::cerr << "Failed to compile shader " << shader.sourcePath << std::endl;
+
+		std::error_code error;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, shader.spirvPath, error);
+
+	if (error) {
+		std::cerr << "Failed to replace " << shader.spirvPath << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string ShaderManager::GetCompilerPath()
+{
+#ifdef _WIN32
+	char* sdkPath = nullptr;
+	size_t length = 0;
+
+	if (_dupenv_s(&sdkPath, &length, "VULKAN_SDK") != 0 || sdkPath == nullptr) {
+		return "glslc";
+	}
+
+	std::string compilerPath = std::string(sdkPath) + "\\Bin\\glslc.exe";
+	free(sdkPath);
+
+	return compilerPath;
+#else
+	const char* sdkPath = std::getenv("VULKAN_SDK");
+
+	if (sdkPath == nullptr) {
+		return "glslc";
+	}
+
+	return std::string(sdkPath) + "/bin/glslc";
+#endif
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "pch.h"
+
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+//CMake builds run from the build directory, which holds the compiled SPIR-V, and point this at the shader sources so edits are still picked up
+#ifndef VT_SHADER_SOURCE_DIRECTORY
+#define VT_SHADER_SOURCE_DIRECTORY "shaders"
+#endif
+
+class ShaderManager
+{
+private:
+	struct ShaderSource {
+		std::string sourcePath;
+		std::string spirvPath;
+		std::filesystem::file_time_type lastWriteTime;
+	};
+
+	std::string shaderDirectory;
+	std::vector<ShaderSource> shaders;
+
+	std::thread watchThread;
+	std::atomic<bool> running;
+
+	std::mutex compiledMutex;
+	std::vector<std::string> compiledShaders;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Runs on the watch thread, waits for shader sources to change and recompiles them
+	/// </summary>
+	void Watch();
+
+	/// <summary>
+	/// Recompiles any registered shader whose source has been written since it was last compiled
+	/// </summary>
+	void CompileChangedShaders();
+
+	/// <summary>
+	/// Compiles a shader source to SPIR-V with glslc, the output is written to a temporary file and moved into place so the renderer never reads a partial file
+	/// </summary>
+	/// <param name="shader">The shader to compile</param>
+	/// <returns>True if the shader compiled successfully</returns>
+	bool Compile(const ShaderSource& shader);
+
+	/// <summary>
+	/// Returns the glslc executable to use, taken from the Vulkan SDK if VULKAN_SDK is set and the path otherwise
+	/// </summary>
+	/// <returns>The glslc command</returns>
+	static std::string GetCompilerPath();
+
+#pragma endregion
+
+public:
+#pragma region Constructor
+
+	ShaderManager(const std::string& shaderDirectory = VT_SHADER_SOURCE_DIRECTORY);
+
+	~ShaderManager();
+
+#pragma endregion
+
+#pragma region Watching
+
+	/// <summary>
+	/// Registers a shader source to be recompiled when it changes
+	/// </summary>
+	/// <param name="sourcePath">The path of the GLSL source</param>
+	/// <param name="spirvPath">The path the compiled SPIR-V is written to</param>
+	void AddShader(const std::string& sourcePath, const std::string& spirvPath);
+
+	/// <summary>
+	/// Starts watching the shader directory on a background thread
+	/// </summary>
+	void Start();
+
+	/// <summary>
+	/// Stops watching and waits for the background thread to finish
+	/// </summary>
+	void Stop();
+
+	/// <summary>
+	/// Returns the SPIR-V files that have been recompiled since the last call, called once per frame on the render thread
+	/// </summary>
+	/// <returns>The paths of the recompiled SPIR-V files</returns>
+	std::vector<std::string> PollCompiledShaders();
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "Skeleton.h"
+
+//SSE2 is part of every x64 CPU, other targets use the scalar blend
+#if defined(_M_X64) || defined(__SSE2__)
+#define SKELETON_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#pragma region Constructor
+
+AnimationClip::AnimationClip(uint32_t jointCount, uint32_t frameCount, float frameRate)
+{
+	this->jointCount = jointCount;
+	this->frameCount = std::max(frameCount, 1u);
+	this->frameRate = frameRate;
+
+	poses.resize(static_cast<size_t>(jointCount) * this->frameCount);
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+JointPose& AnimationClip::GetPose(uint32_t frame, uint32_t joint)
+{
+	return poses[static_cast<size_t>(frame) * jointCount + joint];
+}
+
+uint32_t AnimationClip::GetJointCount() const
+{
+	return jointCount;
+}
+
+float AnimationClip::GetDuration() const
+{
+	return frameCount / frameRate;
+}
+
+#pragma endregion
+
+#pragma region Sampling
+
+void AnimationClip::Sample(float time, JointPose* result) const
+{
+	float frame = fmodf(time * frameRate, static_cast<float>(frameCount));
+	if (frame < 0.0f) {
+		frame += frameCount;
+	}
+
+	uint32_t fromFrame = std::min(static_cast<uint32_t>(frame), frameCount - 1);
+	uint32_t toFrame = (fromFrame + 1) % frameCount;
+
+	BlendPoses(&poses[static_cast<size_t>(fromFrame) * jointCount], &poses[static_cast<size_t>(toFrame) * jointCount], frame - fromFrame, result, jointCount);
+}
+
+#ifdef SKELETON_USE_SSE
+
+//Returns the dot product of two vectors in every lane
+static inline __m128 Dot4(__m128 a, __m128 b)
+{
+	__m128 products = _mm_mul_ps(a, b);
+	__m128 sums = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_add_ps(sums, _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+void AnimationClip::BlendPoses(const JointPose* from, const JointPose* to, float weight, JointPose* result, uint32_t count)
+{
+	__m128 toWeight = _mm_set1_ps(weight);
+	__m128 fromWeight = _mm_set1_ps(1.0f - weight);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (uint32_t i = 0; i < count; i++) {
+		const float* fromPose = reinterpret_cast<const float*>(&from[i]);
+		const float* toPose = reinterpret_cast<const float*>(&to[i]);
+		float* resultPose = reinterpret_cast<float*>(&result[i]);
+
+		//q and -q are the same rotation, flipping the target to the same side as the source takes the short way around
+		__m128 fromRotation = _mm_loadu_ps(fromPose);
+		__m128 toRotation = _mm_loadu_ps(toPose);
+		toRotation = _mm_xor_ps(toRotation, _mm_and_ps(Dot4(fromRotation, toRotation), signMask));
+
+		__m128 rotation = _mm_add_ps(_mm_mul_ps(fromRotation, fromWeight), _mm_mul_ps(toRotation, toWeight));
+		rotation = _mm_div_ps(rotation, _mm_sqrt_ps(Dot4(rotation, rotation)));
+
+		__m128 translation = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fromPose + 4), fromWeight), _mm_mul_ps(_mm_loadu_ps(toPose + 4), toWeight));
+		__m128 scale = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fromPose + 8), fromWeight), _mm_mul_ps(_mm_loadu_ps(toPose + 8), toWeight));
+
+		_mm_storeu_ps(resultPose, rotation);
+		_mm_storeu_ps(resultPose + 4, translation);
+		_mm_storeu_ps(resultPose + 8, scale);
+	}
+}
+
+#else
+
+void AnimationClip::BlendPoses(const JointPose* from, const JointPose* to, float weight, JointPose* result, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		glm::quat toRotation = glm::dot(from[i].rotation, to[i].rotation) < 0.0f ? -to[i].rotation : to[i].rotation;
+
+		result[i].rotation = glm::normalize(from[i].rotation * (1.0f - weight) + toRotation * weight);
+		result[i].translation = glm::mix(from[i].translation, to[i].translation, weight);
+		result[i].scale = glm::mix(from[i].scale, to[i].scale, weight);
+	}
+}
+
+#endif
+
+void AnimationClip::ComputeSkinMatrices(const Skeleton& skeleton, const JointPose* poses, const glm::mat4& model, glm::mat4* result)
+{
+	uint32_t jointCount = skeleton.GetJointCount();
+
+	//Parents come first so their world matrix is always ready, the result doubles as storage for it
+	for (uint32_t i = 0; i < jointCount; i++) {
+		int32_t parent = skeleton.parents[i];
+		result[i] = (parent < 0 ? model : result[parent]) * poses[i].GetMatrix();
+	}
+
+	for (uint32_t i = 0; i < jointCount; i++) {
+		result[i] = result[i] * skeleton.inverseBindMatrices[i];
+	}
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "pch.h"
+
+//A joint's transform relative to its parent, padded to 16 byte lanes so poses can be blended four floats at a time
+struct JointPose {
+	glm::quat rotation;
+	glm::vec4 translation;
+	glm::vec4 scale;
+
+	JointPose(glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f), glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f)) {
+		this->rotation = rotation;
+		this->translation = glm::vec4(translation, 0.0f);
+		this->scale = glm::vec4(scale, 0.0f);
+	}
+
+	glm::mat4 GetMatrix() const {
+		return glm::translate(glm::mat4(1.0f), glm::vec3(translation)) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+	}
+};
+
+struct Skeleton {
+	//Every joint's parent comes before it so poses can be resolved in a single pass, the root's parent is -1
+	std::vector<int32_t> parents;
+	//Moves a vertex from model space into the space of the joint it is bound to
+	std::vector<glm::mat4> inverseBindMatrices;
+
+	uint32_t GetJointCount() const {
+		return static_cast<uint32_t>(parents.size());
+	}
+};
+
+//A looping animation baked to poses at a fixed rate so sampling only ever blends two neighbouring frames
+class AnimationClip
+{
+private:
+	uint32_t jointCount;
+	uint32_t frameCount;
+	float frameRate;
+	std::vector<JointPose> poses;
+
+public:
+
+#pragma region Constructor
+
+	AnimationClip(uint32_t jointCount = 0, uint32_t frameCount = 1, float frameRate = 30.0f);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns a joint's pose in a frame so the clip can be filled in
+	/// </summary>
+	/// <param name="frame">The frame index</param>
+	/// <param name="joint">The joint index</param>
+	/// <returns>The joint's pose relative to its parent</returns>
+	JointPose& GetPose(uint32_t frame, uint32_t joint);
+
+	/// <summary>
+	/// Returns the number of joints each frame has a pose for
+	/// </summary>
+	uint32_t GetJointCount() const;
+
+	/// <summary>
+	/// Returns the length of the clip in seconds, the last frame blends back into the first
+	/// </summary>
+	float GetDuration() const;
+
+#pragma endregion
+
+#pragma region Sampling
+
+	/// <summary>
+	/// Blends the two frames around a time into a pose for every joint
+	/// </summary>
+	/// <param name="time">The time in seconds, wrapped to the length of the clip</param>
+	/// <param name="result">Receives one pose per joint</param>
+	void Sample(float time, JointPose* result) const;
+
+	/// <summary>
+	/// Blends two sets of poses, rotations are normalized lerps so they take the shortest path
+	/// </summary>
+	/// <param name="from">The poses at a weight of 0</param>
+	/// <param name="to">The poses at a weight of 1</param>
+	/// <param name="weight">How far to blend towards the second set</param>
+	/// <param name="result">Receives the blended poses, may be the same as either input</param>
+	/// <param name="count">The number of poses in each set</param>
+	static void BlendPoses(const JointPose* from, const JointPose* to, float weight, JointPose* result, uint32_t count);
+
+	/// <summary>
+	/// Turns poses relative to their parents into skinning matrices
+	/// </summary>
+	/// <param name="skeleton">The skeleton the poses belong to</param>
+	/// <param name="poses">One pose per joint</param>
+	/// <param name="model">The model matrix, folded into every joint so skinned vertices come out in world space</param>
+	/// <param name="result">Receives one matrix per joint</param>
+	static void ComputeSkinMatrices(const Skeleton& skeleton, const JointPose* poses, const glm::mat4& model, glm::mat4* result);
+
+#pragma endregion
+};
\ No newline at end of file
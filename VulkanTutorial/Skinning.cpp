@@ -0,0 +1,461 @@
+#include "pch.h"
+#include "Skinning.h"
+
+#include "TriangleApp.h"
+#include "TransformData.h"
+
+#include <thread>
+
+#pragma region Constructor
+
+Skinning::Skinning()
+{
+	restVertexCount = 0;
+	jointCount = 0;
+	outputVertexCount = 0;
+	maxVertexCount = 0;
+	maxSkeletonJoints = 0;
+
+	descriptorSetLayout = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+}
+
+void Skinning::Cleanup()
+{
+	if (pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(TriangleApp::logicalDevice, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(TriangleApp::logicalDevice, pipelineLayout, nullptr);
+		pipelineLayout = VK_NULL_HANDLE;
+	}
+
+	if (descriptorSetLayout != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(TriangleApp::logicalDevice, descriptorSetLayout, nullptr);
+		descriptorSetLayout = VK_NULL_HANDLE;
+	}
+}
+
+#pragma endregion
+
+#pragma region Resources
+
+VkPipeline Skinning::CreatePipeline(VkShaderModule shaderModule)
+{
+	if (pipelineLayout == VK_NULL_HANDLE) {
+		CreateLayouts();
+	}
+
+	VkPipelineShaderStageCreateInfo stageCreateInfo = {};
+	stageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageCreateInfo.module = shaderModule;
+	stageCreateInfo.pName = "main";
+
+	VkComputePipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.stage = stageCreateInfo;
+	createInfo.layout = pipelineLayout;
+	createInfo.basePipelineHandle = VK_NULL_HANDLE;
+	createInfo.basePipelineIndex = -1;
+
+	VkPipeline newPipeline;
+	if (vkCreateComputePipelines(TriangleApp::logicalDevice, VK_NULL_HANDLE, 1, &createInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Skinning Pipeline!");
+	}
+
+	VkPipeline oldPipeline = pipeline;
+	pipeline = newPipeline;
+
+	return oldPipeline;
+}
+
+void Skinning::CreateResources(uint32_t imageCount)
+{
+	//Every model's rest vertices and skin go into one pair of buffers so a single dispatch can reach all of them
+	std::vector<Vertex> restVertices;
+	std::vector<VertexSkin> skins;
+	restVertices.reserve(restVertexCount);
+	skins.reserve(restVertexCount);
+
+	for (SkinnedModel& model : models) {
+		std::vector<Vertex> vertices = model.mesh->GetVertices();
+		std::vector<VertexSkin> skin = model.mesh->GetSkin();
+
+		restVertices.insert(restVertices.end(), vertices.begin(), vertices.end());
+		skins.insert(skins.end(), skin.begin(), skin.end());
+	}
+
+	//Buffers can not be empty, a scene without characters still gets one element of each
+	restVertices.resize(std::max<size_t>(restVertices.size(), 1));
+	skins.resize(std::max<size_t>(skins.size(), 1));
+	std::vector<SkinnedCharacterData> characterUpload = characterData;
+	characterUpload.resize(std::max<size_t>(characterUpload.size(), 1), {});
+
+	restVertexBuffer = CreateStaticBuffer(restVertices.data(), sizeof(Vertex) * restVertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::Geometry);
+	skinBuffer = CreateStaticBuffer(skins.data(), sizeof(VertexSkin) * skins.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::Geometry);
+	characterBuffer = CreateStaticBuffer(characterUpload.data(), sizeof(SkinnedCharacterData) * characterUpload.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::Other);
+
+	TransformData identity = TransformData::LoadMat4(glm::mat4(1.0f));
+	instanceBuffer = CreateStaticBuffer(&identity, sizeof(TransformData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory::Instances);
+
+	uint32_t outputCount = std::max(outputVertexCount, 1u);
+
+	outputVertexBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(Vertex) * outputCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Geometry, *outputVertexBuffer);
+
+	outputPositionBuffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(sizeof(glm::vec3) * outputCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Geometry, *outputPositionBuffer);
+
+	jointBuffers.resize(imageCount);
+
+	for (size_t i = 0; i < imageCount; i++) {
+		jointBuffers[i] = std::make_shared<Buffer>();
+		Buffer::CreateBuffer(sizeof(glm::mat4) * std::max(jointCount, 1u), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniforms, *jointBuffers[i]);
+	}
+
+	//Create the descriptor pool
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = imageCount * 6;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+	poolCreateInfo.maxSets = imageCount;
+
+	if (vkCreateDescriptorPool(TriangleApp::logicalDevice, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Skinning Descriptor Pool!");
+	}
+
+	//Allocate the descriptor sets
+	std::vector<VkDescriptorSetLayout> layouts(imageCount, descriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = descriptorPool;
+	allocateInfo.descriptorSetCount = imageCount;
+	allocateInfo.pSetLayouts = layouts.data();
+
+	descriptorSets.resize(imageCount);
+
+	if (vkAllocateDescriptorSets(TriangleApp::logicalDevice, &allocateInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate Skinning Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < imageCount; i++) {
+		VkBuffer buffers[] = {
+			jointBuffers[i]->GetBuffer(),
+			characterBuffer->GetBuffer(),
+			restVertexBuffer->GetBuffer(),
+			skinBuffer->GetBuffer(),
+			outputVertexBuffer->GetBuffer(),
+			outputPositionBuffer->GetBuffer()
+		};
+
+		std::array<VkDescriptorBufferInfo, 6> bufferInfos = {};
+		std::array<VkWriteDescriptorSet, 6> descriptorWrites = {};
+		for (size_t j = 0; j < descriptorWrites.size(); j++) {
+			bufferInfos[j].buffer = buffers[j];
+			bufferInfos[j].range = VK_WHOLE_SIZE;
+
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].dstSet = descriptorSets[i];
+			descriptorWrites[j].dstBinding = static_cast<uint32_t>(j);
+			descriptorWrites[j].dstArrayElement = 0;
+			descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+		}
+
+		vkUpdateDescriptorSets(TriangleApp::logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void Skinning::CleanupResources()
+{
+	vkDestroyDescriptorPool(TriangleApp::logicalDevice, descriptorPool, nullptr);
+	descriptorPool = VK_NULL_HANDLE;
+	descriptorSets.clear();
+
+	for (size_t i = 0; i < jointBuffers.size(); i++) {
+		jointBuffers[i]->Cleanup();
+	}
+
+	jointBuffers.clear();
+
+	characterBuffer->Cleanup();
+	restVertexBuffer->Cleanup();
+	skinBuffer->Cleanup();
+	outputVertexBuffer->Cleanup();
+	outputPositionBuffer->Cleanup();
+	instanceBuffer->Cleanup();
+
+	characterBuffer = nullptr;
+	restVertexBuffer = nullptr;
+	skinBuffer = nullptr;
+	outputVertexBuffer = nullptr;
+	outputPositionBuffer = nullptr;
+	instanceBuffer = nullptr;
+}
+
+#pragma endregion
+
+#pragma region Characters
+
+uint32_t Skinning::AddModel(std::shared_ptr<Mesh> mesh, std::shared_ptr<Skeleton> skeleton)
+{
+	if (restVertexBuffer != nullptr) {
+		throw std::runtime_error("Skinned models must be added before the skinning resources are created!");
+	}
+
+	if (!mesh->IsSkinned()) {
+		throw std::runtime_error("Skinned models need a mesh with skinning data!");
+	}
+
+	SkinnedModel model = {};
+	model.mesh = mesh;
+	model.skeleton = skeleton;
+	model.restOffset = restVertexCount;
+	models.push_back(model);
+
+	uint32_t vertexCount = static_cast<uint32_t>(mesh->GetVertices().size());
+	restVertexCount += vertexCount;
+	maxVertexCount = std::max(maxVertexCount, vertexCount);
+	maxSkeletonJoints = std::max(maxSkeletonJoints, skeleton->GetJointCount());
+
+	return static_cast<uint32_t>(models.size() - 1);
+}
+
+uint32_t Skinning::AddCharacter(uint32_t modelIndex, std::shared_ptr<AnimationClip> clip, std::shared_ptr<Transform> transform, float startTime)
+{
+	if (restVertexBuffer != nullptr) {
+		throw std::runtime_error("Skinned characters must be added before the skinning resources are created!");
+	}
+
+	SkinnedModel& model = models[modelIndex];
+
+	if (clip->GetJointCount() != model.skeleton->GetJointCount()) {
+		throw std::runtime_error("Animation clip does not match the character's skeleton!");
+	}
+
+	SkinnedCharacter character = {};
+	character.modelIndex = modelIndex;
+	character.clip = clip;
+	character.transform = transform;
+	character.time = startTime;
+	character.speed = 1.0f;
+	characters.push_back(character);
+
+	//Every character gets its own joint matrices and its own copy of the skinned vertices
+	SkinnedCharacterData data = {};
+	data.restOffset = model.restOffset;
+	data.vertexCount = static_cast<uint32_t>(model.mesh->GetVertices().size());
+	data.jointOffset = jointCount;
+	data.outputOffset = outputVertexCount;
+	characterData.push_back(data);
+
+	jointCount += model.skeleton->GetJointCount();
+	outputVertexCount += data.vertexCount;
+
+	return static_cast<uint32_t>(characters.size() - 1);
+}
+
+SkinnedCharacter& Skinning::GetCharacter(uint32_t index)
+{
+	return characters[index];
+}
+
+uint32_t Skinning::GetCharacterCount()
+{
+	return static_cast<uint32_t>(characters.size());
+}
+
+std::shared_ptr<Mesh> Skinning::GetCharacterMesh(uint32_t index)
+{
+	return models[characters[index].modelIndex].mesh;
+}
+
+#pragma endregion
+
+#pragma region Rendering
+
+VkDeviceSize Skinning::UpdatePoses(uint32_t imageIndex, float deltaTime)
+{
+	if (characters.empty()) {
+		return 0;
+	}
+
+	void* data;
+	vkMapMemory(TriangleApp::logicalDevice, jointBuffers[imageIndex]->GetBufferMemory(), 0, sizeof(glm::mat4) * jointCount, 0, &data);
+	glm::mat4* jointMatrices = static_cast<glm::mat4*>(data);
+
+	//Characters write to separate ranges of the joint buffer so they can be posed in any order
+	auto poseCharacters = [&](size_t begin, size_t end) {
+		std::vector<JointPose> poses(maxSkeletonJoints);
+
+		for (size_t i = begin; i < end; i++) {
+			SkinnedCharacter& character = characters[i];
+			character.time = fmodf(character.time + deltaTime * character.speed, character.clip->GetDuration());
+
+			character.clip->Sample(character.time, poses.data());
+			AnimationClip::ComputeSkinMatrices(*models[character.modelIndex].skeleton, poses.data(), character.transform->GetModelMatrix(), jointMatrices + characterData[i].jointOffset);
+		}
+	};
+
+	size_t count = characters.size();
+	size_t threadCount = 1;
+	if (count >= PARALLEL_POSE_THRESHOLD) {
+		threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / PARALLEL_POSE_THRESHOLD));
+	}
+
+	if (threadCount == 1) {
+		poseCharacters(0, count);
+	}
+	else {
+		size_t chunkSize = (count + threadCount - 1) / threadCount;
+		std::vector<std::thread> workers;
+
+		for (size_t t = 0; t < threadCount; t++) {
+			size_t begin = std::min(t * chunkSize, count);
+			size_t end = std::min(begin + chunkSize, count);
+			workers.emplace_back(poseCharacters, begin, end);
+		}
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	vkUnmapMemory(TriangleApp::logicalDevice, jointBuffers[imageIndex]->GetBufferMemory());
+
+	return sizeof(glm::mat4) * jointCount;
+}
+
+void Skinning::RecordDispatch(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (characters.empty()) {
+		return;
+	}
+
+	//The previous frame has to finish drawing the skinned vertices before they are overwritten
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[imageIndex], 0, nullptr);
+
+	//One row of workgroups per character, threads past the end of a smaller mesh exit straight away
+	vkCmdDispatch(commandBuffer, (maxVertexCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, static_cast<uint32_t>(characters.size()), 1);
+
+	//Make the skinned vertices visible to the vertex input
+	std::array<VkBufferMemoryBarrier, 2> barriers = {};
+	VkBuffer barrierBuffers[] = { outputVertexBuffer->GetBuffer(), outputPositionBuffer->GetBuffer() };
+
+	for (size_t i = 0; i < barriers.size(); i++) {
+		barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[i].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].buffer = barrierBuffers[i];
+		barriers[i].offset = 0;
+		barriers[i].size = VK_WHOLE_SIZE;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data(),
+		0, nullptr);
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkBuffer Skinning::GetOutputVertexBuffer()
+{
+	return outputVertexBuffer->GetBuffer();
+}
+
+VkBuffer Skinning::GetOutputPositionBuffer()
+{
+	return outputPositionBuffer->GetBuffer();
+}
+
+VkBuffer Skinning::GetInstanceBuffer()
+{
+	return instanceBuffer->GetBuffer();
+}
+
+uint32_t Skinning::GetOutputOffset(uint32_t index)
+{
+	return characterData[index].outputOffset;
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void Skinning::CreateLayouts()
+{
+	//Joint matrices, characters, rest vertices, skin, skinned vertices and skinned positions
+	std::array<VkDescriptorSetLayoutBinding, 6> bindings = {};
+	for (size_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = static_cast<uint32_t>(i);
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(TriangleApp::logicalDevice, &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Skinning Descriptor Set Layout!");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+
+	if (vkCreatePipelineLayout(TriangleApp::logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Skinning Pipeline Layout!");
+	}
+}
+
+std::shared_ptr<Buffer> Skinning::CreateStaticBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, MemoryCategory category)
+{
+	//Create the staging buffer
+	Buffer stagingBuffer;
+	Buffer::CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
+
+	void* mappedData;
+	vkMapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory(), 0, size, 0, &mappedData);
+	memcpy(mappedData, data, static_cast<size_t>(size));
+	vkUnmapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory());
+
+	std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+	Buffer::CreateBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, category, *buffer);
+	Buffer::CopyBuffer(stagingBuffer.GetBuffer(), buffer->GetBuffer(), size);
+
+	stagingBuffer.Cleanup();
+
+	return buffer;
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "pch.h"
+#include "Buffer.h"
+#include "Mesh.h"
+#include "Skeleton.h"
+
+//Must match the Character struct in SkinVertices.comp
+struct SkinnedCharacterData {
+	uint32_t restOffset;
+	uint32_t vertexCount;
+	uint32_t jointOffset;
+	uint32_t outputOffset;
+};
+
+struct SkinnedCharacter {
+	uint32_t modelIndex;
+	std::shared_ptr<AnimationClip> clip;
+	std::shared_ptr<Transform> transform;
+	float time;
+	float speed;
+};
+
+class Skinning
+{
+private:
+	struct SkinnedModel {
+		std::shared_ptr<Mesh> mesh;
+		std::shared_ptr<Skeleton> skeleton;
+		uint32_t restOffset;
+	};
+
+	std::vector<SkinnedModel> models;
+	std::vector<SkinnedCharacter> characters;
+	std::vector<SkinnedCharacterData> characterData;
+	uint32_t restVertexCount;
+	uint32_t jointCount;
+	uint32_t outputVertexCount;
+	uint32_t maxVertexCount;
+	uint32_t maxSkeletonJoints;
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> descriptorSets;
+
+	//Joint matrices are written by the CPU every frame, the skinned vertices only ever live on the GPU
+	std::vector<std::shared_ptr<Buffer>> jointBuffers;
+	std::shared_ptr<Buffer> characterBuffer;
+	std::shared_ptr<Buffer> restVertexBuffer;
+	std::shared_ptr<Buffer> skinBuffer;
+	std::shared_ptr<Buffer> outputVertexBuffer;
+	std::shared_ptr<Buffer> outputPositionBuffer;
+	//Skinned vertices are already in world space so every character is drawn with a single identity instance
+	std::shared_ptr<Buffer> instanceBuffer;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Creates the descriptor set layout and pipeline layout used by the skinning compute shader
+	/// </summary>
+	void CreateLayouts();
+
+	/// <summary>
+	/// Creates a device local buffer and fills it through a staging buffer
+	/// </summary>
+	std::shared_ptr<Buffer> CreateStaticBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, MemoryCategory category);
+
+#pragma endregion
+
+public:
+	//Must match the local size in SkinVertices.comp
+	static const uint32_t WORKGROUP_SIZE = 64;
+	//Below this many characters posing them on one thread is faster than starting workers
+	static const size_t PARALLEL_POSE_THRESHOLD = 32;
+
+#pragma region Constructor
+
+	Skinning();
+
+	/// <summary>
+	/// Destroys the compute pipeline and layouts, CleanupResources must be called first
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Resources
+
+	/// <summary>
+	/// Creates the skinning compute pipeline, the previous pipeline is returned so the caller can destroy it once no frame is using it
+	/// </summary>
+	/// <param name="shaderModule">The compiled SkinVertices.comp shader</param>
+	/// <returns>The replaced pipeline or VK_NULL_HANDLE if there was none</returns>
+	VkPipeline CreatePipeline(VkShaderModule shaderModule);
+
+	/// <summary>
+	/// Uploads the models and creates the joint buffers and descriptor sets for each swap chain image
+	/// </summary>
+	/// <param name="imageCount">The number of swap chain images</param>
+	void CreateResources(uint32_t imageCount);
+
+	/// <summary>
+	/// Destroys the skinning buffers and descriptor sets
+	/// </summary>
+	void CleanupResources();
+
+#pragma endregion
+
+#pragma region Characters
+
+	/// <summary>
+	/// Adds a skinned mesh that characters can be created from, must be called before CreateResources
+	/// </summary>
+	/// <param name="mesh">A mesh with skinning data, its index buffer is used to draw the characters</param>
+	/// <param name="skeleton">The skeleton the mesh's joint indices refer to</param>
+	/// <returns>The index of the model</returns>
+	uint32_t AddModel(std::shared_ptr<Mesh> mesh, std::shared_ptr<Skeleton> skeleton);
+
+	/// <summary>
+	/// Adds an animated instance of a model, must be called before CreateResources
+	/// </summary>
+	/// <param name="modelIndex">The index returned by AddModel</param>
+	/// <param name="clip">The looping animation to play, it must have a pose for every joint of the model's skeleton</param>
+	/// <param name="transform">Places the character in the world</param>
+	/// <param name="startTime">How far into the clip the character starts, in seconds</param>
+	/// <returns>The index of the character</returns>
+	uint32_t AddCharacter(uint32_t modelIndex, std::shared_ptr<AnimationClip> clip, std::shared_ptr<Transform> transform, float startTime = 0.0f);
+
+	/// <summary>
+	/// Returns a character so its animation or transform can be changed
+	/// </summary>
+	SkinnedCharacter& GetCharacter(uint32_t index);
+
+	/// <summary>
+	/// Returns the number of characters
+	/// </summary>
+	uint32_t GetCharacterCount();
+
+	/// <summary>
+	/// Returns the mesh a character is drawn with
+	/// </summary>
+	std::shared_ptr<Mesh> GetCharacterMesh(uint32_t index);
+
+#pragma endregion
+
+#pragma region Rendering
+
+	/// <summary>
+	/// Advances every character's animation and writes their joint matrices into the joint buffer of a swap chain image, large crowds are posed on worker threads
+	/// </summary>
+	/// <param name="imageIndex">The swap chain image that is about to be drawn</param>
+	/// <param name="deltaTime">The time since the last frame in seconds</param>
+	/// <returns>The number of bytes copied to the device</returns>
+	VkDeviceSize UpdatePoses(uint32_t imageIndex, float deltaTime);
+
+	/// <summary>
+	/// Records one dispatch that skins every character, followed by a barrier so the draws can read the results
+	/// </summary>
+	/// <param name="commandBuffer">The command buffer to record into, outside of a render pass</param>
+	/// <param name="imageIndex">The swap chain image the command buffer draws to</param>
+	void RecordDispatch(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the buffer holding every character's skinned vertices in world space, laid out like a mesh vertex buffer
+	/// </summary>
+	VkBuffer GetOutputVertexBuffer();
+
+	/// <summary>
+	/// Returns the buffer holding only the skinned positions, used by the depth pre-pass
+	/// </summary>
+	VkBuffer GetOutputPositionBuffer();
+
+	/// <summary>
+	/// Returns the buffer holding the identity transform the characters are drawn with
+	/// </summary>
+	VkBuffer GetInstanceBuffer();
+
+	/// <summary>
+	/// Returns the index of a character's first vertex in the output buffers
+	/// </summary>
+	uint32_t GetOutputOffset(uint32_t index);
+
+#pragma endregion
+};
\ No newline at end of file
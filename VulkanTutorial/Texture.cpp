@@ -0,0 +1,535 @@
+#include "pch.h"
+#include "Texture.h"
+
+#include "TriangleApp.h"
+#include "Buffer.h"
+#include "Command.h"
+#include "TextureFile.h"
+
+#include <fstream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb/stb_image_resize.h>
+
+#pragma region Constructor
+
+Texture::Texture()
+{
+	width = 0;
+	height = 0;
+	mipLevels = 0;
+	format = VK_FORMAT_R8G8B8A8_UNORM;
+	streamed = false;
+	imageView = VK_NULL_HANDLE;
+	residentMip = 0;
+	tailMip = 0;
+	lastUsedFrame = 0;
+	version = 0;
+}
+
+void Texture::Cleanup()
+{
+	DestroyImage();
+
+	mipData.clear();
+	mipData.shrink_to_fit();
+}
+
+RetiredTexture Texture::Release()
+{
+	RetiredTexture retired;
+	retired.image = image;
+	retired.imageView = imageView;
+
+	image = Image();
+	imageView = VK_NULL_HANDLE;
+
+	mipData.clear();
+	mipData.shrink_to_fit();
+
+	return retired;
+}
+
+void RetiredTexture::Cleanup()
+{
+	if (imageView != VK_NULL_HANDLE) {
+		vkDestroyImageView(TriangleApp::logicalDevice, imageView, nullptr);
+		imageView = VK_NULL_HANDLE;
+	}
+
+	if (image.GetImage() != VK_NULL_HANDLE) {
+		image.Cleanup();
+	}
+
+	if (stagingBuffer.GetBuffer() != VK_NULL_HANDLE) {
+		stagingBuffer.Cleanup();
+	}
+}
+
+#pragma endregion
+
+#pragma region Loading
+
+void Texture::LoadFromFile(const std::string& filePath, bool streamed)
+{
+	//Baked textures are already block compressed and can be uploaded as they are
+	if (filePath.size() >= 5 && filePath.compare(filePath.size() - 5, 5, ".vtex") == 0) {
+		LoadFromCompressedFile(filePath, streamed);
+		return;
+	}
+
+	int textureWidth, textureHeight, textureChannels;
+	stbi_uc* pixels = stbi_load(filePath.c_str(), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+
+	if (!pixels) {
+		throw std::runtime_error("Failed to load image!");
+	}
+
+	this->filePath = filePath;
+	LoadFromPixels(pixels, static_cast<uint32_t>(textureWidth), static_cast<uint32_t>(textureHeight), streamed);
+
+	stbi_image_free(pixels);
+}
+
+void Texture::LoadFromCompressedFile(const std::string& filePath, bool streamed)
+{
+	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open texture file!");
+	}
+
+	std::vector<char> fileData(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(fileData.data(), static_cast<std::streamsize>(fileData.size()));
+
+	if (!file) {
+		throw std::runtime_error("Failed to read texture file!");
+	}
+
+	LoadFromCompressedData(fileData, streamed);
+	this->filePath = filePath;
+}
+
+void Texture::LoadFromCompressedData(const std::vector<char>& fileData, bool streamed)
+{
+	TextureFileHeader header;
+
+	if (fileData.size() < sizeof(TextureFileHeader)) {
+		throw std::runtime_error("Invalid texture file!");
+	}
+
+	memcpy(&header, fileData.data(), sizeof(TextureFileHeader));
+
+	if (!header.IsValid() || fileData.size() < sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * header.mipLevels) {
+		throw std::runtime_error("Invalid texture file!");
+	}
+
+	std::vector<TextureFileLevel> levels(header.mipLevels);
+	memcpy(levels.data(), fileData.data() + sizeof(TextureFileHeader), sizeof(TextureFileLevel) * levels.size());
+
+	//Block compressed formats are optional so check that the device can sample them
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(TriangleApp::physicalDevice, static_cast<VkFormat>(header.format), &formatProperties);
+
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+		throw std::runtime_error("Texture format is not supported by the device!");
+	}
+
+	SetDimensions(static_cast<VkFormat>(header.format), header.width, header.height, streamed);
+
+	if (header.mipLevels != mipLevels) {
+		throw std::runtime_error("Texture file has an incomplete mip chain!");
+	}
+
+	mipData.resize(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		if (levels[i].size != GetLevelSize(i)) {
+			throw std::runtime_error("Texture file level size does not match its format!");
+		}
+
+		if (levels[i].offset > fileData.size() || levels[i].size > fileData.size() - levels[i].offset) {
+			throw std::runtime_error("Failed to read texture file!");
+		}
+
+		mipData[i].resize(static_cast<size_t>(levels[i].size));
+		memcpy(mipData[i].data(), fileData.data() + levels[i].offset, static_cast<size_t>(levels[i].size));
+	}
+
+	//Compressed levels cannot be blitted so non-streamed textures upload the whole chain at once
+	residentMip = mipLevels;
+	UploadLevels(streamed ? tailMip : 0, nullptr);
+
+	if (!streamed) {
+		mipData.clear();
+		mipData.shrink_to_fit();
+	}
+}
+
+std::shared_ptr<DecodedImage> Texture::DecodeImage(const std::vector<char>& fileData)
+{
+	//Decoding runs on the asset workers, the scope only changes the category for this thread
+	MemoryScope scope(MemoryCategory::Textures);
+
+	int textureWidth, textureHeight, textureChannels;
+	stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(fileData.data()), static_cast<int>(fileData.size()), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+
+	if (!pixels) {
+		throw std::runtime_error("Failed to load image!");
+	}
+
+	std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+	image->width = static_cast<uint32_t>(textureWidth);
+	image->height = static_cast<uint32_t>(textureHeight);
+	image->pixels.assign(pixels, pixels + static_cast<size_t>(textureWidth) * textureHeight * 4);
+
+	stbi_image_free(pixels);
+
+	return image;
+}
+
+void Texture::LoadFromPixels(const uint8_t* pixels, uint32_t width, uint32_t height, bool streamed)
+{
+	SetDimensions(VK_FORMAT_R8G8B8A8_UNORM, width, height, streamed);
+
+	if (streamed) {
+		mipData = GenerateMipChain(pixels, width, height);
+
+		//Start with only the tail on the GPU, the streamer brings in the rest
+		residentMip = mipLevels;
+		UploadLevels(tailMip, nullptr);
+		return;
+	}
+
+	//Non-streamed textures upload level 0 once and blit the rest of the chain on the GPU
+	VkDeviceSize imageSize = GetLevelSize(0);
+
+	Buffer stagingBuffer;
+	Buffer::CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
+
+	void* data;
+	vkMapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory(), 0, imageSize, 0, &data);
+	memcpy(data, pixels, static_cast<size_t>(imageSize));
+	vkUnmapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory());
+
+	Image::CreateImage(width, height, mipLevels, format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MemoryCategory::Textures,
+		image);
+
+	Image::TransitionImageLayout(image.GetImage(), format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+	Image::CopyBufferToImage(stagingBuffer.GetBuffer(), image.GetImage(), width, height);
+	Image::GenerateMipmaps(image.GetImage(), format, static_cast<int32_t>(width), static_cast<int32_t>(height), mipLevels);
+
+	stagingBuffer.Cleanup();
+
+	imageView = Image::CreateImageView(image.GetImage(), format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	residentMip = 0;
+	version++;
+}
+
+#pragma endregion
+
+#pragma region Streaming
+
+void Texture::SetResidentMip(uint32_t level, TextureUploadBatch& batch)
+{
+	level = std::min(level, tailMip);
+
+	if (!streamed || level == residentMip) {
+		return;
+	}
+
+	UploadLevels(level, &batch);
+}
+
+void Texture::MarkUsed(uint64_t frame)
+{
+	lastUsedFrame = frame;
+}
+
+VkDeviceSize Texture::GetLevelSize(uint32_t level)
+{
+	VkDeviceSize levelWidth = std::max(width >> level, 1u);
+	VkDeviceSize levelHeight = std::max(height >> level, 1u);
+	uint32_t blockSize = GetBlockSize(format);
+
+	if (blockSize > 0) {
+		return ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize;
+	}
+
+	return levelWidth * levelHeight * 4;
+}
+
+std::vector<std::vector<uint8_t>> Texture::GenerateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+	if (levelCount == 0 || levelCount > Image::GetMipLevelCount(width, height)) {
+		levelCount = Image::GetMipLevelCount(width, height);
+	}
+
+	std::vector<std::vector<uint8_t>> levels(levelCount);
+	levels[0].assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+	//Each level is filtered down from the one above it
+	for (uint32_t i = 1; i < levelCount; i++) {
+		int srcWidth = static_cast<int>(std::max(width >> (i - 1), 1u));
+		int srcHeight = static_cast<int>(std::max(height >> (i - 1), 1u));
+		int dstWidth = static_cast<int>(std::max(width >> i, 1u));
+		int dstHeight = static_cast<int>(std::max(height >> i, 1u));
+
+		levels[i].resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+		if (!stbir_resize_uint8(levels[i - 1].data(), srcWidth, srcHeight, 0, levels[i].data(), dstWidth, dstHeight, 0, 4)) {
+			throw std::runtime_error("Failed to generate texture mip chain!");
+		}
+	}
+
+	return levels;
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void Texture::SetDimensions(VkFormat format, uint32_t width, uint32_t height, bool streamed)
+{
+	this->format = format;
+	this->width = width;
+	this->height = height;
+	this->streamed = streamed;
+	mipLevels = Image::GetMipLevelCount(width, height);
+
+	//The tail is the first level small enough to always keep resident
+	tailMip = 0;
+	while (tailMip < mipLevels - 1 && std::max(width >> tailMip, height >> tailMip) > TAIL_SIZE) {
+		tailMip++;
+	}
+}
+
+void Texture::UploadLevels(uint32_t level, TextureUploadBatch* batch)
+{
+	uint32_t newLevelCount = mipLevels - level;
+	uint32_t newWidth = std::max(width >> level, 1u);
+	uint32_t newHeight = std::max(height >> level, 1u);
+
+	//Levels that are already on the GPU are copied from the old image instead of being uploaded again
+	uint32_t firstKept = std::max(level, residentMip);
+	bool hasOldImage = image.GetImage() != VK_NULL_HANDLE;
+
+	//Upload any levels finer than the old resident mip through a staging buffer
+	VkDeviceSize stagingSize = 0;
+	for (uint32_t i = level; i < firstKept; i++) {
+		stagingSize += GetLevelSize(i);
+	}
+
+	Buffer stagingBuffer;
+	if (stagingSize > 0) {
+		Buffer::CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
+
+		void* data;
+		vkMapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory(), 0, stagingSize, 0, &data);
+
+		VkDeviceSize offset = 0;
+		for (uint32_t i = level; i < firstKept; i++) {
+			memcpy(static_cast<uint8_t*>(data) + offset, mipData[i].data(), mipData[i].size());
+			offset += GetLevelSize(i);
+		}
+
+		vkUnmapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory());
+	}
+
+	Image newImage;
+	Image::CreateImage(newWidth, newHeight, newLevelCount, format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MemoryCategory::Textures,
+		newImage);
+
+	//Streaming records into the frame's upload commands, loading has nothing in flight yet so it can wait for the copy
+	VkCommandBuffer commandBuffer = batch != nullptr ? batch->commandBuffer : Command::BeginSingleTimeCommand();
+
+	std::array<VkImageMemoryBarrier, 2> barriers = {};
+	for (size_t i = 0; i < barriers.size(); i++) {
+		barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barriers[i].subresourceRange.baseMipLevel = 0;
+		barriers[i].subresourceRange.baseArrayLayer = 0;
+		barriers[i].subresourceRange.layerCount = 1;
+	}
+
+	//Prepare the new image to be written to
+	barriers[0].image = newImage.GetImage();
+	barriers[0].subresourceRange.levelCount = newLevelCount;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	//Prepare the old image to be read from
+	barriers[1].image = image.GetImage();
+	barriers[1].subresourceRange.levelCount = mipLevels - residentMip;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, hasOldImage ? 2 : 1, barriers.data());
+
+	//Copy the levels that are shared between the old and new image
+	if (hasOldImage) {
+		std::vector<VkImageCopy> copyRegions;
+
+		for (uint32_t i = firstKept; i < mipLevels; i++) {
+			VkImageCopy region = {};
+			region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.srcSubresource.mipLevel = i - residentMip;
+			region.srcSubresource.baseArrayLayer = 0;
+			region.srcSubresource.layerCount = 1;
+			region.srcOffset = { 0, 0, 0 };
+			region.dstSubresource = region.srcSubresource;
+			region.dstSubresource.mipLevel = i - level;
+			region.dstOffset = { 0, 0, 0 };
+			region.extent = { std::max(width >> i, 1u), std::max(height >> i, 1u), 1 };
+
+			copyRegions.push_back(region);
+		}
+
+		vkCmdCopyImage(commandBuffer,
+			image.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			newImage.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+	}
+
+	//Upload the newly resident levels
+	if (stagingSize > 0) {
+		std::vector<VkBufferImageCopy> uploadRegions;
+		VkDeviceSize offset = 0;
+
+		for (uint32_t i = level; i < firstKept; i++) {
+			VkBufferImageCopy region = {};
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i - level;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { std::max(width >> i, 1u), std::max(height >> i, 1u), 1 };
+
+			uploadRegions.push_back(region);
+			offset += GetLevelSize(i);
+		}
+
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.GetBuffer(), newImage.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(uploadRegions.size()), uploadRegions.data());
+	}
+
+	//Make the new image readable by shaders
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[0]);
+
+	if (batch != nullptr) {
+		//Frames in flight may still sample the old image and the copies read from it and the staging buffer, so they are freed once this frame finishes
+		RetiredTexture retired;
+		retired.image = image;
+		retired.imageView = imageView;
+		retired.stagingBuffer = stagingBuffer;
+
+		batch->retired.push_back(retired);
+		batch->uploadBytes += stagingSize;
+		batch->recorded = true;
+	}
+	else {
+		Command::EndSingleTimeCommand(commandBuffer);
+
+		if (stagingSize > 0) {
+			stagingBuffer.Cleanup();
+		}
+
+		DestroyImage();
+	}
+
+	image = newImage;
+	imageView = Image::CreateImageView(image.GetImage(), format, VK_IMAGE_ASPECT_COLOR_BIT, newLevelCount);
+	residentMip = level;
+	version++;
+}
+
+void Texture::DestroyImage()
+{
+	if (imageView != VK_NULL_HANDLE) {
+		vkDestroyImageView(TriangleApp::logicalDevice, imageView, nullptr);
+		imageView = VK_NULL_HANDLE;
+	}
+
+	if (image.GetImage() != VK_NULL_HANDLE) {
+		image.Cleanup();
+	}
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkImageView Texture::GetImageView()
+{
+	return imageView;
+}
+
+std::string Texture::GetFilePath()
+{
+	return filePath;
+}
+
+VkFormat Texture::GetFormat()
+{
+	return format;
+}
+
+uint32_t Texture::GetMipLevels()
+{
+	return mipLevels;
+}
+
+uint32_t Texture::GetResidentMip()
+{
+	return residentMip;
+}
+
+uint32_t Texture::GetTailMip()
+{
+	return tailMip;
+}
+
+uint64_t Texture::GetLastUsedFrame()
+{
+	return lastUsedFrame;
+}
+
+uint32_t Texture::GetVersion()
+{
+	return version;
+}
+
+VkDeviceSize Texture::GetResidentSize()
+{
+	return image.GetMemorySize();
+}
+
+bool Texture::IsStreamed()
+{
+	return streamed;
+}
+
+#pragma endregion
\ No newline at end of file
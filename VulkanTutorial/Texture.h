@@ -0,0 +1,242 @@
+#pragma once
+
+#include "pch.h"
+#include "Image.h"
+#include "Buffer.h"
+
+//RGBA8 pixels decoded from an image file, decoding doesn't touch the GPU so it can run on any thread
+struct DecodedImage {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> pixels;
+};
+
+//GPU resources a texture has replaced, they are destroyed once the frames that might still be using them have finished
+struct RetiredTexture {
+	Image image;
+	VkImageView imageView = VK_NULL_HANDLE;
+	//The staging buffer the new levels were copied from, empty if nothing was uploaded
+	Buffer stagingBuffer;
+
+	/// <summary>
+	/// Destroys the resources that were handed over
+	/// </summary>
+	void Cleanup();
+};
+
+//Residency changes recorded for one frame, the command buffer is submitted ahead of the frame's draws on the same queue
+struct TextureUploadBatch {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	std::vector<RetiredTexture> retired;
+	//The bytes copied from staging buffers
+	VkDeviceSize uploadBytes = 0;
+	//Whether any commands were recorded
+	bool recorded = false;
+};
+
+class Texture
+{
+private:
+	std::string filePath;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+	VkFormat format;
+
+	//CPU copy of every level in the mip chain, only kept for streamed textures
+	std::vector<std::vector<uint8_t>> mipData;
+	bool streamed;
+
+	Image image;
+	VkImageView imageView;
+
+	uint32_t residentMip;
+	uint32_t tailMip;
+	uint64_t lastUsedFrame;
+	uint32_t version;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Sets the format and size of the texture and works out the mip chain length and tail
+	/// </summary>
+	/// <param name="format">The format of the texture</param>
+	/// <param name="width">The width of level 0</param>
+	/// <param name="height">The height of level 0</param>
+	/// <param name="streamed">Whether the texture is managed by a texture streamer</param>
+	void SetDimensions(VkFormat format, uint32_t width, uint32_t height, bool streamed);
+
+	/// <summary>
+	/// Recreates the GPU image with levels [level, mipLevels), copying levels that are already resident and uploading the rest from the CPU mip chain
+	/// </summary>
+	/// <param name="level">The finest level to make resident</param>
+	/// <param name="batch">The batch to record into and hand the old image to, without one the upload is submitted and waited on straight away</param>
+	void UploadLevels(uint32_t level, TextureUploadBatch* batch);
+
+	/// <summary>
+	/// Destroys the image view and image
+	/// </summary>
+	void DestroyImage();
+
+#pragma endregion
+
+public:
+	static const uint32_t TAIL_SIZE = 64;
+
+#pragma region Constructor
+
+	Texture();
+
+	/// <summary>
+	/// Destroys the GPU resources and frees the CPU mip chain
+	/// </summary>
+	void Cleanup();
+
+	/// <summary>
+	/// Hands the GPU resources to the caller to destroy once no frame is using them and frees the CPU mip chain
+	/// </summary>
+	/// <returns>The image and view the texture held</returns>
+	RetiredTexture Release();
+
+#pragma endregion
+
+#pragma region Loading
+
+	/// <summary>
+	/// Loads an image file from disk
+	/// </summary>
+	/// <param name="filePath">The path of the image to load, .vtex files are loaded as baked block compressed textures</param>
+	/// <param name="streamed">If true only the mip tail is uploaded and finer levels are streamed in by a TextureStreamer, otherwise the full chain is generated on the GPU</param>
+	void LoadFromFile(const std::string& filePath, bool streamed = true);
+
+	/// <summary>
+	/// Loads a texture baked by the TextureBaker, the stored levels are uploaded without being decoded
+	/// </summary>
+	/// <param name="filePath">The path of the .vtex file to load</param>
+	/// <param name="streamed">If true only the mip tail is uploaded and finer levels are streamed in by a TextureStreamer, otherwise every level is uploaded</param>
+	void LoadFromCompressedFile(const std::string& filePath, bool streamed = true);
+
+	/// <summary>
+	/// Loads a texture baked by the TextureBaker from a copy of the file already in memory
+	/// </summary>
+	/// <param name="fileData">The contents of the .vtex file</param>
+	/// <param name="streamed">If true only the mip tail is uploaded and finer levels are streamed in by a TextureStreamer, otherwise every level is uploaded</param>
+	void LoadFromCompressedData(const std::vector<char>& fileData, bool streamed = true);
+
+	/// <summary>
+	/// Decodes an image file in memory to RGBA8 pixels without creating any GPU resources, safe to call from worker threads
+	/// </summary>
+	/// <param name="fileData">The contents of the image file</param>
+	/// <returns>The decoded pixels</returns>
+	static std::shared_ptr<DecodedImage> DecodeImage(const std::vector<char>& fileData);
+
+	/// <summary>
+	/// Creates the texture from RGBA8 pixels in memory
+	/// </summary>
+	/// <param name="pixels">The RGBA8 pixels of level 0</param>
+	/// <param name="width">The width of the image</param>
+	/// <param name="height">The height of the image</param>
+	/// <param name="streamed">If true only the mip tail is uploaded and finer levels are streamed in by a TextureStreamer, otherwise the full chain is generated on the GPU</param>
+	void LoadFromPixels(const uint8_t* pixels, uint32_t width, uint32_t height, bool streamed = true);
+
+#pragma endregion
+
+#pragma region Streaming
+
+	/// <summary>
+	/// Recreates the GPU image so that mip levels [level, mipLevels) are resident, levels already on the GPU are copied across
+	/// </summary>
+	/// <param name="level">The finest level that should be resident, clamped between 0 and the tail mip</param>
+	/// <param name="batch">The frame's uploads, the copies are recorded into its command buffer and the old image is retired through it</param>
+	void SetResidentMip(uint32_t level, TextureUploadBatch& batch);
+
+	/// <summary>
+	/// Marks the texture as sampled on the specified frame
+	/// </summary>
+	/// <param name="frame">The frame the texture was sampled on</param>
+	void MarkUsed(uint64_t frame);
+
+	/// <summary>
+	/// Returns the number of bytes that a single mip level takes up
+	/// </summary>
+	/// <param name="level">The mip level</param>
+	/// <returns>The size of the level in bytes</returns>
+	VkDeviceSize GetLevelSize(uint32_t level);
+
+	/// <summary>
+	/// Builds a full RGBA8 mip chain on the CPU, each level is filtered down from the one above it
+	/// </summary>
+	/// <param name="pixels">The RGBA8 pixels of level 0</param>
+	/// <param name="width">The width of level 0</param>
+	/// <param name="height">The height of level 0</param>
+	/// <param name="levelCount">The number of levels to generate, 0 generates the full chain</param>
+	/// <returns>The pixels of every generated level</returns>
+	static std::vector<std::vector<uint8_t>> GenerateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t levelCount = 0);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the image view covering every resident mip level
+	/// </summary>
+	/// <returns>The texture's image view</returns>
+	VkImageView GetImageView();
+
+	/// <summary>
+	/// Returns the path the texture was loaded from
+	/// </summary>
+	/// <returns>The texture's file path</returns>
+	std::string GetFilePath();
+
+	/// <summary>
+	/// Returns the format of the texture's image
+	/// </summary>
+	/// <returns>The texture's format</returns>
+	VkFormat GetFormat();
+
+	/// <summary>
+	/// Returns the number of levels in the full mip chain
+	/// </summary>
+	/// <returns>The mip level count</returns>
+	uint32_t GetMipLevels();
+
+	/// <summary>
+	/// Returns the finest mip level that is currently on the GPU
+	/// </summary>
+	/// <returns>The finest resident mip level</returns>
+	uint32_t GetResidentMip();
+
+	/// <summary>
+	/// Returns the first level of the mip tail, levels from here down are never evicted
+	/// </summary>
+	/// <returns>The tail mip level</returns>
+	uint32_t GetTailMip();
+
+	/// <summary>
+	/// Returns the last frame the texture was sampled on
+	/// </summary>
+	/// <returns>The last used frame</returns>
+	uint64_t GetLastUsedFrame();
+
+	/// <summary>
+	/// Returns a counter that increases every time the image view is recreated
+	/// </summary>
+	/// <returns>The texture's version</returns>
+	uint32_t GetVersion();
+
+	/// <summary>
+	/// Returns the amount of device memory used by the texture
+	/// </summary>
+	/// <returns>The size of the texture's allocation in bytes</returns>
+	VkDeviceSize GetResidentSize();
+
+	/// <summary>
+	/// Returns whether the texture is managed by a texture streamer
+	/// </summary>
+	/// <returns>True if the texture is streamed</returns>
+	bool IsStreamed();
+
+#pragma endregion
+};
\ No newline at end of file
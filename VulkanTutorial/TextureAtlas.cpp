@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "TextureAtlas.h"
+
+#include "TriangleApp.h"
+#include "Buffer.h"
+#include "Command.h"
+#include "Texture.h"
+
+#include <stb/stb_image.h>
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb/stb_rect_pack.h>
+
+#pragma region Constructor
+
+TextureAtlas::TextureAtlas(uint32_t layerSize, uint32_t gutter)
+{
+	this->layerSize = layerSize;
+
+	//Entries are aligned to the gutter so it has to be a power of two
+	this->gutter = 1;
+	while (this->gutter < gutter) {
+		this->gutter *= 2;
+	}
+
+	//Each mip level halves the gutter, stop once it would be less than a texel wide
+	mipLevels = 1;
+	while ((this->gutter >> (mipLevels - 1)) > 1) {
+		mipLevels++;
+	}
+
+	layerCount = 0;
+	imageView = VK_NULL_HANDLE;
+}
+
+void TextureAtlas::Cleanup()
+{
+	if (imageView != VK_NULL_HANDLE) {
+		vkDestroyImageView(TriangleApp::logicalDevice, imageView, nullptr);
+		imageView = VK_NULL_HANDLE;
+	}
+
+	if (image.GetImage() != VK_NULL_HANDLE) {
+		image.Cleanup();
+	}
+
+	entries.clear();
+}
+
+#pragma endregion
+
+#pragma region Building
+
+uint32_t TextureAtlas::AddFromFile(const std::string& filePath)
+{
+	int textureWidth, textureHeight, textureChannels;
+	stbi_uc* pixels = stbi_load(filePath.c_str(), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+
+	if (!pixels) {
+		throw std::runtime_error("Failed to load image!");
+	}
+
+	uint32_t id = AddFromPixels(pixels, static_cast<uint32_t>(textureWidth), static_cast<uint32_t>(textureHeight));
+	stbi_image_free(pixels);
+
+	return id;
+}
+
+uint32_t TextureAtlas::AddFromPixels(const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+	MemoryScope scope(MemoryCategory::Textures);
+
+	if (width + gutter * 2 > layerSize || height + gutter * 2 > layerSize) {
+		throw std::runtime_error("Image is too large to fit in a texture atlas layer!");
+	}
+
+	AtlasEntry entry;
+	entry.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	entry.width = width;
+	entry.height = height;
+
+	entries.push_back(entry);
+
+	return static_cast<uint32_t>(entries.size() - 1);
+}
+
+void TextureAtlas::Build()
+{
+	if (entries.empty()) {
+		throw std::runtime_error("Cannot build an empty texture atlas!");
+	}
+
+	//Pack in cells the size of the gutter so every entry starts on a texel boundary of each usable mip
+	int cellsPerLayer = static_cast<int>(layerSize / gutter);
+
+	std::vector<stbrp_rect> rects(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		rects[i].id = static_cast<int>(i);
+		rects[i].w = static_cast<stbrp_coord>((entries[i].width + gutter * 3 - 1) / gutter);
+		rects[i].h = static_cast<stbrp_coord>((entries[i].height + gutter * 3 - 1) / gutter);
+		rects[i].was_packed = 0;
+	}
+
+	std::vector<stbrp_node> nodes(cellsPerLayer);
+	std::vector<stbrp_rect> remaining = rects;
+	std::vector<std::vector<uint8_t>> layerPixels;
+
+	regions.resize(entries.size());
+
+	//Fill one layer at a time, anything that does not fit moves on to the next layer
+	while (!remaining.empty()) {
+		stbrp_context context;
+		stbrp_init_target(&context, cellsPerLayer, cellsPerLayer, nodes.data(), static_cast<int>(nodes.size()));
+		stbrp_pack_rects(&context, remaining.data(), static_cast<int>(remaining.size()));
+
+		uint32_t layer = static_cast<uint32_t>(layerPixels.size());
+		layerPixels.push_back(std::vector<uint8_t>(static_cast<size_t>(layerSize) * layerSize * 4, 0));
+		std::vector<uint8_t>& pixels = layerPixels.back();
+
+		std::vector<stbrp_rect> unpacked;
+		for (size_t i = 0; i < remaining.size(); i++) {
+			if (!remaining[i].was_packed) {
+				unpacked.push_back(remaining[i]);
+				continue;
+			}
+
+			AtlasEntry& entry = entries[remaining[i].id];
+			uint32_t rectX = remaining[i].x * gutter;
+			uint32_t rectY = remaining[i].y * gutter;
+			uint32_t rectWidth = remaining[i].w * gutter;
+			uint32_t rectHeight = remaining[i].h * gutter;
+
+			//Copy the entry into the layer, the gutter and alignment padding repeat the nearest edge pixel
+			for (uint32_t y = 0; y < rectHeight; y++) {
+				uint32_t sourceY = static_cast<uint32_t>(glm::clamp(static_cast<int>(y) - static_cast<int>(gutter), 0, static_cast<int>(entry.height) - 1));
+
+				for (uint32_t x = 0; x < rectWidth; x++) {
+					uint32_t sourceX = static_cast<uint32_t>(glm::clamp(static_cast<int>(x) - static_cast<int>(gutter), 0, static_cast<int>(entry.width) - 1));
+
+					memcpy(&pixels[((static_cast<size_t>(rectY) + y) * layerSize + rectX + x) * 4], &entry.pixels[(static_cast<size_t>(sourceY) * entry.width + sourceX) * 4], 4);
+				}
+			}
+
+			AtlasRegion& region = regions[remaining[i].id];
+			region.layer = layer;
+			region.uvOffset = glm::vec2(rectX + gutter, rectY + gutter) / static_cast<float>(layerSize);
+			region.uvScale = glm::vec2(entry.width, entry.height) / static_cast<float>(layerSize);
+		}
+
+		if (unpacked.size() == remaining.size()) {
+			throw std::runtime_error("Failed to pack texture atlas!");
+		}
+
+		remaining = unpacked;
+	}
+
+	layerCount = static_cast<uint32_t>(layerPixels.size());
+
+	//Only build the levels that the gutter protects
+	std::vector<std::vector<std::vector<uint8_t>>> layers(layerCount);
+	for (uint32_t i = 0; i < layerCount; i++) {
+		layers[i] = Texture::GenerateMipChain(layerPixels[i].data(), layerSize, layerSize, mipLevels);
+		layerPixels[i].clear();
+	}
+
+	Upload(layers);
+
+	//The source pixels are now on the GPU
+	entries.clear();
+	entries.shrink_to_fit();
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+void TextureAtlas::Upload(const std::vector<std::vector<std::vector<uint8_t>>>& layers)
+{
+	VkDeviceSize stagingSize = 0;
+	for (size_t layer = 0; layer < layers.size(); layer++) {
+		for (size_t level = 0; level < layers[layer].size(); level++) {
+			stagingSize += layers[layer][level].size();
+		}
+	}
+
+	Buffer stagingBuffer;
+	Buffer::CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
+
+	void* data;
+	vkMapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory(), 0, stagingSize, 0, &data);
+
+	std::vector<VkBufferImageCopy> copyRegions;
+	VkDeviceSize offset = 0;
+
+	for (uint32_t layer = 0; layer < layers.size(); layer++) {
+		for (uint32_t level = 0; level < layers[layer].size(); level++) {
+			memcpy(static_cast<uint8_t*>(data) + offset, layers[layer][level].data(), layers[layer][level].size());
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = layer;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { std::max(layerSize >> level, 1u), std::max(layerSize >> level, 1u), 1 };
+
+			copyRegions.push_back(region);
+			offset += layers[layer][level].size();
+		}
+	}
+
+	vkUnmapMemory(TriangleApp::logicalDevice, stagingBuffer.GetBufferMemory());
+
+	Image::CreateImage(layerSize, layerSize, mipLevels, VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MemoryCategory::Textures,
+		image, layerCount);
+
+	Image::TransitionImageLayout(image.GetImage(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, layerCount);
+
+	VkCommandBuffer commandBuffer = Command::BeginSingleTimeCommand();
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.GetBuffer(), image.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+	Command::EndSingleTimeCommand(commandBuffer);
+
+	Image::TransitionImageLayout(image.GetImage(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels, layerCount);
+
+	stagingBuffer.Cleanup();
+
+	//Always use an array view so shaders can sample it the same way no matter how many layers were needed
+	imageView = Image::CreateImageView(image.GetImage(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, VK_IMAGE_VIEW_TYPE_2D_ARRAY, layerCount);
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+AtlasRegion TextureAtlas::GetRegion(uint32_t id)
+{
+	return regions[id];
+}
+
+uint32_t TextureAtlas::GetRegionCount()
+{
+	return static_cast<uint32_t>(regions.size());
+}
+
+VkImageView TextureAtlas::GetImageView()
+{
+	return imageView;
+}
+
+uint32_t TextureAtlas::GetLayerCount()
+{
+	return layerCount;
+}
+
+uint32_t TextureAtlas::GetMipLevels()
+{
+	return mipLevels;
+}
+
+#pragma endregion
\ No newline at end of file
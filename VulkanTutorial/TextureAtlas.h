@@ -0,0 +1,118 @@
+#pragma once
+
+#include "pch.h"
+#include "Image.h"
+
+struct AtlasRegion {
+	uint32_t layer;
+	glm::vec2 uvOffset;
+	glm::vec2 uvScale;
+};
+
+class TextureAtlas
+{
+private:
+	struct AtlasEntry {
+		std::vector<uint8_t> pixels;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	uint32_t layerSize;
+	uint32_t gutter;
+	uint32_t mipLevels;
+	uint32_t layerCount;
+
+	std::vector<AtlasEntry> entries;
+	std::vector<AtlasRegion> regions;
+
+	Image image;
+	VkImageView imageView;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Uploads every layer and its mip levels to the atlas image
+	/// </summary>
+	/// <param name="layers">The mip chain of each layer</param>
+	void Upload(const std::vector<std::vector<std::vector<uint8_t>>>& layers);
+
+#pragma endregion
+
+public:
+#pragma region Constructor
+
+	/// <summary>
+	/// Creates an empty atlas
+	/// </summary>
+	/// <param name="layerSize">The width and height of each array layer in pixels</param>
+	/// <param name="gutter">The border of repeated edge pixels around each entry, rounded up to a power of two. Entries are aligned to this size so mip levels up to log2(gutter) never bleed</param>
+	TextureAtlas(uint32_t layerSize = 2048, uint32_t gutter = 4);
+
+	/// <summary>
+	/// Destroys the atlas image and frees any entries that have not been built
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Building
+
+	/// <summary>
+	/// Loads an image file and adds it to the atlas
+	/// </summary>
+	/// <param name="filePath">The path of the image to add</param>
+	/// <returns>The id used to look up the entry's region once the atlas is built</returns>
+	uint32_t AddFromFile(const std::string& filePath);
+
+	/// <summary>
+	/// Adds RGBA8 pixels to the atlas
+	/// </summary>
+	/// <param name="pixels">The RGBA8 pixels to add</param>
+	/// <param name="width">The width of the image</param>
+	/// <param name="height">The height of the image</param>
+	/// <returns>The id used to look up the entry's region once the atlas is built</returns>
+	uint32_t AddFromPixels(const uint8_t* pixels, uint32_t width, uint32_t height);
+
+	/// <summary>
+	/// Packs every added entry into as few array layers as possible and uploads the atlas to the GPU
+	/// </summary>
+	void Build();
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the layer and uv transform of an entry in the built atlas
+	/// </summary>
+	/// <param name="id">The id returned when the entry was added</param>
+	/// <returns>The entry's region</returns>
+	AtlasRegion GetRegion(uint32_t id);
+
+	/// <summary>
+	/// Returns the number of entries in the atlas
+	/// </summary>
+	/// <returns>The entry count</returns>
+	uint32_t GetRegionCount();
+
+	/// <summary>
+	/// Returns the 2D array view of the atlas
+	/// </summary>
+	/// <returns>The atlas image view</returns>
+	VkImageView GetImageView();
+
+	/// <summary>
+	/// Returns the number of array layers the entries were packed into
+	/// </summary>
+	/// <returns>The layer count</returns>
+	uint32_t GetLayerCount();
+
+	/// <summary>
+	/// Returns the number of mip levels that can be sampled without bleeding between entries
+	/// </summary>
+	/// <returns>The mip level count</returns>
+	uint32_t GetMipLevels();
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "TextureBaker.h"
+
+#include "Texture.h"
+#include "TextureFile.h"
+
+#include <fstream>
+#include <thread>
+
+#include <stb/stb_image.h>
+#define STB_DXT_IMPLEMENTATION
+#include <stb/stb_dxt.h>
+
+#pragma region Baking
+
+void TextureBaker::Bake(const std::string& inputPath, const std::string& outputPath, TextureCompression compression, uint32_t threadCount)
+{
+	int textureWidth, textureHeight, textureChannels;
+	stbi_uc* pixels = stbi_load(inputPath.c_str(), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+
+	if (!pixels) {
+		throw std::runtime_error("Failed to load image!");
+	}
+
+	uint32_t width = static_cast<uint32_t>(textureWidth);
+	uint32_t height = static_cast<uint32_t>(textureHeight);
+
+	//Pick the smallest format that keeps the channels the image actually uses
+	if (compression == TextureCompression::Auto) {
+		switch (textureChannels) {
+		case 1:
+			compression = TextureCompression::BC4;
+			break;
+		case 2:
+			compression = TextureCompression::BC5;
+			break;
+		case 3:
+			compression = TextureCompression::BC1;
+			break;
+		default:
+			compression = TextureCompression::BC1;
+
+			for (size_t i = 3; i < static_cast<size_t>(width) * height * 4; i += 4) {
+				if (pixels[i] != 255) {
+					compression = TextureCompression::BC3;
+					break;
+				}
+			}
+			break;
+		}
+	}
+
+	//Grey and alpha images are expanded to RGBA by stb_image so move alpha into green for BC5
+	if (compression == TextureCompression::BC5 && textureChannels == 2) {
+		for (size_t i = 0; i < static_cast<size_t>(width) * height * 4; i += 4) {
+			pixels[i + 1] = pixels[i + 3];
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> mipChain = Texture::GenerateMipChain(pixels, width, height);
+	stbi_image_free(pixels);
+
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	std::vector<std::vector<uint8_t>> levels(mipChain.size());
+	for (size_t i = 0; i < mipChain.size(); i++) {
+		uint32_t levelWidth = std::max(width >> i, 1u);
+		uint32_t levelHeight = std::max(height >> i, 1u);
+
+		levels[i] = CompressLevel(mipChain[i].data(), levelWidth, levelHeight, compression, threadCount);
+	}
+
+	//Level data starts after the header and level table, each level is aligned to 16 bytes
+	TextureFileHeader header = TextureFileHeader::Create(GetFormat(compression), width, height, static_cast<uint32_t>(levels.size()));
+	std::vector<TextureFileLevel> levelTable(levels.size());
+
+	uint64_t offset = sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * levelTable.size();
+	for (size_t i = 0; i < levels.size(); i++) {
+		offset = (offset + 15) & ~static_cast<uint64_t>(15);
+
+		levelTable[i].offset = offset;
+		levelTable[i].size = levels[i].size();
+
+		offset += levels[i].size();
+	}
+
+	std::ofstream file(outputPath, std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open texture file for writing!");
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(TextureFileHeader));
+	file.write(reinterpret_cast<const char*>(levelTable.data()), sizeof(TextureFileLevel) * levelTable.size());
+
+	const char padding[16] = {};
+	for (size_t i = 0; i < levels.size(); i++) {
+		file.write(padding, static_cast<std::streamsize>(levelTable[i].offset - static_cast<uint64_t>(file.tellp())));
+		file.write(reinterpret_cast<const char*>(levels[i].data()), static_cast<std::streamsize>(levels[i].size()));
+	}
+
+	if (!file) {
+		throw std::runtime_error("Failed to write texture file!");
+	}
+}
+
+std::vector<uint8_t> TextureBaker::CompressLevel(const uint8_t* pixels, uint32_t width, uint32_t height, TextureCompression compression, uint32_t threadCount)
+{
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+	uint32_t blockSize = GetBlockSize(GetFormat(compression));
+
+	std::vector<uint8_t> blocks(static_cast<size_t>(blocksWide) * blocksHigh * blockSize);
+
+	//Each thread compresses its own range of block rows
+	auto compressRows = [&](uint32_t firstRow, uint32_t lastRow) {
+		uint8_t rgba[64];
+		uint8_t channels[32];
+
+		for (uint32_t blockY = firstRow; blockY < lastRow; blockY++) {
+			for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+				//Gather the 4x4 block, edge pixels are repeated when the image is not a multiple of 4
+				for (uint32_t y = 0; y < 4; y++) {
+					for (uint32_t x = 0; x < 4; x++) {
+						uint32_t pixelX = std::min(blockX * 4 + x, width - 1);
+						uint32_t pixelY = std::min(blockY * 4 + y, height - 1);
+
+						memcpy(&rgba[(y * 4 + x) * 4], &pixels[(static_cast<size_t>(pixelY) * width + pixelX) * 4], 4);
+					}
+				}
+
+				uint8_t* destination = &blocks[(static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize];
+
+				switch (compression) {
+				case TextureCompression::BC1:
+					stb_compress_dxt_block(destination, rgba, 0, STB_DXT_HIGHQUAL);
+					break;
+				case TextureCompression::BC3:
+					stb_compress_dxt_block(destination, rgba, 1, STB_DXT_HIGHQUAL);
+					break;
+				case TextureCompression::BC4:
+					for (uint32_t i = 0; i < 16; i++) {
+						channels[i] = rgba[i * 4];
+					}
+					stb_compress_bc4_block(destination, channels);
+					break;
+				case TextureCompression::BC5:
+					for (uint32_t i = 0; i < 16; i++) {
+						channels[i * 2] = rgba[i * 4];
+						channels[i * 2 + 1] = rgba[i * 4 + 1];
+					}
+					stb_compress_bc5_block(destination, channels);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	};
+
+	threadCount = std::max(std::min(threadCount, blocksHigh), 1u);
+	uint32_t rowsPerThread = (blocksHigh + threadCount - 1) / threadCount;
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		uint32_t firstRow = std::min(i * rowsPerThread, blocksHigh);
+		uint32_t lastRow = std::min(firstRow + rowsPerThread, blocksHigh);
+
+		threads.push_back(std::thread(compressRows, firstRow, lastRow));
+	}
+
+	//The calling thread takes the first range
+	compressRows(0, std::min(rowsPerThread, blocksHigh));
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	return blocks;
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+VkFormat TextureBaker::GetFormat(TextureCompression compression)
+{
+	switch (compression) {
+	case TextureCompression::BC1:
+		return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case TextureCompression::BC3:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	case TextureCompression::BC4:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case TextureCompression::BC5:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	default:
+		throw std::runtime_error("Texture compression has no matching format!");
+	}
+}
+
+TextureCompression TextureBaker::ParseCompression(const std::string& value)
+{
+	if (value == "bc1") {
+		return TextureCompression::BC1;
+	}
+	else if (value == "bc3") {
+		return TextureCompression::BC3;
+	}
+	else if (value == "bc4") {
+		return TextureCompression::BC4;
+	}
+	else if (value == "bc5") {
+		return TextureCompression::BC5;
+	}
+	else if (value == "auto") {
+		return TextureCompression::Auto;
+	}
+
+	throw std::runtime_error("Unknown texture compression: " + value);
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.h"
+
+enum class TextureCompression {
+	Auto,
+	BC1,
+	BC3,
+	BC4,
+	BC5
+};
+
+class TextureBaker
+{
+public:
+#pragma region Baking
+
+	/// <summary>
+	/// Loads an image, builds its mip chain, block compresses every level and writes the result to a .vtex file
+	/// </summary>
+	/// <param name="inputPath">The path of the image to bake</param>
+	/// <param name="outputPath">The path of the .vtex file to write</param>
+	/// <param name="compression">The block format to compress to, Auto picks one based on the image's channels</param>
+	/// <param name="threadCount">The number of threads used to compress each level, 0 uses every hardware thread</param>
+	static void Bake(const std::string& inputPath, const std::string& outputPath, TextureCompression compression = TextureCompression::Auto, uint32_t threadCount = 0);
+
+	/// <summary>
+	/// Block compresses a single RGBA8 image
+	/// </summary>
+	/// <param name="pixels">The RGBA8 pixels to compress</param>
+	/// <param name="width">The width of the image</param>
+	/// <param name="height">The height of the image</param>
+	/// <param name="compression">The block format to compress to, must not be Auto</param>
+	/// <param name="threadCount">The number of threads to split the rows of blocks between</param>
+	/// <returns>The compressed blocks in row order</returns>
+	static std::vector<uint8_t> CompressLevel(const uint8_t* pixels, uint32_t width, uint32_t height, TextureCompression compression, uint32_t threadCount);
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Returns the Vulkan format that matches a compression mode
+	/// </summary>
+	/// <param name="compression">The compression mode, must not be Auto</param>
+	/// <returns>The matching block compressed format</returns>
+	static VkFormat GetFormat(TextureCompression compression);
+
+	/// <summary>
+	/// Parses a compression mode from a command line argument
+	/// </summary>
+	/// <param name="value">One of auto, bc1, bc3, bc4 or bc5</param>
+	/// <returns>The parsed compression mode</returns>
+	static TextureCompression ParseCompression(const std::string& value);
+
+#pragma endregion
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pch.h"
+
+//Layout of a baked texture file: header, one level entry per mip, then the level data
+//Level data is stored exactly as it is uploaded so the loader never has to decode it
+struct TextureFileHeader {
+	char identifier[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+
+	static const uint32_t CURRENT_VERSION = 1;
+
+	static TextureFileHeader Create(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+		TextureFileHeader header = {};
+		header.identifier[0] = 'V';
+		header.identifier[1] = 'T';
+		header.identifier[2] = 'E';
+		header.identifier[3] = 'X';
+		header.version = CURRENT_VERSION;
+		header.format = static_cast<uint32_t>(format);
+		header.width = width;
+		header.height = height;
+		header.mipLevels = mipLevels;
+
+		return header;
+	}
+
+	bool IsValid() {
+		return identifier[0] == 'V' && identifier[1] == 'T' && identifier[2] == 'E' && identifier[3] == 'X' && version == CURRENT_VERSION;
+	}
+};
+
+struct TextureFileLevel {
+	uint64_t offset;
+	uint64_t size;
+};
+
+//Returns the size in bytes of a 4x4 block for block compressed formats or 0 for uncompressed formats
+inline uint32_t GetBlockSize(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+
+#pragma region Constructor
+
+TextureStreamer::TextureStreamer(VkDeviceSize budget, uint32_t maxUploadsPerFrame)
+{
+	this->budget = budget;
+	this->maxUploadsPerFrame = maxUploadsPerFrame;
+}
+
+void TextureStreamer::Cleanup()
+{
+	for (size_t i = 0; i < textures.size(); i++) {
+		textures[i]->Cleanup();
+	}
+
+	textures.clear();
+}
+
+#pragma endregion
+
+#pragma region Streaming
+
+std::shared_ptr<Texture> TextureStreamer::Load(const std::string& filePath)
+{
+	std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+	texture->LoadFromFile(filePath, true);
+
+	textures.push_back(texture);
+
+	return texture;
+}
+
+void TextureStreamer::Add(std::shared_ptr<Texture> texture)
+{
+	textures.push_back(texture);
+}
+
+void TextureStreamer::Update(uint64_t frame, TextureUploadBatch& batch)
+{
+	//Bring the resident size back under the budget before streaming anything new
+	if (GetResidentSize() > budget) {
+		Evict(GetResidentSize() - budget, UINT64_MAX, batch);
+	}
+
+	//Most recently sampled textures get their uploads first
+	std::vector<std::shared_ptr<Texture>> sorted = textures;
+	std::sort(sorted.begin(), sorted.end(), [](const std::shared_ptr<Texture>& a, const std::shared_ptr<Texture>& b) {
+		return a->GetLastUsedFrame() > b->GetLastUsedFrame();
+	});
+
+	uint32_t uploads = 0;
+
+	//Stream in one level per texture at a time so coarse levels fill in everywhere before fine ones
+	for (size_t i = 0; i < sorted.size() && uploads < maxUploadsPerFrame; i++) {
+		std::shared_ptr<Texture> texture = sorted[i];
+
+		//The list is sorted so every texture after an idle one is idle too
+		if (texture->GetLastUsedFrame() + IDLE_FRAMES < frame) {
+			break;
+		}
+
+		if (texture->GetResidentMip() == 0) {
+			continue;
+		}
+
+		VkDeviceSize levelSize = texture->GetLevelSize(texture->GetResidentMip() - 1);
+		VkDeviceSize residentSize = GetResidentSize();
+
+		//Only textures that were sampled less recently can give up space
+		if (residentSize + levelSize > budget && !Evict(residentSize + levelSize - budget, texture->GetLastUsedFrame(), batch)) {
+			break;
+		}
+
+		texture->SetResidentMip(texture->GetResidentMip() - 1, batch);
+		uploads++;
+	}
+}
+
+#pragma endregion
+
+#pragma region Helper Methods
+
+bool TextureStreamer::Evict(VkDeviceSize requiredSize, uint64_t frame, TextureUploadBatch& batch)
+{
+	//Least recently sampled textures are evicted first
+	std::vector<std::shared_ptr<Texture>> sorted = textures;
+	std::sort(sorted.begin(), sorted.end(), [](const std::shared_ptr<Texture>& a, const std::shared_ptr<Texture>& b) {
+		return a->GetLastUsedFrame() < b->GetLastUsedFrame();
+	});
+
+	VkDeviceSize freedSize = 0;
+
+	for (size_t i = 0; i < sorted.size() && freedSize < requiredSize; i++) {
+		std::shared_ptr<Texture> texture = sorted[i];
+
+		if (texture->GetLastUsedFrame() >= frame) {
+			break;
+		}
+
+		//Drop the finest levels but never the mip tail, the image is only recreated once for all of them
+		uint32_t level = texture->GetResidentMip();
+		while (freedSize < requiredSize && level < texture->GetTailMip()) {
+			freedSize += texture->GetLevelSize(level);
+			level++;
+		}
+
+		texture->SetResidentMip(level, batch);
+	}
+
+	return freedSize >= requiredSize;
+}
+
+#pragma endregion
+
+#pragma region Accessors
+
+VkDeviceSize TextureStreamer::GetBudget()
+{
+	return budget;
+}
+
+void TextureStreamer::SetBudget(VkDeviceSize value)
+{
+	budget = value;
+}
+
+uint32_t TextureStreamer::GetMaxUploadsPerFrame()
+{
+	return maxUploadsPerFrame;
+}
+
+void TextureStreamer::SetMaxUploadsPerFrame(uint32_t value)
+{
+	maxUploadsPerFrame = value;
+}
+
+VkDeviceSize TextureStreamer::GetResidentSize()
+{
+	VkDeviceSize size = 0;
+
+	for (size_t i = 0; i < textures.size(); i++) {
+		size += textures[i]->GetResidentSize();
+	}
+
+	return size;
+}
+
+std::vector<std::shared_ptr<Texture>> TextureStreamer::GetTextures()
+{
+	return textures;
+}
+
+#pragma endregion
\ No newline at end of file
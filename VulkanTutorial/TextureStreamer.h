@@ -0,0 +1,105 @@
+#pragma once
+
+#include "pch.h"
+#include "Texture.h"
+
+class TextureStreamer
+{
+private:
+	std::vector<std::shared_ptr<Texture>> textures;
+
+	VkDeviceSize budget;
+	uint32_t maxUploadsPerFrame;
+
+#pragma region Helper Methods
+
+	/// <summary>
+	/// Evicts the finest resident level of the least recently sampled textures until the requested space is free
+	/// </summary>
+	/// <param name="requiredSize">The number of bytes that need to fit in the budget</param>
+	/// <param name="frame">Textures sampled on or after this frame will not be evicted</param>
+	/// <param name="batch">The frame's uploads the shrunk images are recorded into</param>
+	/// <returns>True if enough space was freed</returns>
+	bool Evict(VkDeviceSize requiredSize, uint64_t frame, TextureUploadBatch& batch);
+
+#pragma endregion
+
+public:
+	//Textures that haven't been sampled for this many frames stop streaming in finer levels
+	static const uint64_t IDLE_FRAMES = 120;
+
+#pragma region Constructor
+
+	TextureStreamer(VkDeviceSize budget = 256 * 1024 * 1024, uint32_t maxUploadsPerFrame = 2);
+
+	/// <summary>
+	/// Cleans up every texture managed by the streamer
+	/// </summary>
+	void Cleanup();
+
+#pragma endregion
+
+#pragma region Streaming
+
+	/// <summary>
+	/// Loads a streamed texture and starts managing its residency, only the mip tail is uploaded immediately
+	/// </summary>
+	/// <param name="filePath">The path of the image to load</param>
+	/// <returns>The loaded texture</returns>
+	std::shared_ptr<Texture> Load(const std::string& filePath);
+
+	/// <summary>
+	/// Starts managing the residency of a texture that was loaded elsewhere with streaming enabled
+	/// </summary>
+	/// <param name="texture">The loaded texture</param>
+	void Add(std::shared_ptr<Texture> texture);
+
+	/// <summary>
+	/// Streams in the next finest level of recently sampled textures and evicts levels that no longer fit in the budget
+	/// </summary>
+	/// <param name="frame">The current frame, textures not sampled within IDLE_FRAMES of it are left as they are</param>
+	/// <param name="batch">The frame's uploads, every residency change is recorded into it</param>
+	void Update(uint64_t frame, TextureUploadBatch& batch);
+
+#pragma endregion
+
+#pragma region Accessors
+
+	/// <summary>
+	/// Returns the amount of device memory textures are allowed to use
+	/// </summary>
+	/// <returns>The budget in bytes</returns>
+	VkDeviceSize GetBudget();
+
+	/// <summary>
+	/// Sets the amount of device memory textures are allowed to use, levels are evicted on the next update if the new budget is smaller
+	/// </summary>
+	/// <param name="value">The budget in bytes</param>
+	void SetBudget(VkDeviceSize value);
+
+	/// <summary>
+	/// Returns the maximum number of mip levels that will be streamed in each frame
+	/// </summary>
+	/// <returns>The maximum uploads per frame</returns>
+	uint32_t GetMaxUploadsPerFrame();
+
+	/// <summary>
+	/// Sets the maximum number of mip levels that will be streamed in each frame
+	/// </summary>
+	/// <param name="value">The maximum uploads per frame</param>
+	void SetMaxUploadsPerFrame(uint32_t value);
+
+	/// <summary>
+	/// Returns the amount of device memory currently used by streamed textures
+	/// </summary>
+	/// <returns>The resident size in bytes</returns>
+	VkDeviceSize GetResidentSize();
+
+	/// <summary>
+	/// Returns the textures managed by the streamer
+	/// </summary>
+	/// <returns>The list of streamed textures</returns>
+	std::vector<std::shared_ptr<Texture>> GetTextures();
+
+#pragma endregion
+};
\ No newline at end of file
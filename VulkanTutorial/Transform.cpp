@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Transform.h"
+#include "SceneGraph.h"
 #include <glm/gtx/quaternion.hpp>
 
 #pragma region Constructor
@@ -14,7 +15,11 @@ Transform::Transform(glm::vec3 postition, glm::quat orientation, glm::vec3 scale
 	//Generate model matrix
 	model = {};
 	isDirty = true;
+	version = 0;
 	GenerateModelMatrix();
+
+	sceneGraph = nullptr;
+	sceneNode = SceneGraph::INVALID_NODE;
 }
 
 #pragma endregion
@@ -30,8 +35,8 @@ void Transform::SetPosition(glm::vec3 value)
 {
 	position = value;
 
-	//Mark model matrix for regeneration
-	isDirty = true;
+	//Mark the model matrix for regeneration
+	MarkDirty();
 }
 
 glm::quat Transform::GetOrientation()
@@ -44,7 +49,7 @@ void Transform::SetOrientation(glm::quat value)
 	orientation = value;
 
 	//Mark the model matrix for regeneration
-	isDirty = true;
+	MarkDirty();
 }
 
 void Transform::SetOrientation(glm::vec3 value, bool degrees)
@@ -56,7 +61,7 @@ void Transform::SetOrientation(glm::vec3 value, bool degrees)
 	orientation = glm::quat(value);
 
 	//Mark the model matrix for regeneration
-	isDirty = true;
+	MarkDirty();
 }
 
 glm::vec3 Transform::GetScale()
@@ -69,10 +74,19 @@ void Transform::SetScale(glm::vec3 value)
 	scale = value;
 
 	//Mark the model matrix for regeneration
-	isDirty = true;
+	MarkDirty();
 }
 
 glm::mat4 Transform::GetModelMatrix()
+{
+	if (sceneGraph != nullptr) {
+		return sceneGraph->GetWorldMatrix(sceneNode);
+	}
+
+	return GetLocalMatrix();
+}
+
+glm::mat4 Transform::GetLocalMatrix()
 {
 	//Generate the model matrix if it has been changed
 	if (isDirty) {
@@ -82,6 +96,25 @@ glm::mat4 Transform::GetModelMatrix()
 	return model;
 }
 
+uint64_t Transform::GetVersion()
+{
+	return version;
+}
+
+uint64_t Transform::GetWorldVersion()
+{
+	if (sceneGraph != nullptr) {
+		return sceneGraph->GetWorldVersion(sceneNode);
+	}
+
+	return version;
+}
+
+uint32_t Transform::GetSceneNode()
+{
+	return sceneNode;
+}
+
 #pragma endregion
 
 #pragma region Transformations
@@ -97,7 +130,7 @@ void Transform::Translate(glm::vec3 translation, bool localSpace)
 	position += translation;
 
 	//Mark the model matrix for regeneration
-	isDirty = true;
+	MarkDirty();
 }
 
 void Transform::Rotate(glm::quat rotation)
@@ -105,7 +138,7 @@ void Transform::Rotate(glm::quat rotation)
 	orientation = rotation * orientation;
 
 	//Mark the model matrix for regeneration
-	isDirty = true;
+	MarkDirty();
 }
 
 void Transform::Rotate(glm::vec3 eulerRotation, bool degrees)
@@ -127,6 +160,19 @@ void Transform::LookAt(glm::vec3 target, glm::vec3 up)
 	direction /= length;
 
 	orientation = glm::quatLookAt(direction, up);
+
+	//Mark the model matrix for regeneration
+	MarkDirty();
+}
+
+#pragma endregion
+
+#pragma region Change Tracking
+
+void Transform::MarkDirty()
+{
+	isDirty = true;
+	version++;
 }
 
 #pragma endregion
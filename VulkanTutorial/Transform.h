@@ -2,8 +2,12 @@
 
 #include "pch.h"
 
+class SceneGraph;
+
 class Transform
 {
+	friend class SceneGraph;
+
 private:
 
 	glm::vec3 position;
@@ -12,6 +16,20 @@ private:
 
 	glm::mat4 model;
 	bool isDirty; //Keeps track of whether position rotation or scale have changed to know when to regenerate the model matrix
+	uint64_t version; //Incremented whenever position rotation or scale change so observers can tell when to update
+
+	//The scene this transform is a node of, set by the scene graph
+	SceneGraph* sceneGraph;
+	uint32_t sceneNode;
+
+#pragma region Change Tracking
+
+	/// <summary>
+	/// Marks the model matrix for regeneration and bumps the version
+	/// </summary>
+	void MarkDirty();
+
+#pragma endregion
 
 #pragma region Model Matrix
 
@@ -76,11 +94,33 @@ public:
 	void SetScale(glm::vec3 value);
 
 	/// <summary>
-	/// Returns the model matrix of the transform and updates it if necessary
+	/// Returns the model matrix of the transform, the world matrix from the last scene update if it is part of a scene
 	/// </summary>
 	/// <returns>The updated mat4 model matrix</returns>
 	glm::mat4 GetModelMatrix();
 
+	/// <summary>
+	/// Returns the matrix built from this transform's own position rotation and scale and updates it if necessary
+	/// </summary>
+	/// <returns>The mat4 local matrix</returns>
+	glm::mat4 GetLocalMatrix();
+
+	/// <summary>
+	/// Returns a version that changes every time the position rotation or scale do
+	/// </summary>
+	uint64_t GetVersion();
+
+	/// <summary>
+	/// Returns a version that changes every time the model matrix does, including when a parent moves
+	/// </summary>
+	uint64_t GetWorldVersion();
+
+	/// <summary>
+	/// Returns the scene node this transform belongs to
+	/// </summary>
+	/// <returns>The node id or SceneGraph::INVALID_NODE if it isn't part of a scene</returns>
+	uint32_t GetSceneNode();
+
 #pragma endregion
 
 #pragma region Transformations
@@ -1,7 +1,22 @@
 #pragma once
 
 #include "pch.h"
+#include <glm/gtc/packing.hpp>
+#include <limits>
 
+//Layouts an instance's model matrix can be uploaded in, the vertex shaders rebuild the matrix from the INSTANCE_FORMAT specialization constant
+enum class InstanceFormat : uint32_t {
+	//The full matrix, 64 bytes
+	Matrix4x4 = 0,
+	//The top three rows, the last row of an affine transform is always (0, 0, 0, 1), 48 bytes
+	Affine3x4 = 1,
+	//Position, uniform scale and a rotation quaternion, 32 bytes, shear and non-uniform scale are lost
+	PositionRotationScale = 2,
+	//The same with the quaternion stored as half floats, positions stay full precision so distant instances don't snap, 24 bytes
+	PositionRotationScaleHalf = 3
+};
+
+static const uint32_t INSTANCE_FORMAT_COUNT = 4;
 
 struct TransformData {
 	glm::vec4 col1;
@@ -9,10 +24,13 @@ struct TransformData {
 	glm::vec4 col3;
 	glm::vec4 col4;
 
-	static VkVertexInputBindingDescription getBindingDescription() {
+	//The largest instance layout, buffers shared by every format are sized for it
+	static const uint32_t MAX_STRIDE = 64;
+
+	static VkVertexInputBindingDescription getBindingDescription(InstanceFormat format = InstanceFormat::Matrix4x4) {
 		VkVertexInputBindingDescription bindingDescription = {};
 		bindingDescription.binding = 1;
-		bindingDescription.stride = sizeof(TransformData);
+		bindingDescription.stride = GetStride(format);
 		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
 		return bindingDescription;
@@ -44,6 +62,102 @@ struct TransformData {
 		return attributeDescriptions;
 	}
 
+	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions(InstanceFormat format) {
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = getAttributeDescriptions();
+
+		if (format == InstanceFormat::Matrix4x4) {
+			return attributeDescriptions;
+		}
+
+		//The shaders declare all four locations, the ones a format doesn't use read the start of the instance and are ignored
+		for (size_t i = 0; i < attributeDescriptions.size(); i++) {
+			if (i >= GetAttributeCount(format)) {
+				attributeDescriptions[i].offset = 0;
+			}
+		}
+
+		if (format == InstanceFormat::PositionRotationScaleHalf) {
+			attributeDescriptions[1].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		}
+
+		return attributeDescriptions;
+	}
+
+	/// <summary>
+	/// Returns the size of one instance in a format
+	/// </summary>
+	static uint32_t GetStride(InstanceFormat format) {
+		switch (format) {
+		case InstanceFormat::Affine3x4:
+			return sizeof(glm::vec4) * 3;
+		case InstanceFormat::PositionRotationScale:
+			return sizeof(glm::vec4) * 2;
+		case InstanceFormat::PositionRotationScaleHalf:
+			return sizeof(glm::vec4) + sizeof(uint64_t);
+		default:
+			return sizeof(glm::vec4) * 4;
+		}
+	}
+
+	/// <summary>
+	/// Returns the number of vertex attributes a format reads
+	/// </summary>
+	static uint32_t GetAttributeCount(InstanceFormat format) {
+		switch (format) {
+		case InstanceFormat::Affine3x4:
+			return 3;
+		case InstanceFormat::PositionRotationScale:
+		case InstanceFormat::PositionRotationScaleHalf:
+			return 2;
+		default:
+			return 4;
+		}
+	}
+
+	/// <summary>
+	/// Writes a model matrix in a format, the destination must have room for GetStride bytes
+	/// </summary>
+	/// <param name="format">The layout to write</param>
+	/// <param name="value">The model matrix</param>
+	/// <param name="destination">Where to write the instance, it doesn't need to be aligned</param>
+	static void Pack(InstanceFormat format, const glm::mat4& value, void* destination) {
+		if (format == InstanceFormat::Matrix4x4) {
+			memcpy(destination, &value, sizeof(glm::mat4));
+			return;
+		}
+
+		//Rows rather than columns so the translation lands in the w components
+		if (format == InstanceFormat::Affine3x4) {
+			glm::vec4 rows[3];
+			for (int i = 0; i < 3; i++) {
+				rows[i] = glm::vec4(value[0][i], value[1][i], value[2][i], value[3][i]);
+			}
+
+			memcpy(destination, rows, sizeof(rows));
+			return;
+		}
+
+		//Non-uniform scales are rounded up to the largest axis so the instance never shrinks out of its culling bounds
+		glm::vec3 scales(glm::length(glm::vec3(value[0])), glm::length(glm::vec3(value[1])), glm::length(glm::vec3(value[2])));
+		glm::vec3 divisors = glm::max(scales, glm::vec3(std::numeric_limits<float>::min()));
+		glm::mat3 rotationMatrix(glm::vec3(value[0]) / divisors.x, glm::vec3(value[1]) / divisors.y, glm::vec3(value[2]) / divisors.z);
+		glm::quat rotation = glm::normalize(glm::quat_cast(rotationMatrix));
+
+		glm::vec4 positionScale(glm::vec3(value[3]), std::max(scales.x, std::max(scales.y, scales.z)));
+		glm::vec4 quaternion(rotation.x, rotation.y, rotation.z, rotation.w);
+
+		char* bytes = reinterpret_cast<char*>(destination);
+		memcpy(bytes, &positionScale, sizeof(glm::vec4));
+
+		if (format == InstanceFormat::PositionRotationScale) {
+			memcpy(bytes + sizeof(glm::vec4), &quaternion, sizeof(glm::vec4));
+		}
+		else {
+			uint64_t halfQuaternion = glm::packHalf4x16(quaternion);
+			memcpy(bytes + sizeof(glm::vec4), &halfQuaternion, sizeof(uint64_t));
+		}
+	}
+
 	static TransformData LoadMat4(glm::mat4 value) {
 		TransformData data = {};
 		
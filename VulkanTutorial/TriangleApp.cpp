@@ -4,6 +4,12 @@
 #include "Buffer.h"
 #include "Command.h"
 
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <set>
+
 VkPhysicalDevice TriangleApp::physicalDevice = VK_NULL_HANDLE;
 VkDevice TriangleApp::logicalDevice = VK_NULL_HANDLE;
 
@@ -49,6 +55,13 @@ void DestroyDebugUtilsMessengerEXT(
 
 #pragma region Setup
 
+TriangleApp::TriangleApp(int framesInFlight) : MAX_FRAMES_IN_FLIGHT(framesInFlight)
+{
+	if (framesInFlight < 1) {
+		throw std::runtime_error("At least one frame has to be in flight!");
+	}
+}
+
 void TriangleApp::Run()
 {
 	if (enableValidationLayers) {
@@ -61,44 +74,233 @@ void TriangleApp::Run()
 		std::cout << "Setting up Vulkan . . ." << std::endl;
 	}
 
+	CreateScene();
+	CreateCamera(glm::vec3(0.0f, 5.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+
+	//Start reading every file setup needs so the reads overlap with creating the instance and device
+	MountAssetArchive();
+	PreloadAssets();
+
+	InitVulkan();
+
+	//Setup is done with the preloaded files, releasing them lets later loads read fresh copies from disk
+	preloadedAssets.clear();
+
+	if (enableValidationLayers) {
+		std::cout << "Finished Setup" << std::endl;
+	}
+
+	MainLoop();
+	Cleanup();
+
+	delete camera;
+}
+
+BenchmarkResult TriangleApp::RunBenchmark(const BenchmarkConfig& config, uint32_t warmupFrames, uint32_t measuredFrames, std::ostream* memoryLog)
+{
+	benchmarking = true;
+	totalTime = 0.0f;
+
+	InitWindow(false);
+	CreateBenchmarkScene(config);
+
+	//The cull buffers are sized for the demo, larger scenes fall back to the frustum culled draws
+	BenchmarkResult result;
+	result.config = config;
+	occlusionCullingEnabled = config.instanceCount <= occlusionCulling.GetMaxInstances() && config.meshCount <= occlusionCulling.GetMaxMeshes();
+
+	MountAssetArchive();
+	PreloadAssets();
+	InitVulkan();
+	preloadedAssets.clear();
+
+	result.occlusionCulling = occlusionCullingEnabled;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	result.device = deviceProperties.deviceName;
+
+	//Scatter the lights over the grid on a spiral so every run lights the same clusters
+	float extent = camera->GetTransform()->GetPosition().y;
+	lightClusters.ClearLights();
+
+	for (uint32_t i = 0; i < config.lightCount; i++) {
+		float angle = i * 2.39996f;
+		float radius = extent * sqrtf((i + 0.5f) / config.lightCount);
+		lightClusters.AddLight(Light(glm::vec3(cosf(angle) * radius, 1.0f, sinf(angle) * radius), glm::vec3(1.0f, 1.0f, 1.0f), 2.5f));
+	}
+
+	//Every frame advances the animation by the same step so runs are comparable
+	const float FRAME_STEP = 1.0f / 60.0f;
+	std::vector<double> frameTimes;
+	frameTimes.reserve(measuredFrames);
+	uint64_t uploadBytes = 0;
+	uint64_t drawCalls = 0;
+
+	for (uint32_t frame = 0; frame < warmupFrames + measuredFrames && !glfwWindowShouldClose(window); frame++) {
+		glfwPollEvents();
+
+		//Pipelines are compiled and buffers grown during the warmup so only the GPU time of measured frames is kept
+		if (frame == warmupFrames) {
+			gpuFrameTimeTotal = 0.0;
+			gpuFrameTimeSamples = 0;
+			MemoryTelemetry::ResetPeaks();
+		}
+
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+		deltaTime = FRAME_STEP;
+		totalTime += deltaTime;
+
+		Update();
+		DrawFrame();
+
+		if (frame < warmupFrames) {
+			continue;
+		}
+
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+		uploadBytes += frameUploadBytes;
+		drawCalls += frameDrawCalls;
+
+		//The driver's heap usage includes memory the counters can't see, keep the frame where it was highest
+		MemorySnapshot snapshot = MemoryTelemetry::Capture(frameCount);
+		if (snapshot.GetDeviceLocalUsage() > result.heapUsage) {
+			result.heapUsage = snapshot.GetDeviceLocalUsage();
+			result.heapBudget = snapshot.GetDeviceLocalBudget();
+		}
+
+		if (memoryLog != nullptr) {
+			*memoryLog << config.sweep << "," << config.instanceCount << "," << config.meshCount << "," << config.sphereResolution << "," << config.lightCount << "," << config.framesInFlight << "," << frame - warmupFrames << ",";
+			MemoryTelemetry::WriteCSV(*memoryLog, snapshot);
+			*memoryLog << "\n";
+		}
+	}
+
+	//The counters have only been raised since the first measured frame so the peaks cover the measured frames
+	result.deviceMemory = MemoryTelemetry::GetPeakDeviceMemory();
+	result.hostMemory = MemoryTelemetry::GetPeakHostMemory();
+
+	for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+		result.categoryMemory[i] = MemoryTelemetry::GetPeakDeviceMemory(static_cast<MemoryCategory>(i));
+	}
+
+	vkDeviceWaitIdle(logicalDevice);
+
+	result.frames = static_cast<uint32_t>(frameTimes.size());
+
+	if (!frameTimes.empty()) {
+		double frameCount = static_cast<double>(frameTimes.size());
+		for (double frameTime : frameTimes) {
+			result.cpuFrameTime += frameTime;
+		}
+
+		result.cpuFrameTime /= frameCount;
+		result.uploadBytes = uploadBytes / frameCount;
+		result.drawCalls = drawCalls / frameCount;
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+		result.cpuFrameTimeP95 = frameTimes[static_cast<size_t>(ceil(frameCount * 0.95)) - 1];
+	}
+
+	if (gpuFrameTimeSamples > 0) {
+		result.gpuFrameTime = gpuFrameTimeTotal / gpuFrameTimeSamples;
+	}
+
+	Cleanup();
+
+	delete camera;
+
+	return result;
+}
+
+void TriangleApp::CreateScene()
+{
 	//TODO: Remove this once meshes are generated in an init function or loaded from models
 	meshes.resize(2);
 	meshes[0].GenerateCube();
 	meshes[1].GenerateSphere(10);
 
+	//The spheres also fade into fog
+	meshes[0].SetPipelineKey(PipelineKey(PipelineKey::MAX_LIGHTS, SHADER_FEATURE_TEXTURE | SHADER_FEATURE_VERTEX_COLOR, PipelineKey::MAX_QUALITY, false, instanceFormat));
+	meshes[1].SetPipelineKey(PipelineKey(PipelineKey::MAX_LIGHTS, SHADER_FEATURE_TEXTURE | SHADER_FEATURE_VERTEX_COLOR | SHADER_FEATURE_FOG, PipelineKey::MAX_QUALITY, false, instanceFormat));
+
+	std::array<Entity, 9> cubes;
+	std::array<Entity, 9> spheres;
+
 	for (int y = 0; y < 3; y++) {
 		for (int x = 0; x < 3; x++) {
-			meshes[0].AddInstance(std::make_shared<Transform>(glm::vec3(-1.5f + 1.5f * x, 0.0f, -1.5f + 1.5f * y)));
-			meshes[1].AddInstance(std::make_shared<Transform>(glm::vec3(-1.5f + 1.5f * x, 1.0f, -1.5f + 1.5f * y)));
+			cubes[y * 3 + x] = CreateMeshEntity(0, TransformComponent(glm::vec3(-1.5f + 1.5f * x, 0.0f, -1.5f + 1.5f * y)));
+			spheres[y * 3 + x] = CreateMeshEntity(1, TransformComponent(glm::vec3(-1.5f + 1.5f * x, 1.0f, -1.5f + 1.5f * y)));
 		}
 	}
 
-	vertexBuffers.resize(meshes.size());
-	indexBuffers.resize(meshes.size());
+	//One cube spins, the center cube bobs and the sphere above it circles around it
+	float angularSpeed = glm::radians(360.0f) / 7;
+	world.AddComponent(cubes[0], Spin{ glm::vec3(0.875f, 1.75f, 0.875f) * 90.0f });
+	world.AddComponent(cubes[4], Bob{ glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), angularSpeed });
+	world.AddComponent(spheres[4], Orbit{ glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, angularSpeed });
 
-	//Set starting camera values
-	camera = new Camera(glm::vec3(0.0f, 5.0f, 5.0f), glm::quat(glm::vec3(glm::radians(45.0f), 0.0f, 0.0f)), true);
-	camera->GetTransform()->LookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	
-	InitVulkan();
+	//The orbiting sphere follows the bobbing cube, its orbit is relative to the cube
+	sceneGraph.SetParent(world.GetComponent<const RenderProxy>(spheres[4]).transform->GetSceneNode(), world.GetComponent<const RenderProxy>(cubes[4]).transform->GetSceneNode());
+}
 
-	if (enableValidationLayers) {
-		std::cout << "Finished Setup" << std::endl;
+void TriangleApp::CreateBenchmarkScene(const BenchmarkConfig& config)
+{
+	//Cubes and spheres alternate so the sphere resolution changes the cost of half the meshes
+	meshes.resize(config.meshCount);
+
+	for (uint32_t i = 0; i < config.meshCount; i++) {
+		if (i % 2 == 0) {
+			meshes[i].GenerateCube();
+		}
+		else {
+			meshes[i].GenerateSphere(config.sphereResolution);
+		}
+
+		meshes[i].SetPipelineKey(PipelineKey(PipelineKey::MAX_LIGHTS, SHADER_FEATURE_TEXTURE | SHADER_FEATURE_VERTEX_COLOR, PipelineKey::MAX_QUALITY, false, instanceFormat));
 	}
 
-	MainLoop();
-	Cleanup();
+	//A square grid centred on the origin with the meshes taking turns, every instance spins so the whole scene is uploaded each frame
+	const float SPACING = 1.5f;
+	uint32_t gridSize = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(config.instanceCount))));
+	float gridOffset = (gridSize - 1) * SPACING * 0.5f;
 
-	delete camera;
+	for (uint32_t i = 0; i < config.instanceCount; i++) {
+		glm::vec3 position((i % gridSize) * SPACING - gridOffset, 0.0f, (i / gridSize) * SPACING - gridOffset);
+
+		Entity entity = CreateMeshEntity(i % config.meshCount, TransformComponent(position, glm::quat(glm::vec3(0.0f, 0.0f, 0.0f)), glm::vec3(0.5f)));
+		world.AddComponent(entity, Spin{ glm::vec3(0.0f, 90.0f, 0.0f) });
+	}
+
+	//Look down on the grid from far enough back to see all of it
+	float extent = gridOffset + SPACING;
+	CreateCamera(glm::vec3(0.0f, extent, extent), glm::vec3(0.0f, 0.0f, 0.0f), extent * 4.0f);
+}
+
+void TriangleApp::CreateCamera(glm::vec3 position, glm::vec3 target, float farPlane)
+{
+	//Set starting camera values
+	camera = new Camera(position, glm::quat(glm::vec3(glm::radians(45.0f), 0.0f, 0.0f)), true);
+	camera->SetFarPlane(farPlane);
+	camera->GetTransform()->LookAt(target, glm::vec3(0.0f, 1.0f, 0.0f));
+	sceneGraph.AddNode(camera->GetTransform());
+
+	std::shared_ptr<Transform> cameraTransform = camera->GetTransform();
+	world.CreateEntity(
+		TransformComponent(cameraTransform->GetPosition(), cameraTransform->GetOrientation(), cameraTransform->GetScale()),
+		CameraComponent{ camera->GetPerspective(), camera->GetFOV(), camera->GetOrthographicSize(), camera->GetNearPlane(), camera->GetFarPlane() },
+		RenderProxy{ cameraTransform.get(), camera });
 }
 
-void TriangleApp::InitWindow()
+void TriangleApp::InitWindow(bool visible)
 {
 	//Initialize GLFW
 	glfwInit();
 
 	//Prevent GLFW from loading OpenGL
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
 	//Create the window
 	window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan Window", nullptr, nullptr);
@@ -106,6 +308,8 @@ void TriangleApp::InitWindow()
 	//Setup the frame buffer resized callback
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, FrameBufferResizeCallback);
+	glfwSetKeyCallback(window, KeyCallback);
+	glfwSetMouseButtonCallback(window, MouseButtonCallback);
 }
 
 void TriangleApp::InitVulkan()
@@ -133,6 +337,7 @@ void TriangleApp::InitVulkan()
 
 	//Create the render pass
 	CreateRenderPass();
+	CreateLateRenderPass();
 
 	//Create the descriptor set layout
 	CreateDescriptorSetLayout();
@@ -143,8 +348,11 @@ void TriangleApp::InitVulkan()
 	//Create the frame buffers
 	CreateFrameBuffers();
 
-	//Create the graphics pipeline
-	CreateGraphicsPipeline();
+	//Create the pipeline layout
+	CreatePipelineLayout();
+
+	//Load the shaders, pipelines are compiled for each permutation as the command buffers are recorded
+	CreateShaderModules();
 
 	//Create the command pool
 	CreateCommandPool();
@@ -152,38 +360,91 @@ void TriangleApp::InitVulkan()
 	//Create Uniform Buffers
 	CreateUniformBuffers();
 
+	//Create the light cluster pipeline and the per image light buffers
+	CreateLightClusters();
+	lightClusters.CreateResources(uniformBuffers);
+
+	//Create the occlusion culling pipelines and the depth pyramid
+	if (occlusionCullingSupported) {
+		occlusionCulling.SetInstanceFormat(instanceFormat);
+		CreateOcclusionCullingPipelines();
+		occlusionCulling.CreateResources(uniformBuffers, swapChainExtent, depthImageView);
+	}
+
+	//Create the particle pipelines and the particle buffers
+	CreateParticles();
+	particles.CreateResources(static_cast<uint32_t>(swapChainImages.size()));
+
+	//Create the skinning pipeline, the characters and their joint buffers
+	CreateSkinning();
+	skinning.CreateResources(static_cast<uint32_t>(swapChainImages.size()));
+
+	//Create the texture atlas, this has to happen before the vertex buffers are filled
+	CreateTextureAtlas();
+
 	for (size_t i = 0; i < meshes.size(); i++) {
 		//Create the Vertex Buffer
-		CreateVertexBuffer(i);
+		CreateVertexBuffer(meshes[i]);
+
+		//Create the Position Buffer
+		CreatePositionBuffer(meshes[i]);
 
 		//Create the Index Buffer
-		CreateIndexBuffer(i);
+		CreateIndexBuffer(meshes[i]);
 
 		//Create Instance Buffer
-		meshes[i].CreateInstanceBuffer();
+		meshes[i].CreateInstanceBuffer(static_cast<uint32_t>(swapChainImages.size()));
+	}
+
+	//Particles are instanced from the particle system's buffer so the mesh has no instance buffer of its own
+	CreateVertexBuffer(particleMesh);
+	CreatePositionBuffer(particleMesh);
+	CreateIndexBuffer(particleMesh);
+
+	//Skinned characters are drawn from the skinning output so only their indices are needed
+	for (size_t i = 0; i < skinnedMeshes.size(); i++) {
+		CreateIndexBuffer(*skinnedMeshes[i]);
 	}
 
+	//Create the texture image
+	CreateTextureImage();
+
+	//Create the texture sampler
+	CreateTextureSampler();
+
 	//Create the descriptor pool
 	CreateDescriptorPool();
 
 	//Create the descriptor sets
 	CreateDescriptorSets();
 
-	//Create the texture image
-	CreateTextureImage();
-
-	//Create the texture's image view
-	CreateTextureImageView();
+	//Create the pipeline statistics queries
+	CreateQueryPool();
 
 	//Create the Command Buffers
 	CreateCommandBuffers();
 
 	//Create the Semaphores and Fences
 	CreateSyncObjects();
+
+	//Start watching shader sources for changes
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/BasicShader.vert", "shaders/vert.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/BasicShader.frag", "shaders/frag.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/ClusterLights.comp", "shaders/cluster.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/DepthOnly.vert", "shaders/depth.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/OcclusionCull.comp", "shaders/cull.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/HiZReduce.comp", "shaders/hiz.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/ParticleUpdate.comp", "shaders/particles.spv");
+	shaderManager.AddShader(VT_SHADER_SOURCE_DIRECTORY "/SkinVertices.comp", "shaders/skin.spv");
+	shaderManager.Start();
 }
 
 void TriangleApp::Cleanup()
 {
+	//Stop watching shaders and loading assets
+	shaderManager.Stop();
+	assetManager.Cleanup();
+
 	//Destroy Semaphores
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroySemaphore(logicalDevice, imageAvailableSemaphores[i], nullptr);
@@ -194,6 +455,17 @@ void TriangleApp::Cleanup()
 	//Cleanup swap chain and associated resources
 	CleanupSwapChain();
 
+	//Destroy shader modules
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, depthShaderModule, nullptr);
+
+	//Destroy the light cluster, occlusion culling, particle and skinning pipelines
+	lightClusters.Cleanup();
+	occlusionCulling.Cleanup();
+	particles.Cleanup();
+	skinning.Cleanup();
+
 	//Destroy Command Pool
 	vkDestroyCommandPool(logicalDevice, Command::commandPool, nullptr);
 
@@ -201,17 +473,35 @@ void TriangleApp::Cleanup()
 	for (size_t i = 0; i < meshes.size(); i++) {
 		meshes[i].GetInstanceBuffer()->Cleanup();
 	}
+	DestroyRetiredBuffers(true);
+	DestroyRetiredTextures(true);
 
 	//Destroy Descriptor Set Layout
 	vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
 
+	//Cleanup Textures
+	vkDestroySampler(logicalDevice, textureSampler, nullptr);
+	textureAtlas.Cleanup();
+	textureStreamer.Cleanup();
+	texture->Cleanup();
+
 	//Cleanup Buffers
 	for (size_t i = 0; i < meshes.size(); i++) {
 		meshes[i].GetVertexBuffer()->Cleanup();
+		meshes[i].GetPositionBuffer()->Cleanup();
 		meshes[i].GetIndexBuffer()->Cleanup();
 	}
 
+	particleMesh.GetVertexBuffer()->Cleanup();
+	particleMesh.GetPositionBuffer()->Cleanup();
+	particleMesh.GetIndexBuffer()->Cleanup();
+
+	for (size_t i = 0; i < skinnedMeshes.size(); i++) {
+		skinnedMeshes[i]->GetIndexBuffer()->Cleanup();
+	}
+
 	//Destroy Logical Device
+	MemoryTelemetry::Shutdown();
 	vkDestroyDevice(logicalDevice, nullptr);
 
 	//Destroy Debug Utils Messenger if it was created
@@ -239,15 +529,15 @@ void TriangleApp::Cleanup()
 void TriangleApp::MainLoop()
 {
 	//Set starting time values
-	currentTime = std::chrono::high_resolution_clock::now();
-	lastTime = std::chrono::high_resolution_clock::now();
+	currentTime = std::chrono::steady_clock::now();
+	lastTime = std::chrono::steady_clock::now();
 
 	//Loop until the window is closed
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 
 		//Calculate time change per frame
-		currentTime = std::chrono::high_resolution_clock::now();
+		currentTime = std::chrono::steady_clock::now();
 		deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastTime).count();
 		lastTime = currentTime;
 		totalTime += deltaTime;
@@ -261,15 +551,295 @@ void TriangleApp::MainLoop()
 
 void TriangleApp::Update()
 {
-	float scaledTime = (totalTime * glm::radians(360.0f)) / 7;
+	float time = totalTime;
+	float frameTime = deltaTime;
+
+	world.ParallelEach<TransformComponent, const Spin>([frameTime](Entity entity, TransformComponent& transform, const Spin& spin) {
+		transform.orientation = glm::quat(glm::radians(spin.degreesPerSecond * frameTime)) * transform.orientation;
+	});
+
+	world.ParallelEach<TransformComponent, const Bob>([time](Entity entity, TransformComponent& transform, const Bob& bob) {
+		transform.position = bob.origin + bob.offset * sinf(time * bob.angularSpeed);
+	});
+
+	world.ParallelEach<TransformComponent, const Orbit>([time](Entity entity, TransformComponent& transform, const Orbit& orbit) {
+		float angle = time * orbit.angularSpeed;
+		transform.position = orbit.center + glm::vec3(cosf(angle), 0.0f, sinf(angle)) * orbit.radius;
+	});
+
+	SyncRenderProxies();
+
+	//Push the changed transforms down to their children before anything reads a model matrix
+	sceneGraph.UpdateWorldMatrices();
+	UpdateInstanceBVH();
+}
+
+Entity TriangleApp::CreateMeshEntity(uint32_t meshIndex, TransformComponent transform)
+{
+	MemoryScope scope(MemoryCategory::Instances);
+
+	//The mesh draws from a render side copy of the transform that SyncRenderProxies keeps up to date
+	std::shared_ptr<Transform> instance = std::make_shared<Transform>(transform.position, transform.orientation, transform.scale);
+	uint32_t instanceId = meshes[meshIndex].AddInstance(instance);
+	sceneGraph.AddNode(instance);
+
+	return world.CreateEntity(transform, MeshRenderer{ meshIndex, instanceId }, RenderProxy{ instance.get(), nullptr });
+}
+
+void TriangleApp::DestroyMeshEntity(Entity entity)
+{
+	MeshRenderer renderer = world.GetComponent<const MeshRenderer>(entity);
+	RenderProxy proxy = world.GetComponent<const RenderProxy>(entity);
+
+	//The mesh and scene graph hold the last references to the render side transform
+	sceneGraph.RemoveNode(proxy.transform->GetSceneNode());
+	meshes[renderer.meshIndex].RemoveInstance(renderer.instanceId);
+	world.DestroyEntity(entity);
+}
+
+void TriangleApp::SpawnInstances(uint32_t count)
+{
+	//Lay the new cubes out on a spiral around the scene so they stay in view
+	for (uint32_t i = 0; i < count; i++) {
+		float index = static_cast<float>(spawnedEntities.size());
+		float angle = index * 0.5f;
+		float radius = 4.0f + index * 0.02f;
+
+		TransformComponent transform(glm::vec3(cos(angle) * radius, -1.0f, sin(angle) * radius), glm::quat(glm::vec3(0.0f, angle, 0.0f)), glm::vec3(0.25f));
+		spawnedEntities.push_back(CreateMeshEntity(0, transform));
+	}
+}
+
+void TriangleApp::DespawnInstances(uint32_t count)
+{
+	for (uint32_t i = 0; i < count && !spawnedEntities.empty(); i++) {
+		DestroyMeshEntity(spawnedEntities.back());
+		spawnedEntities.pop_back();
+	}
+}
+
+void TriangleApp::SyncRenderProxies()
+{
+	//Only chunks written to since the last sync are visited, unchanged values are skipped so the scene graph doesn't recompute them
+	world.EachChanged<const TransformComponent, const RenderProxy>(lastProxySync, [](Entity entity, const TransformComponent& transform, const RenderProxy& proxy) {
+		if (proxy.transform->GetPosition() != transform.position) {
+			proxy.transform->SetPosition(transform.position);
+		}
+
+		if (proxy.transform->GetOrientation() != transform.orientation) {
+			proxy.transform->SetOrientation(transform.orientation);
+		}
+
+		if (proxy.transform->GetScale() != transform.scale) {
+			proxy.transform->SetScale(transform.scale);
+		}
+	});
+
+	world.EachChanged<const CameraComponent, const RenderProxy>(lastProxySync, [](Entity entity, const CameraComponent& settings, const RenderProxy& proxy) {
+		proxy.camera->SetPerspective(settings.perspective);
+		proxy.camera->SetFOV(settings.FOV, false);
+		proxy.camera->SetOrthographicSize(settings.orthographicSize);
+		proxy.camera->SetNearPlane(settings.nearPlane);
+		proxy.camera->SetFarPlane(settings.farPlane);
+	});
+
+	lastProxySync = world.GetTick();
+}
+
+void TriangleApp::UpdateInstanceBVH()
+{
+	//Any change to the set of instances rebuilds the tree, moved instances only refit it
+	bool rebuild = meshBounds.size() != meshes.size();
+	size_t item = 0;
+
+	for (size_t i = 0; i < meshes.size() && !rebuild; i++) {
+		std::vector<std::shared_ptr<Transform>> instances = meshes[i].GetActiveInstances();
+		std::vector<uint32_t> instanceIds = meshes[i].GetActiveInstanceIds();
+
+		for (size_t j = 0; j < instances.size() && !rebuild; j++, item++) {
+			rebuild = item >= bvhItems.size() || bvhItemTransforms[item] != instances[j].get() || bvhItemIds[item] != instanceIds[j];
+		}
+	}
+
+	rebuild = rebuild || item != bvhItems.size();
+
+	if (rebuild) {
+		meshBounds.resize(meshes.size());
+		bvhItems.clear();
+		bvhItemIds.clear();
+		bvhItemTransforms.clear();
+		bvhItemVersions.clear();
+
+		std::vector<AABB> bounds;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			meshBounds[i] = meshes[i].GetBoundingBox();
+			std::vector<std::shared_ptr<Transform>> instances = meshes[i].GetActiveInstances();
+			std::vector<uint32_t> instanceIds = meshes[i].GetActiveInstanceIds();
+
+			for (size_t j = 0; j < instances.size(); j++) {
+				bvhItems.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(j) });
+				bvhItemIds.push_back(instanceIds[j]);
+				bvhItemTransforms.push_back(instances[j].get());
+				bvhItemVersions.push_back(instances[j]->GetWorldVersion());
+				bounds.push_back(meshBounds[i].transform(instances[j]->GetModelMatrix()));
+			}
+		}
+
+		instanceBVH.Build(bounds);
+		return;
+	}
+
+	for (size_t i = 0; i < bvhItems.size(); i++) {
+		uint64_t version = bvhItemTransforms[i]->GetWorldVersion();
+
+		if (version != bvhItemVersions[i]) {
+			bvhItemVersions[i] = version;
+			instanceBVH.UpdateItem(static_cast<uint32_t>(i), meshBounds[bvhItems[i].first].transform(bvhItemTransforms[i]->GetModelMatrix()));
+		}
+	}
+
+	instanceBVH.Refit();
+}
+
+void TriangleApp::UpdateVisibleInstances()
+{
+	visibleInstances.resize(meshes.size());
+	visibleInstanceCounts.resize(meshes.size());
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		visibleInstances[i].clear();
+	}
+
+	Frustum frustum = Frustum::fromViewProjection(camera->GetProjection() * camera->GetView());
+
+	bvhResults.clear();
+	instanceBVH.QueryFrustum(frustum, bvhResults);
+
+	//Keep each mesh's instances in their original order so the instance buffer only changes where visibility does
+	std::sort(bvhResults.begin(), bvhResults.end());
+
+	for (uint32_t item : bvhResults) {
+		visibleInstances[bvhItems[item].first].push_back(bvhItems[item].second);
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		visibleInstanceCounts[i] = static_cast<uint32_t>(visibleInstances[i].size());
+	}
+}
+
+bool TriangleApp::Raycast(const Ray& ray, float maxDistance, RaycastHit& hit)
+{
+	//The instance BVH narrows the search down to instances whose bounds the ray passes through
+	std::vector<uint32_t> candidates;
+	instanceBVH.QueryRay(ray, maxDistance, candidates);
+
+	float closest = maxDistance;
+	bool found = false;
+
+	for (uint32_t item : candidates) {
+		glm::mat4 inverseModel = glm::inverse(bvhItemTransforms[item]->GetModelMatrix());
+
+		//The direction isn't renormalized so distances along the model space ray match distances along the world space ray
+		Ray modelRay(glm::vec3(inverseModel * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverseModel * glm::vec4(ray.direction, 0.0f)));
+		TriangleHit triangleHit;
+
+		if (meshes[bvhItems[item].first].GetTriangleBVH()->Intersect(modelRay, closest, triangleHit)) {
+			closest = triangleHit.distance;
+			found = true;
+
+			hit.distance = triangleHit.distance;
+			hit.position = ray.origin + ray.direction * triangleHit.distance;
+			hit.meshIndex = bvhItems[item].first;
+			hit.instanceId = bvhItemIds[item];
+			hit.triangle = triangleHit.triangle;
+			hit.barycentric = triangleHit.barycentric;
+		}
+	}
+
+	return found;
+}
+
+bool TriangleApp::Pick(double cursorX, double cursorY, RaycastHit& hit)
+{
+	//Cursor positions are in window coordinates which can differ from the swap chain's size on high DPI displays
+	int width, height;
+	glfwGetWindowSize(window, &width, &height);
+
+	if (width == 0 || height == 0) {
+		return false;
+	}
+
+	Ray ray = camera->ScreenPointToRay(glm::vec2(cursorX, cursorY), glm::vec2(width, height));
+	return Raycast(ray, camera->GetFarPlane() - camera->GetNearPlane(), hit);
+}
+
+bool TriangleApp::HasLineOfSight(glm::vec3 from, glm::vec3 to)
+{
+	//Leaving the direction unnormalized puts the target at a distance of 1
+	Ray ray(from, to - from);
+
+	std::vector<uint32_t> candidates;
+	instanceBVH.QueryRay(ray, 1.0f, candidates);
 
-	meshes[0].GetActiveInstances()[4]->SetPosition(glm::vec3(0.0f, sinf(scaledTime * 1.0f), 0.0f));
-	meshes[0].GetActiveInstances()[0]->Rotate(glm::vec3(0.875f, 1.75f, 0.875f) * 90.0f * deltaTime);
-	meshes[1].GetActiveInstances()[4]->SetPosition(glm::vec3(cosf(scaledTime), 1.0f, sinf(scaledTime)));
+	for (uint32_t item : candidates) {
+		glm::mat4 inverseModel = glm::inverse(bvhItemTransforms[item]->GetModelMatrix());
+		Ray modelRay(glm::vec3(inverseModel * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverseModel * glm::vec4(ray.direction, 0.0f)));
+
+		if (meshes[bvhItems[item].first].GetTriangleBVH()->IntersectAny(modelRay, 1.0f)) {
+			return false;
+		}
+	}
+
+	return true;
 }
 
 void TriangleApp::DrawFrame()
 {
+	//Switching the depth pre-pass changes the render pass so everything that depends on it is rebuilt
+	if (depthPrePassToggled) {
+		depthPrePassToggled = false;
+		depthPrePass = !depthPrePass;
+		fragmentInvocations = 0;
+		statisticsFrames = 0;
+		RecreateSwapChain();
+	}
+
+	//Culling adds a second render pass so it is toggled the same way
+	if (occlusionCullingToggled) {
+		occlusionCullingToggled = false;
+		occlusionCullingEnabled = !occlusionCullingEnabled && OcclusionCullingFits();
+		fragmentInvocations = 0;
+		statisticsFrames = 0;
+		RecreateSwapChain();
+	}
+
+	//The cull buffers are sized for the demo, once spawned instances outgrow them the frustum culled draws take over
+	if (occlusionCullingEnabled && !OcclusionCullingFits()) {
+		occlusionCullingEnabled = false;
+		fragmentInvocations = 0;
+		statisticsFrames = 0;
+		std::cout << "Occlusion culling off, the scene has more instances than the cull buffers hold" << std::endl;
+		RecreateSwapChain();
+	}
+
+	//A new instance format only needs new pipelines and instance buffers, both are swapped in while older frames finish with the old ones
+	if (instanceFormatToggled) {
+		instanceFormatToggled = false;
+		SetInstanceFormat(static_cast<InstanceFormat>((static_cast<uint32_t>(instanceFormat) + 1) % INSTANCE_FORMAT_COUNT));
+	}
+
+	if (memoryReportRequested) {
+		memoryReportRequested = false;
+		MemoryTelemetry::Print(std::cout, MemoryTelemetry::Capture(frameCount));
+	}
+
+	//Swap in reloaded shaders and finish loaded assets before any command buffers are submitted
+	ReloadShaders();
+	assetManager.Update(MAX_ASSET_UPLOADS_PER_FRAME);
+
+	frameUploadBytes = 0;
+	frameDrawCalls = 0;
+
 	//Wait for the fence to finish
 	vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
@@ -293,14 +863,58 @@ void TriangleApp::DrawFrame()
 	//Mark the image as being in use
 	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
-	//TODO: Re-record command buffer for each object
+	//The last frame drawn to this image has finished so its statistics are ready
+	ReadPipelineStatistics(imageIndex);
+	ReadTimestamps(imageIndex);
+
+	//Make room for instances added since the last frame before anything binds the instance buffers
+	ReserveInstanceBuffers();
+
+	if (occlusionCullingEnabled && recordedInstanceCounts[imageIndex] != totalInstanceCount) {
+		commandBufferDirty[imageIndex] = true;
+	}
+
+	//Re-sort the meshes and re-record the command buffer if the camera or the meshes moved enough to change the order
+	UpdateDrawOrder();
+
+	if (recordedDrawOrders[imageIndex] != drawOrder) {
+		commandBufferDirty[imageIndex] = true;
+	}
+
+	//Without occlusion culling the draws only cover the instances in the frustum, their counts are baked into the command buffer
+	if (!occlusionCullingEnabled) {
+		UpdateVisibleInstances();
+
+		if (recordedVisibleCounts[imageIndex] != visibleInstanceCounts) {
+			commandBufferDirty[imageIndex] = true;
+		}
+	}
+
+	//Stream texture mips once visibility is known, the copies are submitted with this frame instead of stalling the queue
+	bool texturesUploaded = UpdateTextureStreaming(imageIndex);
+
+	//The image is no longer in use so its command buffer can be re-recorded if anything it draws has changed
+	if (commandBufferDirty[imageIndex]) {
+		vkResetCommandBuffer(commandBuffers[imageIndex], 0);
+		RecordCommandBuffer(imageIndex);
+	}
 
 	//Update uniform buffers
-	UpdateUniformBuffers(imageIndex);
+	frameUploadBytes += UpdateUniformBuffers(imageIndex);
+	frameUploadBytes += lightClusters.UpdateLightBuffer(imageIndex);
 
-	//Update instance buffer
-	for (size_t i = 0; i < meshes.size(); i++) {
-		meshes[i].UpdateInstanceBuffer();
+	if (occlusionCullingEnabled) {
+		frameUploadBytes += occlusionCulling.UpdateInstances(imageIndex, meshes);
+	}
+
+	frameUploadBytes += particles.UpdateSettings(imageIndex, deltaTime, static_cast<uint32_t>(particleMesh.GetIndices().size()));
+	frameUploadBytes += skinning.UpdatePoses(imageIndex, deltaTime);
+
+	//The cull pass writes the instances it draws from its own objects, only the CPU culled draws read the meshes' instance buffers
+	if (!occlusionCullingEnabled) {
+		for (size_t i = 0; i < meshes.size(); i++) {
+			frameUploadBytes += meshes[i].UpdateInstanceBuffer(imageIndex, visibleInstances[i]);
+		}
 	}
 
 	//Submit to the graphics queue
@@ -313,8 +927,10 @@ void TriangleApp::DrawFrame()
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	//The upload commands end with a barrier so the draws after them see the new texture levels
+	std::array<VkCommandBuffer, 2> submitCommandBuffers = { uploadCommandBuffers[currentFrame], commandBuffers[imageIndex] };
+	submitInfo.commandBufferCount = texturesUploaded ? 2 : 1;
+	submitInfo.pCommandBuffers = texturesUploaded ? submitCommandBuffers.data() : &commandBuffers[imageIndex];
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 	submitInfo.signalSemaphoreCount = 1;
@@ -327,6 +943,16 @@ void TriangleApp::DrawFrame()
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
 
+	if (pipelineStatisticsSupported) {
+		statisticsPending[imageIndex] = true;
+	}
+
+	if (timestampsSupported) {
+		timestampsPending[imageIndex] = true;
+	}
+
+	frameDrawCalls = recordedDrawCalls[imageIndex];
+
 	//Present on the screen
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -351,6 +977,12 @@ void TriangleApp::DrawFrame()
 
 	//Update the current frame
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameCount++;
+
+	//Free pipelines and buffers that the frames which just finished were using
+	DestroyRetiredPipelines(false);
+	DestroyRetiredBuffers(false);
+	DestroyRetiredTextures(false);
 }
 
 void TriangleApp::CreateSyncObjects()
@@ -414,10 +1046,21 @@ void TriangleApp::CreateInstance()
 
 	//Find the number of required extensions
 	std::vector<const char*> requiredExtensions = GetRequiredExtensions();
-	uint32_t requiredExtensionsCount = static_cast<uint32_t>(requiredExtensions.size());
 
-	/*
-	//Print out the extensions that have been found and the extensions that are needed
+	//Needed to read heap budgets, memory reports fall back to heap sizes without it
+	physicalDeviceProperties2Supported = false;
+	for (uint32_t i = 0; i < extensionCount; i++) {
+		if (strcmp(extensions[i].extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+			physicalDeviceProperties2Supported = true;
+			requiredExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			break;
+		}
+	}
+
+	uint32_t requiredExtensionsCount = static_cast<uint32_t>(requiredExtensions.size());
+
+	/*
+	//Print out the extensions that have been found and the extensions that are needed
 	std::cout << "Found " << extensionCount << " extensions:" << std::endl;
 	for (VkExtensionProperties e : extensions) {
 		std::cout << "\t" << e.extensionName << std::endl;
@@ -441,10 +1084,7 @@ void TriangleApp::CreateInstance()
 		}
 
 		if (!foundExtension) {
-			char message[256] = "Could not find required extension: ";
-			strcat_s(message, sizeof(message), requiredExtensions[i]);
-
-			throw std::runtime_error(message);
+			throw std::runtime_error(std::string("Could not find required extension: ") + requiredExtensions[i]);
 		}
 	}
 
@@ -538,8 +1178,8 @@ QueueFamilyIndices TriangleApp::FindQueueFamilies(VkPhysicalDevice device)
 	int i = 0;
 
 	for (const auto queueFamily : queueFamilies) {
-		//Check for Graphics support
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+		//Check for Graphics support, compute is also needed on the same queue to build the light clusters
+		if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
 			indices.graphicsFamily = i;
 		}
 
@@ -668,16 +1308,67 @@ void TriangleApp::CreateLogicalDevice()
 	}
 
 	//Set used device features
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 
+	//Baked textures are block compressed so enable BC formats when they are available
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+	//Used to count fragment shader invocations when comparing the depth pre-pass
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+
+	//The cull pass writes the first instance of each indirect draw and the pyramid is built by sampling the depth buffer
+	VkFormatProperties depthFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, FindDepthFormat(), &depthFormatProperties);
+
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	occlusionCullingSupported = supportedFeatures.drawIndirectFirstInstance == VK_TRUE && (depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	occlusionCullingEnabled = occlusionCullingEnabled && occlusionCullingSupported;
+
+	//Frames are timed on the GPU with timestamps written by the graphics queue
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t timestampBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+	timestampsSupported = timestampBits > 0 && deviceProperties.limits.timestampPeriod > 0.0f;
+	timestampPeriod = deviceProperties.limits.timestampPeriod;
+	timestampMask = timestampBits >= 64 ? UINT64_MAX : (1ull << timestampBits) - 1;
+
+	//Heap budgets are optional, the memory counters work without them
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	memoryBudgetSupported = false;
+
+	if (physicalDeviceProperties2Supported) {
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const VkExtensionProperties& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+				memoryBudgetSupported = true;
+				enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				break;
+			}
+		}
+	}
+
 	//Setup Logical Device
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -695,6 +1386,8 @@ void TriangleApp::CreateLogicalDevice()
 	//Set the queues
 	vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0, &presentQueue);
+
+	MemoryTelemetry::Initialize(instance, physicalDevice, memoryBudgetSupported);
 }
 
 #pragma endregion
@@ -714,171 +1407,198 @@ void TriangleApp::CreateSurface()
 
 void TriangleApp::CreateTextureImage()
 {
-	//TODO: figure out how to load the data from an image file
-	/*
-	int textureWidth, textureHeight, textureChannels;
-	stbi_uc* pixels = stbi_load("textures/testImage.png", &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = textureWidth * textureHeight * textureChannels;
-
-	if (!pixels) {
-		throw std::runtime_error("Failed to load image!");
+	VkPhysicalDeviceFeatures deviceFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+
+	//Draw with a plain white texture while the real one loads so the sampler binding is always valid
+	const uint8_t white[] = { 255, 255, 255, 255 };
+
+	texture = std::make_shared<Texture>();
+	texture->LoadFromPixels(white, 1, 1, false);
+
+	//Prefer the baked texture, then the source image, UpdateTextureStreaming swaps it in once it is uploaded
+	if (deviceFeatures.textureCompressionBC && assetManager.Exists("textures/testImage.vtex")) {
+		textureAsset = assetManager.Load("textures/testImage.vtex", nullptr, [this](Asset& asset) {
+			std::shared_ptr<Texture> loaded = std::make_shared<Texture>();
+			loaded->LoadFromCompressedData(asset.GetData(), true);
+			asset.ReleaseData();
+
+			textureStreamer.Add(loaded);
+			asset.SetPayload(loaded);
+		});
+	}
+	else if (assetManager.Exists("textures/testImage.png")) {
+		textureAsset = assetManager.Load("textures/testImage.png", [](Asset& asset) {
+			asset.SetPayload(Texture::DecodeImage(asset.GetData()));
+			asset.ReleaseData();
+		}, [this](Asset& asset) {
+			std::shared_ptr<DecodedImage> image = asset.GetPayload<DecodedImage>();
+			std::shared_ptr<Texture> loaded = std::make_shared<Texture>();
+			loaded->LoadFromPixels(image->pixels.data(), image->width, image->height, true);
+
+			textureStreamer.Add(loaded);
+			asset.SetPayload(loaded);
+		});
 	}
+}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* data;
+void TriangleApp::CreateTextureAtlas()
+{
+	std::vector<uint32_t> regionIds;
 
-	vkMapMemory(logicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+	if (std::filesystem::is_directory("textures/atlas")) {
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("textures/atlas")) {
+			if (entry.is_regular_file()) {
+				regionIds.push_back(textureAtlas.AddFromFile(entry.path().string()));
+			}
+		}
+	}
 
-	stbi_image_free(pixels);
+	//Keep the atlas binding valid even when there is nothing to pack
+	if (regionIds.empty()) {
+		const uint8_t white[] = { 255, 255, 255, 255 };
+		textureAtlas.AddFromPixels(white, 1, 1);
+	}
 
-	CreateImage(textureWidth, textureHeight, VK_FORMAT_R8G8B8A8_UNORM,
-		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-		VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage,
-		textureImageMemory);
-	
+	textureAtlas.Build();
 
-	TransitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	CopyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(textureWidth), static_cast<uint32_t>(textureHeight));
-	TransitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	*/
+	//Give each mesh one of the packed textures
+	for (size_t i = 0; i < meshes.size() && !regionIds.empty(); i++) {
+		meshes[i].SetAtlasRegion(textureAtlas.GetRegion(regionIds[i % regionIds.size()]));
+	}
 }
 
-void TriangleApp::CreateTextureImageView()
+void TriangleApp::CreateTextureSampler()
 {
-	//textureImageView = CreateImageView(textureImage, VK_FORMAT_R8G8B8A8_UNORM);
+	VkSamplerCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	createInfo.magFilter = VK_FILTER_LINEAR;
+	createInfo.minFilter = VK_FILTER_LINEAR;
+	createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	createInfo.anisotropyEnable = VK_FALSE;
+	createInfo.maxAnisotropy = 1.0f;
+	createInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	createInfo.unnormalizedCoordinates = VK_FALSE;
+	createInfo.compareEnable = VK_FALSE;
+	createInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	createInfo.mipLodBias = 0.0f;
+	createInfo.minLod = 0.0f;
+	createInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(logicalDevice, &createInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture sampler!");
+	}
 }
 
-void TriangleApp::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& memory)
+bool TriangleApp::UpdateTextureStreaming(uint32_t imageIndex)
 {
-	VkImageCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	createInfo.imageType = VK_IMAGE_TYPE_2D;
-	createInfo.extent.width = width;
-	createInfo.extent.height = height;
-	createInfo.extent.depth = 1;
-	createInfo.mipLevels = 1;
-	createInfo.arrayLayers = 1;
-	createInfo.format = format;
-	createInfo.tiling = tiling;
-	createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	createInfo.usage = usage;
-	createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	//Replace the placeholder once the texture has been uploaded, frames still in flight may be sampling the old one
+	if (textureAsset != nullptr && textureAsset->IsDone()) {
+		if (textureAsset->IsReady()) {
+			retiredTextures.push_back(std::make_pair(texture->Release(), frameCount + MAX_FRAMES_IN_FLIGHT));
+			texture = textureAsset->GetPayload<Texture>();
+
+			//The new texture's version can match the placeholder's so force every image to rebind it
+			for (uint32_t& version : descriptorTextureVersions) {
+				version = texture->GetVersion() + 1;
+			}
+		}
+		else {
+			std::cerr << "Texture failed to load: " << textureAsset->GetError() << std::endl;
+		}
 
-	if (vkCreateImage(logicalDevice, &createInfo, nullptr, &image) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create image!");
+		textureAsset = nullptr;
 	}
 
-	VkMemoryRequirements memoryRequirements;
-	vkGetImageMemoryRequirements(logicalDevice, image, &memoryRequirements);
-
-	VkMemoryAllocateInfo allocateInfo = {};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocateInfo.allocationSize = memoryRequirements.size;
-	allocateInfo.memoryTypeIndex = FindMemoryType(memoryRequirements.memoryTypeBits, properties);
+	//Only draws that survived culling sample the texture, GPU cull results aren't read back so with occlusion culling any mesh with instances counts
+	for (size_t i = 0; i < meshes.size(); i++) {
+		uint32_t drawnInstances = occlusionCullingEnabled ? meshes[i].GetActiveInstanceCount() : visibleInstanceCounts[i];
 
-	if (vkAllocateMemory(logicalDevice, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate image memory!");
+		if (drawnInstances > 0 && meshes[i].SamplesStreamedTexture()) {
+			texture->MarkUsed(frameCount);
+			break;
+		}
 	}
 
-	vkBindImageMemory(logicalDevice, image, memory, 0);
-}
+	//This frame's fence has been waited on so its upload command buffer can be reused
+	VkCommandBuffer commandBuffer = uploadCommandBuffers[currentFrame];
+	vkResetCommandBuffer(commandBuffer, 0);
 
-VkImageView TriangleApp::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
-{
-	VkImageViewCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	createInfo.image = image;
-	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	createInfo.format = format;
-	createInfo.subresourceRange.aspectMask = aspectFlags;
-	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
-	createInfo.subresourceRange.baseArrayLayer = 0;
-	createInfo.subresourceRange.layerCount = 1;
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	VkImageView imageView;
-	if (vkCreateImageView(logicalDevice, &createInfo, nullptr, &imageView) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create image view!");
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording upload Command Buffer!");
 	}
 
-	return imageView;
-}
-
-void TriangleApp::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-	VkCommandBuffer commandBuffer = Command::BeginSingleTimeCommand();
-
-	VkImageMemoryBarrier barrier = {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags srcStage;
-	VkPipelineStageFlags dstStage;
+	TextureUploadBatch batch;
+	batch.commandBuffer = commandBuffer;
+	textureStreamer.Update(frameCount, batch);
 
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record upload Command Buffer!");
 	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else {
-		throw std::runtime_error("Unsupported Layput Transition!");
+	//Replaced images are read by this frame's copies too, so they are kept one frame longer than other retired resources
+	for (const RetiredTexture& retired : batch.retired) {
+		retiredTextures.push_back(std::make_pair(retired, frameCount + MAX_FRAMES_IN_FLIGHT + 1));
 	}
 
-	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	frameUploadBytes += batch.uploadBytes;
+
+	//Only this image's descriptor set is idle, the other images are rebound when they are next acquired
+	if (descriptorTextureVersions[imageIndex] != texture->GetVersion()) {
+		UpdateTextureDescriptors(imageIndex);
+		commandBufferDirty[imageIndex] = true;
+	}
 
-	Command::EndSingleTimeCommand(commandBuffer);
+	return batch.recorded;
 }
 
-void TriangleApp::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t imageWidth, uint32_t imageHeight)
+void TriangleApp::UpdateTextureDescriptors(size_t imageIndex)
 {
-	VkCommandBuffer commandBuffer = Command::BeginSingleTimeCommand();
-
-	VkBufferImageCopy region = {};
-	region.bufferOffset = 0;
-	region.bufferImageHeight = 0;
-	region.bufferRowLength = 0;
-
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = {
-		imageWidth,
-		imageHeight,
-		1
-	};
-
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	std::array<VkDescriptorImageInfo, 2> imageInfos = {};
+	imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfos[0].imageView = texture->GetImageView();
+	imageInfos[0].sampler = textureSampler;
+
+	imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfos[1].imageView = textureAtlas.GetImageView();
+	imageInfos[1].sampler = textureSampler;
+
+	std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+	for (size_t j = 0; j < descriptorWrites.size(); j++) {
+		descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[j].dstSet = descriptorSets[imageIndex];
+		descriptorWrites[j].dstBinding = static_cast<uint32_t>(j + 1);
+		descriptorWrites[j].dstArrayElement = 0;
+		descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[j].descriptorCount = 1;
+		descriptorWrites[j].pBufferInfo = nullptr;
+		descriptorWrites[j].pImageInfo = &imageInfos[j];
+		descriptorWrites[j].pTexelBufferView = nullptr;
+	}
+
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+	descriptorTextureVersions[imageIndex] = texture->GetVersion();
+}
 
-	Command::EndSingleTimeCommand(commandBuffer);
+void TriangleApp::DestroyRetiredTextures(bool force)
+{
+	for (size_t i = 0; i < retiredTextures.size();) {
+		if (force || retiredTextures[i].second <= frameCount) {
+			retiredTextures[i].first.Cleanup();
+			retiredTextures.erase(retiredTextures.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
 }
 
 #pragma endregion
@@ -889,14 +1609,15 @@ void TriangleApp::CreateDepthResources()
 {
 	VkFormat depthFormat = FindDepthFormat();
 
-	CreateImage(swapChainExtent.width, swapChainExtent.height,
+	Image::CreateImage(swapChainExtent.width, swapChainExtent.height, 1,
 		depthFormat,
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (occlusionCullingSupported ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		depthImage, depthImageMemory);
+		MemoryCategory::Attachments,
+		depthImage);
 
-	depthImageView = CreateImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+	depthImageView = Image::CreateImageView(depthImage.GetImage(), depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 }
 
 VkFormat TriangleApp::FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
@@ -1000,10 +1721,12 @@ void TriangleApp::CreateSwapChain()
 
 void TriangleApp::RecreateSwapChain()
 {
+	//Wait while the window is minimized
 	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
 	while (width == 0 || height == 0) {
-		glfwGetFramebufferSize(window, &width, &height);
 		glfwWaitEvents();
+		glfwGetFramebufferSize(window, &width, &height);
 	}
 
 	//Wait for the device to finish any current processes
@@ -1016,12 +1739,26 @@ void TriangleApp::RecreateSwapChain()
 	CreateSwapChain();
 	CreateImageViews();
 	CreateRenderPass();
-	CreateGraphicsPipeline();
+	CreateLateRenderPass();
+	CreatePipelineLayout();
 	CreateDepthResources();
 	CreateFrameBuffers();
 	CreateUniformBuffers();
+	lightClusters.CreateResources(uniformBuffers);
+
+	if (occlusionCullingSupported) {
+		occlusionCulling.CreateResources(uniformBuffers, swapChainExtent, depthImageView);
+	}
+
+	particles.CreateResources(static_cast<uint32_t>(swapChainImages.size()));
+	skinning.CreateResources(static_cast<uint32_t>(swapChainImages.size()));
+
+	//The instance buffers have a region per image so they are resized before the command buffers bind them
+	ReserveInstanceBuffers();
+
 	CreateDescriptorPool();
 	CreateDescriptorSets();
+	CreateQueryPool();
 	CreateCommandBuffers();
 }
 
@@ -1032,11 +1769,24 @@ void TriangleApp::CleanupSwapChain()
 		vkDestroyFramebuffer(logicalDevice, frameBuffer, nullptr);
 	}
 
+	for (auto frameBuffer : lateFrameBuffers) {
+		vkDestroyFramebuffer(logicalDevice, frameBuffer, nullptr);
+	}
+	lateFrameBuffers.clear();
+
 	//Free Command Buffers
 	vkFreeCommandBuffers(logicalDevice, Command::commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
 
-	//Destroy the graphics pipeline
-	vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+	//Destroy the graphics pipelines, they are recompiled against the new render pass as they are drawn
+	DestroyPipelines();
+
+	for (VkPipeline& depthPipeline : depthPipelines) {
+		if (depthPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(logicalDevice, depthPipeline, nullptr);
+			depthPipeline = VK_NULL_HANDLE;
+		}
+	}
+	DestroyRetiredPipelines(true);
 
 	//Destroy the Pipeline Layout
 	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
@@ -1044,6 +1794,11 @@ void TriangleApp::CleanupSwapChain()
 	//Destroy Render Pass
 	vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
 
+	if (lateRenderPass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(logicalDevice, lateRenderPass, nullptr);
+		lateRenderPass = VK_NULL_HANDLE;
+	}
+
 	//Destroy Image Views
 	for (VkImageView view : swapChainImageView) {
 		vkDestroyImageView(logicalDevice, view, nullptr);
@@ -1057,17 +1812,39 @@ void TriangleApp::CleanupSwapChain()
 		uniformBuffers[i]->Cleanup();
 	}
 
+	//Destroy Light Cluster Buffers
+	lightClusters.CleanupResources();
+
+	//Destroy the culling buffers and depth pyramid
+	if (occlusionCullingSupported) {
+		occlusionCulling.CleanupResources();
+	}
+
+	//Destroy the particle buffers, the particles are respawned once the swap chain is recreated
+	particles.CleanupResources();
+
+	//Destroy the skinning buffers
+	skinning.CleanupResources();
+
 	//Destroy Descriptor Pool
 	vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
 
+	//Destroy the statistics queries
+	if (statisticsQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(logicalDevice, statisticsQueryPool, nullptr);
+		statisticsQueryPool = VK_NULL_HANDLE;
+	}
+
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(logicalDevice, timestampQueryPool, nullptr);
+		timestampQueryPool = VK_NULL_HANDLE;
+	}
+
 	//Destroy Depth Image Views
 	vkDestroyImageView(logicalDevice, depthImageView, nullptr);
 
-	//Destroy Depth Image
-	vkDestroyImage(logicalDevice, depthImage, nullptr);
-
-	//Free Depth Image Memory
-	vkFreeMemory(logicalDevice, depthImageMemory, nullptr);
+	//Destroy Depth Image and free its memory
+	depthImage.Cleanup();
 }
 
 void TriangleApp::CreateImageViews()
@@ -1076,7 +1853,7 @@ void TriangleApp::CreateImageViews()
 
 	//Create Image Views
 	for (size_t i = 0; i < swapChainImages.size(); i++) {
-		swapChainImageView[i] = CreateImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		swapChainImageView[i] = Image::CreateImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 	}
 }
 
@@ -1105,6 +1882,31 @@ void TriangleApp::CreateFrameBuffers()
 			throw std::runtime_error("Failed to create Frame Buffer!");
 		}
 	}
+
+	//The late render pass has a different subpass layout so it needs its own frame buffers
+	if (lateRenderPass != VK_NULL_HANDLE) {
+		lateFrameBuffers.resize(swapChainImages.size());
+
+		for (size_t i = 0; i < lateFrameBuffers.size(); i++) {
+			std::array<VkImageView, 2> attachments = {
+				swapChainImageView[i],
+				depthImageView
+			};
+
+			VkFramebufferCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			createInfo.renderPass = lateRenderPass;
+			createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			createInfo.pAttachments = attachments.data();
+			createInfo.width = swapChainExtent.width;
+			createInfo.height = swapChainExtent.height;
+			createInfo.layers = 1;
+
+			if (vkCreateFramebuffer(logicalDevice, &createInfo, nullptr, &lateFrameBuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create Frame Buffer!");
+			}
+		}
+	}
 }
 
 SwapChainSupportDetails TriangleApp::QuerySwapChainSupport(VkPhysicalDevice device)
@@ -1148,6 +1950,11 @@ VkSurfaceFormatKHR TriangleApp::ChooseSwapSurfaceFormat(const std::vector<VkSurf
 
 VkPresentModeKHR TriangleApp::ChooseSwapSurfacePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
+	//Benchmarks present as soon as a frame is done so the refresh rate doesn't cap the frame times
+	if (benchmarking && std::find(availablePresentModes.begin(), availablePresentModes.end(), VK_PRESENT_MODE_IMMEDIATE_KHR) != availablePresentModes.end()) {
+		return VK_PRESENT_MODE_IMMEDIATE_KHR;
+	}
+
 	//Check for a present mode with the preferred settings
 	for (const auto& availablePresentMode : availablePresentModes) {
 		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
@@ -1183,28 +1990,65 @@ VkExtent2D TriangleApp::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surface
 
 #pragma region Graphics Pipeline Management
 
-void TriangleApp::CreateGraphicsPipeline()
+void TriangleApp::CreatePipelineLayout()
+{
+	//Setup Pipeline Layout
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+
+	//Per draw values are pushed while recording instead of being uploaded to a buffer
+	VkPushConstantRange pushConstantRange = DrawConstants::getPushConstantRange();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	//Create the pipeline layout
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Graphics Pipeline Layout!");
+	}
+}
+
+void TriangleApp::CreateShaderModules()
 {
 	//Read in shader code
-	auto vertexShaderCode = ReadFile("shaders/vert.spv");
-	auto fragmentShaderCode = ReadFile("shaders/frag.spv");
+	auto vertexShaderCode = LoadShaderCode("shaders/vert.spv");
+	auto fragmentShaderCode = LoadShaderCode("shaders/frag.spv");
 
 	//Create shader module
-	VkShaderModule vertexShaderModule = CreateShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
+	vertexShaderModule = CreateShaderModule(vertexShaderCode);
+	fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
+	depthShaderModule = CreateShaderModule(LoadShaderCode("shaders/depth.spv"));
+}
+
+VkPipeline TriangleApp::CreateGraphicsPipeline(const PipelineKey& key, VkShaderModule vertexModule, VkShaderModule fragmentModule, bool latePass)
+{
+	bool depthOnly = fragmentModule == VK_NULL_HANDLE;
+
+	//Setup the permutation's specialization constants
+	PipelineSpecialization specialization = key.GetSpecialization();
+	std::array<VkSpecializationMapEntry, 6> specializationEntries = PipelineSpecialization::getMapEntries();
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(specialization);
+	specializationInfo.pData = &specialization;
 
 	//Setup shader stages
 	VkPipelineShaderStageCreateInfo vertexStageCreateInfo = {};
 	vertexStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertexStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertexStageCreateInfo.module = vertexShaderModule;
+	vertexStageCreateInfo.module = vertexModule;
 	vertexStageCreateInfo.pName = "main";
+	vertexStageCreateInfo.pSpecializationInfo = &specializationInfo;
 
 	VkPipelineShaderStageCreateInfo fragmentStageCreateInfo = {};
 	fragmentStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragmentStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragmentStageCreateInfo.module = fragmentShaderModule;
+	fragmentStageCreateInfo.module = fragmentModule;
 	fragmentStageCreateInfo.pName = "main";
+	fragmentStageCreateInfo.pSpecializationInfo = &specializationInfo;
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = {
 		vertexStageCreateInfo,
@@ -1212,12 +2056,13 @@ void TriangleApp::CreateGraphicsPipeline()
 	};
 
 	//Setup the Vertex input
-	std::array<VkVertexInputAttributeDescription, 3> vertexDescriptions = Vertex::getAttributeDescriptions();
-	std::array<VkVertexInputAttributeDescription, 4> transformDescriptions = TransformData::getAttributeDescriptions();
-	std::array<VkVertexInputAttributeDescription, 7> attributeDescriptions = {
+	std::array<VkVertexInputAttributeDescription, 4> vertexDescriptions = Vertex::getAttributeDescriptions();
+	std::array<VkVertexInputAttributeDescription, 4> transformDescriptions = TransformData::getAttributeDescriptions(key.instanceFormat);
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {
 		vertexDescriptions[0],
 		vertexDescriptions[1],
 		vertexDescriptions[2],
+		vertexDescriptions[3],
 		transformDescriptions[0],
 		transformDescriptions[1],
 		transformDescriptions[2],
@@ -1226,9 +2071,28 @@ void TriangleApp::CreateGraphicsPipeline()
 
 	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
 		Vertex::getBindingDescription(),
-		TransformData::getBindingDescription()
+		TransformData::getBindingDescription(key.instanceFormat)
 	};
 
+	//The depth pre-pass reads tightly packed positions so it fetches as little vertex data as possible
+	if (depthOnly) {
+		VkVertexInputAttributeDescription positionDescription = {};
+		positionDescription.binding = 0;
+		positionDescription.location = 0;
+		positionDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+		positionDescription.offset = 0;
+
+		attributeDescriptions = {
+			positionDescription,
+			transformDescriptions[0],
+			transformDescriptions[1],
+			transformDescriptions[2],
+			transformDescriptions[3]
+		};
+
+		bindingDescriptions[0].stride = sizeof(glm::vec3);
+	}
+
 	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
 	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -1291,7 +2155,7 @@ void TriangleApp::CreateGraphicsPipeline()
 	//Setup Color Blending
 	VkPipelineColorBlendAttachmentState colorBlendAttachmentState = {};
 	colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachmentState.blendEnable = VK_FALSE;
+	colorBlendAttachmentState.blendEnable = key.transparent ? VK_TRUE : VK_FALSE;
 	colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 	colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 	colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
@@ -1303,8 +2167,8 @@ void TriangleApp::CreateGraphicsPipeline()
 	colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	colorBlendCreateInfo.logicOpEnable = VK_FALSE;
 	colorBlendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-	colorBlendCreateInfo.attachmentCount = 1;
-	colorBlendCreateInfo.pAttachments = &colorBlendAttachmentState;
+	colorBlendCreateInfo.attachmentCount = depthOnly ? 0 : 1;
+	colorBlendCreateInfo.pAttachments = depthOnly ? nullptr : &colorBlendAttachmentState;
 	colorBlendCreateInfo.blendConstants[0] = 0.0f;
 	colorBlendCreateInfo.blendConstants[1] = 0.0f;
 	colorBlendCreateInfo.blendConstants[2] = 0.0f;
@@ -1316,6 +2180,18 @@ void TriangleApp::CreateGraphicsPipeline()
 	depthStencilCreateInfo.depthTestEnable = VK_TRUE;
 	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
 	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	//After a pre-pass only the closest fragment of each pixel passes, so nothing is shaded twice
+	//The late pass draws instances that had no part in the pre-pass so it tests and writes depth as usual
+	if (depthPrePass && !depthOnly && !latePass && !key.transparent) {
+		depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+		depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
+
+	//Transparent draws are left out of the pre-pass and must not hide what is drawn behind them
+	if (key.transparent) {
+		depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+	}
 	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
 	depthStencilCreateInfo.minDepthBounds = 0.0f;
 	depthStencilCreateInfo.maxDepthBounds = 1.0f;
@@ -1336,23 +2212,10 @@ void TriangleApp::CreateGraphicsPipeline()
 	dynamicStateCreateInfo.pDynamicStates = dynamicStates;
 	*/
 
-	//Setup Pipeline Layout
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = 1;
-	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-
-	//Create the pipeline layout
-	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create Graphics Pipeline Layout!");
-	}
-
 	//Setup graphics pipeline create info
 	VkGraphicsPipelineCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	createInfo.stageCount = 2;
+	createInfo.stageCount = depthOnly ? 1 : 2;
 	createInfo.pStages = shaderStages;
 	createInfo.pVertexInputState = &vertexInputCreateInfo;
 	createInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
@@ -1363,161 +2226,825 @@ void TriangleApp::CreateGraphicsPipeline()
 	createInfo.pColorBlendState = &colorBlendCreateInfo;
 	createInfo.pDynamicState = nullptr;
 	createInfo.layout = pipelineLayout;
-	createInfo.renderPass = renderPass;
-	createInfo.subpass = 0;
+	createInfo.renderPass = latePass ? lateRenderPass : renderPass;
+	createInfo.subpass = depthPrePass && !depthOnly && !latePass ? 1 : 0;
 	createInfo.basePipelineHandle = VK_NULL_HANDLE;
 	createInfo.basePipelineIndex = -1;
 
 	//Create graphics pipeline
-	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &createInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Graphics Pipeline!");
 	}
 
-	//Cleanup shader modules
-	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
-	vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+	return pipeline;
 }
 
-void TriangleApp::CreateDescriptorSetLayout()
+void TriangleApp::CreateLightClusters()
 {
-	std::vector<VkDescriptorSetLayoutBinding> bindings(1);
+	CreateLightClusterPipeline();
 
-	bindings[0] = {};
-	bindings[0].binding = 0;
-	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	bindings[0].descriptorCount = 1;
-	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	bindings[0].pImmutableSamplers = nullptr;
+	//The scene's only light, more can be added at any time up to LightClusters::MAX_LIGHTS
+	lightClusters.AddLight(Light(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), 2.5f));
+}
 
-	VkDescriptorSetLayoutCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	createInfo.bindingCount = 1;
-	createInfo.pBindings = bindings.data();
+VkPipeline TriangleApp::CreateLightClusterPipeline()
+{
+	VkShaderModule computeShaderModule = CreateShaderModule(LoadShaderCode("shaders/cluster.spv"));
+	VkPipeline oldPipeline;
 
-	if (vkCreateDescriptorSetLayout(logicalDevice, &createInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create descriptor set layout");
+	try {
+		oldPipeline = lightClusters.CreatePipeline(computeShaderModule);
 	}
+	catch (...) {
+		vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+		throw;
+	}
+
+	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+
+	return oldPipeline;
 }
 
-void TriangleApp::CreateDescriptorPool()
+std::array<VkPipeline, 3> TriangleApp::CreateOcclusionCullingPipelines()
 {
-	VkDescriptorPoolSize poolSize = {};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+	VkShaderModule cullShaderModule = CreateShaderModule(LoadShaderCode("shaders/cull.spv"));
+	VkShaderModule reduceShaderModule = VK_NULL_HANDLE;
+	std::array<VkPipeline, 3> oldPipelines;
 
-	VkDescriptorPoolCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	createInfo.poolSizeCount = 1;
-	createInfo.pPoolSizes = &poolSize;
-	createInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+	try {
+		reduceShaderModule = CreateShaderModule(LoadShaderCode("shaders/hiz.spv"));
+		oldPipelines = occlusionCulling.CreatePipelines(cullShaderModule, reduceShaderModule);
+	}
+	catch (...) {
+		vkDestroyShaderModule(logicalDevice, cullShaderModule, nullptr);
 
-	if (vkCreateDescriptorPool(logicalDevice, &createInfo, nullptr, &descriptorPool)) {
-		throw std::runtime_error("Failed to create Descriptor Pool!");
+		if (reduceShaderModule != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(logicalDevice, reduceShaderModule, nullptr);
+		}
+
+		throw;
 	}
+
+	vkDestroyShaderModule(logicalDevice, cullShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, reduceShaderModule, nullptr);
+
+	return oldPipelines;
 }
 
-void TriangleApp::CreateDescriptorSets()
+void TriangleApp::CreateParticles()
 {
-	std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
-	VkDescriptorSetAllocateInfo allocateInfo = {};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocateInfo.descriptorPool = descriptorPool;
-	allocateInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-	allocateInfo.pSetLayouts = layouts.data();
+	CreateParticlePipelines();
+
+	//Small orange cubes for the particle fountain
+	particleMesh.GenerateCube();
+	particleMesh.SetPipelineKey(PipelineKey(PipelineKey::MAX_LIGHTS, SHADER_FEATURE_VERTEX_COLOR));
+	particleMesh.SetDrawConstants(DrawConstants(glm::vec4(1.0f, 0.6f, 0.2f, 1.0f)));
+
+	//A fountain in the middle of the scene that splashes off the floor
+	ParticleEmitter& emitter = particles.GetEmitter();
+	emitter.position = glm::vec3(0.0f, 0.5f, 0.0f);
+	emitter.radius = 0.05f;
+	emitter.velocity = glm::vec3(0.0f, 6.0f, 0.0f);
+	emitter.velocitySpread = 2.0f;
+	emitter.minLifetime = 3.0f;
+	emitter.maxLifetime = 5.0f;
+	emitter.size = 0.01f;
+	emitter.rate = 250000.0f;
+
+	particles.AddCollisionPlane(glm::vec3(0.0f, 1.0f, 0.0f), -0.5f);
+}
 
-	descriptorSets.resize(swapChainImages.size());
+std::array<VkPipeline, 2> TriangleApp::CreateParticlePipelines()
+{
+	VkShaderModule particleShaderModule = CreateShaderModule(LoadShaderCode("shaders/particles.spv"));
+	std::array<VkPipeline, 2> oldPipelines;
 
-	if (vkAllocateDescriptorSets(logicalDevice, &allocateInfo, descriptorSets.data()) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate Descriptor Sets!");
+	try {
+		oldPipelines = particles.CreatePipelines(particleShaderModule);
+	}
+	catch (...) {
+		vkDestroyShaderModule(logicalDevice, particleShaderModule, nullptr);
+		throw;
 	}
 
-	for (size_t i = 0; i < uniformBuffers.size(); i++) {
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = uniformBuffers[i]->GetBuffer();
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
-
-		VkWriteDescriptorSet descriptorWrite = {};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = descriptorSets[i];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &bufferInfo;
-		descriptorWrite.pImageInfo = nullptr;
-		descriptorWrite.pTexelBufferView = nullptr;
+	vkDestroyShaderModule(logicalDevice, particleShaderModule, nullptr);
 
-		vkUpdateDescriptorSets(logicalDevice, 1, &descriptorWrite, 0, nullptr);
-	}
+	return oldPipelines;
 }
 
-void TriangleApp::CreateRenderPass()
+void TriangleApp::CreateSkinning()
 {
-	//Setup Color Attachment
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format = swapChainImageFormat;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	CreateSkinningPipeline();
 
-	//Setup Depth Attachment
-	VkAttachmentDescription depthAttachment = {};
-	depthAttachment.format = FindDepthFormat();
-	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	//A sphere that sways from its base, vertices follow the second joint more the higher up they are
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+	mesh->GenerateSphere(10);
+	mesh->SetPipelineKey(PipelineKey(PipelineKey::MAX_LIGHTS, SHADER_FEATURE_VERTEX_COLOR));
+	mesh->SetDrawConstants(DrawConstants(glm::vec4(0.4f, 0.8f, 1.0f, 1.0f)));
 
-	//Setup Subpass
-	VkAttachmentReference colorAttachmentReference = {};
-	colorAttachmentReference.attachment = 0;
-	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	std::vector<Vertex> vertices = mesh->GetVertices();
+	std::vector<VertexSkin> skin(vertices.size());
 
-	VkAttachmentReference depthAttachmentReference = {};
-	depthAttachmentReference.attachment = 1;
-	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		float weight = glm::clamp(vertices[i].position.y + 0.5f, 0.0f, 1.0f);
+		skin[i] = VertexSkin(glm::uvec4(0, 1, 0, 0), glm::vec4(1.0f - weight, weight, 0.0f, 0.0f));
+	}
 
-	VkSubpassDescription subpassDescription = {};
-	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpassDescription.colorAttachmentCount = 1;
-	subpassDescription.pColorAttachments = &colorAttachmentReference;
-	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
-	
-	//Setup Subpass Dependencies
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	mesh->SetSkin(skin);
+	skinnedMeshes.push_back(mesh);
 
-	//Setup attachment array
-	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+	//The second joint sits at the bottom of the sphere
+	std::shared_ptr<Skeleton> skeleton = std::make_shared<Skeleton>();
+	skeleton->parents = { -1, 0 };
+	skeleton->inverseBindMatrices = { glm::mat4(1.0f), glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.5f, 0.0f)) };
 
-	//Setup Create Info
-	VkRenderPassCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-	createInfo.pAttachments = attachments.data();
-	createInfo.subpassCount = 1;
-	createInfo.pSubpasses = &subpassDescription;
-	createInfo.dependencyCount = 1;
-	createInfo.pDependencies = &dependency;
+	const uint32_t frameCount = 30;
+	std::shared_ptr<AnimationClip> sway = std::make_shared<AnimationClip>(skeleton->GetJointCount(), frameCount, 30.0f);
 
-	//Create Render Pass
-	if (vkCreateRenderPass(logicalDevice, &createInfo, nullptr, &renderPass) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create Render Pass!");
+	for (uint32_t frame = 0; frame < frameCount; frame++) {
+		float angle = 0.5f * sinf(glm::radians(360.0f) * frame / frameCount);
+		sway->GetPose(frame, 1) = JointPose(glm::vec3(0.0f, -0.5f, 0.0f), glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f)));
 	}
-}
+
+	uint32_t model = skinning.AddModel(mesh, skeleton);
+
+	//A crowd behind the scene, all of them are skinned by the same dispatch
+	for (int z = 0; z < 16; z++) {
+		for (int x = 0; x < 16; x++) {
+			std::shared_ptr<Transform> transform = std::make_shared<Transform>(glm::vec3(-6.0f + 0.8f * x, 0.0f, -4.0f - 0.8f * z), glm::quat(glm::vec3(0.0f, 0.0f, 0.0f)), glm::vec3(0.4f, 0.4f, 0.4f));
+			skinning.AddCharacter(model, sway, transform, 0.05f * (x + z));
+		}
+	}
+}
+
+VkPipeline TriangleApp::CreateSkinningPipeline()
+{
+	VkShaderModule skinShaderModule = CreateShaderModule(LoadShaderCode("shaders/skin.spv"));
+	VkPipeline oldPipeline;
+
+	try {
+		oldPipeline = skinning.CreatePipeline(skinShaderModule);
+	}
+	catch (...) {
+		vkDestroyShaderModule(logicalDevice, skinShaderModule, nullptr);
+		throw;
+	}
+
+	vkDestroyShaderModule(logicalDevice, skinShaderModule, nullptr);
+
+	return oldPipeline;
+}
+
+VkPipeline TriangleApp::GetDepthPipeline(InstanceFormat format)
+{
+	VkPipeline& depthPipeline = depthPipelines[static_cast<size_t>(format)];
+
+	if (depthPipeline == VK_NULL_HANDLE) {
+		PipelineKey depthKey;
+		depthKey.instanceFormat = format;
+		depthPipeline = CreateGraphicsPipeline(depthKey, depthShaderModule, VK_NULL_HANDLE);
+	}
+
+	return depthPipeline;
+}
+
+VkPipeline TriangleApp::GetPipeline(const PipelineKey& key, bool latePass)
+{
+	std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash>& passPipelines = latePass ? latePipelines : pipelines;
+	auto pipeline = passPipelines.find(key);
+
+	if (pipeline != passPipelines.end()) {
+		return pipeline->second;
+	}
+
+	VkPipeline newPipeline = CreateGraphicsPipeline(key, vertexShaderModule, fragmentShaderModule, latePass);
+	passPipelines[key] = newPipeline;
+
+	return newPipeline;
+}
+
+void TriangleApp::DestroyPipelines()
+{
+	for (auto& pipeline : pipelines) {
+		vkDestroyPipeline(logicalDevice, pipeline.second, nullptr);
+	}
+
+	for (auto& pipeline : latePipelines) {
+		vkDestroyPipeline(logicalDevice, pipeline.second, nullptr);
+	}
+
+	pipelines.clear();
+	latePipelines.clear();
+}
+
+void TriangleApp::ReloadShaders()
+{
+	std::vector<std::string> compiledShaders = shaderManager.PollCompiledShaders();
+
+	if (compiledShaders.empty()) {
+		return;
+	}
+
+	//Compute passes only depend on their own shaders so each can be swapped on its own
+	const std::array<ComputeShaderReload, 4> computeReloads = { {
+		{ { "shaders/cluster.spv" }, [this]() { return std::vector<VkPipeline>{ CreateLightClusterPipeline() }; } },
+		{ { "shaders/cull.spv", "shaders/hiz.spv" }, [this]() {
+			if (!occlusionCullingSupported) {
+				return std::vector<VkPipeline>();
+			}
+
+			std::array<VkPipeline, 3> oldPipelines = CreateOcclusionCullingPipelines();
+			return std::vector<VkPipeline>(oldPipelines.begin(), oldPipelines.end());
+		} },
+		{ { "shaders/particles.spv" }, [this]() {
+			std::array<VkPipeline, 2> oldPipelines = CreateParticlePipelines();
+			return std::vector<VkPipeline>(oldPipelines.begin(), oldPipelines.end());
+		} },
+		{ { "shaders/skin.spv" }, [this]() { return std::vector<VkPipeline>{ CreateSkinningPipeline() }; } }
+	} };
+
+	for (const ComputeShaderReload& reload : computeReloads) {
+		ReloadComputePass(compiledShaders, reload);
+	}
+
+	if (compiledShaders.empty()) {
+		return;
+	}
+
+	//The depth pre-pass has its own vertex shader
+	if (std::find(compiledShaders.begin(), compiledShaders.end(), "shaders/depth.spv") != compiledShaders.end()) {
+		VkShaderModule newDepthModule = VK_NULL_HANDLE;
+
+		try {
+			newDepthModule = CreateShaderModule(ReadFile("shaders/depth.spv"));
+
+			//Only the instance formats that have been drawn have a pipeline, the rest compile from the new module when they are first used
+			std::array<VkPipeline, INSTANCE_FORMAT_COUNT> newDepthPipelines = {};
+
+			try {
+				for (size_t i = 0; i < depthPipelines.size(); i++) {
+					if (depthPipelines[i] != VK_NULL_HANDLE) {
+						PipelineKey depthKey;
+						depthKey.instanceFormat = static_cast<InstanceFormat>(i);
+						newDepthPipelines[i] = CreateGraphicsPipeline(depthKey, newDepthModule, VK_NULL_HANDLE);
+					}
+				}
+			}
+			catch (...) {
+				for (VkPipeline pipeline : newDepthPipelines) {
+					if (pipeline != VK_NULL_HANDLE) {
+						vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+					}
+				}
+
+				throw;
+			}
+
+			for (VkPipeline pipeline : depthPipelines) {
+				if (pipeline != VK_NULL_HANDLE) {
+					retiredPipelines.push_back(std::make_pair(pipeline, frameCount + MAX_FRAMES_IN_FLIGHT));
+				}
+			}
+
+			depthPipelines = newDepthPipelines;
+			MarkCommandBuffersDirty();
+
+			vkDestroyShaderModule(logicalDevice, depthShaderModule, nullptr);
+			depthShaderModule = newDepthModule;
+		}
+		catch (const std::exception& e) {
+			if (newDepthModule != VK_NULL_HANDLE) {
+				vkDestroyShaderModule(logicalDevice, newDepthModule, nullptr);
+			}
+
+			std::cerr << "Shader reload failed: " << e.what() << std::endl;
+		}
+
+		compiledShaders.erase(std::remove(compiledShaders.begin(), compiledShaders.end(), "shaders/depth.spv"), compiledShaders.end());
+
+		if (compiledShaders.empty()) {
+			return;
+		}
+	}
+
+	//Rebuild every permutation in use up front so the old ones keep drawing if the new shaders do not build
+	VkShaderModule newVertexModule = VK_NULL_HANDLE;
+	VkShaderModule newFragmentModule = VK_NULL_HANDLE;
+	std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> newPipelines;
+	std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> newLatePipelines;
+
+	try {
+		newVertexModule = CreateShaderModule(ReadFile("shaders/vert.spv"));
+		newFragmentModule = CreateShaderModule(ReadFile("shaders/frag.spv"));
+
+		for (auto& pipeline : pipelines) {
+			newPipelines[pipeline.first] = CreateGraphicsPipeline(pipeline.first, newVertexModule, newFragmentModule);
+		}
+
+		for (auto& pipeline : latePipelines) {
+			newLatePipelines[pipeline.first] = CreateGraphicsPipeline(pipeline.first, newVertexModule, newFragmentModule, true);
+		}
+	}
+	catch (const std::exception& e) {
+		for (auto& pipeline : newPipelines) {
+			vkDestroyPipeline(logicalDevice, pipeline.second, nullptr);
+		}
+
+		for (auto& pipeline : newLatePipelines) {
+			vkDestroyPipeline(logicalDevice, pipeline.second, nullptr);
+		}
+
+		if (newVertexModule != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(logicalDevice, newVertexModule, nullptr);
+		}
+
+		if (newFragmentModule != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(logicalDevice, newFragmentModule, nullptr);
+		}
+
+		std::cerr << "Shader reload failed: " << e.what() << std::endl;
+		return;
+	}
+
+	//Frames that are already in flight may still be using the old pipelines
+	for (auto& pipeline : pipelines) {
+		retiredPipelines.push_back(std::make_pair(pipeline.second, frameCount + MAX_FRAMES_IN_FLIGHT));
+	}
+
+	for (auto& pipeline : latePipelines) {
+		retiredPipelines.push_back(std::make_pair(pipeline.second, frameCount + MAX_FRAMES_IN_FLIGHT));
+	}
+
+	pipelines.swap(newPipelines);
+	latePipelines.swap(newLatePipelines);
+
+	//Pipelines do not reference their modules once created so the old ones can go straight away
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+	vertexShaderModule = newVertexModule;
+	fragmentShaderModule = newFragmentModule;
+
+	MarkCommandBuffersDirty();
+
+	if (enableValidationLayers) {
+		std::cout << "Reloaded shaders" << std::endl;
+	}
+}
+
+void TriangleApp::ReloadComputePass(std::vector<std::string>& compiledShaders, const ComputeShaderReload& reload)
+{
+	bool compiled = false;
+
+	for (const std::string& shader : reload.shaders) {
+		if (std::find(compiledShaders.begin(), compiledShaders.end(), shader) != compiledShaders.end()) {
+			compiled = true;
+			compiledShaders.erase(std::remove(compiledShaders.begin(), compiledShaders.end(), shader), compiledShaders.end());
+		}
+	}
+
+	if (!compiled) {
+		return;
+	}
+
+	//The old pipelines keep running if the new shaders do not build
+	try {
+		std::vector<VkPipeline> oldPipelines = reload.recreate();
+
+		if (oldPipelines.empty()) {
+			return;
+		}
+
+		//Frames that are already in flight may still be using the old pipelines
+		for (VkPipeline oldPipeline : oldPipelines) {
+			retiredPipelines.push_back(std::make_pair(oldPipeline, frameCount + MAX_FRAMES_IN_FLIGHT));
+		}
+
+		MarkCommandBuffersDirty();
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Shader reload failed: " << e.what() << std::endl;
+	}
+}
+
+void TriangleApp::DestroyRetiredPipelines(bool force)
+{
+	for (size_t i = 0; i < retiredPipelines.size();) {
+		if (force || retiredPipelines[i].second <= frameCount) {
+			vkDestroyPipeline(logicalDevice, retiredPipelines[i].first, nullptr);
+			retiredPipelines.erase(retiredPipelines.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+void TriangleApp::ReserveInstanceBuffers()
+{
+	totalInstanceCount = 0;
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		std::shared_ptr<Buffer> oldBuffer = meshes[i].ReserveInstances(meshes[i].GetActiveInstanceCount(), static_cast<uint32_t>(swapChainImages.size()));
+		totalInstanceCount += meshes[i].GetActiveInstanceCount();
+
+		//Command buffers that are still in flight bind the old buffer, every image is re-recorded with the new one
+		if (oldBuffer != nullptr) {
+			retiredBuffers.push_back(std::make_pair(oldBuffer, frameCount + MAX_FRAMES_IN_FLIGHT));
+			MarkCommandBuffersDirty();
+		}
+	}
+}
+
+bool TriangleApp::OcclusionCullingFits()
+{
+	uint32_t instanceCount = 0;
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		instanceCount += meshes[i].GetActiveInstanceCount();
+	}
+
+	return instanceCount <= occlusionCulling.GetMaxInstances() && meshes.size() <= occlusionCulling.GetMaxMeshes();
+}
+
+void TriangleApp::SetInstanceFormat(InstanceFormat format)
+{
+	InstanceFormat previousFormat = instanceFormat;
+	std::vector<PipelineKey> previousKeys;
+	instanceFormat = format;
+
+	//Each mesh replaces its instance buffer with one in the new layout the next time it is reserved
+	for (size_t i = 0; i < meshes.size(); i++) {
+		PipelineKey key = meshes[i].GetPipelineKey();
+		previousKeys.push_back(key);
+		key.instanceFormat = format;
+		meshes[i].SetPipelineKey(key);
+	}
+
+	//The cull pass copies instances into the visible instance buffer in the layout the draws read
+	if (occlusionCullingSupported) {
+		occlusionCulling.SetInstanceFormat(format);
+
+		//The old format keeps drawing if the cull shaders do not build for the new one
+		try {
+			for (VkPipeline oldPipeline : CreateOcclusionCullingPipelines()) {
+				retiredPipelines.push_back(std::make_pair(oldPipeline, frameCount + MAX_FRAMES_IN_FLIGHT));
+			}
+		}
+		catch (const std::exception& e) {
+			instanceFormat = previousFormat;
+			occlusionCulling.SetInstanceFormat(previousFormat);
+
+			for (size_t i = 0; i < meshes.size(); i++) {
+				meshes[i].SetPipelineKey(previousKeys[i]);
+			}
+
+			std::cerr << "Instance format change failed: " << e.what() << std::endl;
+			return;
+		}
+	}
+
+	MarkCommandBuffersDirty();
+
+	std::cout << "Instance format: " << TransformData::GetStride(format) << " bytes per instance" << std::endl;
+}
+
+void TriangleApp::DestroyRetiredBuffers(bool force)
+{
+	for (size_t i = 0; i < retiredBuffers.size();) {
+		if (force || retiredBuffers[i].second <= frameCount) {
+			retiredBuffers[i].first->Cleanup();
+			retiredBuffers.erase(retiredBuffers.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+uint32_t TriangleApp::GetInstanceReallocationCount()
+{
+	uint32_t count = 0;
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		count += meshes[i].GetInstanceReallocationCount();
+	}
+
+	return count;
+}
+
+void TriangleApp::CreateDescriptorSetLayout()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings(6);
+
+	bindings[0] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[0].pImmutableSamplers = nullptr;
+
+	bindings[1] = {};
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].pImmutableSamplers = nullptr;
+
+	bindings[2] = {};
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[2].pImmutableSamplers = nullptr;
+
+	//Lights, cluster light counts and cluster light indices
+	for (uint32_t i = 3; i < 6; i++) {
+		bindings[i] = {};
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	createInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &createInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor set layout");
+	}
+}
+
+void TriangleApp::CreateDescriptorPool()
+{
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * 3;
+
+	VkDescriptorPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	createInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	createInfo.pPoolSizes = poolSizes.data();
+	createInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+
+	if (vkCreateDescriptorPool(logicalDevice, &createInfo, nullptr, &descriptorPool)) {
+		throw std::runtime_error("Failed to create Descriptor Pool!");
+	}
+}
+
+void TriangleApp::CreateDescriptorSets()
+{
+	std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = descriptorPool;
+	allocateInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+	allocateInfo.pSetLayouts = layouts.data();
+
+	descriptorSets.resize(swapChainImages.size());
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocateInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < uniformBuffers.size(); i++) {
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = uniformBuffers[i]->GetBuffer();
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+		descriptorWrite.pImageInfo = nullptr;
+		descriptorWrite.pTexelBufferView = nullptr;
+
+		vkUpdateDescriptorSets(logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+		//Bind the light and cluster buffers for this image
+		std::array<VkDescriptorBufferInfo, 3> lightBufferInfos = {};
+		lightBufferInfos[0].buffer = lightClusters.GetLightBuffer(static_cast<uint32_t>(i));
+		lightBufferInfos[0].range = VK_WHOLE_SIZE;
+		lightBufferInfos[1].buffer = lightClusters.GetClusterBuffer(static_cast<uint32_t>(i));
+		lightBufferInfos[1].range = VK_WHOLE_SIZE;
+		lightBufferInfos[2].buffer = lightClusters.GetLightIndexBuffer(static_cast<uint32_t>(i));
+		lightBufferInfos[2].range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 3> lightDescriptorWrites = {};
+		for (size_t j = 0; j < lightDescriptorWrites.size(); j++) {
+			lightDescriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			lightDescriptorWrites[j].dstSet = descriptorSets[i];
+			lightDescriptorWrites[j].dstBinding = static_cast<uint32_t>(j + 3);
+			lightDescriptorWrites[j].dstArrayElement = 0;
+			lightDescriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			lightDescriptorWrites[j].descriptorCount = 1;
+			lightDescriptorWrites[j].pBufferInfo = &lightBufferInfos[j];
+			lightDescriptorWrites[j].pImageInfo = nullptr;
+			lightDescriptorWrites[j].pTexelBufferView = nullptr;
+		}
+
+		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(lightDescriptorWrites.size()), lightDescriptorWrites.data(), 0, nullptr);
+	}
+
+	descriptorTextureVersions.resize(descriptorSets.size());
+	for (size_t i = 0; i < descriptorSets.size(); i++) {
+		UpdateTextureDescriptors(i);
+	}
+}
+
+void TriangleApp::CreateRenderPass()
+{
+	//Setup Color Attachment
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format = swapChainImageFormat;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	//Setup Depth Attachment
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = FindDepthFormat();
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	//With occlusion culling the depth is kept for the pyramid and the late render pass presents the image
+	if (occlusionCullingEnabled) {
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	//Setup Subpass
+	VkAttachmentReference colorAttachmentReference = {};
+	colorAttachmentReference.attachment = 0;
+	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentReference = {};
+	depthAttachmentReference.attachment = 1;
+	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	//The depth pre-pass only writes depth, the color pass then tests against it
+	VkSubpassDescription depthSubpassDescription = {};
+	depthSubpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	depthSubpassDescription.colorAttachmentCount = 0;
+	depthSubpassDescription.pColorAttachments = nullptr;
+	depthSubpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorAttachmentReference;
+	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
+
+	std::vector<VkSubpassDescription> subpasses;
+	if (depthPrePass) {
+		subpasses.push_back(depthSubpassDescription);
+	}
+	subpasses.push_back(subpassDescription);
+	
+	//Setup Subpass Dependencies
+	std::vector<VkSubpassDependency> dependencies;
+
+	//The depth buffer is shared between frames so the previous frame's depth tests have to finish before it is cleared
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependency.srcAccessMask = 0;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies.push_back(dependency);
+
+	if (depthPrePass) {
+		//The color pass reads the depth written by the pre-pass
+		VkSubpassDependency depthDependency = {};
+		depthDependency.srcSubpass = 0;
+		depthDependency.dstSubpass = 1;
+		depthDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		depthDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies.push_back(depthDependency);
+	}
+
+	if (occlusionCullingEnabled) {
+		//The pyramid is built from the depth once the render pass ends
+		VkSubpassDependency pyramidDependency = {};
+		pyramidDependency.srcSubpass = static_cast<uint32_t>(subpasses.size() - 1);
+		pyramidDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		pyramidDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		pyramidDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		pyramidDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		pyramidDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies.push_back(pyramidDependency);
+	}
+
+	//Setup attachment array
+	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+
+	//Setup Create Info
+	VkRenderPassCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	createInfo.pAttachments = attachments.data();
+	createInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+	createInfo.pSubpasses = subpasses.data();
+	createInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	createInfo.pDependencies = dependencies.data();
+
+	//Create Render Pass
+	if (vkCreateRenderPass(logicalDevice, &createInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Render Pass!");
+	}
+}
+
+void TriangleApp::CreateLateRenderPass()
+{
+	if (!occlusionCullingEnabled) {
+		return;
+	}
+
+	//Keeps everything the first render pass drew and presents the image when done
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format = swapChainImageFormat;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = FindDepthFormat();
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentReference = {};
+	colorAttachmentReference.attachment = 0;
+	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentReference = {};
+	depthAttachmentReference.attachment = 1;
+	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorAttachmentReference;
+	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
+
+	//The first render pass has to finish writing color and the pyramid has to finish reading depth
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+
+	VkRenderPassCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	createInfo.pAttachments = attachments.data();
+	createInfo.subpassCount = 1;
+	createInfo.pSubpasses = &subpassDescription;
+	createInfo.dependencyCount = 1;
+	createInfo.pDependencies = &dependency;
+
+	if (vkCreateRenderPass(logicalDevice, &createInfo, nullptr, &lateRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Late Render Pass!");
+	}
+}
 
 VkShaderModule TriangleApp::CreateShaderModule(const std::vector<char>& code)
 {
@@ -1538,53 +3065,90 @@ VkShaderModule TriangleApp::CreateShaderModule(const std::vector<char>& code)
 
 #pragma region Mesh Management
 
-void TriangleApp::CreateVertexBuffer(int index)
+void TriangleApp::CreateVertexBuffer(Mesh& mesh)
 {
 	//Create the staging buffer
-	VkDeviceSize bufferSize = sizeof(meshes[index].GetVertices()[0]) * meshes[index].GetVertices().size();
+	VkDeviceSize bufferSize = sizeof(mesh.GetVertices()[0]) * mesh.GetVertices().size();
 	Buffer stagingBuffer;
 
-	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
 	
 	//Map vertex data to the buffer
 	void* data;
 	vkMapMemory(logicalDevice, stagingBuffer.GetBufferMemory(), 0, bufferSize, 0, &data);
-	memcpy(data, meshes[index].GetVertices().data(), bufferSize);
+	memcpy(data, mesh.GetVertices().data(), bufferSize);
 	vkUnmapMemory(logicalDevice, stagingBuffer.GetBufferMemory());
 
 	//Create the vertex buffer
-	vertexBuffers[index] = std::make_shared<Buffer>();
-	meshes[index].SetVertexBuffer(vertexBuffers[index]);
-	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *vertexBuffers[index]);
+	std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+	vertexBuffers.push_back(buffer);
+	mesh.SetVertexBuffer(buffer);
+	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Geometry, *buffer);
+
+	//Copy buffer data
+	Buffer::CopyBuffer(stagingBuffer.GetBuffer(), buffer->GetBuffer(), bufferSize);
+
+	//Cleanup staging buffer
+	stagingBuffer.Cleanup();
+}
+
+void TriangleApp::CreatePositionBuffer(Mesh& mesh)
+{
+	//Copy out only the positions so the depth pre-pass does not fetch the rest of each vertex
+	std::vector<Vertex> vertices = mesh.GetVertices();
+	std::vector<glm::vec3> positions(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		positions[i] = vertices[i].position;
+	}
+
+	//Create the staging buffer
+	VkDeviceSize bufferSize = sizeof(positions[0]) * positions.size();
+	Buffer stagingBuffer;
+
+	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
+
+	//Map position data to the buffer
+	void* data;
+	vkMapMemory(logicalDevice, stagingBuffer.GetBufferMemory(), 0, bufferSize, 0, &data);
+	memcpy(data, positions.data(), bufferSize);
+	vkUnmapMemory(logicalDevice, stagingBuffer.GetBufferMemory());
+
+	//Create the position buffer
+	std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+	positionBuffers.push_back(buffer);
+	mesh.SetPositionBuffer(buffer);
+	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Geometry, *buffer);
 
 	//Copy buffer data
-	Buffer::CopyBuffer(stagingBuffer.GetBuffer(), vertexBuffers[index]->GetBuffer(), bufferSize);
+	Buffer::CopyBuffer(stagingBuffer.GetBuffer(), buffer->GetBuffer(), bufferSize);
 
 	//Cleanup staging buffer
 	stagingBuffer.Cleanup();
 }
 
-void TriangleApp::CreateIndexBuffer(int index)
+void TriangleApp::CreateIndexBuffer(Mesh& mesh)
 {
 	//Create the staging buffer
-	VkDeviceSize bufferSize = sizeof(meshes[index].GetIndices()[0]) * meshes[index].GetIndices().size();
+	VkDeviceSize bufferSize = sizeof(mesh.GetIndices()[0]) * mesh.GetIndices().size();
 	Buffer stagingBuffer;
 
-	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, stagingBuffer);
 
 	//Map index data to the buffer
 	void* data;
 	vkMapMemory(logicalDevice, stagingBuffer.GetBufferMemory(), 0, bufferSize, 0, &data);
-	memcpy(data, meshes[index].GetIndices().data(), bufferSize);
+	memcpy(data, mesh.GetIndices().data(), bufferSize);
 	vkUnmapMemory(logicalDevice, stagingBuffer.GetBufferMemory());
 
 	//Create the index buffer
-	indexBuffers[index] = std::make_shared<Buffer>();
-	meshes[index].SetIndexBuffer(indexBuffers[index]);
-	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *indexBuffers[index]);
+	std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+	indexBuffers.push_back(buffer);
+	mesh.SetIndexBuffer(buffer);
+	Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Geometry, *buffer);
 
 	//Copy buffer data
-	Buffer::CopyBuffer(stagingBuffer.GetBuffer(), indexBuffers[index]->GetBuffer(), bufferSize);
+	Buffer::CopyBuffer(stagingBuffer.GetBuffer(), buffer->GetBuffer(), bufferSize);
 
 	//Cleanup staging buffer
 	stagingBuffer.Cleanup();
@@ -1598,21 +3162,30 @@ void TriangleApp::CreateUniformBuffers()
 
 	for (size_t i = 0; i < uniformBuffers.size(); i++) {
 		uniformBuffers[i] = std::make_shared<Buffer>();
-		Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *uniformBuffers[i]);
+		Buffer::CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Uniforms, *uniformBuffers[i]);
 	}
 }
 
-void TriangleApp::UpdateUniformBuffers(uint32_t currentImage)
+VkDeviceSize TriangleApp::UpdateUniformBuffers(uint32_t currentImage)
 {
 	//Setup the view and projection matrices
 	UniformBufferObject ubo = {};
 	ubo.view = camera->GetView();
 	ubo.projection = camera->GetProjection();
 
+	//Used by the light cluster pass to find cluster bounds and by the fragment shader to find its cluster
+	ubo.inverseProjection = glm::inverse(ubo.projection);
+	ubo.screenSize = glm::vec2(swapChainExtent.width, swapChainExtent.height);
+	ubo.nearPlane = camera->GetNearPlane();
+	ubo.farPlane = camera->GetFarPlane();
+	ubo.lightCount = lightClusters.GetLightCount();
+
 	void* data;
 	vkMapMemory(logicalDevice, uniformBuffers[currentImage]->GetBufferMemory(), 0, sizeof(ubo), 0, &data);
 	memcpy(data, &ubo, sizeof(ubo));
 	vkUnmapMemory(logicalDevice, uniformBuffers[currentImage]->GetBufferMemory());
+
+	return sizeof(ubo);
 }
 
 uint32_t TriangleApp::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -1626,7 +3199,7 @@ uint32_t TriangleApp::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
 		}
 	}
 
-	throw std::exception("Failed to find suitable memory type!");
+	throw std::runtime_error("Failed to find suitable memory type!");
 }
 
 #pragma endregion
@@ -1642,11 +3215,24 @@ void TriangleApp::CreateCommandPool()
 	VkCommandPoolCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	createInfo.queueFamilyIndex = queueFamilies.graphicsFamily.value();
-	createInfo.flags = 0;
+	createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	if (vkCreateCommandPool(logicalDevice, &createInfo, nullptr, &Command::commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Command Pool!");
 	}
+
+	//Streamed texture levels are copied by their own command buffers so the pre-recorded draws don't change when a level streams in
+	uploadCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = Command::commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = static_cast<uint32_t>(uploadCommandBuffers.size());
+
+	if (vkAllocateCommandBuffers(logicalDevice, &allocateInfo, uploadCommandBuffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate upload Command Buffers!");
+	}
 }
 
 void TriangleApp::CreateCommandBuffers()
@@ -1663,62 +3249,390 @@ void TriangleApp::CreateCommandBuffers()
 		throw std::runtime_error("Failed to allocate Command Buffers");
 	}
 
+	commandBufferDirty.assign(commandBuffers.size(), false);
+	recordedDrawOrders.resize(commandBuffers.size());
+	recordedVisibleCounts.resize(commandBuffers.size());
+	recordedInstanceCounts.resize(commandBuffers.size());
+	recordedDrawCalls.resize(commandBuffers.size());
+
+	UpdateDrawOrder();
+	UpdateInstanceBVH();
+	UpdateVisibleInstances();
+
 	for (size_t i = 0; i < commandBuffers.size(); i++) {
-		//Setup command
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+		RecordCommandBuffer(i);
+	}
+}
+
+void TriangleApp::RecordCommandBuffer(size_t i)
+{
+	//Setup command
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording Command Buffer!");
+	}
+
+	//Time everything the command buffer does, from the first dispatch to the last draw
+	if (timestampsSupported) {
+		vkCmdResetQueryPool(commandBuffers[i], timestampQueryPool, static_cast<uint32_t>(i) * 2, 2);
+		vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, static_cast<uint32_t>(i) * 2);
+	}
+
+	uint32_t drawCalls = 0;
+
+	//Bin the lights into clusters before any fragments are shaded
+	lightClusters.RecordDispatch(commandBuffers[i], static_cast<uint32_t>(i));
+
+	//Move the particles and write their draw, the simulation runs every time the command buffer is submitted
+	particles.RecordSimulation(commandBuffers[i], static_cast<uint32_t>(i));
+
+	//Skin every character into the output vertex buffer
+	skinning.RecordDispatch(commandBuffers[i], static_cast<uint32_t>(i));
+
+	//Find the instances that were visible last frame, the rest are re-tested after the first render pass
+	uint32_t objectCount = 0;
+	for (size_t j = 0; j < meshes.size(); j++) {
+		objectCount += meshes[j].GetActiveInstanceCount();
+	}
+
+	recordedInstanceCounts[i] = objectCount;
+
+	if (occlusionCullingEnabled) {
+		occlusionCulling.RecordEarlyCull(commandBuffers[i], static_cast<uint32_t>(i), objectCount);
+	}
+
+	if (pipelineStatisticsSupported) {
+		vkCmdResetQueryPool(commandBuffers[i], statisticsQueryPool, static_cast<uint32_t>(i), 1);
+	}
+
+	//Setup render pass
+	VkRenderPassBeginInfo renderPassBeginInfo = {};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.renderPass = renderPass;
+	renderPassBeginInfo.framebuffer = swapChainFrameBuffers[i];
+	renderPassBeginInfo.renderArea.extent = swapChainExtent;
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+
+	std::array<VkClearValue, 2> clearColors = {};
+	clearColors[0] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	clearColors[1].depthStencil = { 1.0f, 0 };
+
+	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearColors.size());
+	renderPassBeginInfo.pClearValues = clearColors.data();
+
+	//Setup commands
+	vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	//Every permutation shares the pipeline layout so the descriptor set stays bound across pipeline changes
+	vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+
+	//Lay down depth for every mesh before anything is shaded
+	if (depthPrePass) {
+		drawCalls += RecordParticleDraws(commandBuffers[i], true);
+		drawCalls += RecordSkinnedDraws(commandBuffers[i], true);
+		drawCalls += RecordMeshDraws(commandBuffers[i], static_cast<uint32_t>(i), true, false);
+
+		vkCmdNextSubpass(commandBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	if (pipelineStatisticsSupported) {
+		vkCmdBeginQuery(commandBuffers[i], statisticsQueryPool, static_cast<uint32_t>(i), 0);
+	}
+
+	//Particles are opaque so they go before the meshes, transparent meshes blend over them
+	drawCalls += RecordParticleDraws(commandBuffers[i], false);
+	drawCalls += RecordSkinnedDraws(commandBuffers[i], false);
+	drawCalls += RecordMeshDraws(commandBuffers[i], static_cast<uint32_t>(i), false, false);
+
+	if (pipelineStatisticsSupported) {
+		vkCmdEndQuery(commandBuffers[i], statisticsQueryPool, static_cast<uint32_t>(i));
+	}
+
+	vkCmdEndRenderPass(commandBuffers[i]);
+
+	//Build the pyramid from what was just drawn and draw anything that was hidden last frame but is visible now
+	if (occlusionCullingEnabled) {
+		occlusionCulling.RecordBuildPyramid(commandBuffers[i]);
+		occlusionCulling.RecordLateCull(commandBuffers[i], static_cast<uint32_t>(i), objectCount);
+
+		VkRenderPassBeginInfo lateRenderPassBeginInfo = {};
+		lateRenderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		lateRenderPassBeginInfo.renderPass = lateRenderPass;
+		lateRenderPassBeginInfo.framebuffer = lateFrameBuffers[i];
+		lateRenderPassBeginInfo.renderArea.extent = swapChainExtent;
+		lateRenderPassBeginInfo.renderArea.offset = { 0, 0 };
+		lateRenderPassBeginInfo.clearValueCount = 0;
+		lateRenderPassBeginInfo.pClearValues = nullptr;
+
+		vkCmdBeginRenderPass(commandBuffers[i], &lateRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		drawCalls += RecordMeshDraws(commandBuffers[i], static_cast<uint32_t>(i), false, true);
+		vkCmdEndRenderPass(commandBuffers[i]);
+	}
+
+	if (timestampsSupported) {
+		vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, static_cast<uint32_t>(i) * 2 + 1);
+	}
+
+	if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to end Command Buffer!");
+	}
+
+	commandBufferDirty[i] = false;
+	recordedDrawOrders[i] = drawOrder;
+	recordedVisibleCounts[i] = visibleInstanceCounts;
+	recordedDrawCalls[i] = drawCalls;
+}
+
+uint32_t TriangleApp::RecordMeshDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool depthOnly, bool latePhase)
+{
+	uint32_t drawCount = 0;
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	bool constantsPushed = false;
+	DrawConstants pushedConstants;
+
+	for (uint32_t j : drawOrder) {
+		//Transparent meshes would hide what is behind them if they were in the pre-pass
+		if (depthOnly && meshes[j].GetPipelineKey().transparent) {
+			continue;
+		}
+
+		//Meshes with every instance outside the frustum have nothing to draw
+		if (!occlusionCullingEnabled && visibleInstanceCounts[j] == 0) {
+			continue;
+		}
+
+		VkPipeline pipeline = depthOnly ? GetDepthPipeline(meshes[j].GetPipelineKey().instanceFormat) : GetPipeline(meshes[j].GetPipelineKey(), latePhase);//Per material
+
+		if (pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
+
+		//Push constants survive pipeline changes so they are only pushed when they differ from the last draw
+		if (!depthOnly && (!constantsPushed || meshes[j].GetDrawConstants() != pushedConstants)) {
+			pushedConstants = meshes[j].GetDrawConstants();
+			pushedConstants.push(commandBuffer, pipelineLayout);
+			constantsPushed = true;
+		}
 
-		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to begin recording Command Buffer!");
+		//The depth pre-pass only reads positions, culled draws read the transforms the cull pass found visible
+		VkBuffer vertexBuffers[] = {
+			depthOnly ? meshes[j].GetPositionBuffer()->GetBuffer() : meshes[j].GetVertexBuffer()->GetBuffer(),
+			occlusionCullingEnabled ? occlusionCulling.GetVisibleInstanceBuffer() : meshes[j].GetInstanceBuffer()->GetBuffer()
+		};
+		VkDeviceSize offsets[] = { 0, occlusionCullingEnabled ? 0 : meshes[j].GetInstanceBufferOffset(imageIndex) };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);//Per mesh
+
+		vkCmdBindIndexBuffer(commandBuffer, meshes[j].GetIndexBuffer()->GetBuffer(), 0, VK_INDEX_TYPE_UINT16);//Per mesh
+
+		if (occlusionCullingEnabled) {
+			vkCmdDrawIndexedIndirect(commandBuffer, occlusionCulling.GetDrawBuffer(), occlusionCulling.GetDrawOffset(j, latePhase), 1, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else {
+			vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(meshes[j].GetIndices().size()), visibleInstanceCounts[j], 0, 0, 0);//Per mesh
 		}
 
-		//Setup render pass
-		VkRenderPassBeginInfo renderPassBeginInfo = {};
-		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassBeginInfo.renderPass = renderPass;
-		renderPassBeginInfo.framebuffer = swapChainFrameBuffers[i];
-		renderPassBeginInfo.renderArea.extent = swapChainExtent;
-		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		drawCount++;
+	}
+
+	return drawCount;
+}
+
+uint32_t TriangleApp::RecordParticleDraws(VkCommandBuffer commandBuffer, bool depthOnly)
+{
+	VkPipeline pipeline = depthOnly ? GetDepthPipeline(particleMesh.GetPipelineKey().instanceFormat) : GetPipeline(particleMesh.GetPipelineKey());
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	if (!depthOnly) {
+		particleMesh.GetDrawConstants().push(commandBuffer, pipelineLayout);
+	}
+
+	//The simulation writes a transform per living particle in the same layout as a mesh instance buffer
+	VkBuffer vertexBuffers[] = {
+		depthOnly ? particleMesh.GetPositionBuffer()->GetBuffer() : particleMesh.GetVertexBuffer()->GetBuffer(),
+		particles.GetInstanceBuffer()
+	};
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+
+	vkCmdBindIndexBuffer(commandBuffer, particleMesh.GetIndexBuffer()->GetBuffer(), 0, VK_INDEX_TYPE_UINT16);
 
-		std::array<VkClearValue, 2> clearColors = {};
-		clearColors[0] = { 0.0f, 0.0f, 0.0f, 1.0f };
-		clearColors[1].depthStencil = { 1.0f, 0 };
+	//The instance count is written by the simulation so the CPU never reads it back
+	vkCmdDrawIndexedIndirect(commandBuffer, particles.GetDrawBuffer(), 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+
+	return 1;
+}
 
-		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearColors.size());
-		renderPassBeginInfo.pClearValues = clearColors.data();
+uint32_t TriangleApp::RecordSkinnedDraws(VkCommandBuffer commandBuffer, bool depthOnly)
+{
+	if (skinning.GetCharacterCount() == 0) {
+		return 0;
+	}
 
-		//Setup commands
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	//Every character reads its vertices from the same output buffer, already in world space
+	VkBuffer vertexBuffers[] = {
+		depthOnly ? skinning.GetOutputPositionBuffer() : skinning.GetOutputVertexBuffer(),
+		skinning.GetInstanceBuffer()
+	};
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
-		//Begin Per Object Commands 
-		//TODO: Move this to work with multiple 
-		for (size_t j = 0; j < meshes.size(); j++) {
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);//Per material
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	std::shared_ptr<Mesh> boundMesh = nullptr;
 
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);//Per material
+	for (uint32_t i = 0; i < skinning.GetCharacterCount(); i++) {
+		std::shared_ptr<Mesh> mesh = skinning.GetCharacterMesh(i);
 
-			VkBuffer vertexBuffers[] = { meshes[j].GetVertexBuffer()->GetBuffer() };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);//Per mesh
+		if (mesh != boundMesh) {
+			VkPipeline pipeline = depthOnly ? GetDepthPipeline(mesh->GetPipelineKey().instanceFormat) : GetPipeline(mesh->GetPipelineKey());
 
-			VkBuffer instanceBuffers[] = { meshes[j].GetInstanceBuffer()->GetBuffer() };//Per Mesh
-			vkCmdBindVertexBuffers(commandBuffers[i], 1, 1, instanceBuffers, offsets);
+			if (pipeline != boundPipeline) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				boundPipeline = pipeline;
+			}
 
-			VkBuffer indexBuffers[] = { meshes[j].GetIndexBuffer()->GetBuffer() };
-			vkCmdBindIndexBuffer(commandBuffers[i], meshes[j].GetIndexBuffer()->GetBuffer(), 0, VK_INDEX_TYPE_UINT16);//Per mesh
+			if (!depthOnly) {
+				mesh->GetDrawConstants().push(commandBuffer, pipelineLayout);
+			}
 
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(meshes[j].GetIndices().size()), meshes[j].GetActiveInstanceCount(), 0, 0, 0);//Per mesh
+			vkCmdBindIndexBuffer(commandBuffer, mesh->GetIndexBuffer()->GetBuffer(), 0, VK_INDEX_TYPE_UINT16);
+			boundMesh = mesh;
 		}
-		//End Per object commands
 
-		vkCmdEndRenderPass(commandBuffers[i]);
+		//The vertex offset selects the character's copy of the skinned vertices
+		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(mesh->GetIndices().size()), 1, 0, static_cast<int32_t>(skinning.GetOutputOffset(i)), 0);
+	}
+
+	return skinning.GetCharacterCount();
+}
+
+void TriangleApp::MarkCommandBuffersDirty()
+{
+	for (size_t i = 0; i < commandBufferDirty.size(); i++) {
+		commandBufferDirty[i] = true;
+	}
+}
+
+void TriangleApp::UpdateDrawOrder()
+{
+	drawOrder.resize(meshes.size());
+
+	if (!drawSorting) {
+		for (size_t i = 0; i < meshes.size(); i++) {
+			drawOrder[i] = static_cast<uint32_t>(i);
+		}
+
+		return;
+	}
+
+	glm::mat4 view = camera->GetView();
+	float nearPlane = camera->GetNearPlane();
+	float depthRange = camera->GetFarPlane() - nearPlane;
+
+	renderQueue.Clear();
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		PipelineKey key = meshes[i].GetPipelineKey();
+		std::vector<std::shared_ptr<Transform>> instances = meshes[i].GetActiveInstances();
+
+		//Instances share one draw, opaque draws sort by their closest instance and transparent draws by their farthest
+		float depth = key.transparent ? 0.0f : 1.0f;
+		for (size_t j = 0; j < instances.size(); j++) {
+			float viewDepth = -(view * instances[j]->GetModelMatrix()[3]).z;
+			float instanceDepth = (viewDepth - nearPlane) / depthRange;
+
+			depth = key.transparent ? std::max(depth, instanceDepth) : std::min(depth, instanceDepth);
+		}
+
+		//Every mesh samples the same textures so they all share material 0
+		renderQueue.Submit(RenderQueue::MakeKey(key.transparent, renderQueue.GetPipelineId(key), 0, static_cast<uint32_t>(i), depth));
+	}
+
+	renderQueue.Sort();
+
+	const std::vector<uint64_t>& keys = renderQueue.GetKeys();
+	for (size_t i = 0; i < keys.size(); i++) {
+		drawOrder[i] = RenderQueue::GetMeshIndex(keys[i]);
+	}
+}
+
+void TriangleApp::CreateQueryPool()
+{
+	if (pipelineStatisticsSupported) {
+		VkQueryPoolCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		createInfo.queryCount = static_cast<uint32_t>(swapChainImages.size());
+		createInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		if (vkCreateQueryPool(logicalDevice, &createInfo, nullptr, &statisticsQueryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create Query Pool!");
+		}
+
+		statisticsPending.assign(swapChainImages.size(), false);
+	}
+
+	//A timestamp before and after each image's commands
+	if (timestampsSupported) {
+		VkQueryPoolCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		createInfo.queryCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
 
-		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to end Command Buffer!");
+		if (vkCreateQueryPool(logicalDevice, &createInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create Query Pool!");
 		}
+
+		timestampsPending.assign(swapChainImages.size(), false);
+	}
+}
+
+void TriangleApp::ReadPipelineStatistics(uint32_t imageIndex)
+{
+	if (!pipelineStatisticsSupported || !statisticsPending[imageIndex]) {
+		return;
+	}
+
+	uint64_t invocations = 0;
+	if (vkGetQueryPoolResults(logicalDevice, statisticsQueryPool, imageIndex, 1, sizeof(invocations), &invocations, sizeof(invocations), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
+	}
+
+	statisticsPending[imageIndex] = false;
+	fragmentInvocations += invocations;
+	statisticsFrames++;
+
+	//Print the average every few hundred frames, press P, O or R to compare with the pre-pass, occlusion culling or draw sorting toggled
+	if (statisticsFrames == 300) {
+		if (enableValidationLayers) {
+			std::cout << "Fragment shader invocations per frame: " << fragmentInvocations / statisticsFrames << " (depth pre-pass " << (depthPrePass ? "on" : "off") << ", occlusion culling " << (occlusionCullingEnabled ? "on" : "off") << ", draw sorting " << (drawSorting ? "on" : "off") << ")" << std::endl;
+			std::cout << "Instances: " << totalInstanceCount << " at " << TransformData::GetStride(instanceFormat) << " bytes each (instance buffer reallocations " << GetInstanceReallocationCount() << ")" << std::endl;
+		}
+
+		fragmentInvocations = 0;
+		statisticsFrames = 0;
+	}
+}
+
+void TriangleApp::ReadTimestamps(uint32_t imageIndex)
+{
+	if (!timestampsSupported || !timestampsPending[imageIndex]) {
+		return;
+	}
+
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(logicalDevice, timestampQueryPool, imageIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
 	}
+
+	//The period is in nanoseconds per tick
+	timestampsPending[imageIndex] = false;
+	gpuFrameTimeTotal += static_cast<double>((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod / 1000000.0;
+	gpuFrameTimeSamples++;
 }
 
 #pragma endregion
@@ -1828,6 +3742,95 @@ void TriangleApp::FrameBufferResizeCallback(GLFWwindow* window, int width, int h
 	app->frameBufferResized = true;
 }
 
+void TriangleApp::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	auto app = reinterpret_cast<TriangleApp*>(glfwGetWindowUserPointer(window));
+
+	//Applied at the start of the next frame since it rebuilds the render pass
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		app->depthPrePassToggled = true;
+	}
+
+	if (key == GLFW_KEY_O && action == GLFW_PRESS && app->occlusionCullingSupported) {
+		app->occlusionCullingToggled = true;
+	}
+
+	if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+		app->instanceFormatToggled = true;
+	}
+
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		app->memoryReportRequested = true;
+	}
+
+	//Instance buffers grow and shrink to fit at the start of the next frame
+	if (key == GLFW_KEY_EQUAL && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+		app->SpawnInstances(SPAWN_BATCH_SIZE);
+	}
+
+	if (key == GLFW_KEY_MINUS && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+		app->DespawnInstances(SPAWN_BATCH_SIZE);
+	}
+
+	//Changing the order is picked up by the per frame order check so it can be applied straight away
+	if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		app->drawSorting = !app->drawSorting;
+		app->fragmentInvocations = 0;
+		app->statisticsFrames = 0;
+	}
+}
+
+void TriangleApp::MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	auto app = reinterpret_cast<TriangleApp*>(glfwGetWindowUserPointer(window));
+
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+		double cursorX, cursorY;
+		glfwGetCursorPos(window, &cursorX, &cursorY);
+
+		RaycastHit hit;
+		if (app->Pick(cursorX, cursorY, hit)) {
+			std::cout << "Picked mesh " << hit.meshIndex << " instance " << hit.instanceId << " at distance " << hit.distance << std::endl;
+		}
+	}
+}
+
+void TriangleApp::MountAssetArchive()
+{
+	//Loose files are used as they are when there is no archive, packed with: VulkanTutorial --pack assets.vpak shaders textures
+	if (!std::filesystem::exists(ASSET_ARCHIVE_PATH)) {
+		return;
+	}
+
+	std::shared_ptr<AssetArchive> archive = std::make_shared<AssetArchive>();
+	archive->Open(ASSET_ARCHIVE_PATH);
+	assetManager.MountArchive(archive);
+}
+
+void TriangleApp::PreloadAssets()
+{
+	const std::vector<std::string> shaderPaths = {
+		"shaders/vert.spv",
+		"shaders/frag.spv",
+		"shaders/depth.spv",
+		"shaders/cluster.spv",
+		"shaders/cull.spv",
+		"shaders/hiz.spv",
+		"shaders/particles.spv",
+		"shaders/skin.spv"
+	};
+
+	for (size_t i = 0; i < shaderPaths.size(); i++) {
+		preloadedAssets.push_back(assetManager.Load(shaderPaths[i]));
+	}
+}
+
+std::vector<char> TriangleApp::LoadShaderCode(const std::string& filePath)
+{
+	//Shares the preloaded read if there is one, otherwise the file is read on a worker while this waits
+	return assetManager.Wait(assetManager.Load(filePath))->GetData();
+}
+
 std::vector<char> TriangleApp::ReadFile(const std::string& filePath)
 {
 	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
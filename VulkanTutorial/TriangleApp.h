@@ -4,9 +4,31 @@
 #include "Vertex.h"
 #include "TransformData.h"
 #include "Buffer.h"
+#include "Image.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "TextureAtlas.h"
+#include "ShaderManager.h"
+#include "PipelineKey.h"
+#include "LightClusters.h"
+#include "OcclusionCulling.h"
+#include "ParticleSystem.h"
+#include "Skinning.h"
+#include "RenderQueue.h"
 #include "UniformBufferObject.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "SceneGraph.h"
+#include "World.h"
+#include "Components.h"
+#include "InstanceBVH.h"
+#include "AssetManager.h"
+#include "Benchmark.h"
+#include "MemoryTelemetry.h"
+
+#include <optional>
+#include <unordered_map>
+#include <chrono>
 
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
@@ -24,11 +46,34 @@ struct SwapChainSupportDetails {
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
+//The closest mesh instance a ray cast hit
+struct RaycastHit {
+	float distance;
+	glm::vec3 position;
+	uint32_t meshIndex;
+	//The id AddInstance returned for the instance, the one RemoveInstance takes
+	uint32_t instanceId;
+	uint32_t triangle;
+	glm::vec2 barycentric;
+};
+
+//A compute pass that is rebuilt when any of its shaders are recompiled
+struct ComputeShaderReload {
+	std::vector<std::string> shaders;
+	//Recreates the pass's pipelines and returns the ones they replaced
+	std::function<std::vector<VkPipeline>()> recreate;
+};
+
 class TriangleApp
 {
 public:
+	//The number of frames that can be recorded while earlier ones are still on the GPU
+	TriangleApp(int framesInFlight = 2);
+
 	//Initailizes the window and starts the main loop
 	void Run();
+	//Draws a generated scene in a hidden window for a fixed number of frames and returns the averages of the measured frames, a memory snapshot of every measured frame is written to the memory log when one is given
+	BenchmarkResult RunBenchmark(const BenchmarkConfig& config, uint32_t warmupFrames, uint32_t measuredFrames, std::ostream* memoryLog = nullptr);
 
 	//TODO: Set these up properly when I'm done testing
 	static VkPhysicalDevice physicalDevice;
@@ -42,7 +87,7 @@ public:
 private:
 	const int WINDOW_WIDTH = 800;
 	const int WINDOW_HEIGHT = 600;
-	const int MAX_FRAMES_IN_FLIGHT = 2;
+	const int MAX_FRAMES_IN_FLIGHT;
 
 	std::chrono::steady_clock::time_point currentTime;
 	std::chrono::steady_clock::time_point lastTime;
@@ -51,6 +96,14 @@ private:
 
 	Camera* camera;
 	std::vector<Mesh> meshes;
+	//Every instance and the camera are nodes so their model matrices include their parents
+	SceneGraph sceneGraph;
+	//Game objects live here, meshes and the camera draw from render proxies synced from the entities' components
+	World world;
+	uint64_t lastProxySync = 0;
+	//Cubes added at runtime with the + key
+	std::vector<Entity> spawnedEntities;
+	static const uint32_t SPAWN_BATCH_SIZE = 100;
 
 	GLFWwindow* window;
 
@@ -59,9 +112,74 @@ private:
 	VkDebugUtilsMessengerEXT debugMessenger;
 
 	VkRenderPass renderPass;
+	//Draws the instances the late occlusion cull found on top of the first render pass
+	VkRenderPass lateRenderPass = VK_NULL_HANDLE;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	//Graphics pipelines for every shader permutation that has been drawn, compiled the first time their key is used
+	std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> pipelines;
+	std::unordered_map<PipelineKey, VkPipeline, PipelineKeyHash> latePipelines;
+	VkShaderModule vertexShaderModule;
+	VkShaderModule fragmentShaderModule;
+
+	//Depth-only pass drawn before the color pass so each pixel is only shaded once, toggled with the P key
+	bool depthPrePass = true;
+	bool depthPrePassToggled = false;
+	VkShaderModule depthShaderModule;
+	//One per instance format, compiled the first time a mesh using that format is drawn
+	std::array<VkPipeline, INSTANCE_FORMAT_COUNT> depthPipelines = {};
+
+	//Instances hidden behind the depth of the previous frame are culled on the GPU, toggled with the O key
+	bool occlusionCullingSupported = false;
+	bool occlusionCullingEnabled = true;
+	bool occlusionCullingToggled = false;
+	OcclusionCulling occlusionCulling;
+
+	//Fragment shader invocations of the color pass, used to compare the cost with and without the depth pre-pass
+	bool pipelineStatisticsSupported = false;
+	VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+	std::vector<bool> statisticsPending;
+	uint64_t fragmentInvocations = 0;
+	uint32_t statisticsFrames = 0;
+	//Timestamps at the start and end of each frame's commands, used by the benchmark to time the GPU
+	bool timestampsSupported = false;
+	float timestampPeriod = 0.0f;
+	uint64_t timestampMask = 0;
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+	std::vector<bool> timestampsPending;
+	double gpuFrameTimeTotal = 0.0;
+	uint32_t gpuFrameTimeSamples = 0;
+	//The bytes copied to the device and the draws submitted by the last frame
+	VkDeviceSize frameUploadBytes = 0;
+	uint32_t frameDrawCalls = 0;
+	std::vector<uint32_t> recordedDrawCalls;
+	//Heap usage and budgets come from VK_EXT_memory_budget, which needs VK_KHR_get_physical_device_properties2 on the instance
+	bool physicalDeviceProperties2Supported = false;
+	bool memoryBudgetSupported = false;
+	//Prints the memory counters at the start of the next frame, requested with the M key
+	bool memoryReportRequested = false;
+	//Benchmarks draw to a hidden window without waiting for the display
+	bool benchmarking = false;
+	//Pipelines replaced by a shader reload and the frame after which they are no longer in use
+	std::vector<std::pair<VkPipeline, uint64_t>> retiredPipelines;
+	//Instance buffers replaced when meshes outgrew them and the frame after which they are no longer in use
+	std::vector<std::pair<std::shared_ptr<Buffer>, uint64_t>> retiredBuffers;
+	//The number of instances across every mesh, the occlusion culling dispatches bake it into the command buffers
+	uint32_t totalInstanceCount = 0;
+	//The layout the scene's instance transforms are uploaded in, cycled with the I key
+	InstanceFormat instanceFormat = InstanceFormat::Affine3x4;
+	bool instanceFormatToggled = false;
+	std::vector<uint32_t> recordedInstanceCounts;
+	ShaderManager shaderManager;
+	LightClusters lightClusters;
+
+	//Simulated and culled on the GPU, every particle is drawn as an instance of the particle mesh
+	ParticleSystem particles;
+	Mesh particleMesh;
+
+	//Animated characters, skinned on the GPU into their own copy of their mesh's vertices
+	Skinning skinning;
+	std::vector<std::shared_ptr<Mesh>> skinnedMeshes;
 
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
@@ -71,6 +189,7 @@ private:
 	bool frameBufferResized = false;
 
 	std::vector<std::shared_ptr<Buffer>> vertexBuffers;
+	std::vector<std::shared_ptr<Buffer>> positionBuffers;
 	std::vector<std::shared_ptr<Buffer>> indexBuffers;
 
 	std::vector<std::shared_ptr<Buffer>> uniformBuffers;
@@ -79,6 +198,28 @@ private:
 	VkDescriptorPool descriptorPool;
 
 	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<bool> commandBufferDirty;
+
+	//Meshes are drawn in sort key order, command buffers are re-recorded when the order changes, toggled with the R key
+	bool drawSorting = true;
+	RenderQueue renderQueue;
+	std::vector<uint32_t> drawOrder;
+	std::vector<std::vector<uint32_t>> recordedDrawOrders;
+
+	//Every active mesh instance in world space, refit as instances move and used to frustum cull when occlusion culling is off
+	InstanceBVH instanceBVH;
+	//The mesh and active instance index, instance id, transform and last seen world version of every item in the BVH
+	std::vector<std::pair<uint32_t, uint32_t>> bvhItems;
+	std::vector<uint32_t> bvhItemIds;
+	std::vector<Transform*> bvhItemTransforms;
+	std::vector<uint64_t> bvhItemVersions;
+	std::vector<uint32_t> bvhResults;
+	//Model space bounds of every mesh
+	std::vector<AABB> meshBounds;
+	//The instances of every mesh inside the view frustum, command buffers are re-recorded when the counts change
+	std::vector<std::vector<uint32_t>> visibleInstances;
+	std::vector<uint32_t> visibleInstanceCounts;
+	std::vector<std::vector<uint32_t>> recordedVisibleCounts;
 
 	VkSurfaceKHR surface;
 
@@ -86,16 +227,32 @@ private:
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageView;
 	std::vector<VkFramebuffer> swapChainFrameBuffers;
+	std::vector<VkFramebuffer> lateFrameBuffers;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 
-	VkImage textureImage;
-	VkImageView textureImageView;
-	VkDeviceMemory textureImageMemory;
-
-	VkImage depthImage;
+	//Files are read and decoded on worker threads, uploads are finished at the start of each frame
+	AssetManager assetManager;
+	std::vector<AssetHandle> preloadedAssets;
+	AssetHandle textureAsset;
+	const uint32_t MAX_ASSET_UPLOADS_PER_FRAME = 2;
+	//Assets are loaded from this archive when it exists, falling back to loose files for anything it doesn't contain
+	const std::string ASSET_ARCHIVE_PATH = "assets.vpak";
+
+	TextureStreamer textureStreamer;
+	std::shared_ptr<Texture> texture;
+	//The texture version each image's descriptor set was last written with, a set is only rewritten once its image's last frame has finished
+	std::vector<uint32_t> descriptorTextureVersions;
+	//Streamed levels are copied by these, one per frame in flight, submitted ahead of the frame's draws
+	std::vector<VkCommandBuffer> uploadCommandBuffers;
+	//Texture images replaced by streaming and the frame after which they are no longer in use
+	std::vector<std::pair<RetiredTexture, uint64_t>> retiredTextures;
+	VkSampler textureSampler;
+	TextureAtlas textureAtlas;
+	uint64_t frameCount = 0;
+
+	Image depthImage;
 	VkImageView depthImageView;
-	VkDeviceMemory depthImageMemory;
 
 	const std::vector<const char*> validationLayers = {
 		"VK_LAYER_KHRONOS_validation"
@@ -112,7 +269,13 @@ private:
 #endif
 
 	//Initialize GLFW resources and create the window
-	void InitWindow();
+	void InitWindow(bool visible = true);
+	//Creates the demo meshes and the entities that animate them
+	void CreateScene();
+	//Creates a grid of spinning instances shared between the benchmark's meshes
+	void CreateBenchmarkScene(const BenchmarkConfig& config);
+	//Creates the main camera looking at a point
+	void CreateCamera(glm::vec3 position, glm::vec3 target, float farPlane = 100.0f);
 	//Initialize Vulkan resources
 	void InitVulkan();
 	//Cleans up GLFW and Vulkan resources called after the window is closed
@@ -120,8 +283,28 @@ private:
 
 	//Called every frame and used to update objects on the screen
 	void MainLoop();
-	//Called every update loop
+	//Called every update loop, runs the entity systems and syncs their results to the renderer
 	void Update();
+	//Creates an entity that draws an instance of a mesh
+	Entity CreateMeshEntity(uint32_t meshIndex, TransformComponent transform);
+	//Destroys an entity created by CreateMeshEntity and removes its instance from the mesh
+	void DestroyMeshEntity(Entity entity);
+	//Adds cubes to the scene at runtime, bound to the + key
+	void SpawnInstances(uint32_t count);
+	//Removes the most recently spawned cubes, bound to the - key
+	void DespawnInstances(uint32_t count);
+	//Copies the components that changed since the last sync into the meshes' transforms and the camera
+	void SyncRenderProxies();
+	//Refits the instance BVH around moved instances, rebuilding it when instances were added or removed
+	void UpdateInstanceBVH();
+	//Finds the instances of every mesh inside the camera's frustum
+	void UpdateVisibleInstances();
+	//Finds the closest mesh instance a world space ray hits, distances are in multiples of the ray's direction
+	bool Raycast(const Ray& ray, float maxDistance, RaycastHit& hit);
+	//Ray casts from the camera through a cursor position in window coordinates
+	bool Pick(double cursorX, double cursorY, RaycastHit& hit);
+	//Returns whether no mesh instance is between two points
+	bool HasLineOfSight(glm::vec3 from, glm::vec3 to);
 	//Draws all of the objects to the screen
 	void DrawFrame();
 	//Creates the semaphores to manage async frame rendering
@@ -151,16 +334,16 @@ private:
 
 	//Creates a texture image
 	void CreateTextureImage();
-	//Creates an image view for the texture
-	void CreateTextureImageView();
-	//Creates an image and binds it to memory
-	void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& memory);
-	//Creates an image view
-	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	//Transitions the image's Image Layout
-	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-	//Copies image data to a buffer
-	void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t imageWidth, uint32_t imageHeight);
+	//Packs the small textures into an atlas and remaps mesh texture coordinates into it
+	void CreateTextureAtlas();
+	//Creates the sampler used to read from textures
+	void CreateTextureSampler();
+	//Records this frame's texture mip changes into its upload command buffer and rebinds the texture for the image if its view changed, returns whether anything was recorded
+	bool UpdateTextureStreaming(uint32_t imageIndex);
+	//Writes the texture's image view to an image's descriptor set
+	void UpdateTextureDescriptors(size_t imageIndex);
+	//Destroys retired texture images once no frame in flight can be using them
+	void DestroyRetiredTextures(bool force);
 
 	//Creates the depth buffer resources
 	void CreateDepthResources();
@@ -190,8 +373,48 @@ private:
 	//Chooses the size of the frames in the swap chain
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 
-	//Creates the graphics pipeline
-	void CreateGraphicsPipeline();
+	//Creates the pipeline layout shared by the graphics pipelines
+	void CreatePipelineLayout();
+	//Loads the compiled shaders used by every graphics pipeline
+	void CreateShaderModules();
+	//Creates the graphics pipeline for a shader permutation, without a fragment module a depth-only pipeline is created for the pre-pass
+	VkPipeline CreateGraphicsPipeline(const PipelineKey& key, VkShaderModule vertexModule, VkShaderModule fragmentModule, bool latePass = false);
+	//Creates the light cluster compute pipeline and the scene's lights
+	void CreateLightClusters();
+	//Creates the light cluster compute pipeline from the compiled shader and returns the pipeline it replaced
+	VkPipeline CreateLightClusterPipeline();
+	//Creates the occlusion culling pipelines from the compiled shaders and returns the pipelines they replaced
+	std::array<VkPipeline, 3> CreateOcclusionCullingPipelines();
+	//Creates the particle compute pipelines and sets up the emitter
+	void CreateParticles();
+	//Creates the particle compute pipelines from the compiled shader and returns the pipelines they replaced
+	std::array<VkPipeline, 2> CreateParticlePipelines();
+	//Creates the skinning compute pipeline and the animated characters
+	void CreateSkinning();
+	//Creates the skinning compute pipeline from the compiled shader and returns the pipeline it replaced
+	VkPipeline CreateSkinningPipeline();
+	//Returns the pipeline for a shader permutation, compiling it if it has not been used yet
+	VkPipeline GetPipeline(const PipelineKey& key, bool latePass = false);
+	//Returns the depth pre-pass pipeline for an instance format, compiling it if it has not been used yet
+	VkPipeline GetDepthPipeline(InstanceFormat format);
+	//Destroys every compiled permutation
+	void DestroyPipelines();
+	//Rebuilds the compiled permutations if the shader manager recompiled any shaders
+	void ReloadShaders();
+	//Recreates a compute pass if any of its shaders were recompiled, retiring the pipelines it replaced, and removes its shaders from the compiled list
+	void ReloadComputePass(std::vector<std::string>& compiledShaders, const ComputeShaderReload& reload);
+	//Destroys retired pipelines once no frame in flight can be using them
+	void DestroyRetiredPipelines(bool force);
+	//Grows or shrinks every mesh's instance buffer to fit its instances, retiring the buffers that were replaced
+	void ReserveInstanceBuffers();
+	//Whether every mesh and instance fits in the fixed size occlusion culling buffers
+	bool OcclusionCullingFits();
+	//Switches every mesh and the occlusion culling pass to a new instance layout, the meshes reallocate their buffers on the next reserve
+	void SetInstanceFormat(InstanceFormat format);
+	//Frees retired instance buffers once no frame in flight can be using them
+	void DestroyRetiredBuffers(bool force);
+	//Returns how many times instance buffers have been replaced across every mesh
+	uint32_t GetInstanceReallocationCount();
 	//Create the descriptor set for the Uniform Buffer Object
 	void CreateDescriptorSetLayout();
 	//Creates the descriptor pool
@@ -200,22 +423,45 @@ private:
 	void CreateDescriptorSets();
 	//Creates the Render Pass
 	void CreateRenderPass();
+	//Creates the render pass that draws the late occlusion cull's instances over the first pass
+	void CreateLateRenderPass();
 	//Creates the Vulkan shader from the shader data
 	VkShaderModule CreateShaderModule(const std::vector<char>& code);
 
 	//Creates the vertex buffer
-	void CreateVertexBuffer(int index);
+	void CreateVertexBuffer(Mesh& mesh);
+	//Creates the position-only vertex buffer used by the depth pre-pass
+	void CreatePositionBuffer(Mesh& mesh);
 	//Creates the index buffer
-	void CreateIndexBuffer(int index);
+	void CreateIndexBuffer(Mesh& mesh);
 	//Creates the uniform buffer
 	void CreateUniformBuffers();
-	//Updates the uniform buffers
-	void UpdateUniformBuffers(uint32_t currentImage);
+	//Updates the uniform buffers and returns the number of bytes written
+	VkDeviceSize UpdateUniformBuffers(uint32_t currentImage);
 	
 	//Creates the Command Pool
 	void CreateCommandPool();
 	//Creates the Command Buffers
 	void CreateCommandBuffers();
+	//Records the draw commands for a swap chain image
+	void RecordCommandBuffer(size_t index);
+	//Records a draw for every mesh from the image's region of the instance buffers, with occlusion culling the instances come from the cull pass of the given phase, returns the number of draws
+	uint32_t RecordMeshDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool depthOnly, bool latePhase);
+	//Records the indirect draw of every living particle, returns the number of draws
+	uint32_t RecordParticleDraws(VkCommandBuffer commandBuffer, bool depthOnly);
+	//Records a draw for every skinned character, returns the number of draws
+	uint32_t RecordSkinnedDraws(VkCommandBuffer commandBuffer, bool depthOnly);
+	//Flags every command buffer to be re-recorded the next time its image is drawn
+	void MarkCommandBuffersDirty();
+	//Sorts the meshes by state and camera distance into the draw order
+	void UpdateDrawOrder();
+
+	//Creates the pipeline statistics query pool with one query per swap chain image and the timestamp query pool with two
+	void CreateQueryPool();
+	//Reads the statistics of the last frame drawn to an image and periodically prints the average
+	void ReadPipelineStatistics(uint32_t imageIndex);
+	//Adds the GPU time of the last frame drawn to an image to the running total
+	void ReadTimestamps(uint32_t imageIndex);
 
 	//Setup the debug util messenger
 	void SetupDebugMessenger();
@@ -233,6 +479,16 @@ private:
 
 	//Called when the GLFW window is resized
 	static void FrameBufferResizeCallback(GLFWwindow* window, int width, int height);
+	//Handles key presses
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	//Picks the mesh instance under the cursor on left click
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	//Serves assets from the packed archive if there is one
+	void MountAssetArchive();
+	//Requests every file needed during setup from the asset manager
+	void PreloadAssets();
+	//Returns the contents of a shader file through the asset manager, blocking until it has been read
+	std::vector<char> LoadShaderCode(const std::string& filePath);
 	//Reads in a file and saves it to a char list
 	static std::vector<char> ReadFile(const std::string& filePath);
 };
\ No newline at end of file
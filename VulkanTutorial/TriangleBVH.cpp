@@ -0,0 +1,513 @@
+#include "pch.h"
+#include "TriangleBVH.h"
+
+//SSE2 is part of every x64 CPU, other targets test the four children one at a time
+#if defined(_M_X64) || defined(__SSE2__)
+#define TRIANGLE_BVH_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#ifdef TRIANGLE_BVH_USE_SSE
+struct TriangleBVH::RayLanes
+{
+	__m128 origin[3];
+	__m128 inverseDirection[3];
+
+	RayLanes(const Ray& ray)
+	{
+		for (int axis = 0; axis < 3; axis++) {
+			origin[axis] = _mm_set1_ps(ray.origin[axis]);
+			inverseDirection[axis] = _mm_set1_ps(ray.inverseDirection[axis]);
+		}
+	}
+};
+#else
+struct TriangleBVH::RayLanes
+{
+	glm::vec3 origin;
+	glm::vec3 inverseDirection;
+
+	RayLanes(const Ray& ray)
+	{
+		origin = ray.origin;
+		inverseDirection = ray.inverseDirection;
+	}
+};
+#endif
+
+#pragma region Building
+
+TriangleBVH::TriangleBVH(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	corners.resize(static_cast<size_t>(triangleCount) * 3);
+	triangleIds.resize(triangleCount);
+	std::vector<glm::vec3> centers(triangleCount);
+
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		for (uint32_t j = 0; j < 3; j++) {
+			corners[i * 3 + j] = positions[indices[i * 3 + j]];
+		}
+
+		triangleIds[i] = i;
+		centers[i] = (corners[i * 3] + corners[i * 3 + 1] + corners[i * 3 + 2]) / 3.0f;
+	}
+
+	std::vector<BuildNode> buildNodes;
+	buildNodes.reserve(static_cast<size_t>(triangleCount) * 2);
+	buildNodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), triangleCount });
+	UpdateLeafBounds(buildNodes[0]);
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+
+		if (Subdivide(buildNodes, nodeIndex, centers)) {
+			stack.push_back(buildNodes[nodeIndex].leftFirst);
+			stack.push_back(buildNodes[nodeIndex].leftFirst + 1);
+		}
+	}
+
+	bounds = AABB(buildNodes[0].minimum, buildNodes[0].maximum);
+	Collapse(buildNodes);
+}
+
+bool TriangleBVH::Subdivide(std::vector<BuildNode>& buildNodes, uint32_t nodeIndex, std::vector<glm::vec3>& centers)
+{
+	BuildNode node = buildNodes[nodeIndex];
+
+	if (node.count <= 1) {
+		return false;
+	}
+
+	AABB centerBounds;
+	for (uint32_t i = 0; i < node.count; i++) {
+		centerBounds.grow(centers[node.leftFirst + i]);
+	}
+
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centerBounds.maximum[axis] - centerBounds.minimum[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+
+		std::array<AABB, SAH_BINS> binBounds;
+		std::array<uint32_t, SAH_BINS> binCounts = {};
+		float scale = SAH_BINS / extent;
+
+		for (uint32_t i = 0; i < node.count; i++) {
+			uint32_t triangle = node.leftFirst + i;
+			uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((centers[triangle][axis] - centerBounds.minimum[axis]) * scale));
+
+			binCounts[bin]++;
+			binBounds[bin].grow(corners[triangle * 3]);
+			binBounds[bin].grow(corners[triangle * 3 + 1]);
+			binBounds[bin].grow(corners[triangle * 3 + 2]);
+		}
+
+		//Sweep from both sides so every split plane between bins is costed in linear time
+		std::array<float, SAH_BINS - 1> leftCosts;
+		AABB leftBounds;
+		uint32_t leftCount = 0;
+
+		for (uint32_t i = 0; i < SAH_BINS - 1; i++) {
+			leftBounds.grow(binBounds[i]);
+			leftCount += binCounts[i];
+			leftCosts[i] = leftCount * leftBounds.getSurfaceArea();
+		}
+
+		AABB rightBounds;
+		uint32_t rightCount = 0;
+
+		for (uint32_t i = SAH_BINS - 1; i > 0; i--) {
+			rightBounds.grow(binBounds[i]);
+			rightCount += binCounts[i];
+
+			float cost = leftCosts[i - 1] + rightCount * rightBounds.getSurfaceArea();
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i - 1;
+			}
+		}
+	}
+
+	AABB nodeBounds(node.minimum, node.maximum);
+	float leafCost = node.count * nodeBounds.getSurfaceArea();
+	if (node.count <= MAX_LEAF_TRIANGLES && (bestAxis < 0 || bestCost >= leafCost)) {
+		return false;
+	}
+
+	uint32_t first = node.leftFirst;
+	uint32_t leftCount = node.count / 2;
+
+	if (bestAxis >= 0) {
+		float scale = SAH_BINS / (centerBounds.maximum[bestAxis] - centerBounds.minimum[bestAxis]);
+		uint32_t i = first;
+		uint32_t j = first + node.count;
+
+		//Move every triangle left of the split plane to the front of the range
+		while (i < j) {
+			uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((centers[i][bestAxis] - centerBounds.minimum[bestAxis]) * scale));
+
+			if (bin <= bestSplit) {
+				i++;
+			}
+			else {
+				SwapTriangles(i, --j, centers);
+			}
+		}
+
+		leftCount = i - first;
+	}
+
+	//Triangles with identical centers can't be separated spatially so they are split down the middle
+	if (leftCount == 0 || leftCount == node.count) {
+		leftCount = node.count / 2;
+	}
+
+	uint32_t left = static_cast<uint32_t>(buildNodes.size());
+	buildNodes.push_back({ glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount });
+	buildNodes.push_back({ glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), node.count - leftCount });
+
+	buildNodes[nodeIndex].leftFirst = left;
+	buildNodes[nodeIndex].count = 0;
+
+	UpdateLeafBounds(buildNodes[left]);
+	UpdateLeafBounds(buildNodes[left + 1]);
+
+	return true;
+}
+
+void TriangleBVH::UpdateLeafBounds(BuildNode& node)
+{
+	AABB leafBounds;
+
+	for (uint32_t i = node.leftFirst * 3; i < (node.leftFirst + node.count) * 3; i++) {
+		leafBounds.grow(corners[i]);
+	}
+
+	node.minimum = leafBounds.minimum;
+	node.maximum = leafBounds.maximum;
+}
+
+void TriangleBVH::Collapse(const std::vector<BuildNode>& buildNodes)
+{
+	nodes.clear();
+	nodes.reserve(buildNodes.size() / 3 + 1);
+	nodes.emplace_back();
+
+	//Each entry pairs a binary node with the wide node its children are written to
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+
+	while (!stack.empty()) {
+		uint32_t buildIndex = stack.back().first;
+		uint32_t nodeIndex = stack.back().second;
+		stack.pop_back();
+
+		//A root small enough to be a leaf becomes the only child of the root
+		std::array<uint32_t, 4> children;
+		uint32_t childCount = 1;
+		children[0] = buildIndex;
+
+		if (buildNodes[buildIndex].count == 0) {
+			children[0] = buildNodes[buildIndex].leftFirst;
+			children[1] = buildNodes[buildIndex].leftFirst + 1;
+			childCount = 2;
+		}
+
+		//Replacing the largest internal child with its own children keeps the boxes tested together similar in size
+		while (childCount < 4) {
+			int largest = -1;
+			float largestArea = -1.0f;
+
+			for (uint32_t i = 0; i < childCount; i++) {
+				const BuildNode& child = buildNodes[children[i]];
+				float area = AABB(child.minimum, child.maximum).getSurfaceArea();
+
+				if (child.count == 0 && area > largestArea) {
+					largest = static_cast<int>(i);
+					largestArea = area;
+				}
+			}
+
+			if (largest < 0) {
+				break;
+			}
+
+			uint32_t opened = children[largest];
+			children[largest] = buildNodes[opened].leftFirst;
+			children[childCount++] = buildNodes[opened].leftFirst + 1;
+		}
+
+		Node node = {};
+
+		for (uint32_t i = 0; i < 4; i++) {
+			if (i >= childCount) {
+				node.children[i] = EMPTY_CHILD;
+				continue;
+			}
+
+			const BuildNode& child = buildNodes[children[i]];
+			node.minimumX[i] = child.minimum.x;
+			node.minimumY[i] = child.minimum.y;
+			node.minimumZ[i] = child.minimum.z;
+			node.maximumX[i] = child.maximum.x;
+			node.maximumY[i] = child.maximum.y;
+			node.maximumZ[i] = child.maximum.z;
+
+			if (child.count > 0) {
+				node.children[i] = child.leftFirst;
+				node.counts[i] = child.count;
+			}
+			else {
+				node.children[i] = static_cast<uint32_t>(nodes.size());
+				nodes.emplace_back();
+				stack.push_back({ children[i], node.children[i] });
+			}
+		}
+
+		nodes[nodeIndex] = node;
+	}
+
+	nodes.shrink_to_fit();
+}
+
+void TriangleBVH::SwapTriangles(uint32_t a, uint32_t b, std::vector<glm::vec3>& centers)
+{
+	for (uint32_t i = 0; i < 3; i++) {
+		std::swap(corners[a * 3 + i], corners[b * 3 + i]);
+	}
+
+	std::swap(triangleIds[a], triangleIds[b]);
+	std::swap(centers[a], centers[b]);
+}
+
+AABB TriangleBVH::GetBounds() const
+{
+	return bounds;
+}
+
+size_t TriangleBVH::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+#pragma endregion
+
+#pragma region Queries
+
+uint32_t TriangleBVH::IntersectChildren(const Node& node, const RayLanes& ray, float maxDistance, std::array<float, 4>& entries)
+{
+#ifdef TRIANGLE_BVH_USE_SSE
+	//Each lane is one child, the slabs of all four are found with one instruction per axis
+	__m128 minimumX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minimumX.data()), ray.origin[0]), ray.inverseDirection[0]);
+	__m128 maximumX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maximumX.data()), ray.origin[0]), ray.inverseDirection[0]);
+	__m128 minimumY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minimumY.data()), ray.origin[1]), ray.inverseDirection[1]);
+	__m128 maximumY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maximumY.data()), ray.origin[1]), ray.inverseDirection[1]);
+	__m128 minimumZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minimumZ.data()), ray.origin[2]), ray.inverseDirection[2]);
+	__m128 maximumZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maximumZ.data()), ray.origin[2]), ray.inverseDirection[2]);
+
+	__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(minimumX, maximumX), _mm_min_ps(minimumY, maximumY)), _mm_max_ps(_mm_min_ps(minimumZ, maximumZ), _mm_setzero_ps()));
+	__m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(minimumX, maximumX), _mm_max_ps(minimumY, maximumY)), _mm_min_ps(_mm_max_ps(minimumZ, maximumZ), _mm_set1_ps(maxDistance)));
+
+	//Unused children are masked out by their child index rather than their boxes, an inverted box still passes the slab test
+	__m128i empty = _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(node.children.data())), _mm_set1_epi32(-1));
+	__m128 hits = _mm_andnot_ps(_mm_castsi128_ps(empty), _mm_cmple_ps(enter, leave));
+
+	_mm_store_ps(entries.data(), enter);
+	return static_cast<uint32_t>(_mm_movemask_ps(hits));
+#else
+	uint32_t hits = 0;
+
+	for (uint32_t i = 0; i < 4; i++) {
+		if (node.children[i] == EMPTY_CHILD) {
+			continue;
+		}
+
+		AABB box(glm::vec3(node.minimumX[i], node.minimumY[i], node.minimumZ[i]), glm::vec3(node.maximumX[i], node.maximumY[i], node.maximumZ[i]));
+		glm::vec3 minimumSlab = (box.minimum - ray.origin) * ray.inverseDirection;
+		glm::vec3 maximumSlab = (box.maximum - ray.origin) * ray.inverseDirection;
+		glm::vec3 entry = glm::min(minimumSlab, maximumSlab);
+		glm::vec3 exit = glm::max(minimumSlab, maximumSlab);
+
+		float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+		float leave = std::min(std::min(exit.x, exit.y), std::min(exit.z, maxDistance));
+
+		if (enter <= leave) {
+			entries[i] = enter;
+			hits |= 1u << i;
+		}
+	}
+
+	return hits;
+#endif
+}
+
+bool TriangleBVH::IntersectTriangle(uint32_t triangle, const Ray& ray, float maxDistance, TriangleHit& hit) const
+{
+	const glm::vec3& a = corners[triangle * 3];
+	glm::vec3 edge1 = corners[triangle * 3 + 1] - a;
+	glm::vec3 edge2 = corners[triangle * 3 + 2] - a;
+
+	glm::vec3 h = glm::cross(ray.direction, edge2);
+	float determinant = glm::dot(edge1, h);
+
+	//Rays parallel to the triangle never hit it, both sides count as hits
+	if (std::abs(determinant) < 1e-8f) {
+		return false;
+	}
+
+	float inverseDeterminant = 1.0f / determinant;
+	glm::vec3 s = ray.origin - a;
+	float u = inverseDeterminant * glm::dot(s, h);
+
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = inverseDeterminant * glm::dot(ray.direction, q);
+
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	float distance = inverseDeterminant * glm::dot(edge2, q);
+
+	if (distance < 0.0f || distance >= maxDistance) {
+		return false;
+	}
+
+	hit.distance = distance;
+	hit.triangle = triangleIds[triangle];
+	hit.barycentric = glm::vec2(u, v);
+
+	return true;
+}
+
+bool TriangleBVH::Intersect(const Ray& ray, float maxDistance, TriangleHit& hit) const
+{
+	if (nodes.empty()) {
+		return false;
+	}
+
+	RayLanes lanes(ray);
+
+	//Each entry keeps the distance its node was entered at so it can be skipped if a closer hit was found meanwhile
+	std::vector<std::pair<uint32_t, float>> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, 0.0f });
+
+	float closest = maxDistance;
+	bool found = false;
+
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back().first;
+		float entry = stack.back().second;
+		stack.pop_back();
+
+		if (entry >= closest) {
+			continue;
+		}
+
+		const Node& node = nodes[nodeIndex];
+		std::array<float, 4> entries;
+		uint32_t hits = IntersectChildren(node, lanes, closest, entries);
+
+		//Visit the children nearest first so their hits can rule out the ones behind them
+		std::array<uint32_t, 4> order;
+		uint32_t hitCount = 0;
+
+		for (uint32_t i = 0; i < 4; i++) {
+			if ((hits & (1u << i)) == 0) {
+				continue;
+			}
+
+			uint32_t j = hitCount++;
+			for (; j > 0 && entries[order[j - 1]] > entries[i]; j--) {
+				order[j] = order[j - 1];
+			}
+
+			order[j] = i;
+		}
+
+		//Leaves are tested straight away, internal children are pushed furthest first so the nearest is popped next
+		for (uint32_t i = 0; i < hitCount; i++) {
+			uint32_t child = order[i];
+
+			if (node.counts[child] > 0 && entries[child] < closest) {
+				for (uint32_t j = 0; j < node.counts[child]; j++) {
+					if (IntersectTriangle(node.children[child] + j, ray, closest, hit)) {
+						closest = hit.distance;
+						found = true;
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = hitCount; i > 0; i--) {
+			uint32_t child = order[i - 1];
+
+			if (node.counts[child] == 0) {
+				stack.push_back({ node.children[child], entries[child] });
+			}
+		}
+	}
+
+	return found;
+}
+
+bool TriangleBVH::IntersectAny(const Ray& ray, float maxDistance) const
+{
+	if (nodes.empty()) {
+		return false;
+	}
+
+	RayLanes lanes(ray);
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	TriangleHit hit;
+
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		std::array<float, 4> entries;
+		uint32_t hits = IntersectChildren(node, lanes, maxDistance, entries);
+
+		for (uint32_t i = 0; i < 4; i++) {
+			if ((hits & (1u << i)) == 0) {
+				continue;
+			}
+
+			if (node.counts[i] == 0) {
+				stack.push_back(node.children[i]);
+				continue;
+			}
+
+			for (uint32_t j = 0; j < node.counts[i]; j++) {
+				if (IntersectTriangle(node.children[i] + j, ray, maxDistance, hit)) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+#pragma endregion
\ No newline at end of file
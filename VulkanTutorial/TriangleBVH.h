@@ -0,0 +1,138 @@
+#pragma once
+
+#include "pch.h"
+#include "Bounds.h"
+
+//Where a ray hit a triangle
+struct TriangleHit {
+	float distance;
+	uint32_t triangle;
+	//Barycentric weights of the triangle's second and third vertices
+	glm::vec2 barycentric;
+};
+
+class TriangleBVH
+{
+private:
+	//Binary nodes the tree is built from, leaves hold a range of triangles and internal nodes point at two adjacent children
+	struct BuildNode
+	{
+		glm::vec3 minimum;
+		uint32_t leftFirst;
+		glm::vec3 maximum;
+		uint32_t count;
+	};
+
+	//The built tree is collapsed into nodes with up to four children whose boxes are stored as structure of arrays,
+	//so one SIMD instruction compares the ray against all four of them
+	struct alignas(64) Node
+	{
+		std::array<float, 4> minimumX;
+		std::array<float, 4> minimumY;
+		std::array<float, 4> minimumZ;
+		std::array<float, 4> maximumX;
+		std::array<float, 4> maximumY;
+		std::array<float, 4> maximumZ;
+		//Internal children hold a node index, leaf children the first of their triangles and unused children EMPTY_CHILD
+		std::array<uint32_t, 4> children;
+		//The number of triangles in each leaf child, 0 for internal and unused children
+		std::array<uint32_t, 4> counts;
+	};
+
+	static_assert(sizeof(Node) == 128, "BVH nodes are expected to be 128 bytes!");
+
+	//The ray's origin and inverse direction in the form the child test reads them, set up once per query
+	struct RayLanes;
+
+	static constexpr uint32_t EMPTY_CHILD = UINT32_MAX;
+
+	std::vector<Node> nodes;
+	AABB bounds;
+	//Triangle corners copied out of the mesh in leaf order so leaves read contiguous memory
+	std::vector<glm::vec3> corners;
+	//The index of each reordered triangle in the mesh's index list
+	std::vector<uint32_t> triangleIds;
+
+#pragma region Building
+
+	/// <summary>
+	/// Splits a leaf along the cheapest binned SAH plane, leaves that are cheaper to keep whole are left alone
+	/// </summary>
+	bool Subdivide(std::vector<BuildNode>& buildNodes, uint32_t nodeIndex, std::vector<glm::vec3>& centers);
+
+	/// <summary>
+	/// Recomputes a leaf's bounds from its triangles
+	/// </summary>
+	void UpdateLeafBounds(BuildNode& node);
+
+	/// <summary>
+	/// Turns the binary tree into four wide nodes, opening the largest internal child until each node has four children
+	/// </summary>
+	void Collapse(const std::vector<BuildNode>& buildNodes);
+
+	/// <summary>
+	/// Swaps two triangles in the reordered lists
+	/// </summary>
+	void SwapTriangles(uint32_t a, uint32_t b, std::vector<glm::vec3>& centers);
+
+#pragma endregion
+
+#pragma region Queries
+
+	/// <summary>
+	/// Tests a ray against a node's four child boxes at once
+	/// </summary>
+	/// <param name="entries">Set to the distance the ray enters each child that it hits</param>
+	/// <returns>A bit per child the ray hits before the max distance</returns>
+	static uint32_t IntersectChildren(const Node& node, const RayLanes& ray, float maxDistance, std::array<float, 4>& entries);
+
+	/// <summary>
+	/// Tests a ray against one reordered triangle with the Moller-Trumbore algorithm
+	/// </summary>
+	bool IntersectTriangle(uint32_t triangle, const Ray& ray, float maxDistance, TriangleHit& hit) const;
+
+#pragma endregion
+
+public:
+	static const uint32_t MAX_LEAF_TRIANGLES = 4;
+	static const uint32_t SAH_BINS = 8;
+
+#pragma region Building
+
+	/// <summary>
+	/// Builds the tree over an indexed triangle list
+	/// </summary>
+	/// <param name="positions">The vertex positions</param>
+	/// <param name="indices">Three indices per triangle</param>
+	TriangleBVH(const std::vector<glm::vec3>& positions, const std::vector<uint16_t>& indices);
+
+	/// <summary>
+	/// Returns the box around every triangle
+	/// </summary>
+	AABB GetBounds() const;
+
+	/// <summary>
+	/// Returns the number of four wide nodes in the tree
+	/// </summary>
+	size_t GetNodeCount() const;
+
+#pragma endregion
+
+#pragma region Queries
+
+	/// <summary>
+	/// Finds the closest triangle a ray hits, the ray doesn't have to be normalized and distances are measured in multiples of its direction
+	/// </summary>
+	/// <param name="ray">The ray in the mesh's model space</param>
+	/// <param name="maxDistance">Hits further than this are ignored</param>
+	/// <param name="hit">Set to the closest hit if there is one</param>
+	/// <returns>Whether anything was hit</returns>
+	bool Intersect(const Ray& ray, float maxDistance, TriangleHit& hit) const;
+
+	/// <summary>
+	/// Returns whether a ray hits anything before a distance, stops at the first hit found instead of the closest
+	/// </summary>
+	bool IntersectAny(const Ray& ray, float maxDistance) const;
+
+#pragma endregion
+};
\ No newline at end of file
@@ -2,13 +2,28 @@
 
 #include "pch.h"
 
+//Laid out to match the std430 Light struct in the shaders
 struct Light {
 	glm::vec3 position;
-	glm::vec3 color;
 	float range;
+	glm::vec3 color;
+	float padding;
+
+	Light(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f), float range = 1.0f) {
+		this->position = position;
+		this->range = range;
+		this->color = color;
+		padding = 0.0f;
+	}
 };
 
 struct UniformBufferObject {
 	glm::mat4 view;
 	glm::mat4 projection;
+	glm::mat4 inverseProjection;
+	glm::vec2 screenSize;
+	float nearPlane;
+	float farPlane;
+	uint32_t lightCount;
+	uint32_t padding[3];
 };
\ No newline at end of file
@@ -6,11 +6,14 @@ struct Vertex {
 	alignas(16) glm::vec3 position;
 	alignas(16) glm::vec3 color;
 	alignas(8) glm::vec2 textureCoordinate;
+	//Atlas layer to sample from, negative values sample the mesh's own texture instead of the atlas
+	float textureLayer;
 
-	Vertex(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f), glm::vec2 textureCoordinate = glm::vec2(0.0f, 0.0f)) {
+	Vertex(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f), glm::vec2 textureCoordinate = glm::vec2(0.0f, 0.0f), float textureLayer = -1.0f) {
 		this->position = position;
 		this->color = color;
 		this->textureCoordinate = textureCoordinate;
+		this->textureLayer = textureLayer;
 	}
 
 	static VkVertexInputBindingDescription getBindingDescription() {
@@ -22,9 +25,9 @@ struct Vertex {
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
 		//Setup attributes
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
 		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -40,6 +43,24 @@ struct Vertex {
 		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
 		attributeDescriptions[2].offset = offsetof(Vertex, textureCoordinate);
 
+		//Location 3 to 6 are used by the instance transform
+		attributeDescriptions[3].binding = 0;
+		attributeDescriptions[3].location = 7;
+		attributeDescriptions[3].format = VK_FORMAT_R32_SFLOAT;
+		attributeDescriptions[3].offset = offsetof(Vertex, textureLayer);
+
 		return attributeDescriptions;
 	}
+};
+
+//Optional per vertex skinning data, kept out of Vertex so rigid meshes do not pay for it, must match SkinVertices.comp
+struct VertexSkin {
+	glm::uvec4 joints;
+	//Should add up to 1, unused joints have a weight of 0
+	glm::vec4 weights;
+
+	VertexSkin(glm::uvec4 joints = glm::uvec4(0, 0, 0, 0), glm::vec4 weights = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)) {
+		this->joints = joints;
+		this->weights = weights;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,748 @@
+#include "pch.h"
+#include "RenderQueue.h"
+#include "InstanceBVH.h"
+#include "TriangleBVH.h"
+#include "ArchivePacker.h"
+#include "AssetArchive.h"
+#include "World.h"
+#include "Components.h"
+#include "SceneGraph.h"
+#include "Transform.h"
+#include "TransformData.h"
+
+#include <random>
+#include <map>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+
+//Checks keep going after a failure so one run reports every broken case
+static int failedChecks = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+			failedChecks++; \
+		} \
+	} while (0)
+
+#define CHECK_THROWS(expression) \
+	do { \
+		bool thrown = false; \
+		try { \
+			expression; \
+		} \
+		catch (const std::exception&) { \
+			thrown = true; \
+		} \
+		if (!thrown) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": expected an exception from: " << #expression << std::endl; \
+			failedChecks++; \
+		} \
+	} while (0)
+
+#pragma region Helpers
+
+static bool NearlyEqual(const glm::mat4& a, const glm::mat4& b, float tolerance)
+{
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			if (std::abs(a[column][row] - b[column][row]) > tolerance) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static glm::vec3 RandomPoint(std::mt19937& random, float range)
+{
+	std::uniform_real_distribution<float> distribution(-range, range);
+	return glm::vec3(distribution(random), distribution(random), distribution(random));
+}
+
+static AABB RandomBox(std::mt19937& random, float range, float maxSize)
+{
+	std::uniform_real_distribution<float> size(0.01f, maxSize);
+	glm::vec3 minimum = RandomPoint(random, range);
+
+	return AABB(minimum, minimum + glm::vec3(size(random), size(random), size(random)));
+}
+
+static std::vector<uint32_t> Sorted(std::vector<uint32_t> values)
+{
+	std::sort(values.begin(), values.end());
+	return values;
+}
+
+#pragma endregion
+
+#pragma region Render Queue
+
+static void TestRadixSortOrder()
+{
+	std::mt19937_64 random(1);
+
+	//Small inputs sort on one thread, the largest is split between workers
+	for (size_t count : { size_t(0), size_t(1), size_t(2), size_t(1000), RenderQueue::PARALLEL_SORT_THRESHOLD * 4 + 3 }) {
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys) {
+			key = random();
+		}
+
+		std::vector<uint64_t> expected = keys;
+		std::sort(expected.begin(), expected.end());
+
+		std::vector<uint64_t> scratch;
+		RenderQueue::RadixSort(keys, scratch);
+
+		CHECK(keys == expected);
+	}
+}
+
+static void TestRadixSortStability()
+{
+	//Every key shares its high bytes with many others and differs in its low bytes, so a pass that reorders equal digits leaves the keys unsorted
+	std::mt19937_64 random(2);
+
+	for (size_t count : { size_t(5000), RenderQueue::PARALLEL_SORT_THRESHOLD * 3 + 7 }) {
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys) {
+			key = ((random() % 4) << 56) | ((random() % 3) << 32) | (random() % 256);
+		}
+
+		std::vector<uint64_t> expected = keys;
+		std::stable_sort(expected.begin(), expected.end());
+
+		std::vector<uint64_t> scratch;
+		RenderQueue::RadixSort(keys, scratch);
+
+		CHECK(keys == expected);
+	}
+}
+
+static void TestRenderQueueDrawOrder()
+{
+	RenderQueue queue;
+
+	PipelineKey firstKey;
+	PipelineKey secondKey;
+	secondKey.instanceFormat = InstanceFormat::Affine3x4;
+
+	uint32_t firstPipeline = queue.GetPipelineId(firstKey);
+	uint32_t secondPipeline = queue.GetPipelineId(secondKey);
+	CHECK(firstPipeline != secondPipeline);
+	CHECK(queue.GetPipelineId(firstKey) == firstPipeline);
+
+	//Mesh indices name the draws, they are submitted out of order
+	queue.Submit(RenderQueue::MakeKey(true, firstPipeline, 0, 10, 0.2f));
+	queue.Submit(RenderQueue::MakeKey(false, secondPipeline, 0, 3, 0.1f));
+	queue.Submit(RenderQueue::MakeKey(false, firstPipeline, 0, 1, 0.9f));
+	queue.Submit(RenderQueue::MakeKey(true, secondPipeline, 0, 11, 0.8f));
+	queue.Submit(RenderQueue::MakeKey(false, firstPipeline, 0, 0, 0.5f));
+	queue.Submit(RenderQueue::MakeKey(false, secondPipeline, 0, 2, 0.7f));
+	queue.Sort();
+
+	std::vector<uint32_t> meshOrder;
+	for (uint64_t key : queue.GetKeys()) {
+		meshOrder.push_back(RenderQueue::GetMeshIndex(key));
+	}
+
+	//Opaque draws are grouped by pipeline and front to back within one, transparent draws come last and back to front
+	std::vector<uint32_t> expected = { 0, 1, 3, 2, 11, 10 };
+	CHECK(meshOrder == expected);
+	CHECK(!RenderQueue::IsTransparent(queue.GetKeys()[3]));
+	CHECK(RenderQueue::IsTransparent(queue.GetKeys()[4]));
+}
+
+#pragma endregion
+
+#pragma region Bounding Volume Hierarchies
+
+static void TestInstanceBVHQueries()
+{
+	std::mt19937 random(3);
+
+	std::vector<AABB> bounds(700);
+	for (AABB& box : bounds) {
+		box = RandomBox(random, 50.0f, 4.0f);
+	}
+
+	InstanceBVH bvh;
+	bvh.Build(bounds);
+	CHECK(bvh.GetItemCount() == bounds.size());
+
+	Frustum frustum = Frustum::fromViewProjection(glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 60.0f) * glm::lookAt(glm::vec3(0.0f, 0.0f, -40.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+	//Every query has to return exactly the items a test of every box would
+	auto compareQueries = [&]() {
+		for (int i = 0; i < 40; i++) {
+			AABB box = RandomBox(random, 50.0f, 20.0f);
+			std::vector<uint32_t> expected;
+			std::vector<uint32_t> results;
+
+			for (uint32_t item = 0; item < bounds.size(); item++) {
+				if (bounds[item].intersects(box)) {
+					expected.push_back(item);
+				}
+			}
+
+			bvh.QueryAABB(box, results);
+			CHECK(Sorted(results) == expected);
+
+			glm::vec3 center = RandomPoint(random, 50.0f);
+			float radius = 10.0f;
+			expected.clear();
+			results.clear();
+
+			for (uint32_t item = 0; item < bounds.size(); item++) {
+				if (bounds[item].intersectsSphere(center, radius)) {
+					expected.push_back(item);
+				}
+			}
+
+			bvh.QuerySphere(center, radius, results);
+			CHECK(Sorted(results) == expected);
+
+			Ray ray(RandomPoint(random, 60.0f), RandomPoint(random, 1.0f));
+			float maxDistance = 80.0f;
+			expected.clear();
+			results.clear();
+
+			for (uint32_t item = 0; item < bounds.size(); item++) {
+				float distance;
+				if (ray.intersects(bounds[item], maxDistance, distance)) {
+					expected.push_back(item);
+				}
+			}
+
+			bvh.QueryRay(ray, maxDistance, results);
+			CHECK(Sorted(results) == expected);
+		}
+
+		std::vector<uint32_t> expected;
+		std::vector<uint32_t> results;
+
+		for (uint32_t item = 0; item < bounds.size(); item++) {
+			uint32_t planeMask = 0x3F;
+			if (frustum.cull(bounds[item], planeMask)) {
+				expected.push_back(item);
+			}
+		}
+
+		bvh.QueryFrustum(frustum, results);
+		CHECK(Sorted(results) == expected);
+	};
+
+	compareQueries();
+
+	//Moving items and refitting must keep every query exact
+	for (uint32_t item = 0; item < bounds.size(); item += 2) {
+		bounds[item] = RandomBox(random, 50.0f, 4.0f);
+		bvh.UpdateItem(item, bounds[item]);
+	}
+
+	bvh.Refit();
+	compareQueries();
+}
+
+static bool IntersectTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const Ray& ray, float& distance)
+{
+	glm::vec3 edge1 = b - a;
+	glm::vec3 edge2 = c - a;
+	glm::vec3 h = glm::cross(ray.direction, edge2);
+	float determinant = glm::dot(edge1, h);
+
+	if (std::abs(determinant) < 1e-8f) {
+		return false;
+	}
+
+	//Same arithmetic as the tree's own test so rays grazing an edge agree
+	float inverseDeterminant = 1.0f / determinant;
+	glm::vec3 s = ray.origin - a;
+	float u = inverseDeterminant * glm::dot(s, h);
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = inverseDeterminant * glm::dot(ray.direction, q);
+	distance = inverseDeterminant * glm::dot(edge2, q);
+
+	return u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f;
+}
+
+static void TestTriangleBVHRays()
+{
+	std::mt19937 random(4);
+
+	//A soup of small triangles with their own corners
+	std::vector<glm::vec3> positions;
+	std::vector<uint16_t> indices;
+	for (uint16_t i = 0; i < 400; i++) {
+		glm::vec3 center = RandomPoint(random, 10.0f);
+
+		for (int corner = 0; corner < 3; corner++) {
+			positions.push_back(center + RandomPoint(random, 1.5f));
+			indices.push_back(static_cast<uint16_t>(i * 3 + corner));
+		}
+	}
+
+	TriangleBVH bvh(positions, indices);
+
+	AABB expectedBounds;
+	for (const glm::vec3& position : positions) {
+		expectedBounds.grow(position);
+	}
+
+	CHECK(bvh.GetBounds().minimum == expectedBounds.minimum);
+	CHECK(bvh.GetBounds().maximum == expectedBounds.maximum);
+
+	uint32_t hitCount = 0;
+
+	for (int i = 0; i < 500; i++) {
+		//Rays aim at a point in the soup with a direction one target distance long, so a max distance below 1 stops them early
+		glm::vec3 origin = RandomPoint(random, 20.0f);
+		Ray ray(origin, RandomPoint(random, 8.0f) - origin);
+		float maxDistance = i % 5 == 0 ? 0.9f : 100.0f;
+
+		bool expectedHit = false;
+		float expectedDistance = maxDistance;
+		for (uint32_t triangle = 0; triangle < indices.size() / 3; triangle++) {
+			float distance;
+			if (IntersectTriangle(positions[indices[triangle * 3]], positions[indices[triangle * 3 + 1]], positions[indices[triangle * 3 + 2]], ray, distance) && distance < expectedDistance) {
+				expectedDistance = distance;
+				expectedHit = true;
+			}
+		}
+
+		TriangleHit hit = {};
+		bool found = bvh.Intersect(ray, maxDistance, hit);
+
+		CHECK(found == expectedHit);
+		CHECK(bvh.IntersectAny(ray, maxDistance) == expectedHit);
+
+		if (found && expectedHit) {
+			CHECK(std::abs(hit.distance - expectedDistance) <= 1e-4f * std::max(1.0f, expectedDistance));
+			hitCount++;
+		}
+	}
+
+	//Make sure the comparison covered both hits and misses
+	CHECK(hitCount > 50);
+	CHECK(hitCount < 450);
+
+	//A single triangle is a leaf at the root, its node has one used child and three unused ones
+	TriangleBVH single({ glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) }, { 0, 1, 2 });
+	TriangleHit singleHit = {};
+
+	CHECK(single.GetNodeCount() == 1);
+	CHECK(single.Intersect(Ray(glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 100.0f, singleHit));
+	CHECK(std::abs(singleHit.distance - 2.0f) <= 1e-5f);
+	CHECK(!single.Intersect(Ray(glm::vec3(5.0f, 5.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 100.0f, singleHit));
+	CHECK(!single.IntersectAny(Ray(glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 1.5f));
+}
+
+#pragma endregion
+
+#pragma region Archives
+
+static void TestArchiveCompression()
+{
+	std::mt19937 random(5);
+
+	std::string text;
+	while (text.size() < 100000) {
+		text += "The quick brown fox jumps over the lazy dog " + std::to_string(text.size() % 97) + "\n";
+	}
+
+	std::vector<char> noise(65536);
+	for (char& value : noise) {
+		value = static_cast<char>(random());
+	}
+
+	std::vector<std::vector<char>> inputs = {
+		std::vector<char>(text.begin(), text.end()),
+		noise,
+		std::vector<char>(5000, 'a'),
+		{ 'x', 'y', 'z' }
+	};
+
+	for (const std::vector<char>& input : inputs) {
+		std::vector<char> compressed = ArchivePacker::CompressBlock(input.data(), input.size());
+		std::vector<char> output(input.size());
+
+		AssetArchive::DecompressBlock(compressed.data(), compressed.size(), output.data(), output.size());
+		CHECK(output == input);
+
+		//The block has to decompress to exactly the size it was written with
+		std::vector<char> larger(input.size() + 1);
+		CHECK_THROWS(AssetArchive::DecompressBlock(compressed.data(), compressed.size(), larger.data(), larger.size()));
+
+		if (compressed.size() > 1) {
+			CHECK_THROWS(AssetArchive::DecompressBlock(compressed.data(), compressed.size() - 1, output.data(), output.size()));
+		}
+	}
+
+	std::vector<char> compressed = ArchivePacker::CompressBlock(inputs[0].data(), inputs[0].size());
+	CHECK(compressed.size() < inputs[0].size() / 4);
+
+	//A match reaching back before the start of the output, and one with a zero offset
+	std::vector<char> output(64);
+	const char backwardsMatch[] = { 0x10, 'a', 0x10, 0x00 };
+	CHECK_THROWS(AssetArchive::DecompressBlock(backwardsMatch, sizeof(backwardsMatch), output.data(), 5));
+
+	const char zeroOffset[] = { 0x10, 'a', 0x00, 0x00 };
+	CHECK_THROWS(AssetArchive::DecompressBlock(zeroOffset, sizeof(zeroOffset), output.data(), 5));
+
+	//A literal run longer than the block
+	const char truncatedLiterals[] = { 0x50, 'a', 'b' };
+	CHECK_THROWS(AssetArchive::DecompressBlock(truncatedLiterals, sizeof(truncatedLiterals), output.data(), 5));
+}
+
+static void TestArchivePacking()
+{
+	//Entries are named relative to the working directory so the files are written under it
+	const std::string directory = "archive_test";
+	const std::string archivePath = "archive_test.vpak";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory + "/nested");
+
+	std::mt19937 random(6);
+	std::map<std::string, std::string> files;
+
+	std::string text;
+	while (text.size() < 20000) {
+		text += "repeated line of text\n";
+	}
+
+	std::string noise(10000, '\0');
+	for (char& value : noise) {
+		value = static_cast<char>(random());
+	}
+
+	files[directory + "/text.txt"] = text;
+	files[directory + "/noise.bin"] = noise;
+	files[directory + "/nested/small.txt"] = "small";
+
+	for (const auto& file : files) {
+		std::ofstream stream(file.first, std::ios::binary);
+		stream.write(file.second.data(), file.second.size());
+	}
+
+	ArchivePacker::Pack(archivePath, { directory });
+
+	{
+		AssetArchive archive;
+		archive.Open(archivePath);
+		CHECK(archive.IsOpen());
+		CHECK(archive.GetPaths().size() == files.size());
+		CHECK(!archive.Contains(directory + "/missing.txt"));
+
+		for (const auto& file : files) {
+			std::vector<char> data;
+			CHECK(archive.Read(file.first, data));
+			CHECK(std::string(data.begin(), data.end()) == file.second);
+		}
+
+		//Text shrinks enough to be stored compressed, noise doesn't so it can be viewed in place
+		const ArchiveEntry* textEntry = archive.Find(directory + "/text.txt");
+		CHECK(textEntry != nullptr && textEntry->compression == static_cast<uint32_t>(ArchiveCompression::LZ4));
+
+		const char* view = nullptr;
+		size_t viewSize = 0;
+		CHECK(archive.GetView(directory + "/noise.bin", view, viewSize));
+		CHECK(viewSize == noise.size() && std::string(view, viewSize) == noise);
+	}
+
+	//Zeroing a compressed entry turns its first sequence into a match with a zero offset, reading it must fail instead of returning garbage
+	uint64_t textOffset = 0;
+	uint64_t textSize = 0;
+	{
+		AssetArchive archive;
+		archive.Open(archivePath);
+		const ArchiveEntry* textEntry = archive.Find(directory + "/text.txt");
+
+		if (textEntry != nullptr) {
+			textOffset = textEntry->offset;
+			textSize = textEntry->size;
+		}
+	}
+
+	CHECK(textSize > 0);
+
+	if (textSize > 0) {
+		{
+			std::fstream stream(archivePath, std::ios::in | std::ios::out | std::ios::binary);
+			std::string zeros(static_cast<size_t>(textSize), '\0');
+			stream.seekp(static_cast<std::streamoff>(textOffset));
+			stream.write(zeros.data(), zeros.size());
+		}
+
+		AssetArchive archive;
+		archive.Open(archivePath);
+
+		std::vector<char> data;
+		CHECK_THROWS(archive.Read(directory + "/text.txt", data));
+		CHECK(archive.Read(directory + "/nested/small.txt", data));
+	}
+
+	std::filesystem::remove_all(directory);
+	std::filesystem::remove(archivePath);
+}
+
+#pragma endregion
+
+#pragma region Entities
+
+struct TestPosition
+{
+	float x;
+	float y;
+};
+
+struct TestVelocity
+{
+	float dx;
+};
+
+static void TestWorldHandles()
+{
+	World world;
+
+	std::vector<Entity> entities;
+	for (int i = 0; i < 10; i++) {
+		entities.push_back(world.CreateEntity(TestPosition{ static_cast<float>(i), 0.0f }));
+	}
+
+	CHECK(world.GetEntityCount() == 10);
+
+	//Destroying from the middle moves another entity into the freed row, its handle has to keep finding its own data
+	Entity destroyed = entities[3];
+	world.DestroyEntity(destroyed);
+
+	CHECK(!world.IsAlive(destroyed));
+	CHECK(world.GetEntityCount() == 9);
+	CHECK_THROWS(world.GetComponent<TestPosition>(destroyed));
+	CHECK_THROWS(world.DestroyEntity(destroyed));
+
+	for (int i = 0; i < 10; i++) {
+		if (i != 3) {
+			CHECK(world.IsAlive(entities[i]));
+			CHECK(world.GetComponent<const TestPosition>(entities[i]).x == static_cast<float>(i));
+		}
+	}
+
+	//The freed index is reused with a new generation, the old handle stays stale
+	Entity reused = world.CreateEntity(TestPosition{ 100.0f, 0.0f });
+	CHECK(reused.index == destroyed.index);
+	CHECK(reused.generation != destroyed.generation);
+	CHECK(world.IsAlive(reused));
+	CHECK(!world.IsAlive(destroyed));
+	CHECK(world.GetComponent<const TestPosition>(reused).x == 100.0f);
+
+	//Adding and removing components moves entities between archetypes without touching their other components
+	world.AddComponent(entities[5], TestVelocity{ 2.0f });
+	CHECK(world.HasComponent<TestVelocity>(entities[5]));
+	CHECK(world.GetComponent<const TestPosition>(entities[5]).x == 5.0f);
+	CHECK(world.GetComponent<const TestVelocity>(entities[5]).dx == 2.0f);
+
+	for (int i = 0; i < 10; i++) {
+		if (i != 3) {
+			CHECK(world.GetComponent<const TestPosition>(entities[i]).x == static_cast<float>(i));
+		}
+	}
+
+	world.RemoveComponent<TestVelocity>(entities[5]);
+	CHECK(!world.HasComponent<TestVelocity>(entities[5]));
+	CHECK(world.GetComponent<const TestPosition>(entities[5]).x == 5.0f);
+
+	//Queries visit every living entity once
+	size_t visited = 0;
+	float sum = 0.0f;
+	world.Each<const TestPosition>([&](Entity entity, const TestPosition& position) {
+		visited++;
+		sum += position.x;
+	});
+
+	CHECK(visited == 10);
+	CHECK(sum == 0.0f + 1.0f + 2.0f + 4.0f + 5.0f + 6.0f + 7.0f + 8.0f + 9.0f + 100.0f);
+
+	//A handle destroyed after its entity moved is stale as well
+	world.DestroyEntity(entities[5]);
+	CHECK(!world.IsAlive(entities[5]));
+	CHECK_THROWS(world.AddComponent(entities[5], TestVelocity{ 1.0f }));
+}
+
+#pragma endregion
+
+#pragma region Scene Graph
+
+static void TestSceneGraphWorldMatrices()
+{
+	SceneGraph sceneGraph;
+
+	std::shared_ptr<Transform> root = std::make_shared<Transform>(glm::vec3(1.0f, 2.0f, 3.0f), glm::quat(glm::vec3(0.0f, 0.5f, 0.0f)), glm::vec3(2.0f));
+	std::shared_ptr<Transform> child = std::make_shared<Transform>(glm::vec3(0.0f, 1.0f, 0.0f), glm::quat(glm::vec3(0.3f, 0.0f, 0.0f)));
+	std::shared_ptr<Transform> grandchild = std::make_shared<Transform>(glm::vec3(4.0f, 0.0f, 0.0f));
+	std::shared_ptr<Transform> other = std::make_shared<Transform>(glm::vec3(-5.0f, 0.0f, 0.0f));
+
+	uint32_t rootNode = sceneGraph.AddNode(root);
+	uint32_t childNode = sceneGraph.AddNode(child, rootNode);
+	uint32_t grandchildNode = sceneGraph.AddNode(grandchild, childNode);
+	uint32_t otherNode = sceneGraph.AddNode(other);
+
+	sceneGraph.UpdateWorldMatrices();
+
+	glm::mat4 expectedChild = root->GetLocalMatrix() * child->GetLocalMatrix();
+	glm::mat4 expectedGrandchild = expectedChild * grandchild->GetLocalMatrix();
+
+	CHECK(NearlyEqual(sceneGraph.GetWorldMatrix(rootNode), root->GetLocalMatrix(), 1e-5f));
+	CHECK(NearlyEqual(sceneGraph.GetWorldMatrix(childNode), expectedChild, 1e-5f));
+	CHECK(NearlyEqual(grandchild->GetModelMatrix(), expectedGrandchild, 1e-5f));
+
+	//Moving a parent changes its descendants' world matrices but not unrelated nodes
+	uint64_t otherVersion = sceneGraph.GetWorldVersion(otherNode);
+	uint64_t grandchildVersion = sceneGraph.GetWorldVersion(grandchildNode);
+
+	root->SetPosition(glm::vec3(-2.0f, 0.0f, 1.0f));
+	sceneGraph.UpdateWorldMatrices();
+
+	CHECK(NearlyEqual(grandchild->GetModelMatrix(), root->GetLocalMatrix() * child->GetLocalMatrix() * grandchild->GetLocalMatrix(), 1e-5f));
+	CHECK(sceneGraph.GetWorldVersion(grandchildNode) != grandchildVersion);
+	CHECK(sceneGraph.GetWorldVersion(otherNode) == otherVersion);
+
+	//Reparenting and removing nodes, children of a removed node move up to its parent
+	sceneGraph.SetParent(otherNode, grandchildNode);
+	CHECK_THROWS(sceneGraph.SetParent(rootNode, otherNode));
+
+	sceneGraph.RemoveNode(childNode);
+	CHECK(sceneGraph.GetParent(grandchildNode) == rootNode);
+	sceneGraph.UpdateWorldMatrices();
+
+	CHECK(NearlyEqual(grandchild->GetModelMatrix(), root->GetLocalMatrix() * grandchild->GetLocalMatrix(), 1e-5f));
+	CHECK(NearlyEqual(other->GetModelMatrix(), root->GetLocalMatrix() * grandchild->GetLocalMatrix() * other->GetLocalMatrix(), 1e-5f));
+	CHECK(child->GetSceneNode() == SceneGraph::INVALID_NODE);
+	CHECK(NearlyEqual(child->GetModelMatrix(), child->GetLocalMatrix(), 1e-6f));
+}
+
+#pragma endregion
+
+#pragma region Instance Formats
+
+//Reads an instance back through the vertex attributes a pipeline declares and rebuilds the model matrix the way the vertex shaders do
+static glm::mat4 DecodeInstance(InstanceFormat format, const char* instance)
+{
+	std::array<VkVertexInputAttributeDescription, 4> attributes = TransformData::getAttributeDescriptions(format);
+	std::array<glm::vec4, 4> values;
+
+	for (size_t i = 0; i < attributes.size(); i++) {
+		uint32_t size = attributes[i].format == VK_FORMAT_R16G16B16A16_SFLOAT ? sizeof(uint64_t) : sizeof(glm::vec4);
+
+		//The attributes a format uses have to stay inside the instance
+		if (i < TransformData::GetAttributeCount(format)) {
+			CHECK(attributes[i].offset + size <= TransformData::GetStride(format));
+		}
+
+		if (attributes[i].format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+			uint64_t packed;
+			memcpy(&packed, instance + attributes[i].offset, sizeof(packed));
+			values[i] = glm::unpackHalf4x16(packed);
+		}
+		else {
+			memcpy(&values[i], instance + attributes[i].offset, sizeof(glm::vec4));
+		}
+	}
+
+	if (format == InstanceFormat::Matrix4x4) {
+		return glm::mat4(values[0], values[1], values[2], values[3]);
+	}
+
+	if (format == InstanceFormat::Affine3x4) {
+		return glm::transpose(glm::mat4(values[0], values[1], values[2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+	}
+
+	glm::vec4 q = glm::normalize(values[1]);
+	glm::mat3 rotation = glm::mat3(
+		1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y),
+		2.0f * (q.x * q.y - q.w * q.z), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z + q.w * q.x),
+		2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * values[0].w;
+
+	return glm::mat4(glm::vec4(rotation[0], 0.0f), glm::vec4(rotation[1], 0.0f), glm::vec4(rotation[2], 0.0f), glm::vec4(glm::vec3(values[0]), 1.0f));
+}
+
+static void TestInstanceFormats()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> scale(0.25f, 3.0f);
+
+	for (int i = 0; i < 200; i++) {
+		Transform transform(RandomPoint(random, 500.0f), glm::quat(glm::vec3(angle(random), angle(random), angle(random))), glm::vec3(scale(random)));
+		glm::mat4 model = transform.GetLocalMatrix();
+
+		//Half float quaternions lose precision in the rotation, the position is kept at full precision
+		for (uint32_t f = 0; f < INSTANCE_FORMAT_COUNT; f++) {
+			InstanceFormat format = static_cast<InstanceFormat>(f);
+			float tolerance = format == InstanceFormat::PositionRotationScaleHalf ? 0.01f : 1e-4f;
+
+			std::array<char, TransformData::MAX_STRIDE + 3> buffer = {};
+			TransformData::Pack(format, model, buffer.data() + 3);
+
+			glm::mat4 decoded = DecodeInstance(format, buffer.data() + 3);
+			CHECK(NearlyEqual(glm::mat4(glm::mat3(decoded)), glm::mat4(glm::mat3(model)), tolerance * 3.0f));
+			CHECK(glm::length(glm::vec3(decoded[3]) - glm::vec3(model[3])) <= 1e-3f);
+		}
+	}
+
+	//The matrix layouts keep shear and non-uniform scale exactly
+	glm::mat4 sheared = glm::mat4(1.0f);
+	sheared[1][0] = 0.5f;
+	sheared[2][2] = 3.0f;
+	sheared[3] = glm::vec4(7.0f, -2.0f, 1.0f, 1.0f);
+
+	for (InstanceFormat format : { InstanceFormat::Matrix4x4, InstanceFormat::Affine3x4 }) {
+		std::array<char, TransformData::MAX_STRIDE> buffer = {};
+		TransformData::Pack(format, sheared, buffer.data());
+		CHECK(DecodeInstance(format, buffer.data()) == sheared);
+	}
+
+	//Non-uniform scales round up to the largest axis so instances never shrink out of their bounds
+	glm::mat4 stretched = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 4.0f));
+	std::array<char, TransformData::MAX_STRIDE> buffer = {};
+	TransformData::Pack(InstanceFormat::PositionRotationScale, stretched, buffer.data());
+	CHECK(NearlyEqual(DecodeInstance(InstanceFormat::PositionRotationScale, buffer.data()), glm::scale(glm::mat4(1.0f), glm::vec3(4.0f)), 1e-5f));
+}
+
+#pragma endregion
+
+int main()
+{
+	const std::vector<std::pair<const char*, std::function<void()>>> tests = {
+		{ "RadixSortOrder", TestRadixSortOrder },
+		{ "RadixSortStability", TestRadixSortStability },
+		{ "RenderQueueDrawOrder", TestRenderQueueDrawOrder },
+		{ "InstanceBVHQueries", TestInstanceBVHQueries },
+		{ "TriangleBVHRays", TestTriangleBVHRays },
+		{ "ArchiveCompression", TestArchiveCompression },
+		{ "ArchivePacking", TestArchivePacking },
+		{ "WorldHandles", TestWorldHandles },
+		{ "SceneGraphWorldMatrices", TestSceneGraphWorldMatrices },
+		{ "InstanceFormats", TestInstanceFormats }
+	};
+
+	for (const auto& test : tests) {
+		int failedBefore = failedChecks;
+
+		try {
+			test.second();
+		}
+		catch (const std::exception& e) {
+			std::cerr << test.first << " threw: " << e.what() << std::endl;
+			failedChecks++;
+		}
+
+		std::cout << (failedChecks == failedBefore ? "PASS " : "FAIL ") << test.first << std::endl;
+	}
+
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "pch.h"
+#include "World.h"
+
+#pragma region Constructor
+
+World::World()
+{
+	//Ticks start above 0 so every column counts as changed since 0
+	tick = 1;
+}
+
+#pragma endregion
+
+#pragma region Components
+
+std::vector<size_t>& World::GetComponentSizes()
+{
+	static std::vector<size_t> componentSizes;
+	return componentSizes;
+}
+
+uint32_t World::RegisterComponent(size_t size)
+{
+	std::vector<size_t>& componentSizes = GetComponentSizes();
+
+	if (componentSizes.size() >= MAX_COMPONENTS) {
+		throw std::runtime_error("Too many component types!");
+	}
+
+	componentSizes.push_back(size);
+
+	return static_cast<uint32_t>(componentSizes.size() - 1);
+}
+
+void* World::GetComponentData(Entity entity, uint32_t componentId, bool write)
+{
+	EntityRecord& record = GetRecord(entity);
+	Archetype& archetype = *archetypes[record.archetype];
+	int32_t column = archetype.columns[componentId];
+
+	if (column < 0) {
+		throw std::runtime_error("Entity does not have the requested component!");
+	}
+
+	Chunk& chunk = archetype.chunks[record.chunk];
+
+	if (write) {
+		chunk.changeTicks[column] = ++tick;
+	}
+
+	return chunk.data.get() + archetype.columnOffsets[column] + GetComponentSizes()[componentId] * record.row;
+}
+
+#pragma endregion
+
+#pragma region Storage
+
+uint32_t World::GetArchetype(uint64_t signature)
+{
+	auto existing = archetypeLookup.find(signature);
+
+	if (existing != archetypeLookup.end()) {
+		return existing->second;
+	}
+
+	std::unique_ptr<Archetype> archetype = std::make_unique<Archetype>();
+	archetype->signature = signature;
+	archetype->columns.fill(-1);
+
+	size_t entitySize = 0;
+	for (uint32_t id = 0; id < MAX_COMPONENTS; id++) {
+		if ((signature & (1ull << id)) != 0) {
+			archetype->columns[id] = static_cast<int32_t>(archetype->componentIds.size());
+			archetype->componentIds.push_back(id);
+			entitySize += GetComponentSizes()[id];
+		}
+	}
+
+	//Leave room for every column to be aligned to 16 bytes
+	size_t padding = 16 * archetype->componentIds.size();
+	archetype->chunkCapacity = static_cast<uint32_t>(std::max<size_t>(1, (CHUNK_SIZE - padding) / std::max<size_t>(1, entitySize)));
+
+	//Columns are laid out back to back, each one holding chunkCapacity components
+	size_t offset = 0;
+	for (uint32_t id : archetype->componentIds) {
+		archetype->columnOffsets.push_back(offset);
+		offset += GetComponentSizes()[id] * archetype->chunkCapacity;
+		offset = (offset + 15) & ~static_cast<size_t>(15);
+	}
+
+	uint32_t index = static_cast<uint32_t>(archetypes.size());
+	archetypes.push_back(std::move(archetype));
+	archetypeLookup[signature] = index;
+
+	return index;
+}
+
+Entity World::CreateEntity(uint64_t signature)
+{
+	//Reuse the indices of destroyed entities, the generation was bumped when they were destroyed
+	Entity entity = {};
+	if (!freeEntities.empty()) {
+		entity.index = freeEntities.back();
+		freeEntities.pop_back();
+	}
+	else {
+		entity.index = static_cast<uint32_t>(records.size());
+		records.push_back({});
+	}
+
+	entity.generation = records[entity.index].generation;
+	records[entity.index].alive = true;
+
+	AllocateRow(entity, GetArchetype(signature));
+
+	return entity;
+}
+
+void World::AllocateRow(Entity entity, uint32_t archetypeIndex)
+{
+	Archetype& archetype = *archetypes[archetypeIndex];
+
+	if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.chunkCapacity) {
+		Chunk chunk = {};
+		chunk.data = std::make_unique<uint8_t[]>(CHUNK_SIZE);
+		chunk.entities.resize(archetype.chunkCapacity);
+		chunk.changeTicks.assign(archetype.componentIds.size(), ++tick);
+		chunk.count = 0;
+		archetype.chunks.push_back(std::move(chunk));
+	}
+
+	uint32_t chunkIndex = static_cast<uint32_t>(archetype.chunks.size() - 1);
+	Chunk& chunk = archetype.chunks[chunkIndex];
+	uint32_t row = chunk.count++;
+	chunk.entities[row] = entity;
+
+	EntityRecord& record = records[entity.index];
+	record.archetype = archetypeIndex;
+	record.chunk = chunkIndex;
+	record.row = row;
+}
+
+void World::RemoveRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row)
+{
+	Archetype& archetype = *archetypes[archetypeIndex];
+	Chunk& lastChunk = archetype.chunks.back();
+	uint32_t lastRow = lastChunk.count - 1;
+	Chunk& chunk = archetype.chunks[chunkIndex];
+
+	//Move the archetype's last entity into the hole unless it is the one being removed
+	if (&chunk != &lastChunk || row != lastRow) {
+		for (size_t column = 0; column < archetype.componentIds.size(); column++) {
+			size_t size = GetComponentSizes()[archetype.componentIds[column]];
+			uint8_t* destination = chunk.data.get() + archetype.columnOffsets[column] + size * row;
+			uint8_t* source = lastChunk.data.get() + archetype.columnOffsets[column] + size * lastRow;
+			memcpy(destination, source, size);
+
+			chunk.changeTicks[column] = tick;
+		}
+
+		Entity moved = lastChunk.entities[lastRow];
+		chunk.entities[row] = moved;
+		records[moved.index].chunk = chunkIndex;
+		records[moved.index].row = row;
+	}
+
+	lastChunk.count--;
+
+	//Free the last chunk once it is empty so the next removal always finds an entity to move at the back
+	if (lastChunk.count == 0 && archetype.chunks.size() > 1) {
+		archetype.chunks.pop_back();
+	}
+}
+
+void World::MoveEntity(Entity entity, uint64_t signature)
+{
+	EntityRecord record = GetRecord(entity);
+	uint32_t target = GetArchetype(signature);
+
+	AllocateRow(entity, target);
+
+	Archetype& source = *archetypes[record.archetype];
+	Archetype& destination = *archetypes[target];
+	EntityRecord& moved = records[entity.index];
+	Chunk& sourceChunk = source.chunks[record.chunk];
+	Chunk& destinationChunk = destination.chunks[moved.chunk];
+
+	//Copy the components both archetypes have, anything added is written by the caller
+	for (uint32_t id : source.componentIds) {
+		int32_t column = destination.columns[id];
+		if (column < 0) {
+			continue;
+		}
+
+		size_t size = GetComponentSizes()[id];
+		memcpy(destinationChunk.data.get() + destination.columnOffsets[column] + size * moved.row,
+			sourceChunk.data.get() + source.columnOffsets[source.columns[id]] + size * record.row,
+			size);
+
+		destinationChunk.changeTicks[column] = ++tick;
+	}
+
+	RemoveRow(record.archetype, record.chunk, record.row);
+}
+
+World::EntityRecord& World::GetRecord(Entity entity)
+{
+	if (!IsAlive(entity)) {
+		throw std::runtime_error("Entity has been destroyed!");
+	}
+
+	return records[entity.index];
+}
+
+#pragma endregion
+
+#pragma region Entities
+
+Entity World::CreateEntity()
+{
+	return CreateEntity(0ull);
+}
+
+void World::DestroyEntity(Entity entity)
+{
+	EntityRecord& record = GetRecord(entity);
+	RemoveRow(record.archetype, record.chunk, record.row);
+
+	//Bumping the generation invalidates every handle to this entity
+	record.alive = false;
+	record.generation++;
+	freeEntities.push_back(entity.index);
+}
+
+bool World::IsAlive(Entity entity)
+{
+	return entity.index < records.size() && records[entity.index].alive && records[entity.index].generation == entity.generation;
+}
+
+size_t World::GetEntityCount()
+{
+	return records.size() - freeEntities.size();
+}
+
+#pragma endregion
+
+#pragma region Queries
+
+uint64_t World::GetTick()
+{
+	return tick;
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,432 @@
+#pragma once
+
+#include "pch.h"
+
+#include <unordered_map>
+#include <tuple>
+#include <type_traits>
+#include <thread>
+
+//Identifies an entity, the generation changes every time an index is reused so stale handles can be detected
+struct Entity
+{
+	uint32_t index;
+	uint32_t generation;
+
+	bool operator==(const Entity& other) const
+	{
+		return index == other.index && generation == other.generation;
+	}
+
+	bool operator!=(const Entity& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+class World
+{
+public:
+	static const uint32_t MAX_COMPONENTS = 64;
+
+	//Chunks are small enough that a system working through one stays in cache
+	static const size_t CHUNK_SIZE = 16384;
+
+	//Below this many matching entities a single thread is faster than starting workers
+	static const size_t PARALLEL_ENTITY_THRESHOLD = 4096;
+
+private:
+	//A fixed size block of entities sharing an archetype, every component type is stored as its own contiguous array
+	struct Chunk
+	{
+		std::unique_ptr<uint8_t[]> data;
+		std::vector<Entity> entities;
+		//The tick each column was last written on so systems can skip chunks that haven't changed
+		std::vector<uint64_t> changeTicks;
+		uint32_t count;
+	};
+
+	//Every entity with exactly the same set of components shares an archetype
+	//Only the last chunk of an archetype is ever partially filled
+	struct Archetype
+	{
+		uint64_t signature;
+		std::vector<uint32_t> componentIds;
+		std::array<int32_t, MAX_COMPONENTS> columns;
+		std::vector<size_t> columnOffsets;
+		uint32_t chunkCapacity;
+		std::vector<Chunk> chunks;
+	};
+
+	struct EntityRecord
+	{
+		uint32_t archetype;
+		uint32_t chunk;
+		uint32_t row;
+		uint32_t generation;
+		bool alive;
+	};
+
+	std::vector<std::unique_ptr<Archetype>> archetypes;
+	std::unordered_map<uint64_t, uint32_t> archetypeLookup;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeEntities;
+	uint64_t tick;
+
+#pragma region Components
+
+	/// <summary>
+	/// Returns the size of every registered component type indexed by component id
+	/// </summary>
+	static std::vector<size_t>& GetComponentSizes();
+
+	/// <summary>
+	/// Assigns the next component id to a component type
+	/// </summary>
+	/// <param name="size">The size of the component in bytes</param>
+	/// <returns>The component's id</returns>
+	static uint32_t RegisterComponent(size_t size);
+
+	/// <summary>
+	/// Returns the combined signature of a list of component types
+	/// </summary>
+	template<class... T>
+	static uint64_t GetSignature()
+	{
+		return (0ull | ... | (1ull << GetComponentId<std::remove_const_t<T>>()));
+	}
+
+	/// <summary>
+	/// Returns a pointer to a component of an entity
+	/// </summary>
+	/// <param name="entity">The entity to read from</param>
+	/// <param name="componentId">The component to find</param>
+	/// <param name="write">Whether the component will be written to, marking its column as changed</param>
+	/// <returns>A pointer to the component</returns>
+	void* GetComponentData(Entity entity, uint32_t componentId, bool write);
+
+#pragma endregion
+
+#pragma region Storage
+
+	/// <summary>
+	/// Finds the archetype with the specified signature, creating it if it doesn't exist yet
+	/// </summary>
+	/// <param name="signature">The component bits of the archetype</param>
+	/// <returns>The index of the archetype</returns>
+	uint32_t GetArchetype(uint64_t signature);
+
+	/// <summary>
+	/// Creates an entity with space for the components in a signature, the components are left uninitialized
+	/// </summary>
+	Entity CreateEntity(uint64_t signature);
+
+	/// <summary>
+	/// Adds an entity to the end of an archetype and updates its record
+	/// </summary>
+	/// <param name="entity">The entity to add</param>
+	/// <param name="archetypeIndex">The archetype to add it to</param>
+	void AllocateRow(Entity entity, uint32_t archetypeIndex);
+
+	/// <summary>
+	/// Removes a row from an archetype, filling the hole with the archetype's last entity so the chunks stay packed
+	/// </summary>
+	void RemoveRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row);
+
+	/// <summary>
+	/// Moves an entity into the archetype matching a new signature, keeping the components both archetypes share
+	/// </summary>
+	void MoveEntity(Entity entity, uint64_t signature);
+
+	/// <summary>
+	/// Throws if an entity handle is stale
+	/// </summary>
+	EntityRecord& GetRecord(Entity entity);
+
+#pragma endregion
+
+#pragma region Queries
+
+	/// <summary>
+	/// Returns the start of a component column in a chunk
+	/// </summary>
+	template<class T>
+	static T* GetColumn(Archetype& archetype, Chunk& chunk)
+	{
+		int32_t column = archetype.columns[GetComponentId<std::remove_const_t<T>>()];
+		return reinterpret_cast<T*>(chunk.data.get() + archetype.columnOffsets[column]);
+	}
+
+	/// <summary>
+	/// Returns whether a chunk's column was written to after a tick
+	/// </summary>
+	template<class T>
+	static bool ChangedSince(Archetype& archetype, Chunk& chunk, uint64_t since)
+	{
+		int32_t column = archetype.columns[GetComponentId<std::remove_const_t<T>>()];
+		return chunk.changeTicks[column] > since;
+	}
+
+	/// <summary>
+	/// Marks the non const columns of a query as changed in a chunk
+	/// </summary>
+	template<class T>
+	static void MarkWritten(Archetype& archetype, Chunk& chunk, uint64_t currentTick)
+	{
+		if (!std::is_const_v<T>) {
+			chunk.changeTicks[archetype.columns[GetComponentId<std::remove_const_t<T>>()]] = currentTick;
+		}
+	}
+
+	/// <summary>
+	/// Calls a function for every entity in a chunk
+	/// </summary>
+	template<class... T, class F>
+	static void EachInChunk(Archetype& archetype, Chunk& chunk, F& function)
+	{
+		std::tuple<T*...> columns(GetColumn<T>(archetype, chunk)...);
+
+		for (uint32_t row = 0; row < chunk.count; row++) {
+			function(chunk.entities[row], std::get<T*>(columns)[row]...);
+		}
+	}
+
+	/// <summary>
+	/// Collects the non empty chunks of every archetype that has all of a query's components
+	/// Chunks whose first component hasn't been written since a tick are skipped
+	/// </summary>
+	template<class... T>
+	std::vector<std::pair<Archetype*, Chunk*>> FindChunks(uint64_t since)
+	{
+		uint64_t signature = GetSignature<T...>();
+		std::vector<std::pair<Archetype*, Chunk*>> matches;
+
+		for (std::unique_ptr<Archetype>& archetype : archetypes) {
+			if ((archetype->signature & signature) != signature) {
+				continue;
+			}
+
+			for (Chunk& chunk : archetype->chunks) {
+				if (chunk.count == 0) {
+					continue;
+				}
+
+				using First = std::tuple_element_t<0, std::tuple<T...>>;
+				if (!ChangedSince<First>(*archetype, chunk, since)) {
+					continue;
+				}
+
+				matches.emplace_back(archetype.get(), &chunk);
+			}
+		}
+
+		return matches;
+	}
+
+#pragma endregion
+
+public:
+#pragma region Constructor
+
+	World();
+
+#pragma endregion
+
+#pragma region Components
+
+	/// <summary>
+	/// Returns the id of a component type, assigning one the first time the type is used
+	/// Components are moved around with memcpy so they have to be trivially copyable
+	/// </summary>
+	template<class T>
+	static uint32_t GetComponentId()
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Components must be trivially copyable!");
+
+		static const uint32_t id = RegisterComponent(sizeof(T));
+		return id;
+	}
+
+#pragma endregion
+
+#pragma region Entities
+
+	/// <summary>
+	/// Creates an entity without any components
+	/// </summary>
+	/// <returns>The new entity</returns>
+	Entity CreateEntity();
+
+	/// <summary>
+	/// Creates an entity directly in the archetype of its components so it never has to be moved
+	/// </summary>
+	/// <param name="components">The entity's initial components</param>
+	/// <returns>The new entity</returns>
+	template<class... T>
+	Entity CreateEntity(const T&... components)
+	{
+		Entity entity = CreateEntity(GetSignature<T...>());
+		(new (GetComponentData(entity, GetComponentId<T>(), true)) T(components), ...);
+
+		return entity;
+	}
+
+	/// <summary>
+	/// Destroys an entity and its components, its handle becomes stale
+	/// </summary>
+	/// <param name="entity">The entity to destroy</param>
+	void DestroyEntity(Entity entity);
+
+	/// <summary>
+	/// Returns whether an entity handle refers to an entity that hasn't been destroyed
+	/// </summary>
+	bool IsAlive(Entity entity);
+
+	/// <summary>
+	/// Returns the number of entities that are alive
+	/// </summary>
+	size_t GetEntityCount();
+
+	/// <summary>
+	/// Adds a component to an entity, replacing it if the entity already has one
+	/// </summary>
+	/// <param name="entity">The entity to add to</param>
+	/// <param name="component">The component's value</param>
+	template<class T>
+	void AddComponent(Entity entity, const T& component)
+	{
+		uint64_t bit = 1ull << GetComponentId<T>();
+		uint64_t signature = archetypes[GetRecord(entity).archetype]->signature;
+
+		if ((signature & bit) == 0) {
+			MoveEntity(entity, signature | bit);
+		}
+
+		new (GetComponentData(entity, GetComponentId<T>(), true)) T(component);
+	}
+
+	/// <summary>
+	/// Removes a component from an entity
+	/// </summary>
+	/// <param name="entity">The entity to remove from</param>
+	template<class T>
+	void RemoveComponent(Entity entity)
+	{
+		uint64_t bit = 1ull << GetComponentId<T>();
+		uint64_t signature = archetypes[GetRecord(entity).archetype]->signature;
+
+		if ((signature & bit) != 0) {
+			MoveEntity(entity, signature & ~bit);
+		}
+	}
+
+	/// <summary>
+	/// Returns whether an entity has a component
+	/// </summary>
+	template<class T>
+	bool HasComponent(Entity entity)
+	{
+		return (archetypes[GetRecord(entity).archetype]->signature & (1ull << GetComponentId<T>())) != 0;
+	}
+
+	/// <summary>
+	/// Returns a reference to an entity's component, the reference is invalidated when components are added to or removed from any entity
+	/// </summary>
+	/// <param name="entity">The entity to read from</param>
+	/// <returns>The component, marked as changed unless T is const</returns>
+	template<class T>
+	T& GetComponent(Entity entity)
+	{
+		return *reinterpret_cast<T*>(GetComponentData(entity, GetComponentId<std::remove_const_t<T>>(), !std::is_const_v<T>));
+	}
+
+#pragma endregion
+
+#pragma region Queries
+
+	/// <summary>
+	/// Returns the current tick, every query that writes to components advances it
+	/// </summary>
+	uint64_t GetTick();
+
+	/// <summary>
+	/// Calls a function with every entity that has all of the listed components
+	/// Components listed as const are read only, every other column is marked as changed
+	/// </summary>
+	/// <param name="function">Called as function(Entity, T&...)</param>
+	template<class... T, class F>
+	void Each(F function)
+	{
+		EachChanged<T...>(0, function);
+	}
+
+	/// <summary>
+	/// Calls a function with every entity whose first listed component was written after a tick
+	/// Changes are tracked per chunk so unchanged neighbours of a changed entity are visited too
+	/// </summary>
+	/// <param name="since">A tick returned by GetTick</param>
+	/// <param name="function">Called as function(Entity, T&...)</param>
+	template<class... T, class F>
+	void EachChanged(uint64_t since, F function)
+	{
+		std::vector<std::pair<Archetype*, Chunk*>> chunks = FindChunks<T...>(since);
+		uint64_t currentTick = ++tick;
+
+		for (std::pair<Archetype*, Chunk*>& chunk : chunks) {
+			(MarkWritten<T>(*chunk.first, *chunk.second, currentTick), ...);
+			EachInChunk<T...>(*chunk.first, *chunk.second, function);
+		}
+	}
+
+	/// <summary>
+	/// Calls a function with every entity that has all of the listed components, splitting the chunks between threads
+	/// The function must only touch the components it is given, entities can't be created or changed until it returns
+	/// </summary>
+	/// <param name="function">Called as function(Entity, T&...) from several threads at once</param>
+	template<class... T, class F>
+	void ParallelEach(F function)
+	{
+		std::vector<std::pair<Archetype*, Chunk*>> chunks = FindChunks<T...>(0);
+		uint64_t currentTick = ++tick;
+		size_t entityCount = 0;
+
+		for (std::pair<Archetype*, Chunk*>& chunk : chunks) {
+			(MarkWritten<T>(*chunk.first, *chunk.second, currentTick), ...);
+			entityCount += chunk.second->count;
+		}
+
+		size_t threadCount = 1;
+		if (entityCount >= PARALLEL_ENTITY_THRESHOLD) {
+			threadCount = std::max<size_t>(1, std::min<size_t>({ std::thread::hardware_concurrency(), entityCount / PARALLEL_ENTITY_THRESHOLD, chunks.size() }));
+		}
+
+		//Whole chunks are handed out so no two threads ever share one
+		auto work = [&](size_t begin, size_t end) {
+			F threadFunction = function;
+
+			for (size_t i = begin; i < end; i++) {
+				EachInChunk<T...>(*chunks[i].first, *chunks[i].second, threadFunction);
+			}
+		};
+
+		if (threadCount == 1) {
+			work(0, chunks.size());
+			return;
+		}
+
+		size_t chunksPerThread = (chunks.size() + threadCount - 1) / threadCount;
+		std::vector<std::thread> workers;
+
+		for (size_t t = 0; t < threadCount; t++) {
+			size_t begin = std::min(t * chunksPerThread, chunks.size());
+			size_t end = std::min(begin + chunksPerThread, chunks.size());
+			workers.emplace_back(work, begin, end);
+		}
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+#pragma endregion
+};
\ No newline at end of file
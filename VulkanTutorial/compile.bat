@@ -1,3 +1,9 @@
 C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\BasicShader.vert -o shaders\vert.spv
 C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\BasicShader.frag -o shaders\frag.spv
+C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\ClusterLights.comp -o shaders\cluster.spv
+C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\DepthOnly.vert -o shaders\depth.spv
+C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\HiZReduce.comp -o shaders\hiz.spv
+C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\OcclusionCull.comp -o shaders\cull.spv
+C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\ParticleUpdate.comp -o shaders\particles.spv
+C:\VulkanSDK\1.2.135.0\Bin\glslc.exe shaders\SkinVertices.comp -o shaders\skin.spv
 pause
\ No newline at end of file
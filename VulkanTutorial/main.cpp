@@ -1,10 +1,81 @@
 #include "pch.h"
 
 #include "TriangleApp.h"
+#include "TextureBaker.h"
+#include "ArchivePacker.h"
+#include "Benchmark.h"
+#include "MicroBenchmark.h"
+
+#include <iostream>
 
 //Check Vulkan Lib and Include paths if there are linker errors, these need to be installed separately as they are too large for default github file storage
 
-int main() {
+int main(int argc, char* argv[]) {
+	//Bake a texture instead of running the app: VulkanTutorial --bake <input> <output> [auto|bc1|bc3|bc4|bc5]
+	if (argc >= 4 && std::string(argv[1]) == "--bake") {
+		try {
+			TextureBaker::Bake(argv[2], argv[3], argc >= 5 ? TextureBaker::ParseCompression(argv[4]) : TextureCompression::Auto);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	//Pack assets instead of running the app: VulkanTutorial --pack <output> <directory or file>...
+	if (argc >= 4 && std::string(argv[1]) == "--pack") {
+		try {
+			ArchivePacker::Pack(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	//Sweep generated scenes instead of running the demo: VulkanTutorial --benchmark [output.csv|output.json] [--frames N] [--warmup N] [--quick] [--memory-log memory.csv]
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark") {
+		try {
+			Benchmark::Run(std::vector<std::string>(argv + 2, argv + argc));
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	//Print the frame time change between two --benchmark runs: VulkanTutorial --compare <baseline.csv> <candidate.csv>
+	if (argc >= 2 && std::string(argv[1]) == "--compare") {
+		try {
+			Benchmark::Compare(std::vector<std::string>(argv + 2, argv + argc));
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	//Time the CPU hot paths without creating a window or device: VulkanTutorial --microbench [filter] [--min-time seconds] [--output results.csv|results.json]
+	if (argc >= 2 && std::string(argv[1]) == "--microbench") {
+		try {
+			MicroBenchmark::Run(std::vector<std::string>(argv + 2, argv + argc));
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
 	TriangleApp app;
 
 	try {
@@ -13,19 +13,15 @@
 #include <glm/gtc/quaternion.hpp>
 
 //Standard Library Includes
+//Only headers that nearly every file uses belong here, anything else is included by the files that need it
 #include <stdexcept>
 #include <cstdlib>
 #include <cstdint>
-#include <fstream>
-#include <chrono>
-#include <functional>
-#include <algorithm>
-#include <iostream>
+#include <cstring>
+#include <string>
 #include <memory>
 #include <vector>
-#include <map>
-#include <set>
 #include <array>
-#include <optional>
+#include <algorithm>
 
 #endif //PCH_H
\ No newline at end of file
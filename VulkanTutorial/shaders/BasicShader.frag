@@ -1,30 +1,113 @@
 #version 450
 #extension GL_ARB_separate_shader_objects: enable
 
+//Permutation settings, set per pipeline through VkSpecializationInfo so disabled code is compiled out
+layout(constant_id = 0) const int LIGHT_COUNT = 128;
+layout(constant_id = 1) const bool USE_TEXTURE = true;
+layout(constant_id = 2) const bool USE_VERTEX_COLOR = true;
+layout(constant_id = 3) const bool USE_FOG = false;
+layout(constant_id = 4) const int QUALITY = 1;
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 vertColor;
 layout(location = 2) in vec2 uv;
-layout(location = 3) in Light{
+layout(location = 3) in float viewDepth;
+layout(location = 4) flat in float layer;
+
+//Must match the constants in LightClusters.h
+const uint CLUSTER_COUNT_X = 16;
+const uint CLUSTER_COUNT_Y = 9;
+const uint CLUSTER_COUNT_Z = 24;
+const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+struct Light{
 	vec3 position;
-	vec3 color;
 	float range;
-} lights[5];
+	vec3 color;
+	float padding;
+};
+
+layout(binding = 0) uniform UniformBufferObject{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseProjection;
+	vec2 screenSize;
+	float nearPlane;
+	float farPlane;
+	uint lightCount;
+} ubo;
+
+//Set per draw with vkCmdPushConstants, must match DrawConstants.h
+layout(push_constant) uniform DrawConstants{
+	vec4 tint;
+	uint materialIndex;
+	uint lod;
+} draw;
+
+layout(binding = 1) uniform sampler2D texSampler;
+layout(binding = 2) uniform sampler2DArray atlasSampler;
+
+layout(std430, binding = 3) readonly buffer LightBuffer{
+	Light lights[];
+};
+
+layout(std430, binding = 4) readonly buffer ClusterBuffer{
+	uint clusterLightCounts[];
+};
+
+layout(std430, binding = 5) readonly buffer LightIndexBuffer{
+	uint lightIndices[];
+};
 
 layout(location = 0) out vec4 outColor;
 
+const vec3 fogColor = vec3(0.05f, 0.05f, 0.08f);
+const float fogDensity = 0.15f;
+
 void main(){
-	int lightCount = lights.length();
 	vec3 finalColor = vec3(0.0f, 0.0f, 0.0f);
 
-	for(int i = 0; i < lightCount; i++){
-		vec3 lightDistance = vec3(abs(position.x - lights[i].position.x), abs(position.y - lights[i].position.y), abs(position.z - lights[i].position.z));
-		float strength = length(lightDistance) / lights[i].range;
+	//Find the cluster this fragment is in, slices are spaced exponentially in view depth
+	uvec2 tile = uvec2(clamp(gl_FragCoord.xy / ubo.screenSize * vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y), vec2(0.0f), vec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1)));
+	float slice = log(max(viewDepth, ubo.nearPlane) / ubo.nearPlane) / log(ubo.farPlane / ubo.nearPlane) * float(CLUSTER_COUNT_Z);
+	uint clusterIndex = tile.x + CLUSTER_COUNT_X * (tile.y + CLUSTER_COUNT_Y * min(uint(slice), CLUSTER_COUNT_Z - 1));
+
+	//Only the lights that reach this cluster are shaded
+	uint clusterLightCount = min(clusterLightCounts[clusterIndex], uint(LIGHT_COUNT));
+	uint listOffset = clusterIndex * MAX_LIGHTS_PER_CLUSTER;
+
+	for(uint i = 0; i < clusterLightCount; i++){
+		Light light = lights[lightIndices[listOffset + i]];
+
+		float strength = length(position - light.position) / light.range;
 		strength = 1.0f - clamp(strength, 0.0f, 1.0f);
 
-		finalColor += lights[i].color * strength;
+		//Higher quality uses a smooth falloff instead of a linear one
+		if(QUALITY > 0){
+			strength = strength * strength * (3.0f - 2.0f * strength);
+		}
+
+		finalColor += light.color * strength;
 	}
 
 	finalColor += vec3(0.015f, 0.015f, 0.015f);
 
-	outColor = vec4(finalColor * vertColor, 1.0f);
+	if(USE_VERTEX_COLOR){
+		finalColor *= vertColor;
+	}
+
+	vec4 textureColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+	if(USE_TEXTURE){
+		//Meshes packed into the atlas have a layer, everything else uses the streamed texture
+		textureColor = layer < 0.0f ? texture(texSampler, uv) : texture(atlasSampler, vec3(uv, layer));
+	}
+
+	outColor = vec4(finalColor, 1.0f) * textureColor * draw.tint;
+
+	if(USE_FOG){
+		//gl_FragCoord.w is 1 / view depth for a perspective projection
+		float fogAmount = 1.0f - exp(-fogDensity / gl_FragCoord.w);
+		outColor.rgb = mix(outColor.rgb, fogColor, fogAmount);
+	}
 }
\ No newline at end of file
@@ -1,34 +1,75 @@
 #version 450
 #extension GL_ARB_separate_shader_objects: enable
 
-struct Light{
-	vec3 position;
-	vec3 color;
-	float range;
-};
-
 layout(binding = 0) uniform UniformBufferObject{
 	mat4 view;
 	mat4 projection;
+	mat4 inverseProjection;
+	vec2 screenSize;
+	float nearPlane;
+	float farPlane;
+	uint lightCount;
 } ubo;
 
+//Set per draw with vkCmdPushConstants, must match DrawConstants.h
+layout(push_constant) uniform DrawConstants{
+	vec4 tint;
+	uint materialIndex;
+	uint lod;
+} draw;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 texCoord;
+layout(location = 7) in float texLayer;
+
+//Must match InstanceFormat in TransformData.h
+layout(constant_id = 5) const int INSTANCE_FORMAT = 0;
 
-//Instanced Data
-layout(location = 3) in mat4 model;
+//Instanced Data, formats smaller than a full matrix leave the last vectors unused
+layout(location = 3) in vec4 instance0;
+layout(location = 4) in vec4 instance1;
+layout(location = 5) in vec4 instance2;
+layout(location = 6) in vec4 instance3;
 
 layout(location = 0) out vec3 position;
 layout(location = 1) out vec3 vertColor;
 layout(location = 2) out vec2 uv;
-layout(location = 3) out Light lights[5];
+layout(location = 3) out float viewDepth;
+layout(location = 4) flat out float layer;
+
+//Must match DepthOnly.vert exactly so the depth pre-pass and color pass produce the same depth
+invariant gl_Position;
+
+//Rebuilds the model matrix from the instance format, must match DepthOnly.vert
+mat4 InstanceModel(){
+	if(INSTANCE_FORMAT == 0){
+		return mat4(instance0, instance1, instance2, instance3);
+	}
+
+	//Affine rows, the last row of the matrix is always (0, 0, 0, 1)
+	if(INSTANCE_FORMAT == 1){
+		return transpose(mat4(instance0, instance1, instance2, vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+	}
+
+	//Position and uniform scale followed by a quaternion, half float quaternions are renormalized after their rounding
+	vec4 q = normalize(instance1);
+
+	mat3 rotation = mat3(
+		1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y),
+		2.0f * (q.x * q.y - q.w * q.z), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z + q.w * q.x),
+		2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * instance0.w;
+
+	return mat4(vec4(rotation[0], 0.0f), vec4(rotation[1], 0.0f), vec4(rotation[2], 0.0f), vec4(instance0.xyz, 1.0f));
+}
 
 void main(){
-	mat4 mvp = ubo.projection * ubo.view * model;
-	gl_Position = mvp * vec4(inPosition, 1.0f);
-	position = (model * vec4(inPosition, 1.0f)).xyz;
-	lights[0] = Light(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 1.0f), 2.5f);
+	vec4 worldPosition = InstanceModel() * vec4(inPosition, 1.0f);
+	vec4 viewPosition = ubo.view * worldPosition;
+	gl_Position = ubo.projection * viewPosition;
+	position = worldPosition.xyz;
+	viewDepth = -viewPosition.z;
 	vertColor = inColor;
 	uv = texCoord;
+	layer = texLayer;
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+layout(binding = 0) uniform UniformBufferObject{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseProjection;
+	vec2 screenSize;
+	float nearPlane;
+	float farPlane;
+	uint lightCount;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+
+//Must match InstanceFormat in TransformData.h
+layout(constant_id = 5) const int INSTANCE_FORMAT = 0;
+
+//Instanced Data, formats smaller than a full matrix leave the last vectors unused
+layout(location = 3) in vec4 instance0;
+layout(location = 4) in vec4 instance1;
+layout(location = 5) in vec4 instance2;
+layout(location = 6) in vec4 instance3;
+
+//Must be computed exactly like BasicShader.vert so the color pass can depth test with EQUAL
+invariant gl_Position;
+
+//Rebuilds the model matrix from the instance format, must match BasicShader.vert
+mat4 InstanceModel(){
+	if(INSTANCE_FORMAT == 0){
+		return mat4(instance0, instance1, instance2, instance3);
+	}
+
+	//Affine rows, the last row of the matrix is always (0, 0, 0, 1)
+	if(INSTANCE_FORMAT == 1){
+		return transpose(mat4(instance0, instance1, instance2, vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+	}
+
+	//Position and uniform scale followed by a quaternion, half float quaternions are renormalized after their rounding
+	vec4 q = normalize(instance1);
+
+	mat3 rotation = mat3(
+		1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y),
+		2.0f * (q.x * q.y - q.w * q.z), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z + q.w * q.x),
+		2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * instance0.w;
+
+	return mat4(vec4(rotation[0], 0.0f), vec4(rotation[1], 0.0f), vec4(rotation[2], 0.0f), vec4(instance0.xyz, 1.0f));
+}
+
+void main(){
+	vec4 worldPosition = InstanceModel() * vec4(inPosition, 1.0f);
+	vec4 viewPosition = ubo.view * worldPosition;
+	gl_Position = ubo.projection * viewPosition;
+}
\ No newline at end of file